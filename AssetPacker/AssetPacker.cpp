@@ -0,0 +1,142 @@
+//============================================================================
+// Name        : AssetPacker.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Builds an asset pack out of a resource folder, so our demos
+//               can load everything from one memory mapped file.
+//               Every file under the folder goes in, under its path relative
+//               to the folder (like "glsl/TextureFragmentShader.glsl"),
+//               which is the same path the demos use to find it.
+//
+//               It can also list what's inside an existing pack.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "CmdOptionParser.hpp"
+#include "AssetPack.hpp"
+
+void find_files(const std::string& root, const std::string& relativeDir,
+                std::vector<std::string>& files);
+int list_pack(const std::string& packPath);
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    const std::string &listPath = options.getCmdOption("-l");
+    if (!listPath.empty())
+        return list_pack(listPath);
+
+    const std::string &filePath = options.getCmdOption("-p");
+    const std::string &outputPath = options.getCmdOption("-o");
+
+    if (filePath.empty() || outputPath.empty()) {
+        cout << "Usage: " << argv[0]
+             << " -p <path_to_resource_folder> -o <output_pack>" << endl
+             << "       " << argv[0]
+             << " -l <pack_to_list>" << endl;
+        exit(1);
+    }
+
+    std::vector<std::string> files;
+    find_files(filePath, "", files);
+
+    // so the same folder always makes the same pack
+    std::sort(files.begin(), files.end());
+
+    std::string root = filePath;
+    if (root.back() != '/')
+        root += "/";
+
+    AssetPackWriter writer;
+
+    for (const std::string& file : files) {
+        if (!writer.AddFile(file, root + file))
+            return -1;
+
+        cout << "Added " << file << endl;
+    }
+
+    if (!writer.Write(outputPath))
+        return -1;
+
+    cout << "Wrote " << writer.NumAssets() << " assets to "
+         << outputPath << endl;
+
+    return 0;
+}
+
+
+// Recursively collect the files under root/relativeDir, with their paths
+// relative to root.  We leave out hidden files and our build files.
+void find_files(const std::string& root, const std::string& relativeDir,
+                std::vector<std::string>& files)
+{
+    std::string dirPath = root;
+    if (!relativeDir.empty())
+        dirPath += "/" + relativeDir;
+
+    DIR *dir = opendir(dirPath.c_str());
+    if (dir == nullptr) {
+        cout << "Could not open folder " << dirPath << endl;
+        return;
+    }
+
+    struct dirent *item;
+    while ((item = readdir(dir)) != nullptr) {
+        std::string name = item->d_name;
+
+        if (name.empty() || name[0] == '.' || name.find("Makefile") == 0)
+            continue;
+
+        std::string relativePath = relativeDir.empty() ? name
+                                                       : relativeDir + "/" + name;
+        std::string fullPath = root + "/" + relativePath;
+
+        struct stat info;
+        if (stat(fullPath.c_str(), &info) != 0)
+            continue;
+
+        if (S_ISDIR(info.st_mode))
+            find_files(root, relativePath, files);
+        else if (S_ISREG(info.st_mode))
+            files.push_back(relativePath);
+    }
+
+    closedir(dir);
+}
+
+
+int list_pack(const std::string& packPath)
+{
+    AssetPack pack;
+
+    if (!pack.Open(packPath))
+        return -1;
+
+    cout << pack.NumAssets() << " assets in " << packPath << endl;
+
+    for (size_t i = 0; i < pack.NumAssets(); i++) {
+        AssetSpan asset = pack.Asset(i);
+
+        cout << std::setw(12) << asset.size << "  "
+             << pack.AssetPath(i) << endl;
+    }
+
+    return 0;
+}
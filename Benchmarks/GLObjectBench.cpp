@@ -0,0 +1,147 @@
+//============================================================================
+// Name        : GLObjectBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for the pooled GL object names.
+//               Every 'frame' we create a bunch of buffers, give them some
+//               data, and delete them again.  First with a glGenBuffers()
+//               and glDeleteBuffers() call per buffer, and then with our
+//               GLBuffer, which gets its names from the pool.  Buffers are
+//               still deleted one at a time (they hold storage), so what
+//               the pool saves here is the glGenBuffers() calls.
+//
+//               This needs a GL context, so it opens a hidden window.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "CmdOptionParser.hpp"
+#include "GLObject.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+// Time per frame, in microseconds
+double time_raw(size_t numObjects, unsigned frames)
+{
+    std::vector<GLuint> buffers(numObjects);
+    const float data[16] = {0};
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned frame = 0; frame < frames; frame++) {
+        for (GLuint& buffer : buffers) {
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(data), data, GL_STREAM_DRAW);
+        }
+
+        for (GLuint& buffer : buffers)
+            glDeleteBuffers(1, &buffer);
+    }
+
+    glFinish();
+
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count() / frames;
+}
+
+
+double time_pooled(size_t numObjects, unsigned frames)
+{
+    std::vector<GLBuffer> buffers(numObjects);
+    const float data[16] = {0};
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned frame = 0; frame < frames; frame++) {
+        for (GLBuffer& buffer : buffers) {
+            buffer = GLBuffer::Create();
+            glBindBuffer(GL_ARRAY_BUFFER, buffer.ID());
+            glBufferData(GL_ARRAY_BUFFER, sizeof(data), data, GL_STREAM_DRAW);
+        }
+
+        for (GLBuffer& buffer : buffers)
+            buffer.Reset();
+
+        GLNamePool::FlushAll();
+    }
+
+    glFinish();
+
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count() / frames;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    size_t numObjects = 1000;
+    unsigned frames = 100;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-n <objects_per_frame>] [-f <frames>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        numObjects = std::stoul(options.getCmdOption("-n"));
+    if (!options.getCmdOption("-f").empty())
+        frames = std::stoul(options.getCmdOption("-f"));
+
+    if (!glfwInit()) {
+        cout << "GLFW Initialization Failed!!" << endl;
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "GLObjectBench",
+                                          nullptr, nullptr);
+    if (window == nullptr) {
+        cout << "Failed to create GLFW window" << endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        cout << "Failed to initialize GLEW" << endl;
+        return -1;
+    }
+
+    double raw = time_raw(numObjects, frames);
+    double pooled = time_pooled(numObjects, frames);
+
+    const GLNamePool& pool = GLNamePool::Get(GLNamePool::Buffers);
+
+    cout << std::fixed << std::setprecision(1);
+    cout << numObjects << " buffers created and deleted per frame, "
+         << frames << " frames" << endl
+         << "  one call per buffer:  " << raw << " us/frame, "
+         << 2 * numObjects << " gen/delete calls per frame" << endl
+         << "  pooled names:         " << pooled << " us/frame, "
+         << (double)(pool.GenCalls() + pool.DeleteCalls()) / frames
+         << " gen/delete calls per frame" << endl;
+
+    glfwTerminate();
+
+    return 0;
+}
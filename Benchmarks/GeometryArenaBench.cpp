@@ -0,0 +1,439 @@
+//============================================================================
+// Name        : GeometryArenaBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for the GeometryArena.  We scatter a lot of small
+//               tori of different sizes around, and draw them:
+//               - each with a vertex array and buffers of its own, a bind
+//                 and a draw call per torus, the way the demos do it
+//               - out of a GeometryArena, with one bind and a
+//                 glDrawElementsBaseVertex() per torus
+//               - out of the arena with one multi-draw call for all of them
+//               and print the time per frame for each.
+//
+//               Then we remove half the tori and put different sized ones
+//               in their place, which breaks up the free space, and time
+//               Compact().
+//
+//               We check that the arena draws the same picture as the
+//               separate buffers, and that every torus's vertices and
+//               indices are still where the arena says after compacting,
+//               and exit with an error if not.
+//
+//               This needs a GL context, so it opens a hidden window.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "CmdOptionParser.hpp"
+#include "GLObject.hpp"
+#include "Shader.hpp"
+#include "GeometryArena.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+const int WindowSize = 64;
+
+
+struct Torus
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+
+// n x n quads around a center, small enough that a lot of them fit on the
+// screen
+Torus make_torus(int n, float x, float y, float size)
+{
+    Torus torus;
+
+    for (int i = 0; i <= n; i++) {
+        for (int j = 0; j <= n; j++) {
+            float u = 2.0f * (float)M_PI * i / n;
+            float v = 2.0f * (float)M_PI * j / n;
+            float r = size * (1.0f + 0.25f * std::cos(v));
+
+            MeshVertex vertex = {
+                { x + r * std::cos(u), y + r * std::sin(u),
+                  0.25f * size * std::sin(v) },
+                { 0.5f + 0.5f * std::cos(v), 0.5f + 0.5f * std::sin(u),
+                  0.5f + 0.5f * std::sin(v) },
+                { (float)i / n, (float)j / n }
+            };
+            torus.vertices.push_back(vertex);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            uint32_t a = i * (n + 1) + j;
+            uint32_t b = a + n + 1;
+            uint32_t quad[6] = { a, b, b + 1, a, b + 1, a + 1 };
+            torus.indices.insert(torus.indices.end(), quad, quad + 6);
+        }
+    }
+
+    return torus;
+}
+
+
+std::vector<Torus> make_tori(size_t count, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> segments(3, 16);
+    std::uniform_real_distribution<float> place(-0.9f, 0.9f);
+
+    std::vector<Torus> tori;
+    for (size_t i = 0; i < count; i++) {
+        float x = place(rng);
+        float y = place(rng);
+        tori.push_back(make_torus(segments(rng), x, y, 0.05f));
+    }
+
+    return tori;
+}
+
+
+// The tori drawn the way the demos draw things
+struct SeparateMesh
+{
+    GLVertexArray vertexArray;
+    GLBuffer vertexBuffer;
+    GLBuffer indexBuffer;
+    GLsizei numIndices;
+};
+
+
+SeparateMesh make_separate(const Torus& torus)
+{
+    SeparateMesh mesh;
+
+    mesh.vertexArray = GLVertexArray::Create();
+    mesh.vertexBuffer = GLBuffer::Create();
+    mesh.indexBuffer = GLBuffer::Create();
+    mesh.numIndices = (GLsizei)torus.indices.size();
+
+    glBindVertexArray(mesh.vertexArray.ID());
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer.ID());
+    glBufferData(GL_ARRAY_BUFFER, torus.vertices.size() * sizeof(MeshVertex),
+                 torus.vertices.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer.ID());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 torus.indices.size() * sizeof(uint32_t),
+                 torus.indices.data(), GL_STATIC_DRAW);
+
+    for (const VertexAttribute& attribute :
+         GeometryArena::MeshVertexLayout().attributes) {
+        glVertexAttribPointer(attribute.index, attribute.size,
+                              attribute.type, attribute.normalized,
+                              sizeof(MeshVertex),
+                              (const void *)attribute.offset);
+        glEnableVertexAttribArray(attribute.index);
+    }
+
+    glBindVertexArray(0);
+
+    return mesh;
+}
+
+
+enum DrawMode { Separate, BaseVertex, MultiDraw };
+
+
+void draw(DrawMode mode, std::vector<SeparateMesh>& separate,
+          GeometryArena& arena,
+          std::vector<GeometryArena::Handle>& handles)
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    switch (mode) {
+    case Separate:
+        for (const SeparateMesh& mesh : separate) {
+            glBindVertexArray(mesh.vertexArray.ID());
+            glDrawElements(GL_TRIANGLES, mesh.numIndices, GL_UNSIGNED_INT,
+                           0);
+        }
+        break;
+
+    case BaseVertex:
+        arena.Bind();
+        for (GeometryArena::Handle handle : handles)
+            arena.Draw(handle);
+        break;
+
+    case MultiDraw:
+        arena.Bind();
+        arena.Draw(handles.data(), handles.size());
+        break;
+    }
+
+    glBindVertexArray(0);
+}
+
+
+// Time per frame, in microseconds
+double time_draw(DrawMode mode, unsigned frames,
+                 std::vector<SeparateMesh>& separate, GeometryArena& arena,
+                 std::vector<GeometryArena::Handle>& handles)
+{
+    // once to get everything onto the GPU
+    draw(mode, separate, arena, handles);
+    glFinish();
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned frame = 0; frame < frames; frame++)
+        draw(mode, separate, arena, handles);
+
+    glFinish();
+
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count() / frames;
+}
+
+
+std::vector<unsigned char> read_pixels()
+{
+    std::vector<unsigned char> pixels(WindowSize * WindowSize * 4);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, WindowSize, WindowSize, GL_RGBA, GL_UNSIGNED_BYTE,
+                 pixels.data());
+
+    return pixels;
+}
+
+
+// Read back where the arena says the torus is
+bool check_torus(const GeometryArena& arena, GeometryArena::Handle handle,
+                 const Torus& torus)
+{
+    if (!arena.Contains(handle))
+        return false;
+
+    const GeometryArena::Range& range = arena.RangeOf(handle);
+    if (range.numVertices != torus.vertices.size() ||
+        range.numIndices != torus.indices.size())
+        return false;
+
+    std::vector<MeshVertex> vertices(range.numVertices);
+    std::vector<uint32_t> indices(range.numIndices);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, arena.VertexBuffer());
+    glGetBufferSubData(GL_COPY_READ_BUFFER,
+                       range.firstVertex * sizeof(MeshVertex),
+                       vertices.size() * sizeof(MeshVertex),
+                       vertices.data());
+
+    glBindBuffer(GL_COPY_READ_BUFFER, arena.IndexBuffer());
+    glGetBufferSubData(GL_COPY_READ_BUFFER,
+                       range.firstIndex * sizeof(uint32_t),
+                       indices.size() * sizeof(uint32_t), indices.data());
+
+    return std::memcmp(vertices.data(), torus.vertices.data(),
+                       vertices.size() * sizeof(MeshVertex)) == 0 &&
+           indices == torus.indices;
+}
+
+
+bool check(bool passed, const char *what)
+{
+    cout << (passed ? "  ok:     " : "  FAILED: ") << what << endl;
+    return passed;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    const std::string &filePath = options.getCmdOption("-p");
+    size_t numMeshes = 2000;
+    unsigned frames = 100;
+
+    if (filePath.empty()) {
+        cout << "Usage: " << argv[0]
+             << " -p <path_to_resource_folder> [-n <meshes>] [-f <frames>]"
+             << endl;
+        return 1;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        numMeshes = std::stoul(options.getCmdOption("-n"));
+    if (!options.getCmdOption("-f").empty())
+        frames = std::stoul(options.getCmdOption("-f"));
+
+    std::string root = filePath;
+    if (root.back() != '/')
+        root += "/";
+
+    std::string vertexFile = root + "glsl/BasicVertexShader.glsl";
+    std::string fragmentFile = root + "glsl/BasicFragmentShader.glsl";
+
+    if (!glfwInit()) {
+        cout << "GLFW Initialization Failed!!" << endl;
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(WindowSize, WindowSize,
+                                          "GeometryArenaBench",
+                                          nullptr, nullptr);
+    if (window == nullptr) {
+        cout << "Failed to create GLFW window" << endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        cout << "Failed to initialize GLEW" << endl;
+        return -1;
+    }
+
+    bool passed = true;
+
+    {
+        Shader shader(vertexFile.c_str(), fragmentFile.c_str());
+        if (shader.Program == 0)
+            return 1;
+
+        shader.Use();
+        glViewport(0, 0, WindowSize, WindowSize);
+
+        std::mt19937 rng(1);
+        std::vector<Torus> tori = make_tori(numMeshes, rng);
+
+        size_t numVertices = 0;
+        size_t numIndices = 0;
+        std::vector<SeparateMesh> separate;
+        for (const Torus& torus : tori) {
+            separate.push_back(make_separate(torus));
+            numVertices += torus.vertices.size();
+            numIndices += torus.indices.size();
+        }
+
+        // Start small, so it has to grow a few times
+        GeometryArena arena(GeometryArena::MeshVertexLayout(),
+                            numVertices / 8, numIndices / 8);
+
+        std::vector<GeometryArena::Handle> handles;
+        for (const Torus& torus : tori) {
+            handles.push_back(arena.Add(torus.vertices.data(),
+                                        torus.vertices.size(),
+                                        torus.indices.data(),
+                                        torus.indices.size()));
+        }
+
+        double separateTime = time_draw(Separate, frames, separate, arena,
+                                        handles);
+        std::vector<unsigned char> separatePixels = read_pixels();
+
+        double baseVertexTime = time_draw(BaseVertex, frames, separate,
+                                          arena, handles);
+        std::vector<unsigned char> baseVertexPixels = read_pixels();
+
+        double multiDrawTime = time_draw(MultiDraw, frames, separate, arena,
+                                         handles);
+        std::vector<unsigned char> multiDrawPixels = read_pixels();
+
+        cout << std::fixed << std::setprecision(1)
+             << numMeshes << " meshes, " << numVertices << " vertices, "
+             << numIndices / 3 << " triangles, " << frames << " frames"
+             << endl
+             << "  separate buffers:    " << std::setw(10) << separateTime
+             << " us/frame, " << numMeshes << " binds and draw calls" << endl
+             << "  arena, base vertex:  " << std::setw(10) << baseVertexTime
+             << " us/frame, 1 bind, " << numMeshes << " draw calls" << endl
+             << "  arena, multi-draw:   " << std::setw(10) << multiDrawTime
+             << " us/frame, 1 bind, 1 draw call" << endl
+             << "  the arena grew " << arena.Grows() << " times, to "
+             << arena.VertexCapacity() << " vertices and "
+             << arena.IndexCapacity() << " indices" << endl;
+
+        passed &= check(baseVertexPixels == separatePixels &&
+                        multiDrawPixels == separatePixels,
+                        "the arena draws the same picture");
+
+        // Swap half of the tori for new ones of other sizes
+        std::vector<Torus> replacements = make_tori(numMeshes / 2, rng);
+        std::vector<size_t> replaced;
+
+        for (size_t i = 0; i < numMeshes; i += 2) {
+            arena.Remove(handles[i]);
+            replaced.push_back(i);
+        }
+
+        for (size_t r = 0; r < replaced.size(); r++) {
+            size_t i = replaced[r];
+            tori[i] = std::move(replacements[r]);
+            handles[i] = arena.Add(tori[i].vertices.data(),
+                                   tori[i].vertices.size(),
+                                   tori[i].indices.data(),
+                                   tori[i].indices.size());
+        }
+
+        // And take out a quarter, for holes
+        for (size_t i = 1; i < numMeshes; i += 4) {
+            arena.Remove(handles[i]);
+            handles[i] = GeometryArena::InvalidHandle;
+        }
+
+        double before = arena.Fragmentation();
+        size_t compactions = arena.Compactions();
+
+        Clock::time_point start = Clock::now();
+        size_t copied = arena.Compact();
+        glFinish();
+        std::chrono::duration<double, std::milli> compactTime =
+            Clock::now() - start;
+
+        cout << std::setprecision(2)
+             << "  fragmentation " << before << " -> "
+             << arena.Fragmentation() << ", " << arena.Compactions()
+             << " compactions (" << compactions << " while adding), "
+             << std::setprecision(1) << copied / 1024.0
+             << " KiB copied in " << compactTime.count() << " ms" << endl;
+
+        bool allThere = arena.Fragmentation() == 0.0;
+        size_t live = 0;
+        for (size_t i = 0; i < numMeshes; i++) {
+            if (handles[i] == GeometryArena::InvalidHandle)
+                continue;
+
+            allThere = allThere && check_torus(arena, handles[i], tori[i]);
+            live++;
+        }
+
+        passed &= check(allThere && live == arena.NumMeshes(),
+                        "every mesh is where the arena says after compacting");
+    }
+
+    glfwTerminate();
+
+    return passed ? 0 : 1;
+}
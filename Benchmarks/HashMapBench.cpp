@@ -0,0 +1,262 @@
+//============================================================================
+// Name        : HashMapBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for HashMap against std::unordered_map, with
+//               SpookyHash keys, from a thousand entries up to ten million.
+//               For each size we time inserting all the keys into an empty
+//               map, looking up keys that are there in a random order, and
+//               looking up keys that aren't, and print nanoseconds per
+//               operation for each map.
+//
+//               Along the way we check that both maps find the same values,
+//               that erasing works, and that a ResourceRegistry hands back
+//               what it was given, and exit with an error if not.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "CmdOptionParser.hpp"
+#include "SpookyV2.h"
+#include "HashMap.hpp"
+#include "ResourceRegistry.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// Where the lookups' values go, so they can't be optimized away
+volatile uint64_t sink;
+
+// The hash is already done, so the standard map shouldn't do another
+struct IdentityHash
+{
+    size_t operator()(uint64_t key) const { return (size_t)key; }
+};
+
+typedef std::unordered_map<uint64_t, uint64_t, IdentityHash> StdMap;
+
+
+// Keys like a registry's, the hashes of the numbers from 'first' on
+std::vector<uint64_t> make_keys(size_t first, size_t count)
+{
+    std::vector<uint64_t> keys(count);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t number = first + i;
+        keys[i] = SpookyHash::Hash64(&number, sizeof(number), 0);
+    }
+    return keys;
+}
+
+
+double nanoseconds(Clock::duration elapsed, size_t operations)
+{
+    return std::chrono::duration<double, std::nano>(elapsed).count() /
+           operations;
+}
+
+
+struct Times
+{
+    double insert = 0;
+    double hit = 0;
+    double miss = 0;
+};
+
+
+// 'lookups' is the keys in the order we look them up, with repeats if the
+// map is small, so the timings aren't all clock overhead
+template <typename Insert, typename Find>
+Times time_map(const std::vector<uint64_t>& keys,
+               const std::vector<uint64_t>& lookups,
+               const std::vector<uint64_t>& misses,
+               const Insert& insert, const Find& find, uint64_t& sum)
+{
+    Times times;
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < keys.size(); i++)
+        insert(keys[i], i);
+    times.insert = nanoseconds(Clock::now() - start, keys.size());
+
+    start = Clock::now();
+    for (uint64_t key : lookups)
+        sum += find(key);
+    times.hit = nanoseconds(Clock::now() - start, lookups.size());
+
+    start = Clock::now();
+    for (uint64_t key : misses)
+        sum += find(key);
+    times.miss = nanoseconds(Clock::now() - start, misses.size());
+
+    return times;
+}
+
+
+bool check_map(const std::vector<uint64_t>& keys,
+               const std::vector<uint64_t>& misses,
+               HashMap<uint64_t>& map, const StdMap& stdMap)
+{
+    if (map.Size() != keys.size() || stdMap.size() != keys.size()) {
+        cout << "  the maps have " << map.Size() << " and " << stdMap.size()
+             << " entries, not " << keys.size() << endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        const uint64_t *value = map.Find(keys[i]);
+        if (value == nullptr || *value != i || stdMap.at(keys[i]) != i) {
+            cout << "  key " << i << " has the wrong value" << endl;
+            return false;
+        }
+    }
+
+    for (uint64_t key : misses) {
+        if (map.Contains(key)) {
+            cout << "  found a key that isn't there" << endl;
+            return false;
+        }
+    }
+
+    // Erase every other key, and put half of them back
+    for (size_t i = 0; i < keys.size(); i += 2)
+        map.Erase(keys[i]);
+    for (size_t i = 0; i < keys.size(); i += 4)
+        map.Insert(keys[i], i);
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        bool wanted = i % 2 == 1 || i % 4 == 0;
+        const uint64_t *value = map.Find(keys[i]);
+
+        if (wanted != (value != nullptr) || (wanted && *value != i)) {
+            cout << "  key " << i << " is wrong after erasing" << endl;
+            return false;
+        }
+    }
+
+    uint64_t visited = 0;
+    map.ForEach([&](uint64_t, const uint64_t&) { visited++; });
+
+    if (visited != map.Size()) {
+        cout << "  ForEach() visited " << visited << " of " << map.Size()
+             << " entries" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool check_registry()
+{
+    ResourceRegistry<std::string> registry;
+
+    registry.Add("a", std::make_shared<std::string>("first"));
+    bool added = registry.Add("a", std::make_shared<std::string>("second"));
+
+    int loads = 0;
+    auto load = [&]() {
+        loads++;
+        return std::make_shared<std::string>("loaded");
+    };
+
+    std::shared_ptr<std::string> b = registry.Load("b", load);
+    registry.Load("b", load);
+
+    bool ok = !added && loads == 1 && registry.Size() == 2 &&
+              *registry.Find("a") == "first" && *b == "loaded" &&
+              registry.Find(ResourceRegistry<std::string>::Key("b")) == b &&
+              registry.Find("c") == nullptr &&
+              registry.Remove("a") && !registry.Remove("a") &&
+              registry.Find("a") == nullptr && registry.Size() == 1;
+
+    if (!ok)
+        cout << "  the registry doesn't hand back what it was given" << endl;
+
+    return ok;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    size_t maxEntries = 10000000;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0] << " [-m <max_entries>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-m").empty())
+        maxEntries = std::stoul(options.getCmdOption("-m"));
+
+    bool ok = check_registry();
+    uint64_t sum = 0;
+
+    cout << std::fixed << std::setprecision(1);
+    cout << "    entries    insert        hit       miss   (ns/op, "
+         << "HashMap / unordered_map)" << endl;
+
+    std::mt19937 rng(1);
+
+    for (size_t count = 1000; count <= maxEntries; count *= 10) {
+        std::vector<uint64_t> keys = make_keys(0, count);
+        std::vector<uint64_t> misses = make_keys(count,
+                                                 std::min<size_t>(count,
+                                                                  1000000));
+
+        std::vector<uint64_t> lookups;
+        while (lookups.size() < 1000000)
+            lookups.insert(lookups.end(), keys.begin(), keys.end());
+        std::shuffle(lookups.begin(), lookups.end(), rng);
+
+        HashMap<uint64_t> map;
+        Times ours = time_map(
+            keys, lookups, misses,
+            [&](uint64_t key, uint64_t value) { map.Insert(key, value); },
+            [&](uint64_t key) {
+                const uint64_t *value = map.Find(key);
+                return value != nullptr ? *value : 0;
+            },
+            sum);
+
+        StdMap stdMap;
+        Times theirs = time_map(
+            keys, lookups, misses,
+            [&](uint64_t key, uint64_t value) { stdMap.emplace(key, value); },
+            [&](uint64_t key) {
+                StdMap::const_iterator it = stdMap.find(key);
+                return it != stdMap.end() ? it->second : 0;
+            },
+            sum);
+
+        cout << std::setw(11) << count
+             << std::setw(6) << ours.insert << " /" << std::setw(5)
+             << theirs.insert
+             << std::setw(6) << ours.hit << " /" << std::setw(5)
+             << theirs.hit
+             << std::setw(6) << ours.miss << " /" << std::setw(5)
+             << theirs.miss << endl;
+
+        ok = check_map(keys, misses, map, stdMap) && ok;
+    }
+
+    sink = sum;
+
+    cout << (ok ? "  ok:     " : "  FAILED: ")
+         << "the maps agree" << endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,406 @@
+//============================================================================
+// Name        : ImageDecodeBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for decoding images, the way Texture used to
+//               (SOIL into RGB, then expanded to 4 bytes a pixel) against
+//               the ImageDecoder: on one thread, a batch at a time on the
+//               JobSystem, and one big JPEG cut into bands at its restart
+//               markers.
+//
+//               The images are the ones in data/image, if we're given the
+//               path to them, and a made up set of JPEGs and PNGs.  The
+//               rates are in megapixels per second.
+//
+//               We check that the PNGs come out the same as SOIL has them,
+//               and that the big JPEG comes out the same in bands as it
+//               does in one piece, and exit with an error if they don't.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include <SOIL/SOIL.h>
+#include <jpeglib.h>
+#include <png.h>
+
+#include "CmdOptionParser.hpp"
+#include "JobSystem.hpp"
+#include "ImageDecoder.hpp"
+#include "PixelConvert.hpp"
+
+typedef std::chrono::steady_clock Clock;
+typedef std::vector<unsigned char> Bytes;
+
+
+struct EncodedImage
+{
+    std::string name;
+    Bytes data;
+    int width;
+    int height;
+};
+
+
+// Something smooth, with a bit of detail, so it compresses like a photo
+void make_pixels(int width, int height, int seed, Bytes& rgb)
+{
+    rgb.resize((size_t)width * height * 3);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char *p = &rgb[((size_t)y * width + x) * 3];
+
+            p[0] = (unsigned char)((x + seed * 37) * 255 / width);
+            p[1] = (unsigned char)((y * 255 / height) ^ ((x >> 3) & 15));
+            p[2] = (unsigned char)(((x * y) >> 6) + seed);
+        }
+    }
+}
+
+
+// A baseline JPEG, with a restart marker every 'restartRows' MCU rows
+Bytes encode_jpeg(const Bytes& rgb, int width, int height, int restartRows)
+{
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr error;
+
+    cinfo.err = jpeg_std_error(&error);
+    jpeg_create_compress(&cinfo);
+
+    unsigned char *buffer = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&cinfo, &buffer, &size);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 90, TRUE);
+    cinfo.restart_in_rows = restartRows;
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = const_cast<unsigned char *>(
+            &rgb[(size_t)cinfo.next_scanline * width * 3]);
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    Bytes jpeg(buffer, buffer + size);
+    free(buffer);
+
+    return jpeg;
+}
+
+
+Bytes encode_png(const Bytes& rgb, int width, int height)
+{
+    png_image image;
+    std::memset(&image, 0, sizeof(image));
+
+    image.version = PNG_IMAGE_VERSION;
+    image.width = width;
+    image.height = height;
+    image.format = PNG_FORMAT_RGB;
+
+    png_alloc_size_t size = 0;
+    png_image_write_to_memory(&image, nullptr, &size, 0, rgb.data(), 0,
+                              nullptr);
+
+    Bytes png(size);
+    if (!png_image_write_to_memory(&image, png.data(), &size, 0,
+                                   rgb.data(), 0, nullptr))
+    {
+        cout << "Could not make a PNG: " << image.message << endl;
+        return Bytes();
+    }
+
+    png.resize(size);
+    return png;
+}
+
+
+bool read_file(const std::string& path, Bytes& data)
+{
+    std::ifstream input(path.c_str(), std::ios::in | std::ios::binary);
+    if (!input)
+        return false;
+
+    data.assign(std::istreambuf_iterator<char>(input),
+                std::istreambuf_iterator<char>());
+
+    return true;
+}
+
+
+double megapixels(const std::vector<EncodedImage>& images)
+{
+    double pixels = 0.0;
+
+    for (const EncodedImage& image : images)
+        pixels += (double)image.width * image.height;
+
+    return pixels / 1e6;
+}
+
+
+// What Texture did before: SOIL into RGB, then into the layout GL wants
+double time_soil(const std::vector<EncodedImage>& images, unsigned repeats)
+{
+    Bytes pixels;
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned r = 0; r < repeats; r++) {
+        for (const EncodedImage& image : images) {
+            int width = 0;
+            int height = 0;
+
+            unsigned char *rgb = SOIL_load_image_from_memory(
+                image.data.data(), (int)image.data.size(),
+                &width, &height, 0, SOIL_LOAD_RGB);
+            if (rgb == nullptr)
+                return 0.0;
+
+            pixels.resize((size_t)width * height * 4);
+            ConvertRGBToBGRA(rgb, pixels.data(), (size_t)width * height);
+
+            SOIL_free_image_data(rgb);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return megapixels(images) * repeats / elapsed.count();
+}
+
+
+double time_decoder(const ImageDecoder& decoder,
+                    const std::vector<EncodedImage>& images,
+                    unsigned repeats)
+{
+    Clock::time_point start = Clock::now();
+
+    for (unsigned r = 0; r < repeats; r++) {
+        for (const EncodedImage& image : images) {
+            ImageDecoder::Image decoded;
+
+            decoder.Decode(image.data.data(), image.data.size(),
+                           ImageDecoder::BGRA, decoded);
+            decoder.Release(decoded);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return megapixels(images) * repeats / elapsed.count();
+}
+
+
+double time_batch(const ImageDecoder& decoder,
+                  const std::vector<EncodedImage>& images, unsigned repeats)
+{
+    std::vector<ImageDecoder::Request> requests(images.size());
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned r = 0; r < repeats; r++) {
+        for (size_t i = 0; i < images.size(); i++) {
+            requests[i].data = images[i].data.data();
+            requests[i].size = images[i].data.size();
+        }
+
+        decoder.DecodeBatch(requests, ImageDecoder::BGRA);
+
+        for (ImageDecoder::Request& request : requests)
+            decoder.Release(request.image);
+    }
+
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return megapixels(images) * repeats / elapsed.count();
+}
+
+
+bool check(bool passed, const char *what)
+{
+    cout << (passed ? "  ok:     " : "  FAILED: ") << what << endl;
+    return passed;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    int numImages = 32;
+    int size = 512;
+    int bigSize = 4096;
+    unsigned repeats = 5;
+    unsigned numThreads = 0;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-p <path_to_resource_folder>] [-n <images>]"
+             << " [-s <image_size>] [-b <big_jpeg_size>] [-r <repeats>]"
+             << " [-t <threads>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        numImages = std::stoi(options.getCmdOption("-n"));
+    if (!options.getCmdOption("-s").empty())
+        size = std::stoi(options.getCmdOption("-s"));
+    if (!options.getCmdOption("-b").empty())
+        bigSize = std::stoi(options.getCmdOption("-b"));
+    if (!options.getCmdOption("-r").empty())
+        repeats = std::stoul(options.getCmdOption("-r"));
+    if (!options.getCmdOption("-t").empty())
+        numThreads = std::stoul(options.getCmdOption("-t"));
+
+    JobSystem jobs(numThreads);
+    ImageBufferPool pool;
+
+    ImageDecoder serial(nullptr, &pool);
+    ImageDecoder parallel(&jobs, &pool);
+
+    // Our corpora
+    std::vector<std::pair<std::string, std::vector<EncodedImage>>> corpora;
+
+    const std::string &filePath = options.getCmdOption("-p");
+    if (!filePath.empty()) {
+        std::vector<EncodedImage> assets;
+        const char *names[] = { "container.jpg", "awesomeface.png" };
+
+        for (const char *name : names) {
+            EncodedImage image;
+            image.name = name;
+
+            std::string path = filePath;
+            if (path.back() != '/')
+                path += "/";
+            path += std::string("image/") + name;
+
+            ImageDecoder::Info info;
+            if (!read_file(path, image.data) ||
+                    !ImageDecoder::ReadInfo(image.data.data(),
+                                            image.data.size(), info))
+            {
+                cout << "Could not read " << path << endl;
+                return -1;
+            }
+
+            image.width = info.width;
+            image.height = info.height;
+            assets.push_back(std::move(image));
+        }
+
+        corpora.push_back(std::make_pair("data/image", std::move(assets)));
+    }
+
+    std::vector<EncodedImage> jpegs;
+    std::vector<EncodedImage> pngs;
+    Bytes rgb;
+
+    for (int i = 0; i < numImages; i++) {
+        make_pixels(size, size, i, rgb);
+
+        EncodedImage image;
+        image.width = size;
+        image.height = size;
+
+        image.data = encode_jpeg(rgb, size, size, 0);
+        jpegs.push_back(image);
+
+        image.data = encode_png(rgb, size, size);
+        pngs.push_back(image);
+    }
+
+    corpora.push_back(std::make_pair("JPEG", std::move(jpegs)));
+    corpora.push_back(std::make_pair("PNG", std::move(pngs)));
+
+    cout << numImages << " made up images of " << size << "x" << size
+         << ", " << repeats << " repeats" << endl;
+    cout << std::fixed << std::setprecision(1);
+    cout << "                 SOIL   decoder   " << std::setw(2)
+         << jobs.NumThreads() << " threads   (MP/s)" << endl;
+
+    for (const auto& corpus : corpora) {
+        cout << "  " << std::left << std::setw(12) << corpus.first
+             << std::right
+             << std::setw(6) << time_soil(corpus.second, repeats)
+             << std::setw(10) << time_decoder(serial, corpus.second, repeats)
+             << std::setw(13) << time_batch(parallel, corpus.second, repeats)
+             << endl;
+    }
+
+    // One big JPEG, in one piece and in bands
+    make_pixels(bigSize, bigSize, 0, rgb);
+
+    std::vector<EncodedImage> big(1);
+    big[0].width = bigSize;
+    big[0].height = bigSize;
+    big[0].data = encode_jpeg(rgb, bigSize, bigSize, 1);
+
+    cout << "  " << bigSize << "x" << bigSize << " JPEG, a restart marker "
+         << "every MCU row" << endl
+         << "  " << std::setw(18)
+         << time_soil(big, repeats)
+         << std::setw(10) << time_decoder(serial, big, repeats)
+         << std::setw(13) << time_decoder(parallel, big, repeats) << endl;
+
+    cout << "  pool: " << pool.Hits() << " buffers reused, "
+         << pool.Misses() << " allocated" << endl;
+
+    bool passed = true;
+
+    ImageDecoder::Image whole;
+    ImageDecoder::Image bands;
+    serial.Decode(big[0].data.data(), big[0].data.size(),
+                  ImageDecoder::BGRA, whole);
+    parallel.Decode(big[0].data.data(), big[0].data.size(),
+                    ImageDecoder::BGRA, bands);
+
+    passed &= check(!whole.pixels.empty() && whole.pixels == bands.pixels,
+                    "a JPEG decodes the same in bands");
+
+    // libpng and SOIL should agree on every pixel of a PNG
+    const EncodedImage& png = corpora.back().second[0];
+    ImageDecoder::Image decoded;
+    serial.Decode(png.data.data(), png.data.size(), ImageDecoder::RGB,
+                  decoded);
+
+    int width = 0;
+    int height = 0;
+    unsigned char *soil = SOIL_load_image_from_memory(
+        png.data.data(), (int)png.data.size(), &width, &height, 0,
+        SOIL_LOAD_RGB);
+
+    if (soil != nullptr) {
+        passed &= check(width == decoded.width && height == decoded.height &&
+                        std::equal(decoded.pixels.begin(),
+                                   decoded.pixels.end(), soil),
+                        "a PNG decodes the same as SOIL has it");
+        SOIL_free_image_data(soil);
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,522 @@
+//============================================================================
+// Name        : IndirectDrawBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for the IndirectRenderer.  We scatter a lot of
+//               tori (a few different meshes, in a GeometryArena) through a
+//               big box, put the camera in the middle of it, and draw what
+//               it sees:
+//               - with a loop on the CPU that tests each object against the
+//                 frustum, and issues a draw call for each one that's in it
+//               - with the IndirectRenderer culling on the CPU, and one
+//                 multi-draw indirect call
+//               - with the IndirectRenderer culling in a compute shader,
+//                 and one multi-draw indirect call
+//               and print the time per frame for each.
+//
+//               We check that the compute shader makes the same commands as
+//               the CPU (except for boxes that just touch the frustum, where
+//               the rounding can go either way), and that every way of
+//               drawing makes the same picture as drawing everything without
+//               culling, also after the arena has been compacted.  We exit
+//               with an error if not.
+//
+//               This needs GL 4.3, and a GL context, so it opens a hidden
+//               window.  Mesa's llvmpipe has everything it needs:
+//               LIBGL_ALWAYS_SOFTWARE=1.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "CmdOptionParser.hpp"
+#include "Camera.hpp"
+#include "Mesh.hpp"
+#include "Shader.hpp"
+#include "GeometryArena.hpp"
+#include "IndirectRenderer.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+const int WindowSize = 128;
+
+// How far a box can be past a plane and still count as touching it
+const double Borderline = 1.0e-3;
+
+
+void make_torus(int n, Mesh& mesh)
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+
+    for (int i = 0; i <= n; i++) {
+        for (int j = 0; j <= n; j++) {
+            float u = 2.0f * (float)M_PI * i / n;
+            float v = 2.0f * (float)M_PI * j / n;
+            float r = 1.0f + 0.25f * std::cos(v);
+
+            MeshVertex vertex = {
+                { r * std::cos(u), r * std::sin(u), 0.25f * std::sin(v) },
+                { std::cos(v) * std::cos(u), std::cos(v) * std::sin(u),
+                  std::sin(v) },
+                { (float)i / n, (float)j / n }
+            };
+            vertices.push_back(vertex);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            uint32_t a = i * (n + 1) + j;
+            uint32_t b = a + n + 1;
+            uint32_t quad[6] = { a, b, b + 1, a, b + 1, a + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+
+    mesh.Assign(std::move(vertices), std::move(indices));
+}
+
+
+struct Scene
+{
+    std::vector<Mesh> meshes;
+    std::vector<GeometryArena::Handle> handles;
+
+    // by object
+    std::vector<size_t> objectMesh;
+    std::vector<Matrix4f, Eigen::aligned_allocator<Matrix4f>> models;
+};
+
+
+void make_scene(size_t numObjects, GeometryArena& arena,
+                IndirectRenderer& renderer, Scene& scene)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> place(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * (float)M_PI);
+    std::uniform_real_distribution<float> size(0.5f, 2.0f);
+
+    for (int n = 3; n <= 10; n++) {
+        scene.meshes.emplace_back();
+        make_torus(n, scene.meshes.back());
+        scene.handles.push_back(arena.Add(scene.meshes.back()));
+    }
+
+    for (size_t i = 0; i < numObjects; i++) {
+        size_t mesh = rng() % scene.meshes.size();
+
+        Affine3f model = Affine3f::Identity();
+        model.translate(Vector3f(place(rng), place(rng), place(rng)));
+        model.rotate(AngleAxisf(angle(rng), Vector3f(place(rng), place(rng),
+                                                     place(rng))
+                                                .normalized()));
+        model.scale(size(rng));
+
+        scene.objectMesh.push_back(mesh);
+        scene.models.push_back(model.matrix());
+
+        renderer.Add(scene.handles[mesh], scene.meshes[mesh].BoundsMin(),
+                     scene.meshes[mesh].BoundsMax(), model.matrix());
+    }
+}
+
+
+// How far the box of an object is inside the frustum: negative if it's
+// outside.  The CPU loop does this in floats, and the checks in doubles.
+template <typename Scalar>
+Scalar box_inside(const Vector4f planes[6], const Mesh& mesh,
+                  const Matrix4f& model)
+{
+    typedef Eigen::Matrix<Scalar, 3, 1> Vector3;
+    typedef Eigen::Matrix<Scalar, 4, 1> Vector4;
+
+    Vector3 boundsMin = Eigen::Map<const Vector3f>(mesh.BoundsMin())
+                            .cast<Scalar>();
+    Vector3 boundsMax = Eigen::Map<const Vector3f>(mesh.BoundsMax())
+                            .cast<Scalar>();
+
+    Eigen::Matrix<Scalar, 4, 4> mx = model.cast<Scalar>();
+    Vector3 center = (boundsMin + boundsMax) / 2;
+    Vector3 extent = (boundsMax - boundsMin) / 2;
+
+    center = (mx * center.homogeneous()).template head<3>();
+    extent = mx.template topLeftCorner<3, 3>().cwiseAbs() * extent;
+
+    Scalar inside = HUGE_VAL;
+    for (int p = 0; p < 6; p++) {
+        Vector4 plane = planes[p].cast<Scalar>();
+
+        inside = std::min(inside,
+                          plane.template head<3>().dot(center) + plane[3] +
+                          plane.template head<3>().cwiseAbs().dot(extent));
+    }
+
+    return inside;
+}
+
+
+enum DrawMode { CpuLoop, CpuCullIndirect, GpuCullIndirect, NoCulling };
+
+
+void draw(DrawMode mode, Camera& camera, const Shader& shader,
+          const Scene& scene, GeometryArena& arena,
+          IndirectRenderer& renderer)
+{
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    Vector4f planes[6];
+    camera.FrustumPlanes(planes);
+
+    // Planes that everything is inside of
+    Vector4f everything[6];
+    for (Vector4f& plane : everything)
+        plane = Vector4f(0.0f, 0.0f, 0.0f, 1.0f);
+
+    switch (mode) {
+    case CpuLoop:
+        // The renderer's vertex array, for the object index, but we
+        // issue the draws ourselves
+        glUseProgram(shader.Program);
+        glBindVertexArray(renderer.VertexArray());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                         IndirectRenderer::ObjectBinding,
+                         renderer.ObjectBuffer());
+
+        for (size_t i = 0; i < scene.models.size(); i++) {
+            const Mesh& mesh = scene.meshes[scene.objectMesh[i]];
+            if (box_inside<float>(planes, mesh, scene.models[i]) < 0.0f)
+                continue;
+
+            const GeometryArena::Range& range =
+                arena.RangeOf(scene.handles[scene.objectMesh[i]]);
+
+            glDrawElementsInstancedBaseVertexBaseInstance(
+                GL_TRIANGLES, (GLsizei)range.numIndices, GL_UNSIGNED_INT,
+                (const void *)(range.firstIndex * sizeof(uint32_t)), 1,
+                (GLint)range.firstVertex, (GLuint)i);
+        }
+        break;
+
+    case CpuCullIndirect:
+    case GpuCullIndirect:
+        renderer.SetCullMode(mode == CpuCullIndirect
+                             ? IndirectRenderer::CpuCull
+                             : IndirectRenderer::GpuCull);
+        renderer.Cull(planes);
+
+        glUseProgram(shader.Program);
+        renderer.Draw();
+        break;
+
+    case NoCulling:
+        renderer.SetCullMode(IndirectRenderer::CpuCull);
+        renderer.Cull(everything);
+
+        glUseProgram(shader.Program);
+        renderer.Draw();
+        break;
+    }
+
+    glBindVertexArray(0);
+}
+
+
+// Time per frame, in microseconds
+double time_draw(DrawMode mode, unsigned frames, Camera& camera,
+                 const Shader& shader, const Scene& scene,
+                 GeometryArena& arena, IndirectRenderer& renderer)
+{
+    draw(mode, camera, shader, scene, arena, renderer);
+    glFinish();
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned frame = 0; frame < frames; frame++)
+        draw(mode, camera, shader, scene, arena, renderer);
+
+    glFinish();
+
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count() / frames;
+}
+
+
+// Just the culling, without drawing
+double time_cull(IndirectRenderer::CullMode mode, unsigned frames,
+                 Camera& camera, IndirectRenderer& renderer)
+{
+    Vector4f planes[6];
+    camera.FrustumPlanes(planes);
+
+    renderer.SetCullMode(mode);
+    renderer.Cull(planes);
+    glFinish();
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned frame = 0; frame < frames; frame++)
+        renderer.Cull(planes);
+
+    glFinish();
+
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count() / frames;
+}
+
+
+std::vector<unsigned char> draw_pixels(DrawMode mode, Camera& camera,
+                                       const Shader& shader,
+                                       const Scene& scene,
+                                       GeometryArena& arena,
+                                       IndirectRenderer& renderer)
+{
+    std::vector<unsigned char> pixels(WindowSize * WindowSize * 4);
+
+    draw(mode, camera, shader, scene, arena, renderer);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, WindowSize, WindowSize, GL_RGBA, GL_UNSIGNED_BYTE,
+                 pixels.data());
+
+    return pixels;
+}
+
+
+// Every way of drawing has to make the picture we get without culling
+bool same_pictures(Camera& camera, const Shader& shader, const Scene& scene,
+                   GeometryArena& arena, IndirectRenderer& renderer)
+{
+    std::vector<unsigned char> all = draw_pixels(NoCulling, camera, shader,
+                                                 scene, arena, renderer);
+    bool same = true;
+
+    for (DrawMode mode : { CpuLoop, CpuCullIndirect, GpuCullIndirect })
+        same = same && draw_pixels(mode, camera, shader, scene, arena,
+                                   renderer) == all;
+
+    // and there has to be something in it
+    size_t drawn = 0;
+    for (size_t i = 3; i < all.size(); i += 4)
+        drawn += all[i] != 0;
+
+    return same && drawn > 0;
+}
+
+
+bool check(bool passed, const char *what)
+{
+    cout << (passed ? "  ok:     " : "  FAILED: ") << what << endl;
+    return passed;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    const std::string &filePath = options.getCmdOption("-p");
+    size_t numObjects = 20000;
+    unsigned frames = 20;
+
+    if (filePath.empty()) {
+        cout << "Usage: " << argv[0]
+             << " -p <path_to_resource_folder> [-n <objects>] [-f <frames>]"
+             << endl;
+        return 1;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        numObjects = std::stoul(options.getCmdOption("-n"));
+    if (!options.getCmdOption("-f").empty())
+        frames = std::stoul(options.getCmdOption("-f"));
+
+    std::string root = filePath;
+    if (root.back() != '/')
+        root += "/";
+
+    std::string vertexFile = root + "glsl/IndirectVertexShader.glsl";
+    std::string fragmentFile = root + "glsl/IndirectFragmentShader.glsl";
+
+    if (!glfwInit()) {
+        cout << "GLFW Initialization Failed!!" << endl;
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(WindowSize, WindowSize,
+                                          "IndirectDrawBench",
+                                          nullptr, nullptr);
+    if (window == nullptr) {
+        cout << "Failed to create GLFW window (this needs GL 4.3)" << endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        cout << "Failed to initialize GLEW" << endl;
+        return -1;
+    }
+
+    if (!IndirectRenderer::Supported()) {
+        cout << "This needs GL 4.3, or multi-draw indirect and shader "
+             << "storage buffers" << endl;
+        glfwTerminate();
+        return 1;
+    }
+
+    bool passed = true;
+
+    {
+        Shader shader(vertexFile.c_str(), fragmentFile.c_str());
+        if (shader.Program == 0)
+            return 1;
+
+        glViewport(0, 0, WindowSize, WindowSize);
+        glEnable(GL_DEPTH_TEST);
+
+        // A mesh that we take out again later, so compacting moves the
+        // rest
+        GeometryArena arena;
+        Mesh spare;
+        make_torus(8, spare);
+        GeometryArena::Handle spareHandle = arena.Add(spare);
+
+        IndirectRenderer renderer(arena);
+        passed &= check(renderer.IsValid(), "the renderer can draw here");
+
+        Scene scene;
+        make_scene(numObjects, arena, renderer, scene);
+
+        Camera camera;
+        camera.lookAt(Vector3f(0.0f, 0.0f, 0.0f), Vector3f(1.0f, 0.3f, 0.2f),
+                      Vector3f(0.0f, 1.0f, 0.0f));
+        camera.setPerspective(45.0f, WindowSize, WindowSize, 0.1f, 150.0f);
+
+        glUseProgram(shader.Program);
+        Matrix4f viewProjection = camera.ViewProjection();
+        glUniformMatrix4fv(glGetUniformLocation(shader.Program,
+                                                "viewProjection"),
+                           1, GL_FALSE, viewProjection.data());
+
+        // The CPU and the GPU culling
+        Vector4f planes[6];
+        camera.FrustumPlanes(planes);
+
+        renderer.SetCullMode(IndirectRenderer::CpuCull);
+        renderer.Cull(planes);
+        std::vector<DrawElementsIndirectCommand> cpuCommands =
+            renderer.ReadCommands();
+        size_t numVisible = renderer.NumVisible();
+
+        bool gpu = IndirectRenderer::ComputeSupported();
+        std::vector<DrawElementsIndirectCommand> gpuCommands = cpuCommands;
+        if (gpu) {
+            renderer.SetCullMode(IndirectRenderer::GpuCull);
+            renderer.Cull(planes);
+            gpuCommands = renderer.ReadCommands();
+        }
+
+        size_t borderline = 0;
+        size_t disagree = 0;
+        bool sameCommands = gpuCommands.size() == cpuCommands.size();
+
+        for (size_t i = 0; i < cpuCommands.size() && sameCommands; i++) {
+            const DrawElementsIndirectCommand& a = cpuCommands[i];
+            const DrawElementsIndirectCommand& b = gpuCommands[i];
+
+            double inside = box_inside<double>(
+                planes, scene.meshes[scene.objectMesh[i]], scene.models[i]);
+            bool touching = std::fabs(inside) < Borderline;
+            borderline += touching;
+
+            sameCommands = a.count == b.count &&
+                           a.firstIndex == b.firstIndex &&
+                           a.baseVertex == b.baseVertex &&
+                           a.baseInstance == b.baseInstance;
+
+            if (a.instanceCount != b.instanceCount) {
+                disagree++;
+                sameCommands = sameCommands && touching;
+            }
+            else if (!touching) {
+                sameCommands = sameCommands &&
+                               a.instanceCount == (inside >= 0.0 ? 1u : 0u);
+            }
+        }
+
+        double loopTime = time_draw(CpuLoop, frames, camera, shader, scene,
+                                    arena, renderer);
+        double cpuTime = time_draw(CpuCullIndirect, frames, camera, shader,
+                                   scene, arena, renderer);
+        double gpuTime = gpu ? time_draw(GpuCullIndirect, frames, camera,
+                                         shader, scene, arena, renderer)
+                             : 0.0;
+
+        double cpuCull = time_cull(IndirectRenderer::CpuCull, frames, camera,
+                                   renderer);
+        double gpuCull = gpu ? time_cull(IndirectRenderer::GpuCull, frames,
+                                         camera, renderer)
+                             : 0.0;
+
+        cout << std::fixed << std::setprecision(1)
+             << numObjects << " objects, " << numVisible << " in the frustum, "
+             << frames << " frames" << endl
+             << "  CPU loop:             " << std::setw(10) << loopTime
+             << " us/frame, " << numVisible << " draw calls" << endl
+             << "  CPU cull, indirect:   " << std::setw(10) << cpuTime
+             << " us/frame, 1 draw call, " << cpuCull << " us culling"
+             << endl;
+
+        if (gpu) {
+            cout << "  GPU cull, indirect:   " << std::setw(10) << gpuTime
+                 << " us/frame, 1 draw call, " << gpuCull << " us culling"
+                 << endl;
+        }
+        else {
+            cout << "  no compute shaders, so no GPU culling" << endl;
+        }
+
+        cout << "  " << borderline << " boxes touching the frustum, "
+             << disagree << " culled differently" << endl;
+
+        passed &= check(sameCommands,
+                        "the GPU writes the same commands as the CPU");
+        passed &= check(same_pictures(camera, shader, scene, arena,
+                                      renderer),
+                        "culling doesn't change the picture");
+
+        // Move everything in the arena
+        arena.Remove(spareHandle);
+        arena.Compact();
+
+        passed &= check(same_pictures(camera, shader, scene, arena,
+                                      renderer),
+                        "nor after compacting the arena");
+    }
+
+    glfwTerminate();
+
+    return passed ? 0 : 1;
+}
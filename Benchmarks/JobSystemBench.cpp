@@ -0,0 +1,154 @@
+//============================================================================
+// Name        : JobSystemBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Scaling benchmarks for the work-stealing JobSystem.
+//               We run a few synthetic workloads with 1 to N threads and
+//               report the best-of-N wall clock time and the speedup over
+//               a single thread.
+//
+//               - compute:  a parallel-for over a big array with a bit of
+//                           floating point work per element.
+//               - tiny:     lots of nearly empty child jobs, which mostly
+//                           measures the scheduling overhead.
+//               - grain:    the compute workload at max threads with
+//                           different grain sizes.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "CmdOptionParser.hpp"
+#include "JobSystem.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+// run a workload a few times, and return the best time in milliseconds
+double time_best(unsigned runs, const std::function<void()> &workload)
+{
+    double best = 1.0e30;
+
+    for (unsigned r = 0; r < runs; r++) {
+        Clock::time_point start = Clock::now();
+        workload();
+        std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+
+void compute_workload(JobSystem &jobs, std::vector<float> &data,
+                      size_t grainSize)
+{
+    jobs.ParallelFor(0, data.size(), grainSize,
+                     [&data](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float x = (float)i * 0.001f;
+            data[i] = std::sqrt(x) * std::sin(x) + std::cos(x * 0.5f);
+        }
+    });
+}
+
+
+void tiny_workload(JobSystem &jobs, size_t numJobs,
+                   std::atomic<size_t> &counter)
+{
+    Job *root = jobs.CreateJob([&jobs, numJobs, &counter](Job *job) {
+        for (size_t i = 0; i < numJobs; i++) {
+            jobs.Run(jobs.CreateJob([&counter](Job *) {
+                counter.fetch_add(1, std::memory_order_relaxed);
+            }, job));
+        }
+    });
+
+    jobs.Run(root);
+    jobs.Wait(root);
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    unsigned runs = 5;
+    size_t elements = 1 << 22;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-t <max_threads>] [-r <runs>] [-n <elements>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-t").empty())
+        maxThreads = std::stoul(options.getCmdOption("-t"));
+    if (!options.getCmdOption("-r").empty())
+        runs = std::stoul(options.getCmdOption("-r"));
+    if (!options.getCmdOption("-n").empty())
+        elements = std::stoul(options.getCmdOption("-n"));
+
+    std::vector<float> data(elements);
+    const size_t tinyJobs = 2000;
+    double computeBase = 0.0, tinyBase = 0.0;
+
+    cout << std::fixed << std::setprecision(3);
+    cout << "threads    compute(ms)  speedup    tiny(ms)  speedup  "
+         << "  jobs/sec" << endl;
+
+    for (unsigned n = 1; n <= maxThreads; n++) {
+        JobSystem jobs(n);
+        std::atomic<size_t> counter(0);
+
+        double compute = time_best(runs, [&] {
+            compute_workload(jobs, data, 4096);
+        });
+        double tiny = time_best(runs, [&] {
+            for (int i = 0; i < 50; i++)
+                tiny_workload(jobs, tinyJobs, counter);
+        });
+
+        if (n == 1) {
+            computeBase = compute;
+            tinyBase = tiny;
+        }
+
+        cout << std::setw(7) << n
+             << std::setw(15) << compute
+             << std::setw(9) << computeBase / compute
+             << std::setw(12) << tiny
+             << std::setw(9) << tinyBase / tiny
+             << std::setw(12) << std::setprecision(0)
+             << (50.0 * tinyJobs) / (tiny * 1.0e-3)
+             << std::setprecision(3) << endl;
+    }
+
+    cout << endl << "grain size sweep with " << maxThreads << " threads" << endl;
+    cout << "  grain    compute(ms)" << endl;
+
+    JobSystem jobs(maxThreads);
+    for (size_t grain = 64; grain <= (1 << 18); grain *= 4) {
+        double compute = time_best(runs, [&] {
+            compute_workload(jobs, data, grain);
+        });
+
+        cout << std::setw(7) << grain << std::setw(15) << compute << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,366 @@
+//============================================================================
+// Name        : LodBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for the levels of detail.  We make a bumpy torus
+//               of n x n quads, build its levels with a LodMesh, and print
+//               each level's triangles and error and how long they took.
+//
+//               Then we scatter g x g copies of it, at random sizes and
+//               turned every which way, over a big square, put a Camera at
+//               one edge looking across it, and pick every object's level
+//               with the LodSelector.  We print the triangles that would
+//               be drawn, in bands of distance from the camera, against
+//               drawing everything at full detail, and the triangles of
+//               the whole scene as the camera backs away from it.  (There
+//               is no culling here, every object counts.)  Selecting is
+//               timed with SIMD and without.
+//
+//               We check that the levels get smaller and their errors
+//               don't, that every index is good, that the SIMD and the
+//               scalar selection agree, and that with hysteresis a camera
+//               going back and forth a little doesn't make any object
+//               change level after the first trip.  We exit with an error
+//               if not.
+//
+//               None of this draws anything, so it runs without a GPU.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <Eigen/Dense>
+using Eigen::Matrix4f;
+using Eigen::Vector3f;
+using Eigen::Affine3f;
+using Eigen::AngleAxisf;
+using Eigen::Translation3f;
+using Eigen::Scaling;
+
+#include "CmdOptionParser.hpp"
+#include "Camera.hpp"
+#include "Mesh.hpp"
+#include "MeshLod.hpp"
+#include "LodSelector.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+const float ViewportWidth = 1920.0f;
+const float ViewportHeight = 1080.0f;
+
+
+double milliseconds(Clock::duration elapsed)
+{
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+
+// A torus with a few waves on it, so there is something to keep.  The
+// grid wraps around, so there are no seams or borders.
+void make_bumpy_torus(int n, Mesh& mesh)
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            float u = 2.0f * (float)M_PI * i / n;
+            float v = 2.0f * (float)M_PI * j / n;
+            float bump = 0.04f * std::sin(5 * u) * std::sin(3 * v) +
+                         0.015f * std::sin(17 * u + 11 * v);
+            float tube = 0.35f + bump;
+            float r = 1.0f + tube * std::cos(v);
+
+            MeshVertex vertex = {
+                { r * std::cos(u), tube * std::sin(v), r * std::sin(u) },
+                { std::cos(v) * std::cos(u), std::sin(v),
+                  std::cos(v) * std::sin(u) },
+                { (float)i / n, (float)j / n }
+            };
+            vertices.push_back(vertex);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            uint32_t a = i * n + j;
+            uint32_t b = ((i + 1) % n) * n + j;
+            uint32_t c = ((i + 1) % n) * n + (j + 1) % n;
+            uint32_t d = i * n + (j + 1) % n;
+            uint32_t quad[6] = { a, c, b, a, d, c };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+
+    mesh.Assign(std::move(vertices), std::move(indices));
+}
+
+
+bool check_levels(const LodMesh& lod)
+{
+    const Mesh& mesh = lod.Geometry();
+
+    for (size_t l = 0; l < lod.NumLevels(); l++) {
+        const LodLevel& level = lod.Level(l);
+        if (level.numIndices == 0 || level.numIndices % 3 != 0 ||
+            level.firstIndex + level.numIndices > mesh.NumIndices())
+            return false;
+
+        if (l > 0 && (level.numIndices >= lod.Level(l - 1).numIndices ||
+                      level.error < lod.Level(l - 1).error))
+            return false;
+
+        for (size_t i = 0; i < level.numIndices; i++) {
+            if (mesh.Indices()[level.firstIndex + i] >= mesh.NumVertices())
+                return false;
+        }
+    }
+
+    return lod.NumLevels() > 1;
+}
+
+
+size_t triangles_drawn(const LodSelector& selector, const LodMesh& lod)
+{
+    size_t triangles = 0;
+    for (size_t i = 0; i < selector.NumObjects(); i++)
+        triangles += lod.Level(selector.Level(i)).numIndices / 3;
+    return triangles;
+}
+
+
+bool check(bool passed, const char *what)
+{
+    cout << (passed ? "  ok:     " : "  FAILED: ") << what << endl;
+    return passed;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    int n = 128;
+    int g = 250;
+    float spacing = 6.0f;
+    float threshold = 1.0f;
+    int frames = 100;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-n <quads_per_side>] [-g <objects_per_side>]"
+             << " [-s <spacing>] [-t <pixels>] [-f <frames>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        n = std::stoi(options.getCmdOption("-n"));
+    if (!options.getCmdOption("-g").empty())
+        g = std::stoi(options.getCmdOption("-g"));
+    if (!options.getCmdOption("-s").empty())
+        spacing = std::stof(options.getCmdOption("-s"));
+    if (!options.getCmdOption("-t").empty())
+        threshold = std::stof(options.getCmdOption("-t"));
+    if (!options.getCmdOption("-f").empty())
+        frames = std::stoi(options.getCmdOption("-f"));
+
+    bool passed = true;
+
+    // Build the levels
+    Mesh mesh;
+    make_bumpy_torus(n, mesh);
+
+    Clock::time_point start = Clock::now();
+    LodMesh lod;
+    lod.Build(mesh);
+    double buildTime = milliseconds(Clock::now() - start);
+
+    cout << "Levels of a bumpy torus of " << mesh.NumTriangles()
+         << " triangles, built in " << std::fixed << std::setprecision(1)
+         << buildTime << " ms:" << endl
+         << "  level   triangles        error" << endl;
+    for (size_t l = 0; l < lod.NumLevels(); l++) {
+        cout << std::setw(7) << l
+             << std::setw(12) << lod.Level(l).numIndices / 3
+             << std::setw(13) << std::setprecision(6) << lod.Level(l).error
+             << endl;
+    }
+    cout << endl;
+
+    passed &= check(check_levels(lod),
+                    "the levels get smaller, their errors don't, and "
+                    "their indices are good");
+
+    // The scene
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+    std::uniform_real_distribution<float> sizes(0.5f, 2.0f);
+    std::uniform_real_distribution<float> angles(0.0f, 2.0f * (float)M_PI);
+
+    LodSelector selector(threshold);
+    for (int x = 0; x < g; x++) {
+        for (int z = 0; z < g; z++) {
+            Vector3f axis(jitter(rng), 1.0f, jitter(rng));
+            Affine3f model = Translation3f((x + 0.5f + jitter(rng)) *
+                                           spacing, 0.0f,
+                                           (z + 0.5f + jitter(rng)) *
+                                           spacing) *
+                             AngleAxisf(angles(rng), axis.normalized()) *
+                             Scaling(sizes(rng));
+            selector.Add(lod, model.matrix());
+        }
+    }
+
+    float side = g * spacing;
+    Vector3f eye(side * 0.5f, 3.0f, -2.0f);
+    Vector3f target(side * 0.5f, 0.0f, side);
+
+    Camera camera;
+    camera.lookAt(eye, target, Vector3f(0.0f, 1.0f, 0.0f));
+    camera.setPerspective(60.0f, ViewportWidth, ViewportHeight,
+                          0.1f, 10000.0f);
+
+    // Time picking the levels, and check the two ways agree
+    float scale = LodSelector::ProjectionScale(camera, ViewportHeight);
+
+    selector.SetThreshold(threshold, selector.Hysteresis());
+    selector.SelectScalar(eye, scale);
+    std::vector<int32_t> scalarLevels(selector.Levels(),
+                                      selector.Levels() +
+                                      selector.NumObjects());
+
+    selector.SetThreshold(threshold, selector.Hysteresis());
+    selector.Select(camera, ViewportHeight);
+    passed &= check(std::equal(scalarLevels.begin(), scalarLevels.end(),
+                               selector.Levels()),
+                    "SIMD and scalar selection pick the same levels");
+
+    start = Clock::now();
+    for (int frame = 0; frame < frames; frame++)
+        selector.Select(eye, scale);
+    double simdTime = milliseconds(Clock::now() - start) / frames;
+
+    start = Clock::now();
+    for (int frame = 0; frame < frames; frame++)
+        selector.SelectScalar(eye, scale);
+    double scalarTime = milliseconds(Clock::now() - start) / frames;
+
+    // By distance
+    const float bands[] = { 0, 25, 50, 100, 200, 400, 800, 1600 };
+    const size_t numBands = sizeof(bands) / sizeof(bands[0]);
+    size_t bandObjects[numBands] = {};
+    size_t bandTriangles[numBands] = {};
+    double bandLevels[numBands] = {};
+
+    rng.seed(1);
+    for (int x = 0; x < g; x++) {
+        for (int z = 0; z < g; z++) {
+            // the same numbers as above, for the same positions
+            jitter(rng); jitter(rng);
+            float px = (x + 0.5f + jitter(rng)) * spacing;
+            float pz = (z + 0.5f + jitter(rng)) * spacing;
+            angles(rng); sizes(rng);
+
+            float distance = (Vector3f(px, 0.0f, pz) - eye).norm();
+            size_t band = std::upper_bound(bands, bands + numBands,
+                                           distance) - bands - 1;
+            int level = selector.Level(x * g + z);
+
+            bandObjects[band]++;
+            bandTriangles[band] += lod.Level(level).numIndices / 3;
+            bandLevels[band] += level;
+        }
+    }
+
+    size_t fullTriangles = selector.NumObjects() * mesh.NumTriangles();
+    size_t lodTriangles = triangles_drawn(selector, lod);
+
+    cout << endl << g * g << " objects over " << std::setprecision(0)
+         << side << " x " << side << ", " << threshold
+         << " pixel threshold, " << ViewportWidth << " x "
+         << ViewportHeight << ":" << endl
+         << "  distance      objects  avg level    triangles"
+         << "   full detail" << endl;
+    for (size_t b = 0; b < numBands; b++) {
+        if (bandObjects[b] == 0)
+            continue;
+
+        cout << std::setprecision(0) << std::setw(6) << bands[b] << " - ";
+        if (b + 1 < numBands)
+            cout << std::left << std::setw(6) << bands[b + 1] << std::right;
+        else
+            cout << "      ";
+        cout << std::setw(8) << bandObjects[b]
+             << std::setw(11) << std::setprecision(2)
+             << bandLevels[b] / bandObjects[b]
+             << std::setw(13) << bandTriangles[b]
+             << std::setw(14) << bandObjects[b] * mesh.NumTriangles()
+             << endl;
+    }
+    cout << "  total     " << std::setw(11) << selector.NumObjects()
+         << std::setw(24) << lodTriangles
+         << std::setw(14) << fullTriangles << endl
+         << "  " << std::setprecision(1)
+         << 100.0 * lodTriangles / fullTriangles
+         << "% of the triangles" << endl << endl;
+
+    cout << "Selecting " << selector.NumObjects() << " objects:" << endl
+         << std::setprecision(3)
+         << "  SIMD:     " << std::setw(8) << simdTime << " ms" << endl
+         << "  scalar:   " << std::setw(8) << scalarTime << " ms" << endl
+         << endl;
+
+    // Backing away from the scene
+    cout << "Triangles per frame as the camera backs away:" << endl
+         << "  distance    triangles   full detail" << endl;
+    const float distances[] = { 0, 100, 250, 500, 1000, 2000, 4000 };
+    for (float distance : distances) {
+        Vector3f back = eye - Vector3f(0.0f, 0.0f, distance);
+        selector.SetThreshold(threshold, selector.Hysteresis());
+        selector.Select(back, scale);
+
+        cout << std::setprecision(0) << std::setw(10) << distance
+             << std::setw(13) << triangles_drawn(selector, lod)
+             << std::setw(14) << fullTriangles << endl;
+    }
+    cout << endl;
+
+    // Going back and forth
+    float hysteresis = selector.Hysteresis();
+    size_t changes[2] = {};
+    for (int h = 0; h < 2; h++) {
+        selector.SetThreshold(threshold, h == 0 ? hysteresis : 0.0f);
+        for (int frame = 0; frame < 20; frame++) {
+            float wobble = frame % 2 == 0 ? 0.25f : -0.25f;
+            selector.Select(eye + Vector3f(0.0f, 0.0f, wobble), scale);
+
+            // the first two frames get them into place
+            if (frame >= 2)
+                changes[h] += selector.NumChanged();
+        }
+    }
+
+    cout << "Level changes going back and forth 0.25 for 18 frames:"
+         << endl
+         << "  with hysteresis:    " << changes[0] << endl
+         << "  without:            " << changes[1] << endl << endl;
+
+    passed &= check(changes[0] == 0,
+                    "with hysteresis, nothing flips back and forth");
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,340 @@
+//============================================================================
+// Name        : MeshLoadBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for the MeshLoader.  We write out a torus as an
+//               OBJ file, with n x n quads, and time parsing it on one
+//               thread and on all of them (MB/s of text), and then loading
+//               it cold, which parses it and cooks the cache, and loading
+//               it again from the cache.
+//
+//               Along the way we check that the mesh comes out the same
+//               whichever way it was loaded, that negative indices work
+//               when the pieces of a file get parsed apart, and that a .glb
+//               of the mesh loads back the same, and exit with an error if
+//               not.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "CmdOptionParser.hpp"
+#include "JobSystem.hpp"
+#include "MappedFile.hpp"
+#include "Mesh.hpp"
+#include "MeshLoader.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// Where the bytes we read go, so they can't be optimized away
+volatile uint64_t sink;
+
+
+double milliseconds(Clock::duration elapsed)
+{
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+
+// (n + 1) x (n + 1) vertices, since the seams have two of everything,
+// and n x n quads
+std::string torus_obj(int n)
+{
+    std::string text = "# a torus\no torus\n";
+    char line[160];
+
+    for (int i = 0; i <= n; i++) {
+        for (int j = 0; j <= n; j++) {
+            float u = 2.0f * (float)M_PI * i / n;
+            float v = 2.0f * (float)M_PI * j / n;
+            float r = 1.0f + 0.25f * std::cos(v);
+
+            snprintf(line, sizeof(line),
+                     "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                     r * std::cos(u), r * std::sin(u), 0.25f * std::sin(v),
+                     (float)i / n, (float)j / n,
+                     std::cos(v) * std::cos(u), std::cos(v) * std::sin(u),
+                     std::sin(v));
+            text += line;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            int a = i * (n + 1) + j + 1;
+            int b = a + n + 1;
+
+            snprintf(line, sizeof(line),
+                     "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
+                     a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1,
+                     a + 1);
+            text += line;
+        }
+    }
+
+    return text;
+}
+
+
+bool write_file(const std::string& path, const void *data, size_t size)
+{
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+    file.write((const char *)data, size);
+    return (bool)file;
+}
+
+
+// The mesh as a .glb, with the vertices interleaved in one buffer view
+// and the indices in another
+bool write_glb(const std::string& path, const Mesh& mesh)
+{
+    size_t vertexBytes = mesh.VertexBytes();
+    size_t indexBytes = mesh.IndexBytes();
+    size_t count = mesh.NumVertices();
+
+    char json[2048];
+    snprintf(json, sizeof(json),
+        "{\"asset\":{\"version\":\"2.0\"},"
+        "\"buffers\":[{\"byteLength\":%zu}],"
+        "\"bufferViews\":["
+            "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu,"
+             "\"byteStride\":32},"
+            "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+        "\"accessors\":["
+            "{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,"
+             "\"count\":%zu,\"type\":\"VEC3\"},"
+            "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,"
+             "\"count\":%zu,\"type\":\"VEC3\"},"
+            "{\"bufferView\":0,\"byteOffset\":24,\"componentType\":5126,"
+             "\"count\":%zu,\"type\":\"VEC2\"},"
+            "{\"bufferView\":1,\"componentType\":5125,"
+             "\"count\":%zu,\"type\":\"SCALAR\"}],"
+        "\"meshes\":[{\"name\":\"torus\",\"primitives\":[{\"attributes\":"
+            "{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},"
+            "\"indices\":3,\"mode\":4}]}]}",
+        vertexBytes + indexBytes, vertexBytes, vertexBytes, indexBytes,
+        count, count, count, mesh.NumIndices());
+
+    // Both chunks have to be a multiple of 4 bytes
+    std::string text = json;
+    text.resize((text.size() + 3) / 4 * 4, ' ');
+
+    std::vector<unsigned char> bin((const unsigned char *)mesh.Vertices(),
+                                   (const unsigned char *)mesh.Vertices() +
+                                   vertexBytes);
+    bin.insert(bin.end(), (const unsigned char *)mesh.Indices(),
+               (const unsigned char *)mesh.Indices() + indexBytes);
+
+    uint32_t header[3] = { 0x46546c67, 2,
+                           (uint32_t)(12 + 8 + text.size() + 8 +
+                                      bin.size()) };
+    uint32_t jsonChunk[2] = { (uint32_t)text.size(), 0x4e4f534a };
+    uint32_t binChunk[2] = { (uint32_t)bin.size(), 0x004e4942 };
+
+    std::vector<unsigned char> file;
+    auto append = [&](const void *bytes, size_t size) {
+        file.insert(file.end(), (const unsigned char *)bytes,
+                    (const unsigned char *)bytes + size);
+    };
+
+    append(header, sizeof(header));
+    append(jsonChunk, sizeof(jsonChunk));
+    append(text.data(), text.size());
+    append(binChunk, sizeof(binChunk));
+    append(bin.data(), bin.size());
+
+    return write_file(path, file.data(), file.size());
+}
+
+
+bool same_mesh(const Mesh& a, const Mesh& b)
+{
+    return a.NumVertices() == b.NumVertices() &&
+           a.NumIndices() == b.NumIndices() &&
+           std::memcmp(a.Vertices(), b.Vertices(), a.VertexBytes()) == 0 &&
+           std::memcmp(a.Indices(), b.Indices(), a.IndexBytes()) == 0 &&
+           std::memcmp(a.BoundsMin(), b.BoundsMin(), 3 * sizeof(float)) == 0 &&
+           std::memcmp(a.BoundsMax(), b.BoundsMax(), 3 * sizeof(float)) == 0;
+}
+
+
+// Lots of little quads, each with its own four vertices and a face that
+// points back at them with negative indices.  Cut into pieces, the faces
+// at the start of a piece point back into the piece before.
+bool check_negative_indices(JobSystem& jobs)
+{
+    std::string text;
+    const int numQuads = 20000;
+
+    for (int i = 0; i < numQuads; i++) {
+        text += "v " + std::to_string(i) + " 0 0\n";
+        text += "v " + std::to_string(i + 1) + " 0 0\n";
+        text += "v " + std::to_string(i + 1) + " 1 0\n";
+        text += "v " + std::to_string(i) + " 1 0\n";
+        text += "f -4 -3 -2 -1\n";
+    }
+
+    Mesh serial, parallel;
+    if (!MeshLoader().ParseObj(text.data(), text.size(), serial) ||
+        !MeshLoader(&jobs).ParseObj(text.data(), text.size(), parallel))
+        return false;
+
+    if (!same_mesh(serial, parallel) ||
+        serial.NumVertices() != numQuads * 4 ||
+        serial.NumTriangles() != numQuads * 2)
+        return false;
+
+    // Every quad is its own four corners, and faces +z, which the normals
+    // had to be worked out to know
+    for (size_t i = 0; i < serial.NumIndices(); i++) {
+        const MeshVertex& vertex = serial.Vertices()[serial.Indices()[i]];
+        size_t quad = i / 6;
+
+        if (vertex.position[0] < quad || vertex.position[0] > quad + 1 ||
+            std::fabs(vertex.normal[2] - 1.0f) > 1e-6f)
+            return false;
+    }
+
+    return true;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    int n = 500;
+    unsigned numThreads = 0;
+    std::string directory = "/tmp";
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-n <quads_per_side>] [-t <threads>] [-d <directory>]"
+             << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        n = std::stoi(options.getCmdOption("-n"));
+    if (!options.getCmdOption("-t").empty())
+        numThreads = std::stoul(options.getCmdOption("-t"));
+    if (!options.getCmdOption("-d").empty())
+        directory = options.getCmdOption("-d");
+
+    JobSystem jobs(numThreads);
+    bool ok = true;
+
+    bool negativeOk = check_negative_indices(jobs);
+    cout << (negativeOk ? "  ok:     " : "  FAILED: ")
+         << "negative indices across pieces" << endl;
+    ok = ok && negativeOk;
+
+    std::string objPath = directory + "/MeshLoadBench.obj";
+    std::string glbPath = directory + "/MeshLoadBench.glb";
+
+    std::string text = torus_obj(n);
+    if (!write_file(objPath, text.data(), text.size())) {
+        cout << "could not write " << objPath << endl;
+        return 1;
+    }
+    std::remove(MeshLoader::CachePath(objPath).c_str());
+
+    double megabytes = text.size() / 1e6;
+    cout << std::fixed << std::setprecision(1)
+         << n << " x " << n << " torus, " << megabytes << " MB of OBJ, "
+         << jobs.NumThreads() << " threads" << endl;
+
+    // Parsing text that's already in memory, best of a few
+    MeshLoader serialLoader;
+    MeshLoader loader(&jobs);
+    Mesh serial, parallel;
+    Clock::duration serialBest = Clock::duration::max();
+    Clock::duration parallelBest = Clock::duration::max();
+
+    for (int attempt = 0; attempt < 3; attempt++) {
+        Clock::time_point start = Clock::now();
+        ok = serialLoader.ParseObj(text.data(), text.size(), serial) && ok;
+        Clock::time_point middle = Clock::now();
+        ok = loader.ParseObj(text.data(), text.size(), parallel) && ok;
+        Clock::time_point end = Clock::now();
+
+        serialBest = std::min(serialBest, middle - start);
+        parallelBest = std::min(parallelBest, end - middle);
+    }
+
+    cout << "  parse, 1 thread:    " << std::setw(8)
+         << megabytes / (milliseconds(serialBest) / 1000) << " MB/s" << endl
+         << "  parse, " << std::setw(2) << jobs.NumThreads() << " threads:  "
+         << std::setw(8)
+         << megabytes / (milliseconds(parallelBest) / 1000) << " MB/s"
+         << endl;
+
+    bool parsedOk = same_mesh(serial, parallel) &&
+                    serial.NumVertices() == (size_t)(n + 1) * (n + 1) &&
+                    serial.NumTriangles() == (size_t)n * n * 2;
+    cout << (parsedOk ? "  ok:     " : "  FAILED: ") << serial.NumVertices()
+         << " vertices, " << serial.NumTriangles()
+         << " triangles, the same on every thread count" << endl;
+    ok = ok && parsedOk;
+
+    // From the file, with no cache, and then from the cache
+    Mesh cold, cached;
+
+    Clock::time_point start = Clock::now();
+    bool coldOk = loader.Load(objPath, cold) && !loader.LoadedFromCache();
+    Clock::duration coldTime = Clock::now() - start;
+
+    start = Clock::now();
+    bool cachedOk = loader.Load(objPath, cached) && loader.LoadedFromCache();
+    Clock::duration cachedTime = Clock::now() - start;
+
+    // Reading every byte is what an upload would do
+    start = Clock::now();
+    uint64_t sum = 0;
+    const unsigned char *bytes = (const unsigned char *)cached.Vertices();
+    for (size_t i = 0; i < cached.VertexBytes(); i += 64)
+        sum += bytes[i];
+    Clock::duration touchTime = Clock::now() - start;
+    sink = sum;
+
+    cout << std::setprecision(2)
+         << "  cold load (parse, cook):  " << std::setw(10)
+         << milliseconds(coldTime) << " ms" << endl
+         << "  cached load (map):        " << std::setw(10)
+         << milliseconds(cachedTime) << " ms" << endl
+         << "  reading the cached mesh:  " << std::setw(10)
+         << milliseconds(touchTime) << " ms" << endl;
+
+    bool loadOk = coldOk && cachedOk && cached.IsMapped() &&
+                  same_mesh(cold, parallel) && same_mesh(cached, parallel);
+    cout << (loadOk ? "  ok:     " : "  FAILED: ")
+         << "the cached mesh is the parsed one" << endl;
+    ok = ok && loadOk;
+
+    Mesh glb;
+    bool glbOk = write_glb(glbPath, parallel) &&
+                 loader.Import(glbPath, glb) && same_mesh(glb, parallel);
+    cout << (glbOk ? "  ok:     " : "  FAILED: ")
+         << "the .glb loads back the same" << endl;
+    ok = ok && glbOk;
+
+    std::remove(objPath.c_str());
+    std::remove(MeshLoader::CachePath(objPath).c_str());
+    std::remove(glbPath.c_str());
+
+    return ok ? 0 : 1;
+}
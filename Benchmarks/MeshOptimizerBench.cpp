@@ -0,0 +1,302 @@
+//============================================================================
+// Name        : MeshOptimizerBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for the mesh optimizer.  We make a torus of n x n
+//               quads, once with its triangles in grid order and once
+//               shuffled (the way a lot of exported meshes come), or load
+//               a mesh with -f, and run it through each stage.  For each we
+//               print the average cache miss ratio (ACMR, vertices
+//               transformed per triangle with a 16 entry FIFO cache), how
+//               long it took, and the bytes per vertex and per index
+//               before and after quantizing.
+//
+//               We check that every stage keeps the same triangles, that
+//               the vertex cache order is better than a shuffled one, and
+//               that the quantized vertices come back within a step of the
+//               originals, and exit with an error if not.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "CmdOptionParser.hpp"
+#include "Mesh.hpp"
+#include "MeshLoader.hpp"
+#include "MeshOptimizer.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+double milliseconds(Clock::duration elapsed)
+{
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+
+void make_torus(int n, std::vector<MeshVertex>& vertices,
+                std::vector<uint32_t>& indices)
+{
+    vertices.clear();
+    indices.clear();
+
+    for (int i = 0; i <= n; i++) {
+        for (int j = 0; j <= n; j++) {
+            float u = 2.0f * (float)M_PI * i / n;
+            float v = 2.0f * (float)M_PI * j / n;
+            float r = 1.0f + 0.25f * std::cos(v);
+
+            MeshVertex vertex = {
+                { r * std::cos(u), r * std::sin(u), 0.25f * std::sin(v) },
+                { std::cos(v) * std::cos(u), std::cos(v) * std::sin(u),
+                  std::sin(v) },
+                { (float)i / n, (float)j / n }
+            };
+            vertices.push_back(vertex);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            uint32_t a = i * (n + 1) + j;
+            uint32_t b = a + n + 1;
+            uint32_t quad[6] = { a, b, b + 1, a, b + 1, a + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+
+// The triangles, each turned so its smallest index comes first (which
+// keeps the winding), and sorted
+std::vector<uint64_t> triangle_set(const std::vector<uint32_t>& indices)
+{
+    std::vector<uint64_t> triangles;
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t t[3] = { indices[i], indices[i + 1], indices[i + 2] };
+        std::rotate(t, std::min_element(t, t + 3), t + 3);
+
+        triangles.push_back((uint64_t)t[0] << 42 | (uint64_t)t[1] << 21 |
+                            t[2]);
+    }
+
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+
+bool same_vertex(const MeshVertex& a, const MeshVertex& b)
+{
+    return std::equal(a.position, a.position + 3, b.position) &&
+           std::equal(a.normal, a.normal + 3, b.normal) &&
+           std::equal(a.texCoord, a.texCoord + 2, b.texCoord);
+}
+
+
+bool check_quantized(const Mesh& mesh, const QuantizedMesh& quantized)
+{
+    if (quantized.NumVertices() != mesh.NumVertices() ||
+        quantized.NumIndices() != mesh.NumIndices())
+        return false;
+
+    for (size_t i = 0; i < mesh.NumVertices(); i++) {
+        const MeshVertex& original = mesh.Vertices()[i];
+        MeshVertex restored = quantized.Dequantize(i);
+
+        // Half a step either way, and a bit for the float math
+        for (int axis = 0; axis < 3; axis++) {
+            float step = quantized.PositionScale()[axis] / 65535.0f;
+            if (std::fabs(restored.position[axis] -
+                          original.position[axis]) > step * 0.5f + 1e-6f ||
+                std::fabs(restored.normal[axis] - original.normal[axis]) >
+                    0.5f / 127.0f + 1e-6f)
+                return false;
+        }
+
+        for (int axis = 0; axis < 2; axis++) {
+            float step = quantized.TexCoordScale()[axis] / 65535.0f;
+            if (std::fabs(restored.texCoord[axis] -
+                          original.texCoord[axis]) > step * 0.5f + 1e-6f)
+                return false;
+        }
+    }
+
+    for (size_t i = 0; i < mesh.NumIndices(); i++) {
+        uint32_t index = quantized.ShortIndices()
+            ? quantized.Indices16()[i] : quantized.Indices32()[i];
+        if (index != mesh.Indices()[i])
+            return false;
+    }
+
+    return true;
+}
+
+
+// Run the mesh through every stage, and print how it went
+bool optimize(const std::string& name, std::vector<MeshVertex> vertices,
+              std::vector<uint32_t> indices, bool mustImprove)
+{
+    std::vector<uint64_t> triangles = triangle_set(indices);
+    bool ok = true;
+
+    double before = AverageCacheMissRatio(indices.data(), indices.size(),
+                                          vertices.size());
+
+    Clock::time_point start = Clock::now();
+    OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+    Clock::duration cacheTime = Clock::now() - start;
+
+    double afterCache = AverageCacheMissRatio(indices.data(), indices.size(),
+                                              vertices.size());
+    ok = ok && triangle_set(indices) == triangles;
+
+    start = Clock::now();
+    OptimizeOverdraw(indices.data(), indices.size(), vertices.data(),
+                     vertices.size());
+    Clock::duration overdrawTime = Clock::now() - start;
+
+    double afterOverdraw = AverageCacheMissRatio(indices.data(),
+                                                 indices.size(),
+                                                 vertices.size());
+    ok = ok && triangle_set(indices) == triangles;
+
+    // The same corners have to end up on the same vertices
+    std::vector<MeshVertex> corners;
+    for (uint32_t index : indices)
+        corners.push_back(vertices[index]);
+
+    start = Clock::now();
+    vertices.resize(OptimizeVertexFetch(vertices.data(), vertices.size(),
+                                        indices.data(), indices.size()));
+    Clock::duration fetchTime = Clock::now() - start;
+
+    for (size_t i = 0; i < indices.size() && ok; i++)
+        ok = same_vertex(vertices[indices[i]], corners[i]);
+
+    Mesh mesh;
+    mesh.Assign(std::move(vertices), std::move(indices));
+
+    start = Clock::now();
+    QuantizedMesh quantized;
+    quantized.Quantize(mesh);
+    Clock::duration quantizeTime = Clock::now() - start;
+
+    ok = ok && check_quantized(mesh, quantized);
+    if (mustImprove)
+        ok = ok && afterCache < before;
+
+    double vertexBytes = (double)sizeof(MeshVertex);
+    double indexBytes = (double)sizeof(uint32_t);
+
+    cout << name << ": " << mesh.NumVertices() << " vertices, "
+         << mesh.NumTriangles() << " triangles" << endl
+         << std::fixed << std::setprecision(3)
+         << "  ACMR            " << before << endl
+         << "  vertex cache    " << afterCache << std::setprecision(1)
+         << std::setw(10) << milliseconds(cacheTime) << " ms" << endl
+         << std::setprecision(3)
+         << "  overdraw        " << afterOverdraw << std::setprecision(1)
+         << std::setw(10) << milliseconds(overdrawTime) << " ms" << endl
+         << "  vertex fetch         " << std::setw(10)
+         << milliseconds(fetchTime) << " ms" << endl
+         << "  quantized            " << std::setw(10)
+         << milliseconds(quantizeTime) << " ms" << endl
+         << std::setprecision(0)
+         << "  bytes per vertex " << vertexBytes << " -> "
+         << (double)quantized.VertexBytes() / quantized.NumVertices()
+         << ", per index " << indexBytes << " -> "
+         << (double)quantized.IndexBytes() / quantized.NumIndices() << endl;
+
+    cout << (ok ? "  ok:     " : "  FAILED: ")
+         << "the same triangles, and the vertices within a step" << endl;
+
+    return ok;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    int n = 300;
+    std::string path;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-n <quads_per_side>] [-f <mesh.obj|mesh.glb>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        n = std::stoi(options.getCmdOption("-n"));
+    if (!options.getCmdOption("-f").empty())
+        path = options.getCmdOption("-f");
+
+    bool ok = true;
+
+    if (!path.empty()) {
+        Mesh mesh;
+        if (!MeshLoader().Import(path, mesh))
+            return 1;
+
+        ok = optimize(path,
+                      std::vector<MeshVertex>(mesh.Vertices(),
+                                              mesh.Vertices() +
+                                              mesh.NumVertices()),
+                      std::vector<uint32_t>(mesh.Indices(),
+                                            mesh.Indices() +
+                                            mesh.NumIndices()),
+                      false);
+
+        return ok ? 0 : 1;
+    }
+
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    make_torus(n, vertices, indices);
+
+    ok = optimize("torus, grid order", vertices, indices, false) && ok;
+
+    // Shuffle the triangles, and the vertices too, so neither has any
+    // order left
+    std::mt19937 rng(1);
+    size_t numTriangles = indices.size() / 3;
+
+    std::vector<size_t> order(numTriangles);
+    for (size_t t = 0; t < numTriangles; t++)
+        order[t] = t;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    std::vector<uint32_t> remap(vertices.size());
+    for (size_t v = 0; v < remap.size(); v++)
+        remap[v] = (uint32_t)v;
+    std::shuffle(remap.begin(), remap.end(), rng);
+
+    std::vector<MeshVertex> shuffledVertices(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++)
+        shuffledVertices[remap[v]] = vertices[v];
+
+    std::vector<uint32_t> shuffledIndices;
+    for (size_t t : order) {
+        for (size_t corner = 0; corner < 3; corner++)
+            shuffledIndices.push_back(remap[indices[t * 3 + corner]]);
+    }
+
+    ok = optimize("torus, shuffled", shuffledVertices, shuffledIndices,
+                  true) && ok;
+
+    return ok ? 0 : 1;
+}
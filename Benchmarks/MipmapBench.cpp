@@ -0,0 +1,189 @@
+//============================================================================
+// Name        : MipmapBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for building mip chains.  We time the
+//               MipmapGenerator with each filter, linear and sRGB, on one
+//               thread and on the JobSystem, and then glGenerateMipmap() on
+//               the same image.  The rates are in megapixels of the base
+//               image per second.
+//
+//               To compare against a software renderer, run it with
+//               LIBGL_ALWAYS_SOFTWARE=1, which gets Mesa's llvmpipe.
+//
+//               This needs a GL context, so it opens a hidden window.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "CmdOptionParser.hpp"
+#include "JobSystem.hpp"
+#include "MipmapGenerator.hpp"
+#include "GLObject.hpp"
+#include "Texture.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+std::vector<unsigned char> make_image(int size)
+{
+    std::mt19937 rng(size);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    std::vector<unsigned char> image((size_t)size * size * 4);
+    for (unsigned char& value : image)
+        value = (unsigned char)byte(rng);
+
+    return image;
+}
+
+
+// Megapixels per second
+double time_generator(const MipmapGenerator& generator,
+                      const std::vector<unsigned char>& image, int size,
+                      unsigned repeats)
+{
+    Clock::time_point start = Clock::now();
+
+    for (unsigned i = 0; i < repeats; i++)
+        generator.Generate(image.data(), size, size);
+
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return (double)size * size * repeats / 1e6 / elapsed.count();
+}
+
+
+double time_gl(const std::vector<unsigned char>& image, int size,
+               unsigned repeats)
+{
+    GLTexture texture = GLTexture::Create();
+
+    glBindTexture(GL_TEXTURE_2D, texture.ID());
+    glTexStorage2D(GL_TEXTURE_2D, Texture::MipLevels(size, size), GL_RGBA8,
+                   size, size);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size,
+                    GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+    glFinish();
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned i = 0; i < repeats; i++) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glFinish();
+    }
+
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return (double)size * size * repeats / 1e6 / elapsed.count();
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    int size = 2048;
+    unsigned repeats = 10;
+    unsigned numThreads = 0;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-s <size>] [-r <repeats>] [-t <threads>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-s").empty())
+        size = std::stoi(options.getCmdOption("-s"));
+    if (!options.getCmdOption("-r").empty())
+        repeats = std::stoul(options.getCmdOption("-r"));
+    if (!options.getCmdOption("-t").empty())
+        numThreads = std::stoul(options.getCmdOption("-t"));
+
+    JobSystem jobs(numThreads);
+    std::vector<unsigned char> image = make_image(size);
+
+    struct Mode
+    {
+        const char *name;
+        MipmapGenerator::Filter filter;
+        bool srgb;
+    };
+
+    const Mode modes[] = {
+        { "box", MipmapGenerator::Box, false },
+        { "box, sRGB", MipmapGenerator::Box, true },
+        { "Kaiser", MipmapGenerator::Kaiser, false },
+        { "Kaiser, sRGB", MipmapGenerator::Kaiser, true },
+    };
+
+    cout << size << "x" << size << " image, " << repeats << " repeats"
+         << endl;
+    cout << std::fixed << std::setprecision(1);
+    cout << "                     1 thread   " << std::setw(2)
+         << jobs.NumThreads() << " threads   (MP/s)" << endl;
+
+    for (const Mode& mode : modes) {
+        MipmapGenerator serial(mode.filter, mode.srgb);
+        MipmapGenerator parallel(mode.filter, mode.srgb, &jobs);
+
+        cout << "  " << std::left << std::setw(16) << mode.name
+             << std::right
+             << std::setw(12) << time_generator(serial, image, size, repeats)
+             << std::setw(13) << time_generator(parallel, image, size,
+                                                repeats)
+             << endl;
+    }
+
+    if (!glfwInit()) {
+        cout << "GLFW Initialization Failed!!" << endl;
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "MipmapBench",
+                                          nullptr, nullptr);
+    if (window == nullptr) {
+        cout << "Failed to create GLFW window" << endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        cout << "Failed to initialize GLEW" << endl;
+        return -1;
+    }
+
+    if (!GLEW_ARB_texture_storage) {
+        cout << "No glTexStorage2D() here, skipping glGenerateMipmap()"
+             << endl;
+        glfwTerminate();
+        return 0;
+    }
+
+    cout << "  glGenerateMipmap() on " << glGetString(GL_RENDERER) << ": "
+         << time_gl(image, size, repeats) << " MP/s" << endl;
+
+    GLNamePool::FlushAll();
+    glfwTerminate();
+
+    return 0;
+}
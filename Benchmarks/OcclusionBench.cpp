@@ -0,0 +1,227 @@
+//============================================================================
+// Name        : OcclusionBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for the CPU OcclusionCuller.
+//               Our scene is a city-like grid of boxes with a row of big
+//               walls in front of the camera.  The walls are our occluders.
+//               We time drawing the occluders and building the depth
+//               pyramid, and testing all the box bounds against it, and
+//               report how many of the boxes got culled.
+//
+//               We also check that:
+//               - with one wall in front of the camera, a box behind it is
+//                 culled, and boxes in front of it and past its edge are
+//                 visible,
+//               - a box behind the camera is culled, and one crossing the
+//                 near plane is visible,
+//               - RenderAsync() and Finish() give what Render() gives,
+//               - every number of threads gives the same boxes as one.
+//               and exit with an error if any of that doesn't hold.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include <Eigen/Dense>
+using Eigen::Matrix4f;
+using Eigen::Vector3f;
+using Eigen::Affine3f;
+using Eigen::Translation3f;
+using Eigen::Scaling;
+
+#include "CmdOptionParser.hpp"
+#include "JobSystem.hpp"
+#include "Camera.hpp"
+#include "OcclusionCuller.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// a unit cube centered on the origin
+const float cubeVertices[] = {
+    -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,
+     0.5f,  0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,
+    -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,
+     0.5f,  0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,
+};
+
+const uint32_t cubeIndices[] = {
+    0, 1, 2,  2, 3, 0,   // near face
+    4, 5, 6,  6, 7, 4,   // far face
+    3, 2, 6,  6, 7, 3,   // top face
+    0, 1, 5,  5, 4, 0,   // bottom face
+    0, 4, 7,  7, 3, 0,   // left face
+    1, 5, 6,  6, 2, 1,   // right face
+};
+
+
+bool check(bool passed, const char *what)
+{
+    cout << (passed ? "  ok:     " : "  FAILED: ") << what << endl;
+    return passed;
+}
+
+
+// Is a unit box around center visible, with the culler's last depth buffer
+bool BoxVisible(const OcclusionCuller& culler, const Vector3f& center)
+{
+    return culler.IsVisible(center - Vector3f(0.5f, 0.5f, 0.5f),
+                            center + Vector3f(0.5f, 0.5f, 0.5f));
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    unsigned numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    int gridSize = 300;
+    int frames = 50;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-t <threads>] [-g <grid_size>] [-f <frames>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-t").empty())
+        numThreads = std::stoul(options.getCmdOption("-t"));
+    if (!options.getCmdOption("-g").empty())
+        gridSize = std::stoi(options.getCmdOption("-g"));
+    if (!options.getCmdOption("-f").empty())
+        frames = std::stoi(options.getCmdOption("-f"));
+
+    // our objects, a grid of unit boxes on the ground
+    std::vector<Vector3f> boxMins;
+    std::vector<Vector3f> boxMaxs;
+
+    for (int z = 0; z < gridSize; z++) {
+        for (int x = 0; x < gridSize; x++) {
+            Vector3f center((x - gridSize / 2) * 2.0f, 0.5f, -z * 2.0f - 10.0f);
+
+            boxMins.push_back(center - Vector3f(0.5f, 0.5f, 0.5f));
+            boxMaxs.push_back(center + Vector3f(0.5f, 0.5f, 0.5f));
+        }
+    }
+
+    std::vector<uint8_t> visible(boxMins.size());
+
+    // our occluders, a few big walls between us and the grid
+    std::vector<Matrix4f, Eigen::aligned_allocator<Matrix4f>> walls;
+    for (int w = -2; w <= 2; w++) {
+        Affine3f wall(Translation3f(w * 12.0f, 2.0f, -8.0f) *
+                      Scaling(8.0f, 4.0f, 0.5f));
+        walls.push_back(wall.matrix());
+    }
+
+    Camera camera;
+    camera.lookAt(Vector3f(0.0f, 2.0f, 0.0f),
+                  Vector3f(0.0f, 2.0f, -1.0f),
+                  Vector3f(0.0f, 1.0f, 0.0f));
+    camera.setPerspective(45.0f, 800.0f, 600.0f, 0.1f, 1000.0f);
+
+    cout << boxMins.size() << " boxes, " << walls.size()
+         << " occluders" << endl;
+    cout << std::fixed << std::setprecision(3);
+
+    // how many boxes would we draw with just frustum culling
+    {
+        OcclusionCuller frustumOnly;
+
+        frustumOnly.Render(camera.ViewProjection());
+        cout << frustumOnly.TestBoxes(boxMins.data(), boxMaxs.data(),
+                                      boxMins.size(), visible.data())
+             << " boxes in the view frustum" << endl;
+    }
+
+    cout << "threads   render(ms)   test(ms)   Mboxes/sec   visible" << endl;
+
+    // what one thread sees, for the others to match
+    std::vector<uint8_t> oneThread;
+    bool sameForThreads = true;
+    bool asyncMatches = true;
+
+    for (unsigned n = 1; n <= numThreads; n *= 2) {
+        JobSystem jobs(n);
+        OcclusionCuller culler(&jobs);
+
+        for (const Matrix4f& wall : walls)
+            culler.AddOccluder(cubeVertices, 8, cubeIndices, 36, wall);
+
+        double renderTime = 0.0, testTime = 0.0;
+        size_t numVisible = 0;
+
+        for (int f = 0; f < frames; f++) {
+            Clock::time_point start = Clock::now();
+            culler.Render(camera.ViewProjection());
+            Clock::time_point rendered = Clock::now();
+            numVisible = culler.TestBoxes(boxMins.data(), boxMaxs.data(),
+                                          boxMins.size(), visible.data());
+            Clock::time_point tested = Clock::now();
+
+            renderTime += std::chrono::duration<double, std::milli>(rendered - start).count();
+            testTime += std::chrono::duration<double, std::milli>(tested - rendered).count();
+        }
+
+        renderTime /= frames;
+        testTime /= frames;
+
+        if (n == 1)
+            oneThread = visible;
+        sameForThreads = sameForThreads && (visible == oneThread);
+
+        // The same again in the background
+        std::vector<uint8_t> asyncVisible(boxMins.size());
+
+        culler.RenderAsync(camera.ViewProjection());
+        culler.Finish();
+        culler.TestBoxes(boxMins.data(), boxMaxs.data(), boxMins.size(),
+                         asyncVisible.data());
+        asyncMatches = asyncMatches && (asyncVisible == visible);
+
+        cout << std::setw(7) << n
+             << std::setw(13) << renderTime
+             << std::setw(11) << testTime
+             << std::setw(13) << boxMins.size() / (testTime * 1000.0)
+             << std::setw(10) << numVisible << endl;
+    }
+
+    bool passed = true;
+
+    // One wall 4 wide, 8 in front of the camera
+    {
+        OcclusionCuller culler;
+        Matrix4f wall = Affine3f(Translation3f(0.0f, 2.0f, -8.0f) *
+                                 Scaling(4.0f, 4.0f, 0.5f)).matrix();
+
+        culler.AddOccluder(cubeVertices, 8, cubeIndices, 36, wall);
+        culler.Render(camera.ViewProjection());
+
+        passed &= check(!BoxVisible(culler, Vector3f(0.0f, 2.0f, -20.0f)),
+                        "a box behind the wall is culled");
+        passed &= check(BoxVisible(culler, Vector3f(0.0f, 2.0f, -4.0f)),
+                        "a box in front of the wall is visible");
+        passed &= check(BoxVisible(culler, Vector3f(8.0f, 2.0f, -20.0f)),
+                        "a box past the wall's edge is visible");
+        passed &= check(!BoxVisible(culler, Vector3f(0.0f, 2.0f, 10.0f)),
+                        "a box behind the camera is culled");
+        passed &= check(BoxVisible(culler, Vector3f(0.0f, 2.0f, 0.2f)),
+                        "a box crossing the near plane is visible");
+    }
+
+    passed &= check(asyncMatches,
+                    "RenderAsync() and Finish() match Render()");
+    passed &= check(sameForThreads,
+                    "every number of threads culls the same boxes");
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+//============================================================================
+// Name        : ProgramCacheBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Loads the same material (vertex and fragment shader pair)
+//               over and over, and checks that the ProgramCache compiles
+//               it once, hands out the same program every time after that,
+//               and deletes it when the last Shader goes away.  After a
+//               Clear(), the next load has to link it again.
+//               We also count the heap allocations and the time it takes
+//               to load a material that is already in the cache, and check
+//               that getting a program the cache already has allocates
+//               nothing.
+//
+//               This needs a GL context, so it opens a hidden window.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "CmdOptionParser.hpp"
+#include "Shader.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// Every heap allocation in the program goes through here
+static std::atomic<size_t> numAllocations(0);
+
+void *operator new(size_t size)
+{
+    numAllocations++;
+
+    void *ptr = std::malloc(size ? size : 1);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+
+    return ptr;
+}
+
+// Both deletes are replaced, and kept out of line: inlined into the
+// library's callers, GCC sees a free() of what operator new returned.
+__attribute__((noinline)) void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+
+bool check(bool passed, const char *what)
+{
+    cout << (passed ? "  ok:     " : "  FAILED: ") << what << endl;
+    return passed;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    const std::string &filePath = options.getCmdOption("-p");
+    size_t numLoads = 1000;
+
+    if (filePath.empty()) {
+        cout << "Usage: " << argv[0]
+             << " -p <path_to_resource_folder> [-n <loads>]" << endl;
+        return 1;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        numLoads = std::stoul(options.getCmdOption("-n"));
+
+    std::string root = filePath;
+    if (root.back() != '/')
+        root += "/";
+
+    std::string vertexFile = root + "glsl/TransTexVertexShader.glsl";
+    std::string fragmentFile = root + "glsl/TextureFragmentShader.glsl";
+
+    if (!glfwInit()) {
+        cout << "GLFW Initialization Failed!!" << endl;
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "ProgramCacheBench",
+                                          nullptr, nullptr);
+    if (window == nullptr) {
+        cout << "Failed to create GLFW window" << endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        cout << "Failed to initialize GLEW" << endl;
+        return -1;
+    }
+
+    ProgramCache &cache = Shader::DefaultCache();
+    GLuint program = 0;
+    bool passed = true;
+
+    {
+        std::vector<Shader> shaders;
+        shaders.reserve(numLoads);
+
+        // The first one reads, scans and compiles everything
+        Clock::time_point start = Clock::now();
+        shaders.emplace_back(vertexFile.c_str(), fragmentFile.c_str());
+        std::chrono::duration<double, std::micro> coldTime =
+            Clock::now() - start;
+
+        program = shaders[0].Program;
+
+        // The rest should all come out of the cache
+        size_t allocationsBefore = numAllocations;
+        start = Clock::now();
+
+        for (size_t i = 1; i < numLoads; i++)
+            shaders.emplace_back(vertexFile.c_str(), fragmentFile.c_str());
+
+        std::chrono::duration<double, std::micro> warmTime =
+            Clock::now() - start;
+        size_t allocations = numAllocations - allocationsBefore;
+
+        bool allSame = true;
+        for (const Shader& shader : shaders)
+            allSame = allSame && (shader.Program == program);
+
+        size_t numWarm = std::max<size_t>(numLoads - 1, 1);
+
+        cout << std::fixed << std::setprecision(2);
+        cout << numLoads << " loads of the same material" << endl
+             << "  first load:       " << coldTime.count() << " us" << endl
+             << "  cached loads:     " << warmTime.count() / numWarm
+             << " us each" << endl
+             << "  allocations:      " << (double)allocations / numWarm
+             << " per cached load" << endl
+             << "  compiles:         " << cache.Compiles() << endl
+             << "  cache hits:       " << cache.Hits() << endl;
+
+        passed &= check(program != 0, "the material compiled");
+        passed &= check(cache.Compiles() == 1, "it was compiled once");
+        passed &= check(cache.Hits() == numLoads - 1,
+                        "every other load was a cache hit");
+        passed &= check(allSame, "every Shader has the same program");
+        passed &= check(cache.NumPrograms() == 1, "there is one program");
+
+        // Straight from the cache, with the sources resolved already, a
+        // hit is just a lookup
+        ShaderSourceLoader loader(root);
+        const ShaderSource *vertexSource =
+            loader.Load("glsl/TransTexVertexShader.glsl");
+        const ShaderSource *fragmentSource =
+            loader.Load("glsl/TextureFragmentShader.glsl");
+
+        if (vertexSource != nullptr && fragmentSource != nullptr) {
+            std::vector<ProgramHandle> handles;
+            handles.reserve(numLoads);
+
+            allocationsBefore = numAllocations;
+            for (size_t i = 0; i < numLoads; i++)
+                handles.push_back(cache.Acquire(*vertexSource,
+                                                *fragmentSource));
+            allocations = numAllocations - allocationsBefore;
+
+            bool sameProgram = true;
+            for (const ProgramHandle& handle : handles)
+                sameProgram = sameProgram && handle.Program() == program;
+
+            cout << "  allocations:      " << (double)allocations / numLoads
+                 << " per cache hit" << endl;
+
+            passed &= check(sameProgram && cache.Compiles() == 1,
+                            "the cache hands out the same program");
+            passed &= check(allocations == 0, "cache hits allocate nothing");
+        }
+        else {
+            passed &= check(false, "the sources load");
+        }
+
+        // Moving a Shader hands over the program without releasing it
+        Shader moved = std::move(shaders.back());
+        shaders.clear();
+
+        passed &= check(moved.Program == program &&
+                        glIsProgram(program) == GL_TRUE,
+                        "the program survives until the last Shader goes");
+    }
+
+    passed &= check(cache.NumPrograms() == 0 &&
+                    glIsProgram(program) == GL_FALSE,
+                    "the program is deleted with the last Shader");
+
+    // Clearing the cache while a Shader still holds the program takes it
+    // away from that Shader, and loading the material again links it again.
+    {
+        Shader held(vertexFile.c_str(), fragmentFile.c_str());
+        size_t compilesBefore = cache.Compiles();
+        size_t hitsBefore = cache.Hits();
+
+        cache.Clear();
+        Shader again(vertexFile.c_str(), fragmentFile.c_str());
+
+        passed &= check(again.Program != 0 &&
+                        glIsProgram(again.Program) == GL_TRUE &&
+                        cache.Compiles() == compilesBefore + 1 &&
+                        cache.Hits() == hitsBefore,
+                        "a load after Clear() links the program again");
+    }
+
+    passed &= check(cache.NumPrograms() == 0,
+                    "the entry goes with the last Shader after Clear()");
+
+    glfwTerminate();
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+//============================================================================
+// Name        : SceneGraphBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for the SceneGraph transform update.
+//               We build a big hierarchy (100k nodes by default), mark a
+//               fraction of the nodes dirty, and time how long Update()
+//               takes to propagate the world matrices.  We do this on one
+//               thread, and then on the JobSystem.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <thread>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include <Eigen/Dense>
+using Eigen::Affine3f;
+using Eigen::AngleAxisf;
+using Eigen::Translation3f;
+using Eigen::Vector3f;
+
+#include "CmdOptionParser.hpp"
+#include "JobSystem.hpp"
+#include "SceneGraph.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+// Build a tree where every node has up to 'fanout' children.
+void build_scene(SceneGraph &scene, size_t numNodes, size_t fanout)
+{
+    for (size_t i = 0; i < numNodes; i++) {
+        SceneNode parent = (i == 0) ? SceneGraph::None
+                                    : (SceneNode)((i - 1) / fanout);
+        Affine3f local(Translation3f(1.0f, 0.0f, 0.0f) *
+                       AngleAxisf(0.01f * i, Vector3f::UnitY()));
+
+        scene.AddNode(parent, local);
+    }
+
+    scene.Update();
+}
+
+
+// Average time of an update, in microseconds
+double time_update(SceneGraph &scene, double dirtyFraction,
+                   unsigned runs, size_t &numUpdated)
+{
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<size_t> pick(0, scene.Size() - 1);
+    size_t numDirty = (size_t)(scene.Size() * dirtyFraction);
+    double total = 0.0;
+
+    numUpdated = 0;
+
+    for (unsigned r = 0; r < runs; r++) {
+        for (size_t i = 0; i < numDirty; i++) {
+            SceneNode node = (dirtyFraction >= 1.0) ? (SceneNode)i
+                                                    : (SceneNode)pick(rng);
+            Affine3f local = scene.Local(node);
+
+            local.rotate(AngleAxisf(0.001f, Vector3f::UnitZ()));
+            scene.SetLocal(node, local);
+        }
+
+        Clock::time_point start = Clock::now();
+        numUpdated += scene.Update();
+        std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+
+        total += elapsed.count();
+    }
+
+    numUpdated /= runs;
+
+    return total / runs;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    size_t numNodes = 100000;
+    size_t fanout = 4;
+    unsigned runs = 20;
+    unsigned numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-n <nodes>] [-f <fanout>] [-r <runs>] [-t <threads>]"
+             << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        numNodes = std::stoul(options.getCmdOption("-n"));
+    if (!options.getCmdOption("-f").empty())
+        fanout = std::stoul(options.getCmdOption("-f"));
+    if (!options.getCmdOption("-r").empty())
+        runs = std::stoul(options.getCmdOption("-r"));
+    if (!options.getCmdOption("-t").empty())
+        numThreads = std::stoul(options.getCmdOption("-t"));
+
+    JobSystem jobs(numThreads);
+
+    SceneGraph serialScene;
+    SceneGraph parallelScene(&jobs);
+
+    build_scene(serialScene, numNodes, fanout);
+    build_scene(parallelScene, numNodes, fanout);
+
+    cout << numNodes << " nodes, fanout " << fanout
+         << ", depth " << serialScene.Depth() << endl;
+
+    cout << std::fixed << std::setprecision(1);
+    cout << "  dirty   recomputed    1 thread(us)   "
+         << numThreads << " threads(us)" << endl;
+
+    const double fractions[] = {0.01, 0.10, 1.0};
+
+    for (double fraction : fractions) {
+        size_t serialUpdated, parallelUpdated;
+
+        double serial = time_update(serialScene, fraction, runs,
+                                    serialUpdated);
+        double parallel = time_update(parallelScene, fraction, runs,
+                                      parallelUpdated);
+
+        cout << std::setw(6) << fraction * 100.0 << "%"
+             << std::setw(13) << serialUpdated
+             << std::setw(16) << serial
+             << std::setw(16) << parallel << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,325 @@
+//============================================================================
+// Name        : SoftwareRasterBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Throughput benchmark for the SoftwareRenderer.
+//               We draw a grid of textured, vertex colored cubes, each with
+//               its own model transform, and report the triangles and the
+//               pixels per second we get with 1, 2, 4, ... threads.
+//
+//               Then we draw the TransformCube scene (with checkerboards
+//               for its images, so no image decoder is involved) and check
+//               that:
+//               - every number of threads gives the same bytes as one,
+//               - the frame hashes to the golden value below.
+//               and exit with an error if either doesn't hold.  The golden
+//               hash is from an x86-64 build with the default flags (SSE2,
+//               no FMA).  -march=native rounds differently, and so does
+//               anything that changes the picture on purpose; we print the
+//               new hash, to update it with.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <Eigen/Dense>
+using Eigen::Matrix4f;
+using Eigen::Vector3f;
+using Eigen::Affine3f;
+using Eigen::AngleAxisf;
+using Eigen::Translation3f;
+
+#include "CmdOptionParser.hpp"
+#include "OGLCommon.hpp"
+#include "SpookyV2.h"
+#include "JobSystem.hpp"
+#include "Camera.hpp"
+#include "SoftwareRenderer.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// SpookyHash::Hash64() of the golden frame's color buffer
+const uint64_t GoldenHash = 0xa6b5c08a0ca2537cULL;
+const int GoldenWidth = 800;
+const int GoldenHeight = 600;
+const int GoldenTicks = 30;
+
+// a unit cube centered on the origin, with the TransformCube attributes
+const float cubeVertices[] = {
+    -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,
+     0.5f,  0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,
+    -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,
+     0.5f,  0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,
+};
+
+const float cubeTexCoords[] = {
+    0.0f, 0.0f,  1.0f, 0.0f,  1.0f, 1.0f,  0.0f, 1.0f,
+    0.0f, 1.0f,  1.0f, 1.0f,  1.0f, 0.0f,  0.0f, 0.0f,
+};
+
+const float cubeColors[] = {
+    0.f, 0.f, 1.f,  1.f, 0.f, 1.f,  1.f, 1.f, 1.f,  0.f, 1.f, 1.f,
+    0.f, 0.f, 0.f,  1.f, 0.f, 0.f,  1.f, 1.f, 0.f,  0.f, 1.f, 0.f,
+};
+
+const uint32_t cubeIndices[] = {
+    0, 1, 2,  2, 3, 0,   // near face
+    4, 5, 6,  6, 7, 4,   // far face
+    3, 2, 6,  6, 7, 3,   // top face
+    0, 1, 5,  5, 4, 0,   // bottom face
+    0, 4, 7,  7, 3, 0,   // left face
+    1, 5, 6,  6, 2, 1,   // right face
+};
+
+
+// a checkerboard, so the texture lookups aren't all the same color
+std::vector<unsigned char> checkerboard(int size, int squares)
+{
+    std::vector<unsigned char> pixels(size * size * 3);
+
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            bool odd = ((x * squares / size) + (y * squares / size)) & 1;
+            unsigned char *p = &pixels[(y * size + x) * 3];
+
+            p[0] = odd ? 220 : 40;
+            p[1] = odd ? 180 : 60;
+            p[2] = (unsigned char)(x * 255 / size);
+        }
+    }
+
+    return pixels;
+}
+
+
+bool check(bool passed, const char *what)
+{
+    cout << (passed ? "  ok:     " : "  FAILED: ") << what << endl;
+    return passed;
+}
+
+
+// The TransformCube scene, GoldenTicks ticks of its animation in
+void RenderGolden(SoftwareRenderer& renderer,
+                  const SoftwareTexture& texture0,
+                  const SoftwareTexture& texture1)
+{
+    SoftwareVertexData cube;
+    cube.positions = cubeVertices;
+    cube.colors = cubeColors;
+    cube.texCoords = cubeTexCoords;
+    cube.numVertices = 8;
+
+    const float deltaTime = 1.0f / 60.0f;
+
+    Affine3f model(AngleAxisf(to_radians(-65.0f), Vector3f::UnitX()));
+    for (int tick = 0; tick < GoldenTicks; tick++) {
+        model *= AngleAxisf(to_radians(deltaTime * 60.0f), Vector3f::UnitZ())
+               * AngleAxisf(to_radians(deltaTime * 30.0f), Vector3f::UnitY())
+               * AngleAxisf(to_radians(deltaTime * 30.0f), Vector3f::UnitX());
+    }
+
+    // the last two faces are the first two turned 90 degrees
+    Affine3f sideFaces = model *
+        AngleAxisf(to_radians(90.0f), Vector3f::UnitY());
+
+    Camera camera;
+    camera.lookAt(Vector3f(0.0f, 0.0f, 3.0f),
+                  Vector3f(0.0f, 0.0f, 0.0f),
+                  Vector3f(0.0f, 1.0f, 0.0f));
+    camera.setPerspective(45.0f, (float)renderer.Width(),
+                          (float)renderer.Height(), 0.1f, 100.0f);
+
+    Matrix4f view = camera.View();
+    Matrix4f projection = camera.Projection();
+
+    renderer.Clear(0.2f, 0.3f, 0.3f, 1.0f);
+
+    renderer.UseTransform(model.data(), 0);
+    renderer.UseTransform(view.data(), 1);
+    renderer.UseTransform(projection.data(), 2);
+    renderer.UseTexture(&texture0, 0);
+    renderer.UseTexture(&texture1, 1);
+
+    renderer.DrawElements(cube, cubeIndices, 24);
+
+    renderer.UseTransform(sideFaces.data(), 0);
+    renderer.DrawElements(cube, cubeIndices, 12);
+
+    renderer.Flush();
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    int gridSize = 30;
+    int frames = 20;
+    int width = 1280;
+    int height = 720;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-t <max_threads>] [-g <grid_size>] [-f <frames>]"
+             << " [-W <width>] [-H <height>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-t").empty())
+        maxThreads = std::stoul(options.getCmdOption("-t"));
+    if (!options.getCmdOption("-g").empty())
+        gridSize = std::stoi(options.getCmdOption("-g"));
+    if (!options.getCmdOption("-f").empty())
+        frames = std::stoi(options.getCmdOption("-f"));
+    if (!options.getCmdOption("-W").empty())
+        width = std::stoi(options.getCmdOption("-W"));
+    if (!options.getCmdOption("-H").empty())
+        height = std::stoi(options.getCmdOption("-H"));
+
+    std::vector<unsigned char> checker = checkerboard(256, 8);
+    SoftwareTexture texture0(checker.data(), 256, 256, 3);
+    SoftwareTexture texture1(checker.data(), 256, 256, 3);
+
+    SoftwareVertexData cube;
+    cube.positions = cubeVertices;
+    cube.colors = cubeColors;
+    cube.texCoords = cubeTexCoords;
+    cube.numVertices = 8;
+
+    // a grid of cubes in front of the camera, each turned a bit differently
+    std::vector<Matrix4f, Eigen::aligned_allocator<Matrix4f>> models;
+
+    for (int y = 0; y < gridSize; y++) {
+        for (int x = 0; x < gridSize; x++) {
+            Affine3f model = Translation3f((x - gridSize * 0.5f) * 1.5f,
+                                           (y - gridSize * 0.5f) * 1.5f,
+                                           -(float)((x + y) % 7))
+                           * AngleAxisf(0.1f * (x + y), Vector3f::UnitY())
+                           * AngleAxisf(0.07f * (x * y), Vector3f::UnitX());
+
+            models.push_back(model.matrix());
+        }
+    }
+
+    Camera camera;
+    camera.lookAt(Vector3f(0.0f, 0.0f, gridSize * 1.2f),
+                  Vector3f(0.0f, 0.0f, 0.0f),
+                  Vector3f(0.0f, 1.0f, 0.0f));
+    camera.setPerspective(60.0f, (float)width, (float)height, 0.1f, 200.0f);
+
+    Matrix4f view = camera.View();
+    Matrix4f projection = camera.Projection();
+
+    cout << models.size() << " cubes, " << models.size() * 12
+         << " triangles per frame at " << width << "x" << height << endl;
+
+    cout << std::fixed << std::setprecision(1);
+    cout << "threads   frame(ms)   Mtris/sec   Mpixels/sec   speedup" << endl;
+
+    // 1, 2, 4, ... and whatever the max is
+    std::vector<unsigned> threadCounts;
+    for (unsigned numThreads = 1; numThreads < maxThreads; numThreads *= 2)
+        threadCounts.push_back(numThreads);
+    threadCounts.push_back(maxThreads);
+
+    double baseline = 0.0;
+
+    for (unsigned numThreads : threadCounts) {
+        JobSystem jobs(numThreads);
+        SoftwareRenderer renderer(width, height, &jobs);
+
+        renderer.UseTransform(view.data(), 1);
+        renderer.UseTransform(projection.data(), 2);
+        renderer.UseTexture(&texture0, 0);
+        renderer.UseTexture(&texture1, 1);
+
+        double seconds = 0.0;
+        size_t triangles = 0;
+        size_t pixels = 0;
+
+        // one frame to warm up
+        for (int frame = -1; frame < frames; frame++) {
+            Clock::time_point start = Clock::now();
+
+            renderer.Clear(0.2f, 0.3f, 0.3f, 1.0f);
+
+            for (const Matrix4f& model : models) {
+                renderer.UseTransform(model.data(), 0);
+                renderer.DrawElements(cube, cubeIndices, 36);
+            }
+
+            renderer.Flush();
+
+            if (frame < 0)
+                continue;
+
+            seconds += std::chrono::duration<double>(Clock::now() -
+                                                     start).count();
+            triangles += renderer.TrianglesSubmitted();
+            pixels += renderer.PixelsShaded();
+        }
+
+        double frameMs = seconds / frames * 1000.0;
+        if (numThreads == 1)
+            baseline = frameMs;
+
+        cout << std::setw(7) << numThreads
+             << std::setw(12) << frameMs
+             << std::setw(12) << triangles / seconds / 1.0e6
+             << std::setw(14) << pixels / seconds / 1.0e6
+             << std::setw(10) << baseline / frameMs << "x" << endl;
+    }
+
+    // The golden frame, with one thread and with several (even where
+    // there's only one core)
+    std::vector<uint32_t> oneThread;
+    bool sameForThreads = true;
+    uint64_t hash = 0;
+
+    for (unsigned numThreads : {1u, std::max(maxThreads, 4u)}) {
+        JobSystem jobs(numThreads);
+        SoftwareRenderer renderer(GoldenWidth, GoldenHeight, &jobs);
+
+        RenderGolden(renderer, texture0, texture1);
+
+        const uint32_t *color = renderer.ColorBuffer();
+        std::vector<uint32_t> frame(color,
+                                    color + GoldenWidth * GoldenHeight);
+
+        if (oneThread.empty()) {
+            oneThread = frame;
+            hash = SpookyHash::Hash64(frame.data(),
+                                      frame.size() * sizeof(uint32_t), 0);
+        }
+        else {
+            sameForThreads = sameForThreads && (frame == oneThread);
+        }
+    }
+
+    bool passed = true;
+
+    passed &= check(sameForThreads,
+                    "the golden frame is the same for every thread count");
+    passed &= check(hash == GoldenHash, "the golden frame hashes the same");
+
+    if (hash != GoldenHash) {
+        cout << "  golden hash: 0x" << std::hex << std::setw(16)
+             << std::setfill('0') << hash << std::dec << endl;
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+//============================================================================
+// Name        : SpookyBatchBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for hashing a lot of short keys.  For each key
+//               size, we hash the same keys with a loop over
+//               SpookyHash::Hash64(), and with SpookyHash64Batch(), and
+//               print millions of keys per second for each.  Then the same
+//               with keys of mixed sizes.
+//
+//               We check that the batch gets the same hashes as the loop,
+//               for every length up to past SpookyHash's long hash, and
+//               exit with an error if it doesn't.
+//
+//               How many lanes there are depends on how libCPPMisc was
+//               compiled; configure it with CXXFLAGS="-O2 -march=native"
+//               (or -mavx2) to get them.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "CmdOptionParser.hpp"
+#include "SpookyV2.h"
+#include "SpookyBatch.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+// Keys of the given sizes, one after another in 'bytes'
+struct Keys
+{
+    std::vector<unsigned char> bytes;
+    std::vector<const void *> pointers;
+    std::vector<size_t> lengths;
+};
+
+
+Keys make_keys(const std::vector<size_t>& lengths, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    Keys keys;
+    keys.lengths = lengths;
+
+    size_t total = 0;
+    for (size_t length : lengths)
+        total += length;
+
+    keys.bytes.resize(total);
+    for (unsigned char& value : keys.bytes)
+        value = (unsigned char)byte(rng);
+
+    size_t offset = 0;
+    for (size_t length : lengths) {
+        keys.pointers.push_back(keys.bytes.data() + offset);
+        offset += length;
+    }
+
+    return keys;
+}
+
+
+// Millions of keys per second, for the loop and for the batch, best of a
+// few tries
+void time_keys(const Keys& keys, unsigned repeats,
+               double& loopRate, double& batchRate)
+{
+    size_t count = keys.lengths.size();
+    std::vector<uint64_t> hashes(count);
+
+    std::chrono::duration<double> loopBest(1e9);
+    std::chrono::duration<double> batchBest(1e9);
+
+    for (int attempt = 0; attempt < 5; attempt++) {
+        Clock::time_point start = Clock::now();
+
+        for (unsigned r = 0; r < repeats; r++) {
+            for (size_t i = 0; i < count; i++)
+                hashes[i] = SpookyHash::Hash64(keys.pointers[i],
+                                               keys.lengths[i], r);
+        }
+
+        Clock::time_point middle = Clock::now();
+
+        for (unsigned r = 0; r < repeats; r++)
+            SpookyHash64Batch(keys.pointers.data(), keys.lengths.data(),
+                              count, r, hashes.data());
+
+        Clock::time_point end = Clock::now();
+
+        loopBest = std::min(loopBest,
+                            std::chrono::duration<double>(middle - start));
+        batchBest = std::min(batchBest,
+                             std::chrono::duration<double>(end - middle));
+    }
+
+    double keysHashed = (double)count * repeats / 1e6;
+    loopRate = keysHashed / loopBest.count();
+    batchRate = keysHashed / batchBest.count();
+}
+
+
+bool check_hashes()
+{
+    // Every length, in a shuffled order, so the lanes get mixed lengths
+    std::vector<size_t> lengths;
+    for (int copy = 0; copy < 4; copy++) {
+        for (size_t length = 0; length < 300; length++)
+            lengths.push_back(length);
+    }
+
+    std::shuffle(lengths.begin(), lengths.end(), std::mt19937(1));
+
+    Keys keys = make_keys(lengths, 2);
+    size_t count = lengths.size();
+
+    std::vector<uint64_t> hashes(count);
+    SpookyHash64Batch(keys.pointers.data(), keys.lengths.data(), count,
+                      1234, hashes.data());
+
+    // and the 128 bit hash, with a seed pair for each key, and a count
+    // that doesn't fill the last lanes
+    size_t count128 = count - 3;
+    std::vector<uint64_t> hash1(count128), hash2(count128);
+
+    for (size_t i = 0; i < count128; i++) {
+        hash1[i] = i;
+        hash2[i] = i * 7 + 1;
+    }
+
+    SpookyHash128Batch(keys.pointers.data(), keys.lengths.data(), count128,
+                       hash1.data(), hash2.data());
+
+    for (size_t i = 0; i < count; i++) {
+        if (hashes[i] != SpookyHash::Hash64(keys.pointers[i],
+                                            keys.lengths[i], 1234))
+        {
+            cout << "  Hash64 differs for a " << keys.lengths[i]
+                 << " byte key" << endl;
+            return false;
+        }
+
+        if (i >= count128)
+            continue;
+
+        uint64 seed1 = i;
+        uint64 seed2 = i * 7 + 1;
+        SpookyHash::Hash128(keys.pointers[i], keys.lengths[i],
+                            &seed1, &seed2);
+
+        if (hash1[i] != seed1 || hash2[i] != seed2) {
+            cout << "  Hash128 differs for a " << keys.lengths[i]
+                 << " byte key" << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    size_t numKeys = 4096;
+    unsigned repeats = 100;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0] << " [-n <keys>] [-r <repeats>]"
+             << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        numKeys = std::stoul(options.getCmdOption("-n"));
+    if (!options.getCmdOption("-r").empty())
+        repeats = std::stoul(options.getCmdOption("-r"));
+
+    bool matched = check_hashes();
+    cout << (matched ? "  ok:     " : "  FAILED: ")
+         << "the batch hashes are SpookyHash's" << endl;
+
+    cout << numKeys << " keys, " << repeats << " repeats, "
+         << SpookyBatchLanes() << " lanes" << endl;
+    cout << std::fixed << std::setprecision(1);
+    cout << "  key bytes     loop     batch   (M keys/s)" << endl;
+
+    const size_t sizes[] = { 8, 16, 24, 32, 48, 64, 128, 256 };
+
+    for (size_t size : sizes) {
+        Keys keys = make_keys(std::vector<size_t>(numKeys, size), 3);
+
+        double loopRate, batchRate;
+        time_keys(keys, repeats, loopRate, batchRate);
+
+        cout << "  " << std::setw(9) << size
+             << std::setw(9) << loopRate
+             << std::setw(10) << batchRate
+             << "   x" << std::setprecision(2) << batchRate / loopRate
+             << std::setprecision(1) << endl;
+    }
+
+    // Sizes all over the place, like the names in an asset pack
+    std::mt19937 rng(4);
+    std::uniform_int_distribution<size_t> size(8, 64);
+
+    std::vector<size_t> lengths(numKeys);
+    for (size_t& length : lengths)
+        length = size(rng);
+
+    double loopRate, batchRate;
+    time_keys(make_keys(lengths, 5), repeats, loopRate, batchRate);
+
+    cout << "  " << std::setw(9) << "8-64"
+         << std::setw(9) << loopRate
+         << std::setw(10) << batchRate
+         << "   x" << std::setprecision(2) << batchRate / loopRate << endl;
+
+    return matched ? 0 : 1;
+}
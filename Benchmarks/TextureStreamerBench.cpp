@@ -0,0 +1,204 @@
+//============================================================================
+// Name        : TextureStreamerBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Flies a camera down a long row of textured quads, with the
+//               TextureStreamer keeping their mip levels within a budget.
+//               The GPU is a fake one that just keeps count of the memory
+//               its textures would take, so this doesn't need GL.
+//
+//               Along the way we check that:
+//               - the streamer's count of resident bytes matches the
+//                 backend's,
+//               - so does its count of textures, so every eviction really
+//                 destroys one,
+//               - it never goes over the budget,
+//               - once the camera stops, everything it asks for gets loaded.
+//               and exit with an error if any of that doesn't hold.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <chrono>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include <Eigen/Dense>
+using Eigen::Vector3f;
+
+#include "CmdOptionParser.hpp"
+#include "MipmapGenerator.hpp"
+#include "TextureStreamer.hpp"
+#include "Camera.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+// A GPU that only keeps count
+class FakeBackend : public TextureBackend
+{
+public:
+    GLuint Create(int width, int height, int numLevels)
+    {
+        size_t bytes = 0;
+        for (int level = 0; level < numLevels; level++) {
+            bytes += (size_t)std::max(width >> level, 1) *
+                     std::max(height >> level, 1) * 4;
+        }
+
+        textures[nextID] = bytes;
+        bytesAllocated += bytes;
+        creates++;
+
+        return nextID++;
+    }
+
+    void Upload(GLuint, int, int, int, const unsigned char *)
+    {
+        uploads++;
+    }
+
+    void Destroy(GLuint texture)
+    {
+        bytesAllocated -= textures[texture];
+        textures.erase(texture);
+    }
+
+    size_t NumLive() const { return textures.size(); }
+
+    size_t bytesAllocated = 0;
+    size_t creates = 0;
+    size_t uploads = 0;
+
+private:
+    std::map<GLuint, size_t> textures;
+    GLuint nextID = 1;
+};
+
+
+bool check(bool passed, const char *what)
+{
+    cout << (passed ? "  ok:     " : "  FAILED: ") << what << endl;
+    return passed;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    size_t numTextures = 64;
+    int size = 512;
+    size_t budget = 16 << 20;
+    unsigned frames = 300;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-n <textures>] [-s <texture_size>] [-b <budget_MB>]"
+             << " [-f <frames>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-n").empty())
+        numTextures = std::stoul(options.getCmdOption("-n"));
+    if (!options.getCmdOption("-s").empty())
+        size = std::stoi(options.getCmdOption("-s"));
+    if (!options.getCmdOption("-b").empty())
+        budget = std::stoul(options.getCmdOption("-b")) << 20;
+    if (!options.getCmdOption("-f").empty())
+        frames = std::stoul(options.getCmdOption("-f"));
+
+    const float viewportWidth = 800.0f;
+    const float viewportHeight = 600.0f;
+    const float spacing = 2.0f;  // between the quads
+    const float radius = 1.0f;  // of each quad's bounding sphere
+
+    FakeBackend backend;
+    MipmapGenerator generator(MipmapGenerator::Box);
+    TextureStreamer streamer(backend, budget, generator);
+
+    std::vector<unsigned char> pixels((size_t)size * size * 4, 128);
+    for (size_t i = 0; i < numTextures; i++)
+        streamer.Add(pixels.data(), size, size);
+
+    // The tails are always resident, whatever the budget
+    size_t tailBytes = streamer.GetStats().bytesResident;
+
+    Camera camera;
+    camera.lookAt(Vector3f(0.0f, 0.0f, 4.0f),
+                  Vector3f(0.0f, 0.0f, 0.0f),
+                  Vector3f(0.0f, 1.0f, 0.0f));
+    camera.setPerspective(45.0f, viewportWidth, viewportHeight,
+                          0.1f, 100.0f);
+
+    bool passed = true;
+    bool matched = true;
+    bool matchedTextures = true;
+    bool inBudget = true;
+    size_t peak = 0;
+
+    auto frame = [&]() {
+        for (size_t i = 0; i < numTextures; i++) {
+            Vector3f center(0.0f, 0.0f, -spacing * i);
+            streamer.Request((StreamedTexture)i, camera, center, radius,
+                             viewportHeight);
+        }
+
+        streamer.Update();
+
+        const TextureStreamer::Stats& stats = streamer.GetStats();
+        matched = matched && (stats.bytesResident == backend.bytesAllocated);
+        matchedTextures = matchedTextures &&
+                          (stats.texturesResident == backend.NumLive());
+        inBudget = inBudget &&
+                   (stats.bytesResident <= std::max(budget, tailBytes));
+        peak = std::max(peak, stats.bytesResident);
+    };
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned i = 0; i < frames; i++) {
+        camera.moveStraight(-spacing * numTextures / frames);
+        frame();
+    }
+
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+
+    const TextureStreamer::Stats& stats = streamer.GetStats();
+
+    cout << std::fixed << std::setprecision(1);
+    cout << numTextures << " textures of " << size << "x" << size
+         << ", " << (budget >> 20) << " MB budget, " << frames << " frames"
+         << endl
+         << "  per frame:        " << elapsed.count() / frames << " us"
+         << endl
+         << "  peak resident:    " << peak / 1048576.0 << " MB" << endl
+         << "  uploaded:         " << stats.bytesUploaded / 1048576.0
+         << " MB" << endl
+         << "  misses:           " << stats.misses << endl
+         << "  evictions:        " << stats.evictions << endl;
+
+    passed &= check(matched, "resident bytes match the backend's");
+    passed &= check(matchedTextures,
+                    "resident textures match the backend's live ones");
+    passed &= check(inBudget, "we stayed within the budget");
+
+    // Stop, and give it a frame to catch up.  If what we see fits, the
+    // next frame shouldn't miss anything.
+    frame();
+    size_t missesBefore = streamer.GetStats().misses;
+    frame();
+
+    if (streamer.GetStats().bytesRequested <= budget) {
+        passed &= check(streamer.GetStats().misses == missesBefore,
+                        "a still camera gets everything it asks for");
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,248 @@
+//============================================================================
+// Name        : TextureUploadBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for texture uploads, by pixel format and size.
+//               We upload the same image:
+//               - the way Texture used to, as tightly packed RGB into a
+//                 glTexImage2D() allocation,
+//               - expanded to RGBA, into glTexStorage2D() storage,
+//               - expanded to BGRA, into glTexStorage2D() storage.
+//               The time for the expanded formats includes expanding them.
+//               Only the base level gets uploaded, there are no mipmaps.
+//
+//               It also makes sure the expanded pixels are right, and
+//               exits with an error if they aren't.
+//
+//               This needs a GL context, so it opens a hidden window.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "CmdOptionParser.hpp"
+#include "PixelConvert.hpp"
+#include "GLObject.hpp"
+#include "Texture.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+std::vector<unsigned char> make_image(int size)
+{
+    std::mt19937 rng(size);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    std::vector<unsigned char> image((size_t)size * size * 3);
+    for (unsigned char& value : image)
+        value = (unsigned char)byte(rng);
+
+    return image;
+}
+
+
+bool check_conversion(const std::vector<unsigned char>& rgb)
+{
+    size_t numPixels = rgb.size() / 3;
+    std::vector<unsigned char> rgba(numPixels * 4);
+    std::vector<unsigned char> bgra(numPixels * 4);
+
+    ConvertRGBToRGBA(rgb.data(), rgba.data(), numPixels);
+    ConvertRGBToBGRA(rgb.data(), bgra.data(), numPixels);
+
+    for (size_t pixel = 0; pixel < numPixels; pixel++) {
+        const unsigned char *in = &rgb[pixel * 3];
+        const unsigned char *a = &rgba[pixel * 4];
+        const unsigned char *b = &bgra[pixel * 4];
+
+        if (a[0] != in[0] || a[1] != in[1] || a[2] != in[2] || a[3] != 0xff ||
+                b[0] != in[2] || b[1] != in[1] || b[2] != in[0] ||
+                b[3] != 0xff)
+        {
+            cout << "FAILED: pixel " << pixel << " converted wrong" << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Time per upload, in microseconds
+double time_rgb(const std::vector<unsigned char>& rgb, int size,
+                unsigned repeats)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned i = 0; i < repeats; i++) {
+        GLTexture texture = GLTexture::Create();
+        glBindTexture(GL_TEXTURE_2D, texture.ID());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, size, size,
+                     0, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+        glFinish();
+    }
+
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GLNamePool::FlushAll();
+
+    return elapsed.count() / repeats;
+}
+
+
+double time_storage(const std::vector<unsigned char>& rgb, int size,
+                    unsigned repeats, GLenum format, GLenum type)
+{
+    std::vector<unsigned char> pixels((size_t)size * size * 4);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned i = 0; i < repeats; i++) {
+        if (format == GL_BGRA)
+            ConvertRGBToBGRA(rgb.data(), pixels.data(), (size_t)size * size);
+        else
+            ConvertRGBToRGBA(rgb.data(), pixels.data(), (size_t)size * size);
+
+        GLTexture texture = GLTexture::Create();
+        glBindTexture(GL_TEXTURE_2D, texture.ID());
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, size, size);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size,
+                        format, type, pixels.data());
+        glFinish();
+    }
+
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GLNamePool::FlushAll();
+
+    return elapsed.count() / repeats;
+}
+
+
+double time_convert(const std::vector<unsigned char>& rgb, int size,
+                    unsigned repeats)
+{
+    std::vector<unsigned char> pixels((size_t)size * size * 4);
+
+    Clock::time_point start = Clock::now();
+
+    for (unsigned i = 0; i < repeats; i++)
+        ConvertRGBToBGRA(rgb.data(), pixels.data(), (size_t)size * size);
+
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count() / repeats;
+}
+
+
+const char *format_name(GLenum format)
+{
+    return (format == GL_BGRA) ? "BGRA" : "RGBA";
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    int maxSize = 2048;
+    unsigned repeats = 20;
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-s <max_size>] [-r <repeats>]" << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-s").empty())
+        maxSize = std::stoi(options.getCmdOption("-s"));
+    if (!options.getCmdOption("-r").empty())
+        repeats = std::stoul(options.getCmdOption("-r"));
+
+    // Odd sizes too, where 3 byte rows aren't 4 byte aligned
+    std::vector<int> sizes;
+    for (int size = 256; size <= maxSize; size *= 2) {
+        sizes.push_back(size);
+        sizes.push_back(size + 1);
+    }
+
+    if (!check_conversion(make_image(257)))
+        return 1;
+
+    if (!glfwInit()) {
+        cout << "GLFW Initialization Failed!!" << endl;
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "TextureUploadBench",
+                                          nullptr, nullptr);
+    if (window == nullptr) {
+        cout << "Failed to create GLFW window" << endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        cout << "Failed to initialize GLEW" << endl;
+        return -1;
+    }
+
+    if (!GLEW_ARB_texture_storage) {
+        cout << "No glTexStorage2D() here, nothing to compare" << endl;
+        glfwTerminate();
+        return 0;
+    }
+
+    const Texture::UploadFormat& preferred = Texture::PreferredFormat();
+    cout << "Preferred upload format: "
+         << format_name(preferred.format) << endl;
+
+    cout << std::fixed << std::setprecision(1);
+    cout << "size        RGB (us)   RGBA (us)   BGRA (us)  expand (us)"
+         << endl;
+
+    for (int size : sizes) {
+        std::vector<unsigned char> rgb = make_image(size);
+
+        double rgbTime = time_rgb(rgb, size, repeats);
+        double rgbaTime = time_storage(rgb, size, repeats,
+                                       GL_RGBA, GL_UNSIGNED_BYTE);
+        double bgraTime = time_storage(rgb, size, repeats,
+                                       GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV);
+        double convertTime = time_convert(rgb, size, repeats);
+
+        cout << std::setw(4) << size << "x" << std::left << std::setw(4)
+             << size << std::right
+             << std::setw(12) << rgbTime
+             << std::setw(12) << rgbaTime
+             << std::setw(12) << bgraTime
+             << std::setw(13) << convertTime << endl;
+    }
+
+    glfwTerminate();
+
+    return 0;
+}
@@ -0,0 +1,289 @@
+//============================================================================
+// Name        : TiledImageBench.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Benchmark for huge images.  First we write a made up image,
+//               a band of rows at a time, into a tiled image file, and see
+//               how fast that goes and how little memory it takes.  Then we
+//               zoom a camera in on a corner of it with a TiledImage, and
+//               see how many tiles get uploaded and how long the frames
+//               take.
+//
+//               Along the way we check that:
+//               - the pixels in the file are the ones we wrote,
+//               - the number of resident tiles stays within the limit,
+//               - once the camera stops, every tile it wants gets there.
+//               and exit with an error if any of that doesn't hold.
+//
+//               The second half needs a GL context, so it opens a hidden
+//               window.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <Eigen/Dense>
+using Eigen::Vector3f;
+
+#include "CmdOptionParser.hpp"
+#include "TiledImageFile.hpp"
+#include "TiledImage.hpp"
+#include "Camera.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+// Some pattern we can check for later
+unsigned char pixel(int x, int y, int c)
+{
+    return (unsigned char)((x >> (c * 2)) ^ (y >> (2 - c)));
+}
+
+
+bool check(bool passed, const char *what)
+{
+    cout << (passed ? "  ok:     " : "  FAILED: ") << what << endl;
+    return passed;
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    int width = 8192;
+    int height = 8192;
+    int tileSize = TiledImageFile::DefaultTileSize;
+    size_t maxResident = 128;
+    unsigned frames = 300;
+    std::string path = "TiledImageBench.tiles";
+
+    if (options.cmdOptionExists("-h")) {
+        cout << "Usage: " << argv[0]
+             << " [-w <width>] [-H <height>] [-t <tile_size>]"
+             << " [-r <max_resident_tiles>] [-f <frames>] [-o <file>]"
+             << endl;
+        return 0;
+    }
+
+    if (!options.getCmdOption("-w").empty())
+        width = std::stoi(options.getCmdOption("-w"));
+    if (!options.getCmdOption("-H").empty())
+        height = std::stoi(options.getCmdOption("-H"));
+    if (!options.getCmdOption("-t").empty())
+        tileSize = std::stoi(options.getCmdOption("-t"));
+    if (!options.getCmdOption("-r").empty())
+        maxResident = std::stoul(options.getCmdOption("-r"));
+    if (!options.getCmdOption("-f").empty())
+        frames = std::stoul(options.getCmdOption("-f"));
+    if (!options.getCmdOption("-o").empty())
+        path = options.getCmdOption("-o");
+
+    bool passed = true;
+
+    //
+    // Writing
+    //
+
+    TiledImageWriter writer;
+    if (!writer.Open(path, width, height, tileSize))
+        return -1;
+
+    size_t rowBytes = (size_t)width * 3;
+    std::vector<unsigned char> rows(rowBytes * tileSize);
+    size_t peakBuffer = 0;
+
+    Clock::time_point start = Clock::now();
+
+    for (int y0 = 0; y0 < height; y0 += tileSize) {
+        int numRows = std::min(tileSize, height - y0);
+
+        for (int y = 0; y < numRows; y++) {
+            unsigned char *row = &rows[y * rowBytes];
+
+            for (int x = 0; x < width; x++) {
+                for (int c = 0; c < 3; c++)
+                    row[x * 3 + c] = pixel(x, y0 + y, c);
+            }
+        }
+
+        if (!writer.WriteRows(rows.data(), numRows))
+            return -1;
+
+        peakBuffer = std::max(peakBuffer, writer.BufferBytes());
+    }
+
+    if (!writer.Close())
+        return -1;
+
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    double imageMB = (double)width * height * 3 / 1048576.0;
+
+    cout << std::fixed << std::setprecision(1);
+    cout << width << "x" << height << " image, " << tileSize
+         << " pixel tiles" << endl
+         << "  write:            " << imageMB / elapsed.count() << " MB/s"
+         << endl
+         << "  image:            " << imageMB << " MB" << endl
+         << "  writer buffers:   " << peakBuffer / 1048576.0 << " MB"
+         << endl;
+
+    TiledImageFile file;
+    if (!file.Open(path))
+        return -1;
+
+    bool matched = true;
+
+    for (int y = 0; y < height; y += 97) {
+        for (int x = 0; x < width; x += 89) {
+            const unsigned char *p =
+                file.Tile(0, x / tileSize, y / tileSize) +
+                ((size_t)(y % tileSize) * tileSize + x % tileSize) * 3;
+
+            for (int c = 0; c < 3; c++)
+                matched = matched && p[c] == pixel(x, y, c);
+        }
+    }
+
+    cout << "  levels:           " << file.NumLevels() << endl;
+    file.Close();
+
+    passed &= check(matched, "the file has the pixels we wrote");
+
+    //
+    // Streaming
+    //
+
+    if (!glfwInit()) {
+        cout << "GLFW Initialization Failed!!" << endl;
+        return -1;
+    }
+
+    const float viewportWidth = 800.0f;
+    const float viewportHeight = 600.0f;
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow((int)viewportWidth,
+                                          (int)viewportHeight,
+                                          "TiledImageBench",
+                                          nullptr, nullptr);
+    if (window == nullptr) {
+        cout << "Failed to create GLFW window" << endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        cout << "Failed to initialize GLEW" << endl;
+        return -1;
+    }
+
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+    bool inLimit = true;
+    size_t uploadsBefore = 0;
+    size_t missesBefore = 0;
+    std::chrono::duration<double, std::micro> updateTime(0);
+
+    {
+        TiledImage image(maxResident);
+        if (!image.Open(path))
+            return -1;
+
+        // The image, as tall as the view, in front of the camera.  y goes
+        // down the image and up the world.
+        float aspect = (float)width / height;
+
+        Matrix4f model = Matrix4f::Identity();
+        model(0, 0) = 2.0f * aspect;
+        model(1, 1) = -2.0f;
+        model(0, 3) = -aspect;
+        model(1, 3) = 1.0f;
+        image.SetModel(model);
+
+        Camera camera;
+        camera.setPerspective(45.0f, viewportWidth, viewportHeight,
+                              0.001f, 100.0f);
+
+        auto frame = [&](float distance) {
+            Vector3f eye(0.5f * aspect, 0.5f, distance);
+            camera.lookAt(eye, Vector3f(eye.x(), eye.y(), 0.0f),
+                          Vector3f(0.0f, 1.0f, 0.0f));
+
+            Clock::time_point before = Clock::now();
+            image.Update(camera, viewportWidth, viewportHeight);
+            updateTime += Clock::now() - before;
+
+            inLimit = inLimit &&
+                      image.GetStats().tilesResident <= maxResident;
+
+            // Give the reading thread a frame's worth of time
+            std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        };
+
+        // Zoom in, from the whole image to its pixels
+        float distance = 3.0f;
+        float closest = 2.0f * viewportHeight / height;
+
+        for (unsigned i = 0; i < frames; i++) {
+            frame(distance);
+            distance = std::max(distance * 0.98f, closest);
+        }
+
+        const TiledImage::Stats& stats = image.GetStats();
+
+        cout << "  GL_MAX_TEXTURE_SIZE: " << maxTextureSize << endl
+             << "  per Update():     " << updateTime.count() / frames
+             << " us" << endl
+             << "  uploaded:         " << stats.tilesUploaded << " tiles"
+             << endl
+             << "  evicted:          " << stats.tilesEvicted << " tiles"
+             << endl
+             << "  misses:           " << stats.misses << endl
+             << "  resident:         " << stats.tilesResident << " tiles, "
+             << stats.tilesResident * tileSize * tileSize * 4 / 1048576.0
+             << " MB" << endl
+             << "  read buffers:     " << image.BufferBytes() / 1048576.0
+             << " MB" << endl;
+
+        passed &= check(inLimit, "we stayed within the resident tiles");
+
+        // Stop, and give it some frames to catch up
+        for (int i = 0; i < 60; i++)
+            frame(distance);
+
+        uploadsBefore = image.GetStats().tilesUploaded;
+        missesBefore = image.GetStats().misses;
+        frame(distance);
+
+        passed &= check(image.GetStats().misses == missesBefore &&
+                        image.GetStats().tilesUploaded == uploadsBefore,
+                        "a still camera gets every tile it wants");
+    }
+
+    GLNamePool::FlushAll();
+    glfwTerminate();
+
+    std::remove(path.c_str());
+
+    return passed ? 0 : 1;
+}
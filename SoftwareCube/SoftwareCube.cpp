@@ -0,0 +1,268 @@
+//============================================================================
+// Name        : SoftwareCube.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : The TransformCube scene, drawn with our SoftwareRenderer
+//               instead of OpenGL.  It uses the same vertex data, textures,
+//               camera and animation as TransformCube, and writes the last
+//               frame it renders out as a PPM image.
+//
+//               This doesn't need a window or a GL driver, so we can use it
+//               to produce reference images of the scene, and to compare
+//               frame times against the GL path.
+//============================================================================
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::cin;
+using std::endl;
+
+// GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <Eigen/Dense>
+using Eigen::Matrix4f;
+using Eigen::Affine3f;
+using Eigen::AngleAxisf;
+using Eigen::Vector3f;
+
+// Simple OpenGL Image Library
+#include <SOIL/SOIL.h>
+
+#include "CmdOptionParser.hpp"
+#include "OGLCommon.hpp"
+#include "Camera.hpp"
+#include "SceneGraph.hpp"
+#include "JobSystem.hpp"
+#include "SoftwareRenderer.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+bool LoadTexture(const std::string& path, SoftwareTexture& texture);
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    std::string textureFile1 = "image/container.jpg";
+    std::string textureFile2 = "image/awesomeface.png";
+    std::string outputFile = "SoftwareCube.ppm";
+
+    unsigned numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    int frames = 1;
+    int width = 800;
+    int height = 600;
+
+    const std::string &filePath = options.getCmdOption("-p");
+    if (!filePath.empty()) {
+        if (filePath.back() != '/') {
+            textureFile1.insert(0, "/");
+            textureFile2.insert(0, "/");
+        }
+
+        textureFile1.insert(0, filePath);
+        textureFile2.insert(0, filePath);
+
+        cout << "Our first texture file: " << textureFile1 << endl;
+        cout << "Our second texture file: " << textureFile2 << endl;
+    }
+    else {
+        cout << "Usage: " << argv[0]
+             << " -p <path_to_resource_folder>"
+             << " [-o <output.ppm>]"
+             << " [-f <frames>]"
+             << " [-t <threads>]"
+             << " [-W <width>] [-H <height>]" << endl;
+        exit(1);
+    }
+
+    if (!options.getCmdOption("-o").empty())
+        outputFile = options.getCmdOption("-o");
+    if (!options.getCmdOption("-f").empty())
+        frames = std::max(std::stoi(options.getCmdOption("-f")), 1);
+    if (!options.getCmdOption("-t").empty())
+        numThreads = std::stoul(options.getCmdOption("-t"));
+    if (!options.getCmdOption("-W").empty())
+        width = std::stoi(options.getCmdOption("-W"));
+    if (!options.getCmdOption("-H").empty())
+        height = std::stoi(options.getCmdOption("-H"));
+
+    // Setup our textures
+    SoftwareTexture ourTexture1;
+    SoftwareTexture ourTexture2;
+
+    if (!LoadTexture(textureFile1, ourTexture1) ||
+            !LoadTexture(textureFile2, ourTexture2))
+        return -1;
+
+    // Setup our vertex data.  This is all the same as TransformCube.
+    GLfloat vertices[] = {
+                          -0.5f, -0.5f,  0.5f,
+                           0.5f, -0.5f,  0.5f,
+                           0.5f,  0.5f,  0.5f,
+                          -0.5f,  0.5f,  0.5f,
+
+                          -0.5f, -0.5f, -0.5f,
+                           0.5f, -0.5f, -0.5f,
+                           0.5f,  0.5f, -0.5f,
+                          -0.5f,  0.5f, -0.5f
+                          };
+
+    GLfloat texCoords[] = {
+                           0.0f, 0.0f,  // Lower-left corner
+                           1.0f, 0.0f,  // Lower-right corner
+                           1.0f, 1.0f,  // Top-right corner
+                           0.0f, 1.0f,  // Top-left corner
+
+                           0.0f, 1.0f,  // Top-left corner
+                           1.0f, 1.0f,  // Top-right corner
+                           1.0f, 0.0f,  // Lower-right corner
+                           0.0f, 0.0f,  // Lower-left corner
+                           };
+
+    GLfloat colors[] = {
+                        0.f, 0.f, 1.f,  // Lower-left-near corner
+                        1.f, 0.f, 1.f,  // Lower-right-near corner
+                        1.f, 1.f, 1.f,  // Top-right-near corner
+                        0.f, 1.f, 1.f,  // Top-left-near corner
+
+                        0.f, 0.f, 0.f,  // Lower-left-far corner
+                        1.f, 0.f, 0.f,  // Lower-right-far corner
+                        1.f, 1.f, 0.f,  // Top-right-far corner
+                        0.f, 1.f, 0.f,  // Top-left-far corner
+                        };
+
+    GLuint indices[] = {
+                        0, 1, 2,  // near face
+                        2, 3, 0,
+
+                        4, 5, 6,  // far face
+                        6, 7, 4,
+
+                        3, 2, 6,  // top face
+                        6, 7, 3,
+
+                        0, 1, 5,  // bottom face
+                        5, 4, 0,
+
+                        0, 4, 7,  // left face
+                        7, 3, 0,
+
+                        1, 5, 6,  // right face
+                        6, 2, 1,
+                        };
+
+    SoftwareVertexData cube;
+    cube.positions = vertices;
+    cube.colors = colors;
+    cube.texCoords = texCoords;
+    cube.numVertices = 8;
+
+    Affine3f modelTrans;
+    modelTrans = AngleAxisf(to_radians(-65.0f), Vector3f::UnitX());
+
+    Camera camera;
+    camera.lookAt(Vector3f(0.0, 0.0, 3.0),
+                  Vector3f(0.0, 0.0, 0.0),
+                  Vector3f(0.0, 1.0, 0.0));
+    camera.setPerspective(45.0f, (float)width, (float)height, 0.1f, 100.0f);
+
+    SceneGraph scene;
+    SceneNode cubeNode = scene.AddNode(SceneGraph::None, modelTrans);
+    SceneNode sideFacesNode = scene.AddNode(cubeNode,
+        Affine3f(AngleAxisf(to_radians(90.0f), Vector3f::UnitY())));
+
+    JobSystem jobs(numThreads);
+    SoftwareRenderer renderer(width, height, &jobs);
+
+    Matrix4f view = camera.View();
+    Matrix4f projection = camera.Projection();
+
+    // Each frame is one tick of TransformCube's simulation at 60 Hz
+    GLfloat deltaTime = 1.0f / 60.0f;
+    double totalSeconds = 0.0;
+
+    cout << "Rendering " << frames << " frame(s) at "
+         << width << "x" << height << " with "
+         << jobs.NumThreads() << " thread(s)" << endl;
+
+    for (int frame = 0; frame < frames; frame++) {
+        if (frame > 0) {
+            modelTrans *= AngleAxisf(to_radians(deltaTime * 60.0f),
+                                     Vector3f::UnitZ())
+                        * AngleAxisf(to_radians(deltaTime * 30.0f),
+                                     Vector3f::UnitY())
+                        * AngleAxisf(to_radians(deltaTime * 30.0f),
+                                     Vector3f::UnitX());
+        }
+
+        Clock::time_point start = Clock::now();
+
+        scene.SetLocal(cubeNode, modelTrans);
+        scene.Update();
+
+        renderer.Clear(0.2f, 0.3f, 0.3f, 1.0f);
+
+        renderer.UseTransform(scene.World(cubeNode).data(), 0);
+        renderer.UseTransform(view.data(), 1);
+        renderer.UseTransform(projection.data(), 2);
+
+        renderer.UseTexture(&ourTexture1, 0);
+        renderer.UseTexture(&ourTexture2, 1);
+
+        // the first four faces, and then the last two rotated 90 degrees,
+        // the same as TransformCube
+        renderer.DrawElements(cube, indices, 24);
+
+        renderer.UseTransform(scene.World(sideFacesNode).data(), 0);
+        renderer.DrawElements(cube, indices, 12);
+
+        renderer.Flush();
+
+        totalSeconds += std::chrono::duration<double>(Clock::now() -
+                                                      start).count();
+    }
+
+    cout << "Average frame time: "
+         << totalSeconds / frames * 1000.0 << " ms" << endl;
+    cout << "Last frame: " << renderer.TrianglesRasterized()
+         << " triangles, " << renderer.PixelsShaded()
+         << " pixels shaded" << endl;
+
+    if (!renderer.WritePPM(outputFile))
+        return -1;
+
+    cout << "Wrote " << outputFile << endl;
+
+    return 0;
+}
+
+
+bool LoadTexture(const std::string& path, SoftwareTexture& texture)
+{
+    int width = 0;
+    int height = 0;
+
+    // The same format our Texture class loads
+    unsigned char *image = SOIL_load_image(path.c_str(),
+                                           &width, &height,
+                                           0, SOIL_LOAD_RGB);
+    if (image == nullptr) {
+        cout << "No loaded image!!" << endl
+             << "libSOIL result: " << SOIL_last_result() << endl;
+        return false;
+    }
+
+    texture.SetImage(image, width, height, 3);
+    SOIL_free_image_data(image);
+
+    return true;
+}
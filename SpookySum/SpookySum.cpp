@@ -0,0 +1,143 @@
+//============================================================================
+// Name        : SpookySum.cpp
+// Author      : James L. Makela
+// Version     : 0.0.1
+// Copyright   : LGPL v3.0
+// Description : Prints the TreeHash of each file it's given, like md5sum
+//               does, and how fast it got through them.  The files are
+//               memory mapped, and their chunks hashed on every core.
+//
+//               With -s it also hashes each file with SpookyHash's
+//               streaming interface, on one thread, to compare with.  With
+//               -v it hashes each file again on one thread, and checks that
+//               the hash comes out the same.
+//============================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "CmdOptionParser.hpp"
+#include "JobSystem.hpp"
+#include "MappedFile.hpp"
+#include "SpookyV2.h"
+#include "TreeHash.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+double gigabytes_per_second(size_t bytes,
+                            std::chrono::duration<double> elapsed)
+{
+    return (double)bytes / 1e9 / std::max(elapsed.count(), 1e-9);
+}
+
+
+int main(int argc, const char **argv)
+{
+    CmdOptionParser options(argc, argv);
+
+    unsigned numThreads = 0;
+    size_t chunkSize = TreeHash::DefaultChunkSize;
+    bool streaming = options.cmdOptionExists("-s");
+    bool verify = options.cmdOptionExists("-v");
+
+    // Everything that isn't an option, or an option's value, is a file
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "-t" || arg == "-c")
+            i++;
+        else if (arg.empty() || arg[0] != '-')
+            files.push_back(arg);
+    }
+
+    if (options.cmdOptionExists("-h") || files.empty()) {
+        cout << "Usage: " << argv[0]
+             << " [-t <threads>] [-c <chunk_KB>] [-s] [-v] <file>..."
+             << endl;
+        return files.empty() ? 1 : 0;
+    }
+
+    if (!options.getCmdOption("-t").empty())
+        numThreads = std::stoul(options.getCmdOption("-t"));
+    if (!options.getCmdOption("-c").empty())
+        chunkSize = std::stoul(options.getCmdOption("-c")) * 1024;
+
+    JobSystem jobs(numThreads);
+    TreeHash tree(&jobs, chunkSize);
+    TreeHash serialTree(nullptr, chunkSize);
+
+    size_t totalBytes = 0;
+    std::chrono::duration<double> treeTime(0);
+    std::chrono::duration<double> streamTime(0);
+    bool failed = false;
+
+    for (const std::string& path : files) {
+        MappedFile file;
+        if (!file.Open(path)) {
+            failed = true;
+            continue;
+        }
+
+        uint64_t hash1, hash2;
+
+        Clock::time_point start = Clock::now();
+        tree.Hash(file.Data(), file.Size(), hash1, hash2);
+        treeTime += Clock::now() - start;
+
+        totalBytes += file.Size();
+
+        cout << std::hex << std::setfill('0') << std::setw(16) << hash1
+             << std::setw(16) << hash2 << std::dec << std::setfill(' ')
+             << "  " << path << endl;
+
+        if (streaming) {
+            SpookyHash spooky;
+            uint64 seed1 = 0;
+            uint64 seed2 = 0;
+
+            start = Clock::now();
+            spooky.Init(seed1, seed2);
+            spooky.Update(file.Data(), file.Size());
+            spooky.Final(&seed1, &seed2);
+            streamTime += Clock::now() - start;
+        }
+
+        if (verify) {
+            uint64_t serial1, serial2;
+            serialTree.Hash(file.Data(), file.Size(), serial1, serial2);
+
+            if (serial1 != hash1 || serial2 != hash2) {
+                cout << "  FAILED: " << path
+                     << " hashes differently on one thread" << endl;
+                failed = true;
+            }
+        }
+    }
+
+    cout << std::fixed << std::setprecision(2)
+         << files.size() << " files, " << totalBytes / 1e9 << " GB, "
+         << chunkSize / 1024 << " KB chunks" << endl
+         << "  tree hash, " << jobs.NumThreads() << " threads: "
+         << gigabytes_per_second(totalBytes, treeTime) << " GB/s" << endl;
+
+    if (streaming)
+        cout << "  SpookyHash::Update(), 1 thread: "
+             << gigabytes_per_second(totalBytes, streamTime) << " GB/s"
+             << endl;
+
+    if (verify && !failed)
+        cout << "  ok: the same hashes on one thread" << endl;
+
+    return failed ? 1 : 0;
+}
@@ -28,6 +28,7 @@ using std::endl;
 #include <SOIL/SOIL.h>
 
 #include "Shader.hpp"
+#include "GLObject.hpp"
 #include "Texture.hpp"
 #include "CmdOptionParser.hpp"
 
@@ -117,121 +118,126 @@ int main(int argc, const char **argv)
 
     glfwSetKeyCallback(window, key_callback);
 
-    // Here is where we build and compile our shader program
-    Shader ourShader(vertexFile.c_str(), fragmentFile.c_str());
-
-    // Setup our textures
-    Texture ourTexture1(textureFile1.c_str());
-    Texture ourTexture2(textureFile2.c_str());
-
-    // Setup our vertex data
-    GLfloat vertices[] = {-0.5f, -0.5f, 0.0f,
-                          0.5f, -0.5f, 0.0f,
-                          0.0f,  0.5f, 0.0f};
-
-    GLfloat colors[] = {1.f, 0.f, 0.f,
-                        0.f, 1.f, 0.f,
-                        0.f, 0.f, 1.f};
-
-    GLfloat texCoords[] = {0.0f, 0.0f,  // Lower-left corner
-                           1.0f, 0.0f,  // Lower-right corner
-                           0.5f, 1.0f   // Top-center corner
-                           };
-
-    GLuint VAO = 0;
-    GLuint vertexVBO = 0;
-    GLuint colorVBO = 0;
-    GLuint textureVBO = 0;
-
-    // Initialize our Vertex Array Object and buffer objects
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &vertexVBO);
-    glGenBuffers(1, &colorVBO);
-    glGenBuffers(1, &textureVBO);
-
-    // bind our Vertex Array Object first
-    glBindVertexArray(VAO);
-
-    // Initialize the vertex buffer and the color buffer objects so we can
-    // Then bind and set our buffers
-    // Note: the order in which things are done here is important. The order
-    //       of operations that works for me is:
-    //       - bind the buffer object
-    //       - copy the data into the buffer
-    //       - Set the attribute pointer
-    //       - move on to the next buffer object
-    //       I think the determining factor is that we can only operate
-    //       on a single bound buffer at a time.
-    glBindBuffer(GL_ARRAY_BUFFER, vertexVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
-                 GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-                          3 * sizeof(GLfloat), (GLvoid*)0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(colors), colors,
-                 GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-                          3 * sizeof(GLfloat), (GLvoid*)0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, textureVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords,
-                 GL_STATIC_DRAW);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
-                          2 * sizeof(GLfloat), (GLvoid*)0);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-
-    // Note that this is allowed, the call to glVertexAttribPointer
-    // registered VBO as the currently bound vertex buffer object so
-    // afterwards we can safely unbind.
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    // Note: Remember, do NOT unbind the EBO, keep it bound to this VAO
-
-    // Unbind the Vertex Array Object.
-    // (It is always good to unbind any buffer/array to prevent strange bugs)
-    glBindVertexArray(0);
-
-    // our main loop
-    while(!glfwWindowShouldClose(window))
+    // Everything that owns GL objects lives in this block, so it all
+    // goes away while the context is still here.
     {
-        // check input events(kbd, mouse, etc.)
-        glfwPollEvents();
+        // Here is where we build and compile our shader program
+        Shader ourShader(vertexFile.c_str(), fragmentFile.c_str());
+
+        // Setup our textures
+        Texture ourTexture1(textureFile1.c_str());
+        Texture ourTexture2(textureFile2.c_str());
+
+        // Setup our vertex data
+        GLfloat vertices[] = {-0.5f, -0.5f, 0.0f,
+                              0.5f, -0.5f, 0.0f,
+                              0.0f,  0.5f, 0.0f};
+
+        GLfloat colors[] = {1.f, 0.f, 0.f,
+                            0.f, 1.f, 0.f,
+                            0.f, 0.f, 1.f};
+
+        GLfloat texCoords[] = {0.0f, 0.0f,  // Lower-left corner
+                               1.0f, 0.0f,  // Lower-right corner
+                               0.5f, 1.0f   // Top-center corner
+                               };
+
+        // Initialize our Vertex Array Object and buffer objects.
+        // These get deleted when they go out of scope.
+        GLVertexArray VAO = GLVertexArray::Create();
+        GLBuffer vertexVBO = GLBuffer::Create();
+        GLBuffer colorVBO = GLBuffer::Create();
+        GLBuffer textureVBO = GLBuffer::Create();
+
+        // bind our Vertex Array Object first
+        glBindVertexArray(VAO.ID());
+
+        // Initialize the vertex buffer and the color buffer objects so we can
+        // Then bind and set our buffers
+        // Note: the order in which things are done here is important.
+        //       The order of operations that works for me is:
+        //       - bind the buffer object
+        //       - copy the data into the buffer
+        //       - Set the attribute pointer
+        //       - move on to the next buffer object
+        //       I think the determining factor is that we can only operate
+        //       on a single bound buffer at a time.
+        glBindBuffer(GL_ARRAY_BUFFER, vertexVBO.ID());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
+                              3 * sizeof(GLfloat), (GLvoid*)0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, colorVBO.ID());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(colors), colors,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
+                              3 * sizeof(GLfloat), (GLvoid*)0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, textureVBO.ID());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
+                              2 * sizeof(GLfloat), (GLvoid*)0);
+
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+
+        // Note that this is allowed, the call to glVertexAttribPointer
+        // registered VBO as the currently bound vertex buffer object so
+        // afterwards we can safely unbind.
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // Note: Remember, do NOT unbind the EBO, keep it bound to this VAO
+
+        // Unbind the Vertex Array Object.
+        // (It is always good to unbind any buffer/array to prevent strange
+        // bugs)
+        glBindVertexArray(0);
 
-        //
-        // rendering routines
-        //
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        // our main loop
+        while(!glfwWindowShouldClose(window))
+        {
+            // check input events(kbd, mouse, etc.)
+            glfwPollEvents();
 
-        // grab our graphics pipeline context
-        ourShader.Use();
-        glBindVertexArray(VAO);
+            //
+            // rendering routines
+            //
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        // grab our textures
-        ourShader.UseTexture(ourTexture1.ID, 0);
-        ourShader.UseTexture(ourTexture2.ID, 1);
+            // grab our graphics pipeline context
+            ourShader.Use();
+            glBindVertexArray(VAO.ID());
 
-        // draw our colored triangle
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+            // grab our textures
+            ourShader.UseTexture(ourTexture1.ID, 0);
+            ourShader.UseTexture(ourTexture2.ID, 1);
 
-        // cleanup
-        glBindVertexArray(0);
+            // draw our colored triangle
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            // cleanup
+            glBindVertexArray(0);
 
-        //
-        // done rendering
-        //
+            //
+            // done rendering
+            //
 
-        glfwSwapBuffers(window);
+            glfwSwapBuffers(window);
+
+            // delete any vertex arrays let go of this frame
+            GLNamePool::FlushAll();
+        }
     }
 
-    // Properly deallocate all resources once we are done.
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &vertexVBO);
-    glDeleteBuffers(1, &colorVBO);
+    // Shaders built from files share programs through the default
+    // cache, and the pools hold on to the names we let go of.  Those
+    // get deleted for real now, before the context goes away.
+    Shader::DefaultCache().Clear();
+    GLNamePool::FlushAll();
 
     glfwTerminate();
     cout << "Terminated GLFW..." << endl;
@@ -11,6 +11,9 @@
 //============================================================================
 
 #include <iostream>
+#include <mutex>
+#include <atomic>
+#include <memory>
 
 // this is just to make printing stuff a bit more concise
 // everything else in std, we can call explicitly
@@ -48,13 +51,25 @@ using Eigen::Scaling;
 #include <SOIL/SOIL.h>
 
 #include "CmdOptionParser.hpp"
+#include "AssetPack.hpp"
 #include "OGLCommon.hpp"
+#include "ResourceRegistry.hpp"
 #include "Shader.hpp"
+#include "ShaderLibrary.hpp"
+#include "TextureReloader.hpp"
 #include "Texture.hpp"
+#include "MipmapGenerator.hpp"
+#include "ImageDecoder.hpp"
+#include "JobSystem.hpp"
+#include "GLObject.hpp"
+#include "SamplerCache.hpp"
+#include "StateTracker.hpp"
 #include "Camera.hpp"
 #include "KeyHandler.hpp"
 #include "MouseHandler.hpp"
 #include "JoystickHandler.hpp"
+#include "GameLoop.hpp"
+#include "SceneGraph.hpp"
 
 // forward declarations defined after main()
 // I like organizing my functions in a top-down fashion
@@ -70,6 +85,7 @@ void mouse_scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void joystick_callback(int joy, int event);
 
 void handle_events(GLfloat deltaTime);
+void simulation_tick(SimulationState& state, GLfloat deltaTime);
 
 // set the camera as a global
 Camera camera;
@@ -79,9 +95,21 @@ KeyHandler keyHandler;
 MouseHandler mouseHandler;
 JoystickHandler joystickHandler;
 
+// The GLFW callbacks run on the main thread, but the input gets consumed
+// by the simulation thread.  So we need to guard the handlers.
+std::mutex inputMutex;
+
 // quick & dirty flag to tell the application whether to animate or not
 bool animateCube = true;
 
+// Which variant of our shader to draw with.  This one is toggled on the
+// main thread, and read by the render loop.
+std::atomic<bool> vertexColors(false);
+
+// Whether to sample our textures without any filtering.  This just picks
+// a different sampler, the textures themselves don't change.
+std::atomic<bool> nearestFiltering(false);
+
 
 int main(int argc, const char **argv)
 {
@@ -94,8 +122,19 @@ int main(int argc, const char **argv)
     std::string textureFile1 = "image/container.jpg";
     std::string textureFile2 = "image/awesomeface.png";
 
+    // Our resources can come from a packed asset file, or a folder
+    AssetPack assets;
+
+    const std::string &packPath = options.getCmdOption("-a");
     const std::string &filePath = options.getCmdOption("-p");
-    if (!filePath.empty()) {
+    if (!packPath.empty()) {
+        if (!assets.Open(packPath))
+            return -1;
+
+        cout << "Our asset pack: " << packPath
+             << " (" << assets.NumAssets() << " assets)" << endl;
+    }
+    else if (!filePath.empty()) {
         if (filePath.back() != '/') {
             vertexFile.insert(0, "/");
             fragmentFile.insert(0, "/");
@@ -115,10 +154,25 @@ int main(int argc, const char **argv)
     }
     else {
         cout << "Usage: " << argv[0]
-             << " -p <path_to_resource_folder>" << endl;
+             << " -p <path_to_resource_folder> | -a <asset_pack>"
+             << " [-t <ticks_per_second>]"
+             << " [-c <max_catch_up_ticks>]" << endl;
         exit(1);
     }
 
+    // Our simulation runs at a fixed rate independent of the rendering
+    GameLoop gameLoop;
+
+    const std::string &tickRate = options.getCmdOption("-t");
+    if (!tickRate.empty())
+        gameLoop.setTickRate(std::stod(tickRate));
+
+    const std::string &catchUpTicks = options.getCmdOption("-c");
+    if (!catchUpTicks.empty())
+        gameLoop.setMaxCatchUpTicks(std::stoul(catchUpTicks));
+
+    cout << "Simulation tick rate: " << gameLoop.TickRate() << endl;
+
     if (!glfwInit()) {
         // Initialization failed
         cout << "GLFW Initialization Failed!!" << endl;
@@ -170,238 +224,350 @@ int main(int argc, const char **argv)
     glfwSetJoystickCallback(joystick_callback);
     joystickHandler.poll_connected();
 
-    // Here is where we build and compile our shader program
-    Shader ourShader(vertexFile.c_str(), fragmentFile.c_str());
-
-    // Setup our textures
-    Texture ourTexture1(textureFile1.c_str());
-    Texture ourTexture2(textureFile2.c_str());
-
-    // Setup our vertex data
-    GLfloat vertices[] = {
-                          -0.5f, -0.5f,  0.5f,
-                           0.5f, -0.5f,  0.5f,
-                           0.5f,  0.5f,  0.5f,
-                          -0.5f,  0.5f,  0.5f,
-
-                          -0.5f, -0.5f, -0.5f,
-                           0.5f, -0.5f, -0.5f,
-                           0.5f,  0.5f, -0.5f,
-                          -0.5f,  0.5f, -0.5f
-                          };
-
-    // Note: texture coordinates are mapped to vertices, and not indices
-    GLfloat texCoords[] = {
-                           0.0f, 0.0f,  // Lower-left corner
-                           1.0f, 0.0f,  // Lower-right corner
-                           1.0f, 1.0f,  // Top-right corner
-                           0.0f, 1.0f,  // Top-left corner
-
-                           0.0f, 1.0f,  // Top-left corner
-                           1.0f, 1.0f,  // Top-right corner
-                           1.0f, 0.0f,  // Lower-right corner
-                           0.0f, 0.0f,  // Lower-left corner
-                           };
-
-    // Note: color values are mapped to vertices, and not indices
-    GLfloat colors[] = {
-                        0.f, 0.f, 1.f,  // Lower-left-near corner
-                        1.f, 0.f, 1.f,  // Lower-right-near corner
-                        1.f, 1.f, 1.f,  // Top-right-near corner
-                        0.f, 1.f, 1.f,  // Top-left-near corner
-
-                        0.f, 0.f, 0.f,  // Lower-left-far corner
-                        1.f, 0.f, 0.f,  // Lower-right-far corner
-                        1.f, 1.f, 0.f,  // Top-right-far corner
-                        0.f, 1.f, 0.f,  // Top-left-far corner
-                        };
-
-    GLuint indices[] = {
-                        0, 1, 2,  // near face
-                        2, 3, 0,
-
-                        4, 5, 6,  // far face
-                        6, 7, 4,
-
-                        3, 2, 6,  // top face
-                        6, 7, 3,
-
-                        0, 1, 5,  // bottom face
-                        5, 4, 0,
-
-                        0, 4, 7,  // left face
-                        7, 3, 0,
-
-                        1, 5, 6,  // right face
-                        6, 2, 1,
-                        };
-
-    // Setup our transformations. We are using Eigen here.
-    Affine3f rot, scale, modelTrans;
-
-    // Define our model transformation
-    rot = AngleAxisf(to_radians(-65.0f), Vector3f::UnitX());
-    //scale = Scaling(Vector3f(0.8, 0.8, 0.8));
-    modelTrans = rot;
-
-    // Define our view and projection transformation
-    camera.lookAt(Vector3f(0.0, 0.0, 3.0),
-                  Vector3f(0.0, 0.0, 0.0),
-                  Vector3f(0.0, 1.0, 0.0));
-
-    camera.setPerspective(45.0f, (float)width, (float)height, 0.1f, 100.0f);
-
-    cout << "Our Model matrix:\n"<< modelTrans.matrix() << endl;
-    cout << "Our View matrix:\n"<< camera.View() << endl;
-    cout << "Our Projection matrix:\n"<< camera.Projection() << endl;
-
-    // glm::mat4 glmProjection;
-    // glmProjection = glm::perspective(glm::radians(45.0f),
-    //                                  (float)width / (float)height,
-    //                                  0.1f, 100.0f);
-    // cout << "GLM Projection:\n" << glm::to_string(glmProjection) << endl;
-
-    // glm::mat4 glmView;
-    // glmView = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f),
-    //                       glm::vec3(0.0f, 0.0f, 0.0f),
-    //                       glm::vec3(0.0f, 1.0f, 0.0f));
-    // cout << "glm::lookAt view:\n" << glm::to_string(glmView) << endl;
-
-    // Initialize our Vertex Array Object and buffer objects
-    GLuint VAO = 0;
-    GLuint vertexVBO = 0;
-    GLuint vertexEBO = 0;
-    GLuint colorVBO = 0;
-    GLuint textureVBO = 0;
-
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &vertexVBO);
-    glGenBuffers(1, &vertexEBO);
-    glGenBuffers(1, &colorVBO);
-    glGenBuffers(1, &textureVBO);
-
-    // bind our Vertex Array Object first
-    glBindVertexArray(VAO);
-
-    // Initialize the vertex buffer and the color buffer objects so we can
-    // Then bind and set our buffers
-    // Note: the order in which things are done here is important. The order
-    //       of operations that works for me is:
-    //       - bind the buffer object
-    //       - copy the data into the buffer
-    //       - Set the attribute pointer
-    //       - move on to the next buffer object
-    //       I think the determining factor is that we can only operate
-    //       on a single bound buffer at a time.
-    glBindBuffer(GL_ARRAY_BUFFER, vertexVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
-                 GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertexEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
-                 GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-                          3 * sizeof(GLfloat), (GLvoid*)0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(colors), colors,
-                 GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-                          3 * sizeof(GLfloat), (GLvoid*)0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, textureVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords,
-                 GL_STATIC_DRAW);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
-                          2 * sizeof(GLfloat), (GLvoid*)0);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-
-    // Note that this is allowed, the call to glVertexAttribPointer
-    // registered VBO as the currently bound vertex buffer object so
-    // afterwards we can safely unbind.
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    // Note: Remember, do NOT unbind the EBO, keep it bound to this VAO
-
-    // Unbind the Vertex Array Object.
-    // (It is always good to unbind any buffer/array to prevent strange bugs)
-    glBindVertexArray(0);
-
-    // our main loop
-    GLfloat prevTime = glfwGetTime();
-    while(!glfwWindowShouldClose(window))
+    // Everything that owns GL objects lives in this block, so it all
+    // goes away while the context is still here.
     {
-        // get the time elapsed since last iteration
-        GLfloat deltaTime = glfwGetTime() - prevTime;
-        prevTime += deltaTime;
-
-        // check input events(kbd, mouse, etc.)
-        glfwPollEvents();
-        handle_events(deltaTime);
-
-        if (animateCube) {
-            // rotate the image at about 60 degrees/sec
-            modelTrans *= AngleAxisf(to_radians(deltaTime * 60.0f),
-                                     Vector3f::UnitZ())
-                        * AngleAxisf(to_radians(deltaTime * 30.0f),
-                                     Vector3f::UnitY())
-                        * AngleAxisf(to_radians(deltaTime * 30.0f),
-                                     Vector3f::UnitX());
+        // Here is where we declare our shader program, and its variant that
+        // tints the textures with the vertex colors.  They compile in the
+        // background while we set up everything else.
+        std::unique_ptr<ShaderSourceLoader> shaderLoader(assets.IsOpen()
+            ? new ShaderSourceLoader(assets)
+            : new ShaderSourceLoader());
+        ShaderLibrary shaders(*shaderLoader, window);
+
+        if (shaders.Declare("cube", vertexFile, fragmentFile,
+                            {{"", "VERTEX_COLORS"}}) == 0) {
+            shaders.Shutdown();
+            glfwTerminate();
+            return -1;
         }
 
-        //
-        // rendering routines
-        //
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // grab our graphics pipeline context
-        ourShader.Use();
-        glBindVertexArray(VAO);
-
-        // set our transformation matrices as uniforms
-        Affine3f tempModelTrans;
-        tempModelTrans = modelTrans;
-
-        ourShader.UseTransform(tempModelTrans.data(), 0);
-        ourShader.UseTransform(camera.View().data(), 1);
-        ourShader.UseTransform(camera.Projection().data(), 2);
-
-
-        // grab our textures
-        ourShader.UseTexture(ourTexture1.ID, 0);
-        ourShader.UseTexture(ourTexture2.ID, 1);
-
-        // draw our cube
-        // Note: we are using vertex indices, so it is impossible
-        //       to draw the last two faces of our cube with a reasonable
-        //       texture.  So the strategy is to draw the first four faces,
-        //       rotate 90 degrees, and then draw the last two faces.
-        glDrawElements(GL_TRIANGLES, 24, GL_UNSIGNED_INT, 0);
-
-        tempModelTrans *= AngleAxisf(to_radians(90.0f), Vector3f::UnitY());
-        ourShader.UseTransform(tempModelTrans.data(), 0);
-
-        glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, 0);
+        shaders.CompileAll();
+
+        // Setup our textures.  Their mip levels get filtered on the CPU, in
+        // linear space, since our images are sRGB.  That, and decoding the
+        // images, runs on a pool of worker threads.
+        JobSystem jobs;
+        ImageBufferPool imageBuffers;
+        ImageDecoder imageDecoder(&jobs, &imageBuffers);
+        Texture::SetImageDecoder(&imageDecoder);
+
+        MipmapGenerator mipmaps(MipmapGenerator::Kaiser, true, &jobs);
+        Texture::SetMipmapGenerator(&mipmaps);
+
+        // They're kept by path in a registry, so anything else that wants one
+        // of them gets the same Texture instead of loading it again.
+        ResourceRegistry<Texture> textures;
+
+        auto loadTexture = [&](const std::string& path) {
+            return textures.Load(path, [&]() {
+                return assets.IsOpen()
+                    ? std::make_shared<Texture>(assets, path.c_str())
+                    : std::make_shared<Texture>(path.c_str());
+            });
+        };
+
+        std::shared_ptr<Texture> ourTexture1 = loadTexture(textureFile1);
+        std::shared_ptr<Texture> ourTexture2 = loadTexture(textureFile2);
+
+        // When we're working out of the resource folder, pick up any changes
+        // to the shaders and images while we're running.
+        TextureReloader textureReloader;
+
+        if (!assets.IsOpen()) {
+            shaders.EnableHotReload();
+            textureReloader.Watch(*ourTexture1, textureFile1);
+            textureReloader.Watch(*ourTexture2, textureFile2);
+        }
 
-        // cleanup
+        // The ways we sample our textures.  The far and near faces get as
+        // much anisotropic filtering as we can, since they are seen at steep
+        // angles, and the side faces are sharpened up with a bit of LOD bias.
+        // Each of these is a sampler of its own, made once.
+        SamplerCache samplerCache;
+        StateTracker state;
+
+        SamplerState cubeSampling;
+        cubeSampling.Anisotropy(16.0f);
+
+        SamplerState sideSampling;
+        sideSampling.Anisotropy(16.0f).LodBias(-0.5f);
+
+        SamplerState nearestSampling;
+        nearestSampling.Filter(GL_NEAREST, GL_NEAREST);
+
+        cout << "Maximum anisotropy: " << samplerCache.MaxAnisotropy() << endl;
+
+        // Setup our vertex data
+        GLfloat vertices[] = {
+                              -0.5f, -0.5f,  0.5f,
+                               0.5f, -0.5f,  0.5f,
+                               0.5f,  0.5f,  0.5f,
+                              -0.5f,  0.5f,  0.5f,
+
+                              -0.5f, -0.5f, -0.5f,
+                               0.5f, -0.5f, -0.5f,
+                               0.5f,  0.5f, -0.5f,
+                              -0.5f,  0.5f, -0.5f
+                              };
+
+        // Note: texture coordinates are mapped to vertices, and not indices
+        GLfloat texCoords[] = {
+                               0.0f, 0.0f,  // Lower-left corner
+                               1.0f, 0.0f,  // Lower-right corner
+                               1.0f, 1.0f,  // Top-right corner
+                               0.0f, 1.0f,  // Top-left corner
+
+                               0.0f, 1.0f,  // Top-left corner
+                               1.0f, 1.0f,  // Top-right corner
+                               1.0f, 0.0f,  // Lower-right corner
+                               0.0f, 0.0f,  // Lower-left corner
+                               };
+
+        // Note: color values are mapped to vertices, and not indices
+        GLfloat colors[] = {
+                            0.f, 0.f, 1.f,  // Lower-left-near corner
+                            1.f, 0.f, 1.f,  // Lower-right-near corner
+                            1.f, 1.f, 1.f,  // Top-right-near corner
+                            0.f, 1.f, 1.f,  // Top-left-near corner
+
+                            0.f, 0.f, 0.f,  // Lower-left-far corner
+                            1.f, 0.f, 0.f,  // Lower-right-far corner
+                            1.f, 1.f, 0.f,  // Top-right-far corner
+                            0.f, 1.f, 0.f,  // Top-left-far corner
+                            };
+
+        GLuint indices[] = {
+                            0, 1, 2,  // near face
+                            2, 3, 0,
+
+                            4, 5, 6,  // far face
+                            6, 7, 4,
+
+                            3, 2, 6,  // top face
+                            6, 7, 3,
+
+                            0, 1, 5,  // bottom face
+                            5, 4, 0,
+
+                            0, 4, 7,  // left face
+                            7, 3, 0,
+
+                            1, 5, 6,  // right face
+                            6, 2, 1,
+                            };
+
+        // Setup our transformations. We are using Eigen here.
+        Affine3f rot, scale, modelTrans;
+
+        // Define our model transformation
+        rot = AngleAxisf(to_radians(-65.0f), Vector3f::UnitX());
+        //scale = Scaling(Vector3f(0.8, 0.8, 0.8));
+        modelTrans = rot;
+
+        // Define our view and projection transformation
+        camera.lookAt(Vector3f(0.0, 0.0, 3.0),
+                      Vector3f(0.0, 0.0, 0.0),
+                      Vector3f(0.0, 1.0, 0.0));
+
+        camera.setPerspective(45.0f, (float)width, (float)height,
+                              0.1f, 100.0f);
+
+        // We can't texture the last two faces of our cube with the vertex
+        // indices we have.  So those get drawn again with a child transform
+        // that is rotated 90 degrees from the cube.
+        SceneGraph scene;
+        SceneNode cubeNode = scene.AddNode(SceneGraph::None, modelTrans);
+        SceneNode sideFacesNode = scene.AddNode(cubeNode,
+            Affine3f(AngleAxisf(to_radians(90.0f), Vector3f::UnitY())));
+        scene.Update();
+
+        cout << "Our Model matrix:\n"<< modelTrans.matrix() << endl;
+        cout << "Our View matrix:\n"<< camera.View() << endl;
+        cout << "Our Projection matrix:\n"<< camera.Projection() << endl;
+
+        // glm::mat4 glmProjection;
+        // glmProjection = glm::perspective(glm::radians(45.0f),
+        //                                  (float)width / (float)height,
+        //                                  0.1f, 100.0f);
+        // cout << "GLM Projection:\n" << glm::to_string(glmProjection)
+        //      << endl;
+
+        // glm::mat4 glmView;
+        // glmView = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f),
+        //                       glm::vec3(0.0f, 0.0f, 0.0f),
+        //                       glm::vec3(0.0f, 1.0f, 0.0f));
+        // cout << "glm::lookAt view:\n" << glm::to_string(glmView) << endl;
+
+        // Initialize our Vertex Array Object and buffer objects.
+        // These get deleted when they go out of scope.
+        GLVertexArray VAO = GLVertexArray::Create();
+        GLBuffer vertexVBO = GLBuffer::Create();
+        GLBuffer vertexEBO = GLBuffer::Create();
+        GLBuffer colorVBO = GLBuffer::Create();
+        GLBuffer textureVBO = GLBuffer::Create();
+
+        // bind our Vertex Array Object first
+        glBindVertexArray(VAO.ID());
+
+        // Initialize the vertex buffer and the color buffer objects so we can
+        // Then bind and set our buffers
+        // Note: the order in which things are done here is important.
+        //       The order of operations that works for me is:
+        //       - bind the buffer object
+        //       - copy the data into the buffer
+        //       - Set the attribute pointer
+        //       - move on to the next buffer object
+        //       I think the determining factor is that we can only operate
+        //       on a single bound buffer at a time.
+        glBindBuffer(GL_ARRAY_BUFFER, vertexVBO.ID());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
+                     GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertexEBO.ID());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+                     GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
+                              3 * sizeof(GLfloat), (GLvoid*)0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, colorVBO.ID());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(colors), colors,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
+                              3 * sizeof(GLfloat), (GLvoid*)0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, textureVBO.ID());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
+                              2 * sizeof(GLfloat), (GLvoid*)0);
+
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+
+        // Note that this is allowed, the call to glVertexAttribPointer
+        // registered VBO as the currently bound vertex buffer object so
+        // afterwards we can safely unbind.
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // Note: Remember, do NOT unbind the EBO, keep it bound to this VAO
+
+        // Unbind the Vertex Array Object.
+        // (It is always good to unbind any buffer/array to prevent strange
+        // bugs)
         glBindVertexArray(0);
 
-        //
-        // done rendering
-        //
+        // Our simulation state is the model transform and the camera view,
+        // which get interpolated, and the projection, which does not.
+        SimulationState simState;
+        simState.transforms.push_back(modelTrans);
+        simState.transforms.push_back(Affine3f(camera.View()));
+        simState.matrices.push_back(camera.Projection());
+
+        gameLoop.start(simState, simulation_tick);
+
+        // our main loop
+        while(!glfwWindowShouldClose(window))
+        {
+            // check input events(kbd, mouse, etc.)
+            // These get handled on the next simulation tick.
+            glfwPollEvents();
+
+            // get the simulation state blended for this point in time
+            gameLoop.interpolate(simState);
+
+            //
+            // rendering routines
+            //
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // pick up any shader variants that have finished compiling, and
+            // draw with the one we want, or whatever is ready until it is.
+            // Reloaded shaders and textures get swapped in here too.
+            // Building a texture binds it behind our state tracker's back.
+            shaders.Update();
+            if (textureReloader.Update())
+                state.Invalidate();
+
+            Shader *ourShader = vertexColors
+                ? shaders.Get("cube", {"VERTEX_COLORS"})
+                : shaders.Get("cube");
+
+            if (ourShader == nullptr) {
+                glfwSwapBuffers(window);
+                continue;
+            }
+
+            // grab our graphics pipeline context
+            state.UseProgram(ourShader->Program);
+            state.BindVertexArray(VAO.ID());
+
+            // update our model transforms
+            scene.SetLocal(cubeNode, simState.transforms[0]);
+            scene.Update();
+
+            // set our transformation matrices as uniforms
+            ourShader->UseTransform(scene.World(cubeNode).data(), 0);
+            ourShader->UseTransform(simState.transforms[1].data(), 1);
+            ourShader->UseTransform(simState.matrices[0].data(), 2);
+
+
+            // grab our textures, and the way we sample them for these faces
+            GLuint sampler = samplerCache.Get(
+                nearestFiltering ? nearestSampling : cubeSampling);
+            ourShader->UseTexture(state, ourTexture1->ID, 0, sampler);
+            ourShader->UseTexture(state, ourTexture2->ID, 1, sampler);
+
+            // draw our cube
+            // Note: we are using vertex indices, so it is impossible
+            //       to draw the last two faces of our cube with a reasonable
+            //       texture.  So the strategy is to draw the first four faces,
+            //       rotate 90 degrees, and then draw the last two faces.
+            glDrawElements(GL_TRIANGLES, 24, GL_UNSIGNED_INT, 0);
+
+            ourShader->UseTransform(scene.World(sideFacesNode).data(), 0);
+
+            // Same textures, sampled differently.  Only the samplers get
+            // bound.
+            sampler = samplerCache.Get(nearestFiltering ? nearestSampling
+                                                        : sideSampling);
+            ourShader->UseTexture(state, ourTexture1->ID, 0, sampler);
+            ourShader->UseTexture(state, ourTexture2->ID, 1, sampler);
+
+            glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, 0);
+
+            // cleanup
+            state.BindVertexArray(0);
+
+            //
+            // done rendering
+            //
+
+            glfwSwapBuffers(window);
+
+            // delete the vertex arrays and samplers let go of this frame
+            GLNamePool::FlushAll();
+        }
 
-        glfwSwapBuffers(window);
+        gameLoop.stop();
+        cout << "Simulation ticks run: " << gameLoop.TicksRun()
+             << ", dropped: " << gameLoop.TicksDropped() << endl;
+        cout << "Samplers: " << samplerCache.NumSamplers()
+             << ", binds: " << state.Binds()
+             << ", skipped: " << state.SkippedBinds() << endl;
+
+        Texture::SetMipmapGenerator(nullptr);
+        Texture::SetImageDecoder(nullptr);
     }
 
-    // Properly deallocate all resources once we are done.
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &vertexVBO);
-    glDeleteBuffers(1, &colorVBO);
+    // Shaders built from files share programs through the default
+    // cache, and the pools hold on to the names we let go of.  Those
+    // get deleted for real now, before the context goes away.
+    Shader::DefaultCache().Clear();
+    GLNamePool::FlushAll();
 
     glfwTerminate();
     cout << "Terminated GLFW..." << endl;
@@ -438,6 +604,8 @@ void report_error(int code, const char * description)
 void key_callback(GLFWwindow* window,
                   int key, int scancode, int action, int mode)
 {
+    std::lock_guard<std::mutex> lock(inputMutex);
+
     keyHandler.callback(key, scancode, action, mode);
 
     if (keyHandler.is_key(GLFW_KEY_ESCAPE)) {
@@ -445,11 +613,24 @@ void key_callback(GLFWwindow* window,
         // property to true, closing the application
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
+
+    if (keyHandler.is_key(GLFW_KEY_C)) {
+        // toggle the shader variant that tints with the vertex colors
+        vertexColors = !vertexColors;
+        keyHandler.reset_key(GLFW_KEY_C);
+    }
+
+    if (keyHandler.is_key(GLFW_KEY_F)) {
+        // toggle between filtered and unfiltered sampling
+        nearestFiltering = !nearestFiltering;
+        keyHandler.reset_key(GLFW_KEY_F);
+    }
 }
 
 
 void mouse_position_callback(GLFWwindow* window, double xpos, double ypos)
 {
+    std::lock_guard<std::mutex> lock(inputMutex);
     mouseHandler.position_callback(Vector2f(xpos, ypos));
 }
 
@@ -457,12 +638,14 @@ void mouse_position_callback(GLFWwindow* window, double xpos, double ypos)
 void mouse_button_callback(GLFWwindow* window,
                            int button, int action, int mods)
 {
+    std::lock_guard<std::mutex> lock(inputMutex);
     mouseHandler.button_callback(button, action, mods);
 }
 
 
 void mouse_scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+    std::lock_guard<std::mutex> lock(inputMutex);
     mouseHandler.scroll_callback(Vector2f(xoffset, yoffset));
 }
 
@@ -473,6 +656,31 @@ void joystick_callback(int joy, int event)
 }
 
 
+// Runs on the simulation thread at a fixed rate.
+// - deltaTime is always the tick interval
+void simulation_tick(SimulationState& state, GLfloat deltaTime)
+{
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        handle_events(deltaTime);
+    }
+
+    if (animateCube) {
+        // rotate the image at about 60 degrees/sec
+        state.transforms[0] *= AngleAxisf(to_radians(deltaTime * 60.0f),
+                                          Vector3f::UnitZ())
+                             * AngleAxisf(to_radians(deltaTime * 30.0f),
+                                          Vector3f::UnitY())
+                             * AngleAxisf(to_radians(deltaTime * 30.0f),
+                                          Vector3f::UnitX());
+    }
+
+    // The camera is only ever moved from the simulation thread
+    state.transforms[1] = Affine3f(camera.View());
+    state.matrices[0] = camera.Projection();
+}
+
+
 void handle_events(GLfloat deltaTime)
 {
     if (keyHandler.is_key(GLFW_KEY_SPACE)) {
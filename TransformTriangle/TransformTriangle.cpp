@@ -53,6 +53,7 @@ using Eigen::Scaling;
 #include <SOIL/SOIL.h>
 
 #include "Shader.hpp"
+#include "GLObject.hpp"
 #include "Texture.hpp"
 #include "CmdOptionParser.hpp"
 
@@ -142,195 +143,200 @@ int main(int argc, const char **argv)
 
     glfwSetKeyCallback(window, key_callback);
 
-    // Here is where we build and compile our shader program
-    Shader ourShader(vertexFile.c_str(), fragmentFile.c_str());
-
-    // Setup our textures
-    Texture ourTexture1(textureFile1.c_str());
-    Texture ourTexture2(textureFile2.c_str());
-
-    // Setup our vertex data
-    GLfloat vertices[] = { 0.5f,  0.5f, 0.0f,
-                           0.5f, -0.5f, 0.0f,
-                          -0.5f, -0.5f, 0.0f,
-                          -0.5f,  0.5f, 0.0f
-                          };
-
-    GLuint indices[] = {0, 1, 3,  // 1st triangle
-                        1, 2, 3   // 2nd triangle
-                        };
-
-    GLfloat colors[] = {1.f, 0.f, 0.f,
-                        0.f, 1.f, 0.f,
-                        0.f, 0.f, 1.f};
-
-    GLfloat texCoords[] = {0.0f, 0.0f,  // Lower-left corner
-                           1.0f, 0.0f,  // Lower-right corner
-                           1.0f, 1.0f,  // Top-right corner
-                           0.0f, 1.0f   // Top-left corner
-                           };
-
-    // Setup our transformations. We are using Eigen here.
-    Affine3f rot, scale, modelTrans, viewTrans;
-    Matrix4f projectionTrans;
-
-    // Define our model transformation
-    rot = AngleAxisf(to_radians(-65.0f), Vector3f::UnitX());
-    //scale = Scaling(Vector3f(0.8, 0.8, 0.8));
-    modelTrans = rot;
-
-    // Define our view transformation
-    viewTrans = Translation3f(Vector3f(0.0, 0.0, -2.0));
-
-    // Define our projection transformation
-    //
-    // This seems odd.  I looked at the GLM code for the perspective
-    // transformation, and it does nothing to convert the FOV (in degrees)
-    // to radians.  Why not???  It seems you would need to use radians
-    // on any trig functions you were using in order to get valid results.
-    GLfloat fov = to_radians(45.0f);
-    GLfloat aspect = (float)width / (float)height;
-
-    GLfloat tanHalfFovy = tan(fov / 2.0);
-    GLfloat xScale = 1.0 / (aspect * tanHalfFovy);
-    GLfloat yScale = 1.0 / tanHalfFovy;
-    GLfloat near = 0.1f, far = 100.0f;
-
-    // using the comma initializer just makes it easier to read.
-    projectionTrans << xScale, 0, 0, 0,
-                       0, yScale, 0, 0,
-                       0, 0, -(far + near) / (far - near), -1,
-                       0, 0, -2 * far * near / (far - near), 0;
-    projectionTrans.transposeInPlace();
-
-    cout << "Our Model matrix:\n"<< modelTrans.matrix() << endl;
-    cout << "Our View matrix:\n"<< viewTrans.matrix() << endl;
-    cout << "Our Projection matrix:\n"<< projectionTrans.matrix() << endl;
-
-    //glm::mat4 glmProjection;
-    //glmProjection = glm::perspective(45.0f, (float)width / (float)height,
-    //                                 0.1f, 100.0f);
-    //cout << "GLM Projection:\n" << glm::to_string(glmProjection) << endl;
-
-    // Initialize our Vertex Array Object and buffer objects
-    GLuint VAO = 0;
-    GLuint vertexVBO = 0;
-    GLuint vertexEBO = 0;
-    GLuint colorVBO = 0;
-    GLuint textureVBO = 0;
-
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &vertexVBO);
-    glGenBuffers(1, &vertexEBO);
-    glGenBuffers(1, &colorVBO);
-    glGenBuffers(1, &textureVBO);
-
-    // bind our Vertex Array Object first
-    glBindVertexArray(VAO);
-
-    // Initialize the vertex buffer and the color buffer objects so we can
-    // Then bind and set our buffers
-    // Note: the order in which things are done here is important. The order
-    //       of operations that works for me is:
-    //       - bind the buffer object
-    //       - copy the data into the buffer
-    //       - Set the attribute pointer
-    //       - move on to the next buffer object
-    //       I think the determining factor is that we can only operate
-    //       on a single bound buffer at a time.
-    glBindBuffer(GL_ARRAY_BUFFER, vertexVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
-                 GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertexEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
-                 GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-                          3 * sizeof(GLfloat), (GLvoid*)0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(colors), colors,
-                 GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-                          3 * sizeof(GLfloat), (GLvoid*)0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, textureVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords,
-                 GL_STATIC_DRAW);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
-                          2 * sizeof(GLfloat), (GLvoid*)0);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-
-    // Note that this is allowed, the call to glVertexAttribPointer
-    // registered VBO as the currently bound vertex buffer object so
-    // afterwards we can safely unbind.
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    // Note: Remember, do NOT unbind the EBO, keep it bound to this VAO
-
-    // Unbind the Vertex Array Object.
-    // (It is always good to unbind any buffer/array to prevent strange bugs)
-    glBindVertexArray(0);
-
-    // our main loop
-    GLfloat prevTime = glfwGetTime();
-    while(!glfwWindowShouldClose(window))
+    // Everything that owns GL objects lives in this block, so it all
+    // goes away while the context is still here.
     {
-        // check input events(kbd, mouse, etc.)
-        glfwPollEvents();
+        // Here is where we build and compile our shader program
+        Shader ourShader(vertexFile.c_str(), fragmentFile.c_str());
+
+        // Setup our textures
+        Texture ourTexture1(textureFile1.c_str());
+        Texture ourTexture2(textureFile2.c_str());
+
+        // Setup our vertex data
+        GLfloat vertices[] = { 0.5f,  0.5f, 0.0f,
+                               0.5f, -0.5f, 0.0f,
+                              -0.5f, -0.5f, 0.0f,
+                              -0.5f,  0.5f, 0.0f
+                              };
+
+        GLuint indices[] = {0, 1, 3,  // 1st triangle
+                            1, 2, 3   // 2nd triangle
+                            };
+
+        GLfloat colors[] = {1.f, 0.f, 0.f,
+                            0.f, 1.f, 0.f,
+                            0.f, 0.f, 1.f};
+
+        GLfloat texCoords[] = {0.0f, 0.0f,  // Lower-left corner
+                               1.0f, 0.0f,  // Lower-right corner
+                               1.0f, 1.0f,  // Top-right corner
+                               0.0f, 1.0f   // Top-left corner
+                               };
+
+        // Setup our transformations. We are using Eigen here.
+        Affine3f rot, scale, modelTrans, viewTrans;
+        Matrix4f projectionTrans;
+
+        // Define our model transformation
+        rot = AngleAxisf(to_radians(-65.0f), Vector3f::UnitX());
+        //scale = Scaling(Vector3f(0.8, 0.8, 0.8));
+        modelTrans = rot;
+
+        // Define our view transformation
+        viewTrans = Translation3f(Vector3f(0.0, 0.0, -2.0));
+
+        // Define our projection transformation
+        //
+        // This seems odd.  I looked at the GLM code for the perspective
+        // transformation, and it does nothing to convert the FOV (in degrees)
+        // to radians.  Why not???  It seems you would need to use radians
+        // on any trig functions you were using in order to get valid results.
+        GLfloat fov = to_radians(45.0f);
+        GLfloat aspect = (float)width / (float)height;
+
+        GLfloat tanHalfFovy = tan(fov / 2.0);
+        GLfloat xScale = 1.0 / (aspect * tanHalfFovy);
+        GLfloat yScale = 1.0 / tanHalfFovy;
+        GLfloat near = 0.1f, far = 100.0f;
+
+        // using the comma initializer just makes it easier to read.
+        projectionTrans << xScale, 0, 0, 0,
+                           0, yScale, 0, 0,
+                           0, 0, -(far + near) / (far - near), -1,
+                           0, 0, -2 * far * near / (far - near), 0;
+        projectionTrans.transposeInPlace();
+
+        cout << "Our Model matrix:\n"<< modelTrans.matrix() << endl;
+        cout << "Our View matrix:\n"<< viewTrans.matrix() << endl;
+        cout << "Our Projection matrix:\n"<< projectionTrans.matrix() << endl;
+
+        //glm::mat4 glmProjection;
+        //glmProjection = glm::perspective(45.0f, (float)width / (float)height,
+        //                                 0.1f, 100.0f);
+        //cout << "GLM Projection:\n" << glm::to_string(glmProjection) << endl;
+
+        // Initialize our Vertex Array Object and buffer objects.
+        // These get deleted when they go out of scope.
+
+        GLVertexArray VAO = GLVertexArray::Create();
+        GLBuffer vertexVBO = GLBuffer::Create();
+        GLBuffer vertexEBO = GLBuffer::Create();
+        GLBuffer colorVBO = GLBuffer::Create();
+        GLBuffer textureVBO = GLBuffer::Create();
+
+        // bind our Vertex Array Object first
+        glBindVertexArray(VAO.ID());
+
+        // Initialize the vertex buffer and the color buffer objects so we can
+        // Then bind and set our buffers
+        // Note: the order in which things are done here is important.
+        //       The order of operations that works for me is:
+        //       - bind the buffer object
+        //       - copy the data into the buffer
+        //       - Set the attribute pointer
+        //       - move on to the next buffer object
+        //       I think the determining factor is that we can only operate
+        //       on a single bound buffer at a time.
+        glBindBuffer(GL_ARRAY_BUFFER, vertexVBO.ID());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
+                     GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertexEBO.ID());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+                     GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
+                              3 * sizeof(GLfloat), (GLvoid*)0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, colorVBO.ID());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(colors), colors,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
+                              3 * sizeof(GLfloat), (GLvoid*)0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, textureVBO.ID());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
+                              2 * sizeof(GLfloat), (GLvoid*)0);
+
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+
+        // Note that this is allowed, the call to glVertexAttribPointer
+        // registered VBO as the currently bound vertex buffer object so
+        // afterwards we can safely unbind.
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // Note: Remember, do NOT unbind the EBO, keep it bound to this VAO
+
+        // Unbind the Vertex Array Object.
+        // (It is always good to unbind any buffer/array to prevent strange
+        // bugs)
+        glBindVertexArray(0);
 
-        // get the time elapsed since last iteration
-        GLfloat deltaTime = glfwGetTime() - prevTime;
-        prevTime += deltaTime;
+        // our main loop
+        GLfloat prevTime = glfwGetTime();
+        while(!glfwWindowShouldClose(window))
+        {
+            // check input events(kbd, mouse, etc.)
+            glfwPollEvents();
 
-        // rotate the image at about 60 degrees/sec
-        modelTrans *= AngleAxisf(to_radians(deltaTime * 60.0f),
-                                 Vector3f::UnitZ());
+            // get the time elapsed since last iteration
+            GLfloat deltaTime = glfwGetTime() - prevTime;
+            prevTime += deltaTime;
 
-        //
-        // rendering routines
-        //
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+            // rotate the image at about 60 degrees/sec
+            modelTrans *= AngleAxisf(to_radians(deltaTime * 60.0f),
+                                     Vector3f::UnitZ());
 
-        // grab our graphics pipeline context
-        ourShader.Use();
-        glBindVertexArray(VAO);
+            //
+            // rendering routines
+            //
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        // set our transformation matrices as uniforms
-        ourShader.UseTransform(modelTrans.data(), 0);
-        ourShader.UseTransform(viewTrans.data(), 1);
+            // grab our graphics pipeline context
+            ourShader.Use();
+            glBindVertexArray(VAO.ID());
 
-        // ourShader.UseTransform(glm::value_ptr(glmProjection), 2);
-        ourShader.UseTransform(projectionTrans.data(), 2);
+            // set our transformation matrices as uniforms
+            ourShader.UseTransform(modelTrans.data(), 0);
+            ourShader.UseTransform(viewTrans.data(), 1);
 
+            // ourShader.UseTransform(glm::value_ptr(glmProjection), 2);
+            ourShader.UseTransform(projectionTrans.data(), 2);
 
-        // grab our textures
-        ourShader.UseTexture(ourTexture1.ID, 0);
-        ourShader.UseTexture(ourTexture2.ID, 1);
 
-        // draw our colored triangle
-        // glDrawArrays(GL_TRIANGLES, 0, 3);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            // grab our textures
+            ourShader.UseTexture(ourTexture1.ID, 0);
+            ourShader.UseTexture(ourTexture2.ID, 1);
 
-        // cleanup
-        glBindVertexArray(0);
+            // draw our colored triangle
+            // glDrawArrays(GL_TRIANGLES, 0, 3);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-        //
-        // done rendering
-        //
+            // cleanup
+            glBindVertexArray(0);
+
+            //
+            // done rendering
+            //
 
-        glfwSwapBuffers(window);
+            glfwSwapBuffers(window);
+
+            // delete any vertex arrays let go of this frame
+            GLNamePool::FlushAll();
+        }
     }
 
-    // Properly deallocate all resources once we are done.
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &vertexVBO);
-    glDeleteBuffers(1, &colorVBO);
+    // Shaders built from files share programs through the default
+    // cache, and the pools hold on to the names we let go of.  Those
+    // get deleted for real now, before the context goes away.
+    Shader::DefaultCache().Clear();
+    GLNamePool::FlushAll();
 
     glfwTerminate();
     cout << "Terminated GLFW..." << endl;
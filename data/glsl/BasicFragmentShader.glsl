@@ -1,8 +1,4 @@
-#version 300 es
-
-#ifdef GL_ES
-precision mediump float;
-#endif
+#include "Common.glsl"
 
 in vec3 color;
 out vec4 out_color;
@@ -0,0 +1,8 @@
+#version 300 es
+
+// Everything our shaders have in common.  The shader loader resolves
+// '#include "Common.glsl"' and moves the #version line to the very top.
+
+#ifdef GL_ES
+    precision mediump float;
+#endif
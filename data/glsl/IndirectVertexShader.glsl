@@ -0,0 +1,34 @@
+#version 430
+
+// For the IndirectRenderer: the object's index comes in as an instanced
+// attribute, and its model matrix out of the objects' storage buffer.
+// The struct has to match IndirectObject.
+
+struct Object
+{
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uint count;
+    uint firstIndex;
+    int baseVertex;
+    uint padding;
+};
+
+layout(std430, binding = 0) readonly buffer Objects { Object objects[]; };
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 3) in uint objectIndex;
+
+out vec3 color;
+
+uniform mat4 viewProjection;
+
+void main() {
+    mat4 model = objects[objectIndex].model;
+
+    gl_Position = viewProjection * model * vec4(position, 1.0);
+
+    color = 0.5 + 0.5 * normalize(mat3(model) * normal);
+}
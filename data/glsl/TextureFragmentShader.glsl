@@ -1,8 +1,4 @@
-#version 300 es
-
-#ifdef GL_ES
-    precision mediump float;
-#endif
+#include "Common.glsl"
 
 in vec3 color;
 in vec2 TexCoord;
@@ -15,4 +11,8 @@ void main() {
     out_color = mix(texture(ourTexture0, TexCoord),
                     texture(ourTexture1, TexCoord),
                     0.2);
+
+#ifdef VERTEX_COLORS
+    out_color *= vec4(color, 1.0);
+#endif
 }
@@ -0,0 +1,131 @@
+//============================================================================
+// Name        : AssetPack.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Our demos open every shader and image as a separate file,
+//               with a path pasted together from the resource folder.
+//               An asset pack puts all of them in one file instead, which
+//               we memory map once and then hand out pieces of it without
+//               copying anything.
+//
+//               The layout of a pack is:
+//               - A 64 byte header
+//               - The index, one entry per asset, sorted by the
+//                 SpookyHash::Hash64() of the asset's logical path
+//                 (like "glsl/TextureFragmentShader.glsl")
+//               - The logical paths, so we can check for collisions and
+//                 list what's in the pack
+//               - The payloads, each starting on a 64 byte boundary
+//
+//               Everything is little-endian.
+//============================================================================
+
+#ifndef ASSETPACK_HPP_
+#define ASSETPACK_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+
+// A piece of memory that we don't own
+struct AssetSpan
+{
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+
+    bool empty() const { return data == nullptr; }
+    const char *chars() const { return reinterpret_cast<const char *>(data); }
+};
+
+
+struct AssetPackHeader
+{
+    static const uint32_t Magic = 0x4b504741;  // "AGPK"
+    static const uint32_t Version = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numEntries;
+    uint32_t reserved;
+    uint64_t indexOffset;
+    uint64_t pathsOffset;
+    uint64_t payloadOffset;
+    uint64_t fileSize;
+    uint64_t hashSeed;
+    uint64_t padding;
+};
+
+struct AssetPackEntry
+{
+    uint64_t hash;
+    uint64_t offset;      // from the start of the file
+    uint64_t size;
+    uint32_t pathOffset;  // from the start of the paths
+    uint32_t pathLength;
+};
+
+
+class AssetPack
+{
+public:
+    static const size_t Alignment = 64;
+    static const uint64_t HashSeed = 0x4f70656e474c4450ULL;
+
+    AssetPack() {}
+    explicit AssetPack(const std::string& packPath) { Open(packPath); }
+
+    bool Open(const std::string& packPath);
+    void Close();
+    bool IsOpen() const { return file.IsOpen(); }
+
+    // Look up an asset by its logical path.  The span is empty if the
+    // asset isn't there.  It stays valid as long as the pack is open.
+    AssetSpan Find(const std::string& logicalPath) const;
+    bool Contains(const std::string& logicalPath) const;
+
+    size_t NumAssets() const { return numEntries; }
+    std::string AssetPath(size_t idx) const;
+    AssetSpan Asset(size_t idx) const;
+
+    static uint64_t HashPath(const std::string& logicalPath);
+
+private:
+    MappedFile file;
+
+    const AssetPackEntry *entries = nullptr;
+    const char *paths = nullptr;
+    size_t numEntries = 0;
+};
+
+
+// Builds a pack file.  Assets get collected in memory and written out in
+// one go.
+class AssetPackWriter
+{
+public:
+    // Add the contents of a file on disk under the given logical path
+    bool AddFile(const std::string& logicalPath, const std::string& filePath);
+    bool AddData(const std::string& logicalPath,
+                 const void *data, size_t size);
+
+    size_t NumAssets() const { return assets.size(); }
+
+    bool Write(const std::string& packPath) const;
+
+private:
+    struct PendingAsset
+    {
+        std::string path;
+        uint64_t hash;
+        std::vector<unsigned char> data;
+    };
+
+    std::vector<PendingAsset> assets;
+};
+
+#endif /* ASSETPACK_HPP_ */
@@ -64,6 +64,14 @@ public:
 
     Matrix4f View() {return this->mView; }
     Matrix4f Projection() {return this->mProjection; }
+    Matrix4f ViewProjection() {return this->mProjection * this->mView; }
+    Vector3f Position() {return this->position; }
+
+    // The planes of the view frustum in world space, in the order left,
+    // right, bottom, top, near, far.  Each is (normal, distance) with the
+    // normal pointing in and of unit length, so a point p is inside when
+    // normal.dot(p) + distance >= 0 for all six.
+    void FrustumPlanes(Vector4f planes[6]);
 
 private:
     Vector3f position;
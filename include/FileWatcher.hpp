@@ -0,0 +1,69 @@
+//============================================================================
+// Name        : FileWatcher.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Tells us when files we care about have been written, so we
+//               can reload them while the program is running.
+//
+//               This uses inotify.  We watch the folder a file is in rather
+//               than the file itself, since a lot of editors save by writing
+//               a new file and renaming it over the old one, which would
+//               take an inotify watch on the file away with it.
+//
+//               A thread of our own waits on the events.  Checking for
+//               changes is just reading a flag, so it can be done every
+//               frame for free.
+//============================================================================
+
+#ifndef FILEWATCHER_HPP_
+#define FILEWATCHER_HPP_
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Did we manage to set up inotify?
+    bool IsValid() const { return inotifyFd >= 0; }
+
+    // Start watching a file.  The changes are reported with the path
+    // spelled the same way it was given here.
+    bool Watch(const std::string& path);
+
+    bool HasChanges() const { return changed.load(std::memory_order_acquire); }
+
+    // The files that have been written since the last call
+    std::vector<std::string> TakeChanges();
+
+private:
+    void Run();
+
+    int inotifyFd = -1;
+    int stopPipe[2] = {-1, -1};
+
+    std::mutex mutex;
+
+    // watch descriptor -> file name in that folder -> paths we were given
+    std::map<int, std::map<std::string, std::set<std::string>>> watches;
+
+    std::set<std::string> changes;
+    std::atomic<bool> changed;
+
+    std::thread thread;
+};
+
+#endif /* FILEWATCHER_HPP_ */
@@ -0,0 +1,194 @@
+//============================================================================
+// Name        : GLObject.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Our GL objects have been plain GLuint names that we had to
+//               remember to delete, and mostly didn't.  These are RAII
+//               wrappers for buffers, textures, vertex arrays, samplers and
+//               programs.  They can be moved, but not copied, so there is
+//               always exactly one owner, and the object is deleted when
+//               that owner goes away.
+//
+//               Creating objects one at a time is a driver call each, so
+//               the names come from a pool instead:
+//               - New names get generated in batches, with one glGen*()
+//                 call for a whole batch.
+//               - Buffers and textures that are let go of are deleted right
+//                 away, since they hold storage (a tile, a whole old arena)
+//                 that we want back now, not some batches later.
+//               - Vertex arrays and samplers are just a bit of state, so
+//                 their names are retired, and deleted in batches, with one
+//                 glDelete*() call.  FlushAll() deletes what's retired; the
+//                 demos call it once a frame, after swapping the buffers.
+//               We can't just hand a retired name out again, since the old
+//               object (its storage, its target, its parameters) would come
+//               with it.  So recycling goes through the delete.
+//
+//               Programs don't have a glGen*() call, so they aren't pooled.
+//
+//               The pools are only safe on the thread with the GL context,
+//               and with that one context: vertex arrays aren't shared
+//               between contexts, so a name from one means nothing (or
+//               something else) in another.
+//============================================================================
+
+#ifndef GLOBJECT_HPP_
+#define GLOBJECT_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h> // Include glew to get all the required OpenGL headers
+
+
+class GLNamePool
+{
+public:
+    enum Kind { Buffers, Textures, VertexArrays, Samplers, NumKinds };
+
+    static const size_t BatchSize = 64;
+
+    // The pool for each kind of object
+    static GLNamePool& Get(Kind kind);
+
+    // Delete the retired names of every pool.  Call it once a frame.
+    static void FlushAll();
+
+    GLNamePool(const GLNamePool&) = delete;
+    GLNamePool& operator=(const GLNamePool&) = delete;
+
+    GLuint Allocate();
+
+    // Delete a buffer or texture now, or retire anything else's name
+    void Release(GLuint name);
+
+    // Delete the retired names now
+    void Flush();
+
+    // stats
+    size_t NumFree() const { return freeNames.size(); }
+    size_t NumRetired() const { return retiredNames.size(); }
+    size_t GenCalls() const { return genCalls; }
+    size_t DeleteCalls() const { return deleteCalls; }
+
+private:
+    explicit GLNamePool(Kind kind) : kind(kind) {}
+
+    void Generate(GLsizei count, GLuint *names);
+    void Delete(GLsizei count, const GLuint *names);
+
+    Kind kind;
+
+    std::vector<GLuint> freeNames;
+    std::vector<GLuint> retiredNames;
+
+    size_t genCalls = 0;
+    size_t deleteCalls = 0;
+};
+
+
+// A GL object with a pooled name
+template <GLNamePool::Kind kind>
+class GLObject
+{
+public:
+    // An empty object, with no name.  Use Create() to make a real one.
+    GLObject() {}
+    ~GLObject() { Reset(); }
+
+    static GLObject Create()
+    {
+        return GLObject(GLNamePool::Get(kind).Allocate());
+    }
+
+    GLObject(const GLObject&) = delete;
+    GLObject& operator=(const GLObject&) = delete;
+
+    GLObject(GLObject&& other) : name(other.name)
+    {
+        other.name = 0;
+    }
+
+    GLObject& operator=(GLObject&& other)
+    {
+        if (this != &other) {
+            Reset();
+            name = other.name;
+            other.name = 0;
+        }
+
+        return *this;
+    }
+
+    GLuint ID() const { return name; }
+    explicit operator bool() const { return name != 0; }
+
+    // Delete the object (or, with no storage, retire its name)
+    void Reset()
+    {
+        if (name != 0)
+            GLNamePool::Get(kind).Release(name);
+
+        name = 0;
+    }
+
+private:
+    explicit GLObject(GLuint name) : name(name) {}
+
+    GLuint name = 0;
+};
+
+typedef GLObject<GLNamePool::Buffers> GLBuffer;
+typedef GLObject<GLNamePool::Textures> GLTexture;
+typedef GLObject<GLNamePool::VertexArrays> GLVertexArray;
+typedef GLObject<GLNamePool::Samplers> GLSampler;
+
+
+// A linked program, which is deleted right away when we're done with it
+class GLProgram
+{
+public:
+    GLProgram() {}
+    ~GLProgram() { Reset(); }
+
+    // Take ownership of a program from glCreateProgram()
+    explicit GLProgram(GLuint program) : program(program) {}
+
+    static GLProgram Create() { return GLProgram(glCreateProgram()); }
+
+    GLProgram(const GLProgram&) = delete;
+    GLProgram& operator=(const GLProgram&) = delete;
+
+    GLProgram(GLProgram&& other) : program(other.program)
+    {
+        other.program = 0;
+    }
+
+    GLProgram& operator=(GLProgram&& other)
+    {
+        if (this != &other) {
+            Reset();
+            program = other.program;
+            other.program = 0;
+        }
+
+        return *this;
+    }
+
+    GLuint ID() const { return program; }
+    explicit operator bool() const { return program != 0; }
+
+    void Reset()
+    {
+        if (program != 0)
+            glDeleteProgram(program);
+
+        program = 0;
+    }
+
+private:
+    GLuint program = 0;
+};
+
+#endif /* GLOBJECT_HPP_ */
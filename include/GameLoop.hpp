@@ -0,0 +1,120 @@
+//============================================================================
+// Name        : GameLoop.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Up to now our demos have advanced their animation and camera
+//               by whatever deltaTime the render loop happened to measure.
+//               That couples the simulation to the frame rate; a heavy
+//               frame makes for a big, jerky simulation step, and a fast
+//               GPU makes us simulate far more often than we need to.
+//
+//               This GameLoop runs the simulation on its own thread at a
+//               fixed tick rate.  Each tick produces a SimulationState,
+//               and the renderer asks for a blend of the two most recent
+//               states based upon how far into the current tick we are.
+//
+//               If the simulation falls behind, it is allowed to catch up
+//               by a limited number of ticks.  Anything beyond that is
+//               dropped so that we don't end up in a 'spiral of death'
+//               where every frame falls further behind.
+//============================================================================
+
+#ifndef GAMELOOP_HPP_
+#define GAMELOOP_HPP_
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+using Eigen::Matrix4f;
+using Eigen::Affine3f;
+
+
+// The simulation hands one of these over to the renderer every tick.
+struct SimulationState
+{
+    uint64_t tick = 0;
+
+    // Transforms that the renderer interpolates between the two most recent
+    // ticks (model transforms, camera views, etc.)
+    std::vector<Affine3f, Eigen::aligned_allocator<Affine3f>> transforms;
+
+    // Matrices that don't make sense to interpolate (projections, etc.)
+    // The renderer just gets the ones from the latest tick.
+    std::vector<Matrix4f, Eigen::aligned_allocator<Matrix4f>> matrices;
+};
+
+
+// Blend two transforms.  Translation and scale are interpolated linearly
+// and the rotation is slerped, so we don't get any shearing in between.
+Affine3f interpolate(const Affine3f& from, const Affine3f& to, float alpha);
+
+
+class GameLoop
+{
+public:
+    typedef std::function<void(SimulationState& state,
+                               float deltaTime)> TickFunction;
+
+    GameLoop(double ticksPerSecond = 60.0, unsigned maxCatchUpTicks = 5);
+    ~GameLoop();
+
+    GameLoop(const GameLoop&) = delete;
+    GameLoop& operator=(const GameLoop&) = delete;
+
+    // These can be changed while the simulation is running.
+    void setTickRate(double ticksPerSecond);
+    void setMaxCatchUpTicks(unsigned maxTicks);
+
+    double TickRate() const;
+    float TickInterval() const;
+
+    // Start ticking from the initial state.  The tick function is only
+    // ever called from the simulation thread.
+    void start(const SimulationState& initialState, TickFunction tick);
+    void stop();
+
+    bool isRunning() const { return running; }
+
+    // Renderer side.  Fills out the state blended between the two latest
+    // ticks for the current point in time.
+    void interpolate(SimulationState& out) const;
+
+    uint64_t TicksRun() const { return ticksRun; }
+    uint64_t TicksDropped() const { return ticksDropped; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void run();
+    void publish(const SimulationState& state);
+
+    std::atomic<int64_t> tickNanoseconds;
+    std::atomic<unsigned> maxCatchUpTicks;
+
+    std::atomic<bool> running {false};
+    std::thread simThread;
+    TickFunction tickFunction;
+
+    // the working copy is only touched by the simulation thread
+    SimulationState working;
+
+    // The two most recent published states, guarded by stateMutex
+    mutable std::mutex stateMutex;
+    SimulationState previous;
+    SimulationState current;
+    Clock::time_point currentTime;
+
+    std::atomic<uint64_t> ticksRun {0};
+    std::atomic<uint64_t> ticksDropped {0};
+};
+
+#endif /* GAMELOOP_HPP_ */
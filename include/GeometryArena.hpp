@@ -0,0 +1,198 @@
+//============================================================================
+// Name        : GeometryArena.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Every mesh in the demos gets a vertex array and two buffers
+//               of its own, so a scene of many small objects is many
+//               buffers, and a vertex array bind for every draw.  A
+//               GeometryArena puts the vertices and indices of lots of
+//               meshes with the same vertex layout into one big vertex
+//               buffer and one big index buffer, with one vertex array over
+//               the both of them:
+//               - Each mesh gets a range of vertices and a range of
+//                 indices, from a RangeAllocator each.  Its indices stay
+//                 the way they are (starting at 0), and are drawn with
+//                 glDrawElementsBaseVertex(), which adds where the mesh's
+//                 vertices start.
+//               - So drawing any number of meshes is one vertex array bind,
+//                 and a draw call each, or a single
+//                 glMultiDrawElementsBaseVertex() for a whole list of them.
+//               - Removing a mesh just gives its ranges back.  When the
+//                 free space gets broken up, Compact() packs the meshes
+//                 together again.  That copies them on the GPU, with
+//                 glCopyBufferSubData(), into new buffers, so the driver
+//                 doesn't have to wait for draws that are still reading the
+//                 old ones.  The handles stay the same.
+//               - When a mesh doesn't fit, the arena compacts, if that
+//                 would make room, or else grows its buffers (the same
+//                 copy, into bigger ones).
+//
+//               The multi-draw uses whatever uniforms are set, so it's for
+//               geometry that is already where it goes in the world (static
+//               level geometry, say).  Meshes that need a transform of
+//               their own are drawn one at a time, which still doesn't bind
+//               anything in between.
+//
+//               Compacting and growing bind the arena's vertex array (and
+//               unbind it), so a StateTracker has to be invalidated after
+//               an Add() or Compact().
+//============================================================================
+
+#ifndef GEOMETRYARENA_HPP_
+#define GEOMETRYARENA_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLObject.hpp"
+#include "Mesh.hpp"
+#include "RangeAllocator.hpp"
+#include "StateTracker.hpp"
+
+
+// One attribute of a vertex, the way glVertexAttribPointer() takes it
+struct VertexAttribute
+{
+    GLuint index;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
+
+// The attributes, and how many bytes a vertex takes
+struct VertexLayout
+{
+    size_t stride;
+    std::vector<VertexAttribute> attributes;
+};
+
+
+class GeometryArena
+{
+public:
+    typedef uint32_t Handle;
+
+    static const Handle InvalidHandle = ~0u;
+
+    // Where a mesh is, in vertices and indices
+    struct Range
+    {
+        size_t firstVertex;
+        size_t numVertices;
+        size_t firstIndex;
+        size_t numIndices;
+    };
+
+    // MeshVertex: position at 0, normal at 1 and texture coordinates at 2
+    static VertexLayout MeshVertexLayout();
+
+    // QuantizedVertex, at the same locations, normalized
+    static VertexLayout QuantizedVertexLayout();
+
+    // The capacities are what the buffers start with, in vertices and
+    // indices
+    explicit GeometryArena(const VertexLayout& layout = MeshVertexLayout(),
+                           size_t vertexCapacity = 65536,
+                           size_t indexCapacity = 196608);
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // The vertices are in the arena's layout, and the indices count from
+    // the first of them.  Returns InvalidHandle if the buffers can't be
+    // made big enough.
+    Handle Add(const void *vertices, size_t numVertices,
+               const uint32_t *indices, size_t numIndices);
+    Handle Add(const Mesh& mesh);
+
+    void Remove(Handle handle);
+    bool Contains(Handle handle) const;
+
+    // Only for handles that are in the arena
+    const Range& RangeOf(Handle handle) const { return meshes[handle]; }
+
+    // Pack the meshes together at the start of the buffers.  Returns how
+    // many bytes got copied.
+    size_t Compact();
+
+    // The worse of the two buffers' (see RangeAllocator::Fragmentation())
+    double Fragmentation() const;
+
+    // Bind the vertex array, before drawing
+    void Bind() const;
+    void Bind(StateTracker& state) const;
+
+    // Draw one mesh, or a list of them with one call, or all of them
+    void Draw(Handle handle, GLenum mode = GL_TRIANGLES) const;
+    void Draw(const Handle *handles, size_t numHandles,
+              GLenum mode = GL_TRIANGLES);
+    void DrawAll(GLenum mode = GL_TRIANGLES);
+
+    const VertexLayout& Layout() const { return layout; }
+
+    GLuint VertexArray() const { return vertexArray.ID(); }
+    GLuint VertexBuffer() const { return vertexBuffer.ID(); }
+    GLuint IndexBuffer() const { return indexBuffer.ID(); }
+
+    // stats
+    size_t NumMeshes() const { return numMeshes; }
+    size_t VertexCapacity() const { return vertexRanges.Capacity(); }
+    size_t IndexCapacity() const { return indexRanges.Capacity(); }
+    size_t VerticesUsed() const { return vertexRanges.Used(); }
+    size_t IndicesUsed() const { return indexRanges.Used(); }
+    size_t Compactions() const { return compactions; }
+    size_t Grows() const { return grows; }
+    size_t BytesCopied() const { return bytesCopied; }
+
+private:
+    // Make sure there's a free range of this size, compacting or growing
+    // if need be
+    bool MakeRoom(RangeAllocator& ranges, size_t size);
+
+    // A new buffer, or an error and false if there's no memory for it
+    bool CreateBuffer(GLBuffer& buffer, size_t bytes);
+
+    // The first keep elements as they are, and then the moves.  Returns
+    // how many bytes that was.
+    size_t CopyRanges(const GLBuffer& from, const GLBuffer& to,
+                      size_t elementSize, size_t keep,
+                      const std::vector<RangeAllocator::Move>& moves);
+
+    // Point the vertex array at the buffers
+    void SetupVertexArray();
+
+    VertexLayout layout;
+
+    GLVertexArray vertexArray;
+    GLBuffer vertexBuffer;
+    GLBuffer indexBuffer;
+
+    RangeAllocator vertexRanges;
+    RangeAllocator indexRanges;
+
+    // By handle.  Removed meshes have no indices, and their handles get
+    // used again.
+    std::vector<Range> meshes;
+    std::vector<Handle> freeHandles;
+    size_t numMeshes = 0;
+
+    // The arrays the multi-draw takes, and the ones for DrawAll(), which
+    // get built again when the meshes change
+    std::vector<GLsizei> counts;
+    std::vector<const void *> offsets;
+    std::vector<GLint> baseVertices;
+    std::vector<Handle> allHandles;
+    bool allChanged = true;
+
+    size_t compactions = 0;
+    size_t grows = 0;
+    size_t bytesCopied = 0;
+};
+
+#endif /* GEOMETRYARENA_HPP_ */
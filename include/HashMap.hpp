@@ -0,0 +1,383 @@
+//============================================================================
+// Name        : HashMap.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : A hash map from 64 bit keys that are already hashes (from
+//               SpookyHash, usually) to values.  std::unordered_map puts
+//               every entry in a node of its own, and every lookup chases a
+//               bucket pointer and then a node pointer, each likely a cache
+//               miss.  This keeps the entries in one flat array instead,
+//               and finds them by open addressing, the way SwissTable does:
+//               - The slots come in groups of 16, and each group has 16
+//                 control bytes, one per slot.  A control byte says the
+//                 slot is empty, or deleted, or holds a key whose low 7
+//                 bits are the byte.
+//               - The rest of a key's bits pick the group we start at.  We
+//                 compare all 16 control bytes with the key's 7 bits at
+//                 once (with SSE2, a compare and a movemask), and only look
+//                 at the keys of the slots that match.  Most of the time
+//                 that's the one slot with the key, or none.
+//               - If the group is full and didn't have it, we go on to the
+//                 next group, skipping 1, 2, 3, ... groups each time.  A
+//                 group with an empty slot ends the search, since an insert
+//                 would have stopped there.
+//
+//               The keys aren't hashed again, so they should already look
+//               random; sequential numbers would all land in group 0.
+//
+//               Erasing a key leaves a deleted marker, unless its group has
+//               an empty slot anyway.  The markers get cleaned up when the
+//               table grows, or when there are enough of them that it gets
+//               rebuilt at the same size.
+//
+//               Pointers to values stay good until the next insert or
+//               erase.
+//============================================================================
+
+#ifndef HASHMAP_HPP_
+#define HASHMAP_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+// The control bytes for one group of slots
+struct alignas(16) HashMapGroup
+{
+    static const size_t Size = 16;
+
+    static const int8_t Empty = -128;
+    static const int8_t Deleted = -2;
+
+    int8_t control[Size];
+
+    // Bit i is set for each slot i whose control byte is 'tag'
+    uint32_t Match(int8_t tag) const
+    {
+#ifdef __SSE2__
+        __m128i bytes = _mm_load_si128((const __m128i *)control);
+        return (uint32_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag)));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < Size; i++)
+            mask |= (uint32_t)(control[i] == tag) << i;
+        return mask;
+#endif
+    }
+
+    uint32_t MatchEmpty() const { return Match(Empty); }
+
+    // Empty or deleted, which are the control bytes with the top bit set
+    uint32_t MatchFree() const
+    {
+#ifdef __SSE2__
+        return (uint32_t)_mm_movemask_epi8(
+            _mm_load_si128((const __m128i *)control));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < Size; i++)
+            mask |= (uint32_t)(control[i] < 0) << i;
+        return mask;
+#endif
+    }
+
+    static int LowestBit(uint32_t mask) { return __builtin_ctz(mask); }
+};
+
+
+template <typename Value>
+class HashMap
+{
+public:
+    HashMap() {}
+    explicit HashMap(size_t count) { Reserve(count); }
+    ~HashMap() { Clear(); }
+
+    HashMap(const HashMap&) = delete;
+    HashMap& operator=(const HashMap&) = delete;
+
+    HashMap(HashMap&& other) { Swap(other); }
+
+    HashMap& operator=(HashMap&& other)
+    {
+        if (this != &other) {
+            Clear();
+            Swap(other);
+        }
+        return *this;
+    }
+
+    size_t Size() const { return size; }
+    bool Empty() const { return size == 0; }
+    size_t Capacity() const { return numGroups * Group::Size; }
+
+    // The value under the key, or null
+    Value *Find(uint64_t key)
+    {
+        size_t slot = FindSlot(key);
+        return slot == NotFound ? nullptr : &slots[slot].Get();
+    }
+
+    const Value *Find(uint64_t key) const
+    {
+        size_t slot = FindSlot(key);
+        return slot == NotFound ? nullptr : &slots[slot].Get();
+    }
+
+    bool Contains(uint64_t key) const { return FindSlot(key) != NotFound; }
+
+    // Put the value under the key, unless the key is already there.  Either
+    // way we get the value that's under it now, and whether it's the one
+    // we just put in.
+    std::pair<Value *, bool> Insert(uint64_t key, const Value& value)
+    {
+        return Emplace(key, value);
+    }
+
+    std::pair<Value *, bool> Insert(uint64_t key, Value&& value)
+    {
+        return Emplace(key, std::move(value));
+    }
+
+    // The value under the key, default constructed if it wasn't there
+    Value& operator[](uint64_t key) { return *Emplace(key).first; }
+
+    // False if the key wasn't there
+    bool Erase(uint64_t key)
+    {
+        size_t slot = FindSlot(key);
+        if (slot == NotFound)
+            return false;
+
+        slots[slot].Get().~Value();
+
+        // If the group has an empty slot, no search ever went past it, so
+        // this one can be empty again too
+        Group& group = groups[slot / Group::Size];
+        if (group.MatchEmpty() != 0) {
+            group.control[slot % Group::Size] = Group::Empty;
+        } else {
+            group.control[slot % Group::Size] = Group::Deleted;
+            deleted++;
+        }
+
+        size--;
+        return true;
+    }
+
+    // Destroys all the values, but keeps the memory
+    void Clear()
+    {
+        ForEachSlot([](Slot& slot) { slot.Get().~Value(); });
+
+        for (size_t g = 0; g < numGroups; g++)
+            std::memset(groups[g].control, Group::Empty, Group::Size);
+
+        size = 0;
+        deleted = 0;
+    }
+
+    // Make room for this many entries without growing again
+    void Reserve(size_t count)
+    {
+        size_t wanted = numGroups != 0 ? numGroups : 1;
+        while (MaxLoad(wanted) < count)
+            wanted *= 2;
+
+        if (wanted != numGroups)
+            Rehash(wanted);
+    }
+
+    // fn(key, value) for every entry, in no particular order
+    template <typename F>
+    void ForEach(const F& fn)
+    {
+        ForEachSlot([&](Slot& slot) { fn(slot.key, slot.Get()); });
+    }
+
+    template <typename F>
+    void ForEach(const F& fn) const
+    {
+        const_cast<HashMap *>(this)->ForEachSlot([&](const Slot& slot) {
+            fn(slot.key, (const Value&)slot.Get());
+        });
+    }
+
+private:
+    typedef HashMapGroup Group;
+
+    static const size_t NotFound = ~(size_t)0;
+
+    struct Slot
+    {
+        uint64_t key;
+        typename std::aligned_storage<sizeof(Value),
+                                      alignof(Value)>::type value;
+
+        Value& Get() { return *reinterpret_cast<Value *>(&value); }
+        const Value& Get() const
+        {
+            return *reinterpret_cast<const Value *>(&value);
+        }
+    };
+
+    static int8_t Tag(uint64_t key) { return (int8_t)(key & 0x7f); }
+
+    // 7/8 of the slots, past which the probes get long
+    static size_t MaxLoad(size_t groups)
+    {
+        return groups * Group::Size / 8 * 7;
+    }
+
+    void Swap(HashMap& other)
+    {
+        std::swap(groups, other.groups);
+        std::swap(slots, other.slots);
+        std::swap(numGroups, other.numGroups);
+        std::swap(size, other.size);
+        std::swap(deleted, other.deleted);
+    }
+
+    size_t FindSlot(uint64_t key) const
+    {
+        if (numGroups == 0)
+            return NotFound;
+
+        size_t mask = numGroups - 1;
+        size_t g = (size_t)(key >> 7) & mask;
+        int8_t tag = Tag(key);
+
+        // Stepping by 1, 2, 3, ... visits every group, since there are a
+        // power of two of them, and the load limit means one has room
+        for (size_t step = 1; ; step++) {
+            const Group& group = groups[g];
+
+            for (uint32_t match = group.Match(tag); match != 0;
+                 match &= match - 1)
+            {
+                size_t slot = g * Group::Size + Group::LowestBit(match);
+                if (slots[slot].key == key)
+                    return slot;
+            }
+
+            if (group.MatchEmpty() != 0)
+                return NotFound;
+
+            g = (g + step) & mask;
+        }
+    }
+
+    // The first empty or deleted slot on the key's probe sequence
+    size_t FindFree(uint64_t key) const
+    {
+        size_t mask = numGroups - 1;
+        size_t g = (size_t)(key >> 7) & mask;
+
+        for (size_t step = 1; ; step++) {
+            uint32_t free = groups[g].MatchFree();
+            if (free != 0)
+                return g * Group::Size + Group::LowestBit(free);
+
+            g = (g + step) & mask;
+        }
+    }
+
+    template <typename... Args>
+    std::pair<Value *, bool> Emplace(uint64_t key, Args&&... args)
+    {
+        size_t slot = FindSlot(key);
+        if (slot != NotFound)
+            return std::make_pair(&slots[slot].Get(), false);
+
+        // Deleted slots count against the load, since they don't end a
+        // search.  If it's mostly them, rebuilding at the same size is
+        // enough.
+        if (size + deleted + 1 > MaxLoad(numGroups)) {
+            if (numGroups == 0)
+                Rehash(1);
+            else if (size + 1 > MaxLoad(numGroups) / 2)
+                Rehash(numGroups * 2);
+            else
+                Rehash(numGroups);
+        }
+
+        slot = FindFree(key);
+
+        int8_t& control = groups[slot / Group::Size].control[
+            slot % Group::Size];
+        if (control == Group::Deleted)
+            deleted--;
+
+        new (&slots[slot].value) Value(std::forward<Args>(args)...);
+        slots[slot].key = key;
+        control = Tag(key);
+        size++;
+
+        return std::make_pair(&slots[slot].Get(), true);
+    }
+
+    void Rehash(size_t newGroups)
+    {
+        std::unique_ptr<Group[]> oldGroups(std::move(groups));
+        std::unique_ptr<Slot[]> oldSlots(std::move(slots));
+        size_t oldNumGroups = numGroups;
+
+        groups.reset(new Group[newGroups]);
+        slots.reset(new Slot[newGroups * Group::Size]);
+        numGroups = newGroups;
+
+        for (size_t g = 0; g < numGroups; g++)
+            std::memset(groups[g].control, Group::Empty, Group::Size);
+
+        deleted = 0;
+
+        for (size_t g = 0; g < oldNumGroups; g++) {
+            for (uint32_t full = ~oldGroups[g].MatchFree() & 0xffff;
+                 full != 0; full &= full - 1)
+            {
+                Slot& from = oldSlots[g * Group::Size +
+                                      Group::LowestBit(full)];
+                size_t slot = FindFree(from.key);
+
+                new (&slots[slot].value) Value(std::move(from.Get()));
+                slots[slot].key = from.key;
+                groups[slot / Group::Size].control[slot % Group::Size] =
+                    Tag(from.key);
+
+                from.Get().~Value();
+            }
+        }
+    }
+
+    template <typename F>
+    void ForEachSlot(const F& fn)
+    {
+        for (size_t g = 0; g < numGroups; g++) {
+            for (uint32_t full = ~groups[g].MatchFree() & 0xffff;
+                 full != 0; full &= full - 1)
+                fn(slots[g * Group::Size + Group::LowestBit(full)]);
+        }
+    }
+
+    std::unique_ptr<Group[]> groups;
+    std::unique_ptr<Slot[]> slots;
+    size_t numGroups = 0;
+    size_t size = 0;
+    size_t deleted = 0;
+};
+
+template <typename Value>
+const size_t HashMap<Value>::NotFound;
+
+#endif /* HASHMAP_HPP_ */
@@ -0,0 +1,147 @@
+//============================================================================
+// Name        : ImageDecoder.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : SOIL decodes an image on the calling thread, always into
+//               RGB, and into a buffer of its own, which we then copy into
+//               the 4 byte layout GL wants.
+//
+//               The ImageDecoder uses libjpeg and libpng directly instead,
+//               and decodes JPEG and PNG files straight into memory the
+//               caller hands it (a mapped pixel buffer, say), in the layout
+//               the caller wants:
+//               - DecodeBatch() decodes a lot of images at once, one per
+//                 job on a JobSystem.
+//               - A big JPEG with restart markers at the ends of its MCU
+//                 rows gets cut into bands at the markers, and the bands
+//                 get decoded in parallel.  Each band is decoded with an
+//                 extra MCU row above and below it, so the chroma
+//                 upsampling comes out the same as it would in one piece.
+//               - The images we decode into our own memory come out of an
+//                 ImageBufferPool, if we have one, and go back to it with
+//                 Release().
+//
+//               Anything that isn't a JPEG or a PNG is left to SOIL.
+//============================================================================
+
+#ifndef IMAGEDECODER_HPP_
+#define IMAGEDECODER_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <mutex>
+
+#include "JobSystem.hpp"
+
+
+// Pixel buffers to decode into, kept for the next image instead of being
+// freed.  Any thread can use it.
+class ImageBufferPool
+{
+public:
+    static const size_t DefaultMaxBuffers = 16;
+
+    explicit ImageBufferPool(size_t maxBuffers = DefaultMaxBuffers)
+        : maxBuffers(maxBuffers) {}
+
+    ImageBufferPool(const ImageBufferPool&) = delete;
+    ImageBufferPool& operator=(const ImageBufferPool&) = delete;
+
+    // A buffer of 'size' bytes, which is the smallest one we have that's
+    // big enough, or a new one.  What's in it is left over.
+    std::vector<unsigned char> Acquire(size_t size);
+
+    // Keep it, unless we have enough already
+    void Release(std::vector<unsigned char>&& buffer);
+
+    size_t NumFree() const;
+
+    // Acquire()s that got a buffer we had, and ones that didn't
+    size_t Hits() const { return hits; }
+    size_t Misses() const { return misses; }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<std::vector<unsigned char>> buffers;
+    size_t maxBuffers;
+
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+
+class ImageDecoder
+{
+public:
+    enum Format { Unknown, JPEG, PNG };
+
+    // The pixels we decode to
+    enum Layout { RGB, RGBA, BGRA };
+
+    struct Info
+    {
+        Format format = Unknown;
+        int width = 0;
+        int height = 0;
+    };
+
+    struct Image
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> pixels;  // tightly packed rows
+    };
+
+    // One image for DecodeBatch()
+    struct Request
+    {
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+
+        Image image;
+        bool decoded = false;
+    };
+
+    // JPEGs shorter than this aren't worth cutting up
+    static const int MinSplitRows = 256;
+
+    // With no JobSystem, everything happens on the calling thread.  The
+    // jobs and the pool have to outlive us.
+    explicit ImageDecoder(JobSystem *jobs = nullptr,
+                          ImageBufferPool *pool = nullptr)
+        : jobs(jobs), pool(pool) {}
+
+    // What the file is, from its first few bytes
+    static Format Identify(const unsigned char *data, size_t size);
+
+    // Its size, without decoding it.  False if it isn't something we can
+    // decode.
+    static bool ReadInfo(const unsigned char *data, size_t size, Info& info);
+
+    static int BytesPerPixel(Layout layout) { return layout == RGB ? 3 : 4; }
+
+    // Decode into the caller's memory, with rows 'stride' bytes apart.
+    // There has to be room for the height ReadInfo() gives.
+    bool Decode(const unsigned char *data, size_t size, Layout layout,
+                unsigned char *pixels, size_t stride) const;
+
+    // Or into an image of our own, out of the pool if we have one
+    bool Decode(const unsigned char *data, size_t size, Layout layout,
+                Image& image) const;
+
+    // Decode all of them, as many at a time as we have threads
+    void DecodeBatch(std::vector<Request>& requests, Layout layout) const;
+
+    // Give the image's pixels back to the pool
+    void Release(Image& image) const;
+
+private:
+    bool DecodeJPEG(const unsigned char *data, size_t size, Layout layout,
+                    unsigned char *pixels, size_t stride) const;
+
+    JobSystem *jobs;
+    ImageBufferPool *pool;
+};
+
+#endif /* IMAGEDECODER_HPP_ */
@@ -0,0 +1,197 @@
+//============================================================================
+// Name        : IndirectRenderer.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : With a GeometryArena the draws are cheap, but the CPU still
+//               goes through every object each frame to work out whether
+//               it's on the screen and to issue its draw.  The
+//               IndirectRenderer hands all of that to the GPU:
+//               - Every object (a mesh in the arena, its bounding box, and
+//                 its model matrix) lives in a shader storage buffer.
+//               - Cull() runs a compute shader with a thread per object,
+//                 which tests the object's box against the Camera's
+//                 frustum and writes a DrawElementsIndirectCommand for it
+//                 into a second buffer: the mesh's ranges, and one
+//                 instance if it's visible, or none if it isn't.
+//               - Draw() is then a single glMultiDrawElementsIndirect()
+//                 over those commands.  Nothing comes back to the CPU.
+//
+//               Each command's baseInstance is its object's index, and our
+//               vertex array has an instanced attribute holding 0, 1, 2,
+//               ..., so the vertex shader gets the object's index as an
+//               input, and reads its matrix out of the storage buffer:
+//
+//                   layout(location = 3) in uint objectIndex;
+//                   ...objects[objectIndex].model...
+//
+//               (see data/glsl/IndirectVertexShader.glsl for the rest).
+//
+//               Without compute shaders (or with SetCullMode(CpuCull)),
+//               the culling runs on the CPU instead, which writes the same
+//               commands and uploads them, and the draw is the same.  The
+//               CPU path also counts the visible objects, which the GPU
+//               path can't without reading the commands back.
+//
+//               This needs shader storage buffers and multi-draw indirect,
+//               which is GL 4.3.  Cull() uses a program of its own, and
+//               Draw() binds a vertex array, so a StateTracker has to be
+//               invalidated after them.
+//============================================================================
+
+#ifndef INDIRECTRENDERER_HPP_
+#define INDIRECTRENDERER_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <Eigen/Dense>
+
+using Eigen::Matrix4f;
+using Eigen::Vector4f;
+
+#include "Camera.hpp"
+#include "GLObject.hpp"
+#include "GeometryArena.hpp"
+
+
+// What glMultiDrawElementsIndirect() reads for each draw
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+
+// An object, laid out the way the shaders see it (std430)
+struct IndirectObject
+{
+    float model[16];        // column major
+    float boundsMin[4];     // the mesh's box, the last one is padding
+    float boundsMax[4];
+    GLuint count;           // the mesh's ranges in the arena
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint padding;
+};
+
+
+class IndirectRenderer
+{
+public:
+    enum CullMode { GpuCull, CpuCull };
+
+    typedef uint32_t Object;
+
+    // Where the shaders find things
+    static const GLuint ObjectBinding = 0;
+    static const GLuint CommandBinding = 1;
+    static const GLuint ObjectIndexAttribute = 3;
+
+    // The threads in a compute shader work group
+    static const GLuint GroupSize = 64;
+
+    // Whether the driver can do this at all, and whether it can cull on
+    // the GPU
+    static bool Supported();
+    static bool ComputeSupported();
+
+    // The arena has to outlive us.  We cull on the GPU if we can.  If the
+    // driver isn't Supported(), we aren't IsValid(), and Cull() and Draw()
+    // do nothing; the objects have to be drawn some other way.
+    explicit IndirectRenderer(GeometryArena& arena);
+
+    IndirectRenderer(const IndirectRenderer&) = delete;
+    IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+    bool IsValid() const { return valid; }
+
+    // An object that draws a mesh of the arena, whose vertices are inside
+    // the box, with a model matrix
+    Object Add(GeometryArena::Handle mesh,
+               const float boundsMin[3], const float boundsMax[3],
+               const Matrix4f& model = Matrix4f::Identity());
+
+    void SetTransform(Object object, const Matrix4f& model);
+
+    void Clear();
+
+    // Falls back to CpuCull if we can't cull on the GPU
+    void SetCullMode(CullMode mode);
+    CullMode Mode() const { return mode; }
+
+    // Work out what's visible, and write the commands.  Adding meshes to
+    // the arena, or compacting it, can move the meshes, so cull again
+    // after that before drawing.
+    void Cull(Camera& camera);
+    void Cull(const Vector4f planes[6]);
+
+    // Draw what the last Cull() found, with whatever program is in use
+    void Draw(GLenum mode = GL_TRIANGLES);
+
+    // The commands the last Cull() wrote, read back from the GPU
+    std::vector<DrawElementsIndirectCommand> ReadCommands() const;
+
+    size_t NumObjects() const { return objects.size(); }
+
+    // Only counted when culling on the CPU
+    size_t NumVisible() const { return numVisible; }
+
+    // The arena's vertices and indices, and the object index, for drawing
+    // objects one at a time with glDrawElementsInstancedBaseVertex-
+    // BaseInstance() (good as of the last Cull())
+    GLuint VertexArray() const { return vertexArray.ID(); }
+
+    GLuint ObjectBuffer() const { return objectBuffer.ID(); }
+    GLuint CommandBuffer() const { return commandBuffer.ID(); }
+
+private:
+    // The arena moved its meshes or its buffers, or we have new objects
+    void Update();
+
+    // Point our vertex array at the arena's buffers, and ours
+    void SetupVertexArray();
+
+    bool BuildCullProgram();
+
+    void CullCpu(const Vector4f planes[6]);
+    void CullGpu(const Vector4f planes[6]);
+
+    GeometryArena& arena;
+    CullMode mode;
+    bool valid = false;
+
+    std::vector<IndirectObject> objects;
+    std::vector<GeometryArena::Handle> meshes;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    GLVertexArray vertexArray;
+    GLBuffer objectBuffer;
+    GLBuffer commandBuffer;
+    GLBuffer objectIndexBuffer;
+    size_t capacity = 0;
+
+    GLProgram cullProgram;
+    GLint planesLocation = -1;
+    GLint numObjectsLocation = -1;
+
+    // What we last saw of the arena, to know when it changed
+    size_t arenaCompactions = ~(size_t)0;
+    size_t arenaGrows = ~(size_t)0;
+
+    // The objects in [firstDirty, lastDirty) have to be uploaded
+    size_t firstDirty = 0;
+    size_t lastDirty = 0;
+
+    // How many objects the last Cull() wrote commands for
+    size_t numCommands = 0;
+    size_t numVisible = 0;
+};
+
+#endif /* INDIRECTRENDERER_HPP_ */
@@ -0,0 +1,232 @@
+//============================================================================
+// Name        : JobSystem.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Everything we have built so far runs on a single thread.
+//               This is a general purpose work-stealing job system that the
+//               rest of the libraries can use to fan out work across cores.
+//
+//               Each worker thread owns a Chase-Lev deque.  The owner
+//               pushes and pops jobs at the bottom, and idle workers steal
+//               from the top of somebody else's deque.  The thread that
+//               constructs the JobSystem is worker 0, and when it waits on
+//               a job it helps out by running jobs instead of blocking.
+//
+//               Jobs can be created as children of another job.  A parent
+//               job is not finished until all of its children are finished,
+//               so waiting on the parent waits on the whole tree.
+//
+//               Jobs come out of a per-thread ring buffer, so no more than
+//               MaxJobsPerThread jobs created by a thread should be in
+//               flight at one time.
+//
+//               Threads other than the workers can create, run and wait on
+//               jobs too.  They just go through a shared (locked) queue.
+//============================================================================
+
+#ifndef JOBSYSTEM_HPP_
+#define JOBSYSTEM_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+
+struct Job;
+
+typedef void (*JobFunction)(Job *job, void *data);
+
+
+// We size this so that a job is two cache lines, and the rest goes
+// to the data (usually a lambda's captures)
+struct Job
+{
+    static const size_t DataSize = 96;
+
+    JobFunction function;
+    Job *parent;
+    std::atomic<int32_t> unfinishedJobs;
+
+    alignas(16) unsigned char data[DataSize];
+};
+
+
+// Lock-free work-stealing deque (Chase & Lev, with the memory ordering
+// from Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+// Models").  Only the owning thread may Push() and Pop().
+// Any thread may Steal().
+class WorkStealingQueue
+{
+public:
+    static const size_t Capacity = 4096;  // must be a power of 2
+
+    WorkStealingQueue();
+
+    bool Push(Job *job);  // false if the queue is full
+    Job *Pop();
+    Job *Steal();
+
+    size_t Size() const;
+
+private:
+    static const size_t Mask = Capacity - 1;
+
+    // keep the thieves' end and the owner's end on separate cache lines
+    std::atomic<int64_t> top;
+    char topPadding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> bottom;
+    char bottomPadding[64 - sizeof(std::atomic<int64_t>)];
+
+    std::atomic<Job *> jobs[Capacity];
+};
+
+
+class JobSystem
+{
+public:
+    static const size_t MaxJobsPerThread = 4096;  // must be a power of 2
+
+    // numThreads includes the calling thread.  0 means one per core.
+    explicit JobSystem(unsigned numThreads = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned NumThreads() const { return (unsigned)workers.size(); }
+
+    // The worker index of the calling thread, or -1 if it is not one
+    // of our workers.
+    int WorkerIndex() const;
+
+    Job *CreateJob(JobFunction function, Job *parent = nullptr);
+
+    // Create a job out of a callable taking a (Job *).  The callable is
+    // copied into the job's data, so it needs to fit.
+    template <typename F>
+    Job *CreateJob(const F& f, Job *parent = nullptr)
+    {
+        static_assert(sizeof(F) <= Job::DataSize,
+                      "JobSystem::CreateJob(): callable is too big");
+        static_assert(std::alignment_of<F>::value <= 16,
+                      "JobSystem::CreateJob(): callable is over-aligned");
+
+        Job *job = CreateJob(&InvokeCallable<F>, parent);
+        new (job->data) F(f);
+
+        return job;
+    }
+
+    void Run(Job *job);
+
+    // Wait for a job (and its children) to finish.  The calling thread
+    // runs other jobs in the meantime.
+    void Wait(const Job *job);
+
+    bool IsFinished(const Job *job) const
+    {
+        return job->unfinishedJobs.load(std::memory_order_acquire) == 0;
+    }
+
+    // Call fn(begin, end) over sub-ranges of [begin, end) that are no
+    // bigger than grainSize, and wait for them all.  A grainSize of 0
+    // picks one that gives each thread a few ranges to balance with.
+    template <typename F>
+    void ParallelFor(size_t begin, size_t end, size_t grainSize, const F& fn)
+    {
+        if (end <= begin)
+            return;
+
+        if (grainSize == 0)
+            grainSize = std::max<size_t>((end - begin) / (NumThreads() * 4),
+                                         1);
+
+        ParallelForJob<F> range = {this, &fn, begin, end, grainSize};
+        Job *root = CreateJob(range);
+
+        Run(root);
+        Wait(root);
+    }
+
+private:
+    struct Worker
+    {
+        WorkStealingQueue queue;
+
+        Job *jobPool = nullptr;
+        size_t allocated = 0;
+
+        uint32_t randomState = 0;
+        std::thread thread;
+    };
+
+    template <typename F>
+    static void InvokeCallable(Job *job, void *data)
+    {
+        F *f = static_cast<F *>(data);
+
+        (*f)(job);
+        f->~F();
+    }
+
+    // Each range job peels off the upper half as a child job until it
+    // is down to the grain size, so thieves always grab the big pieces.
+    template <typename F>
+    struct ParallelForJob
+    {
+        JobSystem *system;
+        const F *fn;
+        size_t begin;
+        size_t end;
+        size_t grainSize;
+
+        void operator()(Job *job) const
+        {
+            size_t b = begin;
+            size_t e = end;
+
+            while (e - b > grainSize) {
+                size_t mid = b + (e - b) / 2;
+
+                ParallelForJob upper = {system, fn, mid, e, grainSize};
+                system->Run(system->CreateJob(upper, job));
+
+                e = mid;
+            }
+
+            (*fn)(b, e);
+        }
+    };
+
+    void WorkerLoop(unsigned index);
+
+    Job *GetJob();
+    void Execute(Job *job);
+    void Finish(Job *job);
+
+    std::vector<Worker *> workers;
+
+    // Jobs from threads that aren't workers go through here
+    std::mutex sharedMutex;
+    std::deque<Job *> sharedQueue;
+    std::atomic<size_t> sharedQueued {0};
+    Job *sharedPool = nullptr;
+    size_t sharedAllocated = 0;
+
+    // Idle workers go to sleep until there is something to do
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::atomic<int> pendingJobs {0};
+    std::atomic<int> sleepingWorkers {0};
+    std::atomic<bool> running {true};
+};
+
+#endif /* JOBSYSTEM_HPP_ */
@@ -0,0 +1,120 @@
+//============================================================================
+// Name        : LodSelector.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Picks a level of detail for every object each frame, out of
+//               the levels a LodMesh made.  A level's error is a distance
+//               in world space; how big that is on the screen depends on
+//               how far away the object is:
+//
+//                   pixels = error * projection(1,1) * viewportHeight / 2
+//                            / distance
+//
+//               where projection(1,1) is the Camera's 1 / tan(fov / 2),
+//               and the distance is to the nearest point of the object's
+//               bounding sphere.  We pick the coarsest level whose error
+//               is within the threshold (a pixel, by default).
+//
+//               An object right at the distance where two levels switch
+//               would flicker between them as the camera moves a little,
+//               so there's hysteresis: an object only goes to a finer
+//               level when it has to, and only goes coarser when that
+//               level's error is within threshold * (1 - hysteresis).  In
+//               between, it keeps the level it had.
+//
+//               The objects are kept as arrays of each of their numbers,
+//               and Select() does 8 of them at a time with AVX (or 4 with
+//               SSE2).  The comparisons are done as error * scale <=
+//               threshold * distance, so there's no division, and a level
+//               is just the count of the levels that pass.  SelectScalar()
+//               does the same one at a time, to check and time it against.
+//
+//               Like the OcclusionCuller, none of this touches OpenGL.
+//============================================================================
+
+#ifndef LODSELECTOR_HPP_
+#define LODSELECTOR_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Dense>
+
+using Eigen::Matrix4f;
+using Eigen::Vector3f;
+
+#include "Camera.hpp"
+#include "MeshLod.hpp"
+
+
+class LodSelector
+{
+public:
+    typedef uint32_t Object;
+
+    static const size_t MaxLevels = LodMesh::MaxLevels;
+
+    // The objects are done in batches of this many
+    static const size_t BatchSize = 8;
+
+    // threshold is in pixels, hysteresis a fraction of it
+    explicit LodSelector(float threshold = 1.0f, float hysteresis = 0.25f);
+
+    // An object with a bounding sphere, and its levels' errors (which
+    // must not go down), in world space
+    Object Add(const Vector3f& center, float radius,
+               const float *errors, size_t numLevels);
+
+    // An object drawing this mesh with this model matrix.  The errors and
+    // the radius grow with the largest scale in the matrix.
+    Object Add(const LodMesh& mesh, const Matrix4f& model);
+
+    void Clear();
+
+    // Everything starts over at level 0 after this
+    void SetThreshold(float threshold, float hysteresis);
+    float Threshold() const { return threshold; }
+    float Hysteresis() const { return hysteresis; }
+
+    // Pick the levels for this view
+    void Select(Camera& camera, float viewportHeight);
+    void Select(const Vector3f& eye, float projectionScale);
+
+    // The same, without SIMD
+    void SelectScalar(const Vector3f& eye, float projectionScale);
+
+    // projection(1,1) * viewportHeight / 2
+    static float ProjectionScale(Camera& camera, float viewportHeight);
+
+    size_t NumObjects() const { return numObjects; }
+
+    // What the last Select() picked
+    int Level(Object object) const { return levels[object]; }
+    const int32_t *Levels() const { return levels.data(); }
+
+    // How many objects went to a different level in the last Select()
+    size_t NumChanged() const { return numChanged; }
+
+private:
+    // Make room for one more object, in whole batches
+    void Grow();
+
+    float threshold;
+    float hysteresis;
+
+    size_t numObjects = 0;
+
+    // One entry per object, padded to a whole batch
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+    std::vector<float> errors[MaxLevels - 1];   // for levels 1 and up
+    std::vector<int32_t> levels;
+
+    size_t numChanged = 0;
+};
+
+#endif /* LODSELECTOR_HPP_ */
@@ -0,0 +1,47 @@
+//============================================================================
+// Name        : MappedFile.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : A read-only memory mapped file.  Instead of reading a file
+//               into a buffer of our own, we let the kernel page it in as
+//               we touch it.  The mapping goes away with the object.
+//============================================================================
+
+#ifndef MAPPEDFILE_HPP_
+#define MAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <string>
+
+
+class MappedFile
+{
+public:
+    MappedFile() {}
+    explicit MappedFile(const std::string& path) { Open(path); }
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other);
+    MappedFile& operator=(MappedFile&& other);
+
+    // Map the whole file.  Any previous mapping is closed first.
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return data != nullptr; }
+
+    const unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+    const std::string& Path() const { return path; }
+
+private:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    std::string path;
+};
+
+#endif /* MAPPEDFILE_HPP_ */
@@ -0,0 +1,93 @@
+//============================================================================
+// Name        : Mesh.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : An indexed triangle mesh, with the vertices laid out the way
+//               they go into a vertex buffer: position, normal and texture
+//               coordinates, 32 bytes a vertex, and 32 bit indices.
+//
+//               The arrays are either the mesh's own, or a piece of a
+//               memory mapped mesh cache (see MeshLoader), in which case
+//               nothing got copied or parsed to get them, and they can go
+//               straight to glBufferData().  Either way we only hand out
+//               const pointers.
+//
+//               Meshes can't be copied, only moved, so they can be shared
+//               through a ResourceRegistry<Mesh> like the other resources.
+//============================================================================
+
+#ifndef MESH_HPP_
+#define MESH_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+
+struct MeshVertex
+{
+    float position[3];
+    float normal[3];
+    float texCoord[2];
+};
+
+
+class Mesh
+{
+public:
+    Mesh() {}
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    Mesh(Mesh&& other);
+    Mesh& operator=(Mesh&& other);
+
+    // Take over these arrays, and work out the bounds
+    void Assign(std::vector<MeshVertex>&& vertices,
+                std::vector<uint32_t>&& indices);
+
+    // Point at arrays inside a mapped file, which we keep open
+    void Assign(MappedFile&& file,
+                const MeshVertex *vertices, size_t numVertices,
+                const uint32_t *indices, size_t numIndices,
+                const float boundsMin[3], const float boundsMax[3]);
+
+    void Clear();
+
+    const MeshVertex *Vertices() const { return vertices; }
+    const uint32_t *Indices() const { return indices; }
+
+    size_t NumVertices() const { return numVertices; }
+    size_t NumIndices() const { return numIndices; }
+    size_t NumTriangles() const { return numIndices / 3; }
+
+    size_t VertexBytes() const { return numVertices * sizeof(MeshVertex); }
+    size_t IndexBytes() const { return numIndices * sizeof(uint32_t); }
+
+    // The box around all the vertices' positions
+    const float *BoundsMin() const { return boundsMin; }
+    const float *BoundsMax() const { return boundsMax; }
+
+    bool IsMapped() const { return file.IsOpen(); }
+
+private:
+    void Take(Mesh& other);
+
+    std::vector<MeshVertex> vertexStorage;
+    std::vector<uint32_t> indexStorage;
+    MappedFile file;
+
+    const MeshVertex *vertices = nullptr;
+    const uint32_t *indices = nullptr;
+    size_t numVertices = 0;
+    size_t numIndices = 0;
+
+    float boundsMin[3] = {0, 0, 0};
+    float boundsMax[3] = {0, 0, 0};
+};
+
+#endif /* MESH_HPP_ */
@@ -0,0 +1,134 @@
+//============================================================================
+// Name        : MeshLoader.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Loads meshes from Wavefront OBJ files and binary glTF
+//               (.glb) files into indexed Meshes, and cooks them into a
+//               binary cache so the next load doesn't parse anything.
+//
+//               OBJ is text, and big scenes are hundreds of megabytes of
+//               it, so the parse is spread over a JobSystem:
+//               - The file is memory mapped and cut into one piece per job,
+//                 each starting at the beginning of a line.
+//               - Each job parses its lines into its own arrays of
+//                 positions, texture coordinates, normals and triangle
+//                 corners.  Polygons get fanned into triangles.
+//               - Once we know how many of each the earlier pieces had, the
+//                 corners' indices get made global (OBJ's negative indices
+//                 count back from the corner's line, so they can only be
+//                 resolved then).
+//               - Last, the distinct position/texcoord/normal combinations
+//                 become the vertices, found with a HashMap, and the
+//                 corners become indices to them.
+//
+//               From a .glb we take every triangle primitive of every mesh,
+//               with its POSITION, NORMAL and TEXCOORD_0 attributes (floats)
+//               and its indices, into one Mesh.  Node transforms aren't
+//               applied, and everything else in the file is ignored.
+//
+//               Vertices without a normal get the average of the normals of
+//               their triangles.
+//
+//               With SetOptimize(), loaded meshes go through OptimizeMesh()
+//               before they get cooked, so the cache has them in vertex
+//               cache order, and the cost is only paid once.
+//
+//               The cache sits next to the source file, with ".meshcache"
+//               added to its name:
+//               - A 128 byte header, which records the source file's size
+//                 and modification time, and whether the mesh was
+//                 optimized, so a stale cache gets cooked again
+//               - The vertices, starting on a 64 byte boundary
+//               - The indices, starting on a 64 byte boundary
+//               Loading from it is a memory map, and the Mesh points into
+//               the mapping.
+//============================================================================
+
+#ifndef MESHLOADER_HPP_
+#define MESHLOADER_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "JobSystem.hpp"
+#include "Mesh.hpp"
+
+
+struct MeshCacheHeader
+{
+    static const uint32_t Magic = 0x4853454d;  // "MESH"
+    static const uint32_t Version = 2;
+
+    enum Flags { Optimized = 1 };
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t indexSize;
+    uint64_t numVertices;
+    uint64_t numIndices;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t fileSize;
+    uint64_t sourceSize;
+    int64_t sourceTime;     // nanoseconds since the epoch
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t padding[3];
+};
+
+
+class MeshLoader
+{
+public:
+    enum Format { Unknown, Obj, Glb };
+
+    static const size_t Alignment = 64;
+
+    // With no JobSystem, OBJ files get parsed on the calling thread.  The
+    // jobs have to outlive us.
+    explicit MeshLoader(JobSystem *jobs = nullptr) : jobs(jobs) {}
+
+    // From the cache, if there's one that's up to date.  Otherwise from
+    // the file itself, and then we write the cache for next time (if we
+    // can't, we still have the mesh).
+    bool Load(const std::string& path, Mesh& mesh);
+
+    // From the file itself, no cache either way
+    bool Import(const std::string& path, Mesh& mesh) const;
+
+    bool ParseObj(const char *text, size_t size, Mesh& mesh) const;
+    bool ParseGlb(const unsigned char *data, size_t size, Mesh& mesh) const;
+
+    // Optimize what Load() and Import() load
+    void SetOptimize(bool enable) { optimize = enable; }
+    bool Optimize() const { return optimize; }
+
+    // Did the last Load() come from the cache?
+    bool LoadedFromCache() const { return fromCache; }
+
+    // By the file's extension
+    static Format FormatOf(const std::string& path);
+
+    static std::string CachePath(const std::string& path);
+
+    // The source's size and time, and the flags, go in the header, and
+    // ReadCache() only takes a cache whose header has the same ones
+    static bool WriteCache(const std::string& cachePath, const Mesh& mesh,
+                           uint64_t sourceSize, int64_t sourceTime,
+                           uint32_t flags = 0);
+    static bool ReadCache(const std::string& cachePath, Mesh& mesh,
+                          uint64_t sourceSize, int64_t sourceTime,
+                          uint32_t flags = 0);
+
+private:
+    JobSystem *jobs;
+    bool optimize = false;
+    bool fromCache = false;
+};
+
+#endif /* MESHLOADER_HPP_ */
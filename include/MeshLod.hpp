@@ -0,0 +1,106 @@
+//============================================================================
+// Name        : MeshLod.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : A mesh far enough away covers a few pixels, and drawing all
+//               of its triangles there is a waste.  These make coarser
+//               versions of a mesh ahead of time, so that something like
+//               the LodSelector can swap them in by distance:
+//               - SimplifyMesh() takes triangles away with Garland and
+//                 Heckbert's quadric edge collapse.  Every vertex gets a
+//                 quadric, the sum of the squared distances to the planes
+//                 of the triangles around it (weighted by area), and each
+//                 step moves a vertex onto a neighbour where that adds the
+//                 least error.  The collapses only ever move a vertex onto
+//                 one that's already there, so the simplified indices still
+//                 point into the original vertices.
+//               - A LodMesh runs that a few times, each level aiming for a
+//                 fraction of the triangles of the one before, and keeps
+//                 all the levels' indices one after the other in one Mesh
+//                 with the original vertices.  Drawn out of a GeometryArena,
+//                 a level is just a different range of indices.
+//
+//               The error of a level is how far its surface is from the
+//               original, in the mesh's units (an area weighted RMS of the
+//               distances to the original planes, the worst of any of its
+//               collapses), which is what gets projected onto the screen to
+//               pick one.  The errors go up with the levels.
+//
+//               Vertices where the positions are shared by more than one
+//               vertex (seams, where the normals or texture coordinates
+//               split), or on a border or a non-manifold edge, are never
+//               moved, so a level has no cracks that the original didn't.
+//               A mesh with a lot of those won't simplify as far.
+//============================================================================
+
+#ifndef MESHLOD_HPP_
+#define MESHLOD_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.hpp"
+
+
+// Simplify the triangles in place, until there are at most targetIndices
+// indices, or the next collapse would be worse than maxError.  Returns how
+// many indices are left, which are at the front.  resultError, if given,
+// gets the error of the worst collapse we made.
+size_t SimplifyMesh(uint32_t *indices, size_t numIndices,
+                    const MeshVertex *vertices, size_t numVertices,
+                    size_t targetIndices, float maxError,
+                    float *resultError = nullptr);
+
+
+// Where a level's indices are in the LodMesh's mesh
+struct LodLevel
+{
+    size_t firstIndex;
+    size_t numIndices;
+    float error;
+};
+
+
+class LodMesh
+{
+public:
+    static const size_t MaxLevels = 8;
+
+    LodMesh() {}
+
+    LodMesh(const LodMesh&) = delete;
+    LodMesh& operator=(const LodMesh&) = delete;
+
+    LodMesh(LodMesh&& other) = default;
+    LodMesh& operator=(LodMesh&& other) = default;
+
+    // Level 0 is the mesh itself.  Each level after that aims for ratio of
+    // the triangles of the one before; we stop at maxLevels, or when a
+    // level doesn't get close to that, or when its error would be more
+    // than maxError.  The levels' indices are put in vertex cache order.
+    void Build(const Mesh& source, size_t maxLevels = MaxLevels,
+               float ratio = 0.5f, float maxError = 1e30f);
+
+    void Clear();
+
+    // The original vertices, and all the levels' indices
+    const Mesh& Geometry() const { return mesh; }
+
+    size_t NumLevels() const { return levels.size(); }
+    const LodLevel& Level(size_t level) const { return levels[level]; }
+
+    // A sphere around all the vertices
+    const float *Center() const { return center; }
+    float Radius() const { return radius; }
+
+private:
+    Mesh mesh;
+    std::vector<LodLevel> levels;
+
+    float center[3] = {0, 0, 0};
+    float radius = 0;
+};
+
+#endif /* MESHLOD_HPP_ */
@@ -0,0 +1,124 @@
+//============================================================================
+// Name        : MeshOptimizer.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : The triangles of a mesh come out of an exporter (or our
+//               MeshLoader) in whatever order they were modelled in, and
+//               every attribute is a 32 bit float.  These put a mesh in
+//               the order the GPU would like to draw it, and squeeze its
+//               vertices down:
+//               - OptimizeVertexCache() orders the triangles so that they
+//                 reuse the vertices the GPU has just transformed, with Tom
+//                 Forsyth's "Linear-Speed Vertex Cache Optimisation".  Each
+//                 vertex gets a score from where it is in a simulated LRU
+//                 cache and how many triangles still need it, and the next
+//                 triangle is always the best scoring one.
+//               - OptimizeOverdraw() then cuts that order into clusters,
+//                 wherever the cache starts over (or nearly), and sorts the
+//                 clusters so the ones facing out from the middle of the
+//                 mesh get drawn first, and hide what's behind them.  The
+//                 threshold says how much worse than the cache order we're
+//                 willing to get for that; 1.05 is 5%.
+//               - OptimizeVertexFetch() renumbers the vertices in the order
+//                 the triangles first use them, so the vertex fetches walk
+//                 through memory instead of around it.  Vertices no
+//                 triangle uses are dropped.
+//               - A QuantizedMesh stores positions and texture coordinates
+//                 as 16 bit normalized integers across their bounds, and
+//                 normals as 8 bit signed normalized ones, which is 16
+//                 bytes a vertex instead of 32.  Indices are 16 bit when
+//                 there are few enough vertices.
+//
+//               AverageCacheMissRatio() is how we tell whether it worked:
+//               the vertices a FIFO cache (like most GPUs have) would
+//               transform per triangle.  3 is the worst, 0.5 the best a
+//               big regular grid can do.
+//============================================================================
+
+#ifndef MESHOPTIMIZER_HPP_
+#define MESHOPTIMIZER_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.hpp"
+
+
+double AverageCacheMissRatio(const uint32_t *indices, size_t numIndices,
+                             size_t numVertices, size_t cacheSize = 16);
+
+void OptimizeVertexCache(uint32_t *indices, size_t numIndices,
+                         size_t numVertices);
+
+void OptimizeOverdraw(uint32_t *indices, size_t numIndices,
+                      const MeshVertex *vertices, size_t numVertices,
+                      float threshold = 1.05f);
+
+// Returns how many vertices are left, which are at the front
+size_t OptimizeVertexFetch(MeshVertex *vertices, size_t numVertices,
+                           uint32_t *indices, size_t numIndices);
+
+// All three, in that order
+void OptimizeMesh(Mesh& mesh, float overdrawThreshold = 1.05f);
+
+
+// For glVertexAttribPointer(), the position and texture coordinates are
+// GL_UNSIGNED_SHORT and the normal GL_BYTE, all normalized.  The shader
+// turns them back with the QuantizedMesh's offsets and scales.
+struct QuantizedVertex
+{
+    uint16_t position[4];   // the last one is just padding
+    int8_t normal[4];       // this one too
+    uint16_t texCoord[2];
+};
+
+
+class QuantizedMesh
+{
+public:
+    void Quantize(const Mesh& mesh);
+
+    const QuantizedVertex *Vertices() const { return vertices.data(); }
+    size_t NumVertices() const { return vertices.size(); }
+
+    // One of these is empty, depending on ShortIndices()
+    bool ShortIndices() const { return !shortIndices.empty(); }
+    const uint16_t *Indices16() const { return shortIndices.data(); }
+    const uint32_t *Indices32() const { return indices.data(); }
+    size_t NumIndices() const { return numIndices; }
+
+    size_t VertexBytes() const
+    {
+        return vertices.size() * sizeof(QuantizedVertex);
+    }
+    size_t IndexBytes() const
+    {
+        return numIndices * (ShortIndices() ? sizeof(uint16_t)
+                                            : sizeof(uint32_t));
+    }
+
+    // position = offset + scale * normalized position, and the same for
+    // the texture coordinates
+    const float *PositionOffset() const { return positionOffset; }
+    const float *PositionScale() const { return positionScale; }
+    const float *TexCoordOffset() const { return texCoordOffset; }
+    const float *TexCoordScale() const { return texCoordScale; }
+
+    // What the shader gets back for a vertex
+    MeshVertex Dequantize(size_t vertex) const;
+
+private:
+    std::vector<QuantizedVertex> vertices;
+    std::vector<uint16_t> shortIndices;
+    std::vector<uint32_t> indices;
+    size_t numIndices = 0;
+
+    float positionOffset[3] = {0, 0, 0};
+    float positionScale[3] = {1, 1, 1};
+    float texCoordOffset[2] = {0, 0};
+    float texCoordScale[2] = {1, 1};
+};
+
+#endif /* MESHOPTIMIZER_HPP_ */
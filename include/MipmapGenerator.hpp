@@ -0,0 +1,84 @@
+//============================================================================
+// Name        : MipmapGenerator.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Builds the mip chain of an image on the CPU, instead of
+//               leaving it to glGenerateMipmap(), which runs on the GL
+//               thread, and whose speed and quality are up to the driver.
+//
+//               There are two filters:
+//               - Box averages each 2x2 block.  It's cheap, and a bit
+//                 blurry.
+//               - Kaiser is a Kaiser windowed sinc, 8 taps each way.  It
+//                 keeps more detail, at a few times the cost.
+//
+//               Our images are sRGB, and averaging sRGB values darkens
+//               everything.  In sRGB mode the colors get converted to
+//               linear before filtering, and back after.  Alpha is always
+//               linear.
+//
+//               Each level is made from the one above it.  The rows of a
+//               level are spread over the JobSystem, if we have one.
+//               Once the levels get small, the job overhead isn't worth it,
+//               and the rest of the chain gets done on the calling thread.
+//
+//               The images are 4 bytes per pixel, with alpha last (RGBA
+//               or BGRA, see PixelConvert.hpp).
+//============================================================================
+
+#ifndef MIPMAPGENERATOR_HPP_
+#define MIPMAPGENERATOR_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "JobSystem.hpp"
+
+
+class MipmapGenerator
+{
+public:
+    enum Filter { Box, Kaiser };
+
+    // A level of the chain, with its pixels packed tightly
+    struct Level
+    {
+        int width;
+        int height;
+        std::vector<unsigned char> pixels;
+    };
+
+    explicit MipmapGenerator(Filter filter = Box, bool srgb = false,
+                             JobSystem *jobs = nullptr);
+
+    // The levels below an image, starting with level 1, and going down
+    // to 1x1.  Each level is half the size of the one before, rounded
+    // down, like GL's.
+    std::vector<Level> Generate(const unsigned char *pixels,
+                                int width, int height) const;
+
+    // Make one level from the one above it
+    void Downsample(const unsigned char *src, int srcWidth, int srcHeight,
+                    unsigned char *dst) const;
+
+    Filter GetFilter() const { return filter; }
+    bool IsSRGB() const { return srgb; }
+
+private:
+    void DownsampleBox(const unsigned char *src, int srcWidth, int srcHeight,
+                       unsigned char *dst, bool parallel) const;
+    void DownsampleFiltered(const unsigned char *src,
+                            int srcWidth, int srcHeight,
+                            unsigned char *dst, bool parallel) const;
+
+    // Call fn(begin, end) over the rows, on the jobs if we want to
+    template <typename F>
+    void ForRows(int numRows, int rowWidth, bool parallel, const F& fn) const;
+
+    Filter filter;
+    bool srgb;
+    JobSystem *jobs;
+};
+
+#endif /* MIPMAPGENERATOR_HPP_ */
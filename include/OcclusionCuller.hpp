@@ -0,0 +1,160 @@
+//============================================================================
+// Name        : OcclusionCuller.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Testing objects against the view frustum still submits
+//               everything that is hidden behind something big.  This is a
+//               CPU occlusion culler that draws a few large occluder meshes
+//               into a small depth buffer, and then tests the bounding
+//               boxes of objects against it.
+//
+//               The rasterizer is tile based.  Triangles are transformed and
+//               binned to screen tiles, and then each tile gets rasterized
+//               as its own job, 4 pixels at a time with SSE.  From the depth
+//               buffer we build a hierarchical pyramid where each texel is
+//               the farthest depth of the 2x2 texels below it.  So a box
+//               only has to look at a handful of texels at the right level
+//               to know whether it is behind everything there.
+//
+//               Rendering can run asynchronously on the JobSystem.  We keep
+//               two depth buffers; the boxes get tested against the last
+//               one that was finished, which means the results can be a
+//               frame behind.  That's alright as long as the boxes are
+//               projected with the view-projection the buffer was drawn
+//               with, which is what we do.
+//
+//               Depths are in [0, 1], with 0 at the near plane.
+//
+//               None of this touches OpenGL, so it can be tested and
+//               benchmarked on machines without a GPU.
+//============================================================================
+
+#ifndef OCCLUSIONCULLER_HPP_
+#define OCCLUSIONCULLER_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+using Eigen::Matrix4f;
+using Eigen::Vector3f;
+using Eigen::Vector4f;
+
+#include "JobSystem.hpp"
+
+
+class OcclusionCuller
+{
+public:
+    static const int TileWidth = 32;
+    static const int TileHeight = 32;
+
+    // The width and height get rounded up to a multiple of the tile size.
+    // If jobs is null, everything runs on the calling thread.
+    OcclusionCuller(JobSystem *jobs = nullptr,
+                    int width = 256, int height = 128);
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // The occluder geometry is not copied.  It has to stay around until
+    // the rendering is finished.
+    // - vertices are tightly packed (x, y, z) positions
+    // - indices make up triangles
+    void AddOccluder(const float *vertices, size_t numVertices,
+                     const uint32_t *indices, size_t numIndices,
+                     const Matrix4f& model = Matrix4f::Identity());
+    void ClearOccluders();
+
+    // Draw the occluders and wait for them.
+    void Render(const Matrix4f& viewProjection);
+
+    // Start drawing the occluders in the background.  The result gets
+    // used for testing after the next Finish().
+    void RenderAsync(const Matrix4f& viewProjection);
+    void Finish();
+
+    // Test a world space bounding box against the last finished depth
+    // buffer.  Boxes outside the screen are not visible, and boxes that
+    // cross the near plane always are.
+    bool IsVisible(const Vector3f& boxMin, const Vector3f& boxMax) const;
+
+    // Test a bunch of boxes at once, spread over the JobSystem.
+    // Returns the number of visible boxes.
+    size_t TestBoxes(const Vector3f *boxMins, const Vector3f *boxMaxs,
+                     size_t numBoxes, uint8_t *visible) const;
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    // The last finished depth buffer (mip 0) and its pyramid levels
+    const float *DepthBuffer() const;
+    size_t NumLevels() const;
+    const float *Level(size_t level, int &levelWidth, int &levelHeight) const;
+
+    // number of triangles that went into the last finished depth buffer
+    size_t TrianglesRendered() const;
+
+private:
+    struct Occluder
+    {
+        const float *vertices;
+        size_t numVertices;
+        const uint32_t *indices;
+        size_t numIndices;
+        Matrix4f model;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    // A triangle in screen space, with depth as a plane equation
+    struct Triangle
+    {
+        float x[3];
+        float y[3];
+        float z[3];
+    };
+
+    struct DepthTarget
+    {
+        Matrix4f viewProjection;
+        std::vector<std::vector<float>> levels;
+        std::vector<int> levelWidth;
+        std::vector<int> levelHeight;
+        size_t numTriangles = 0;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    void RenderTarget(DepthTarget& target);
+    void SetupTriangles(const Matrix4f& viewProjection);
+    void RasterizeTile(DepthTarget& target, int tile);
+    void BuildPyramid(DepthTarget& target);
+    void RasterizeTriangle(float *depth, const Triangle& tri,
+                           int tileX0, int tileY0, int tileX1, int tileY1);
+
+    JobSystem *jobs;
+
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+
+    std::vector<Occluder, Eigen::aligned_allocator<Occluder>> occluders;
+
+    // shared by all the tiles while rendering
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<uint32_t>> tileBins;
+
+    DepthTarget *front;  // finished, used for testing
+    DepthTarget *back;   // being rendered
+
+    bool rendering = false;
+    Job *renderJob = nullptr;
+};
+
+#endif /* OCCLUSIONCULLER_HPP_ */
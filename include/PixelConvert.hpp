@@ -0,0 +1,30 @@
+//============================================================================
+// Name        : PixelConvert.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Our images get decoded as tightly packed 3 byte RGB pixels,
+//               which is about the worst thing we can hand to a GL driver.
+//               Rows aren't 4 byte aligned, and the hardware has no 3 byte
+//               texel format, so most drivers expand the pixels themselves,
+//               one at a time on the CPU, inside glTex*Image2D().
+//
+//               These expand them to 4 byte pixels, with an opaque alpha,
+//               in the byte order the driver wants.  With SSSE3 they go 4
+//               pixels at a time, with a byte shuffle.
+//============================================================================
+
+#ifndef PIXELCONVERT_HPP_
+#define PIXELCONVERT_HPP_
+
+#include <cstddef>
+
+// RGB -> RGBA
+void ConvertRGBToRGBA(const unsigned char *src, unsigned char *dst,
+                      size_t numPixels);
+
+// RGB -> BGRA, which is what a lot of hardware keeps its texels in
+void ConvertRGBToBGRA(const unsigned char *src, unsigned char *dst,
+                      size_t numPixels);
+
+#endif /* PIXELCONVERT_HPP_ */
@@ -0,0 +1,137 @@
+//============================================================================
+// Name        : ProgramCache.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Making two Shaders out of the same pair of files used to
+//               compile and link the program twice, and since a Shader
+//               never deleted its program, the first one just leaked.
+//
+//               The ProgramCache keeps one program per pair of resolved
+//               sources, keyed by their hashes (which cover the #defines
+//               too).  Asking for a program we already have is a hash
+//               lookup.  What we hand out is a ProgramHandle, which can be
+//               moved but not copied, and the program gets deleted when the
+//               last handle to it goes away.
+//
+//               Like everything else that talks to GL, the cache is meant
+//               to be used from the thread with the context.  It has to
+//               outlive the handles it hands out.
+//============================================================================
+
+#ifndef PROGRAMCACHE_HPP_
+#define PROGRAMCACHE_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+#include "ShaderSource.hpp"
+#include "GLObject.hpp"
+
+class ProgramHandle;
+
+
+class ProgramCache
+{
+public:
+    ProgramCache() {}
+
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache& operator=(const ProgramCache&) = delete;
+
+    // The program built from these sources, compiled and linked if we
+    // don't have it yet.  The handle is empty if it doesn't compile.
+    ProgramHandle Acquire(const ShaderSource& vertexSource,
+                          const ShaderSource& fragmentSource);
+
+    // Delete all the programs now, while there's still a context to
+    // delete them with.  Handles that are still out are safe to let go
+    // of afterwards, but they don't have a program any more (and test
+    // false), until the same sources are acquired again.
+    void Clear();
+
+    // stats
+    size_t NumPrograms() const { return programs.size(); }
+    size_t Compiles() const { return compiles; }
+    size_t Hits() const { return hits; }
+
+private:
+    friend class ProgramHandle;
+
+    struct ProgramKey
+    {
+        uint64_t vertexHash;
+        uint64_t fragmentHash;
+
+        bool operator==(const ProgramKey& other) const {
+            return vertexHash == other.vertexHash &&
+                   fragmentHash == other.fragmentHash;
+        }
+    };
+
+    struct ProgramKeyHash
+    {
+        size_t operator()(const ProgramKey& key) const {
+            // the halves are good hashes already
+            return (size_t)(key.vertexHash ^ (key.fragmentHash * 31));
+        }
+    };
+
+    struct Entry
+    {
+        ProgramKey key;
+        GLProgram program;
+        size_t refs;
+    };
+
+    static GLuint Compile(GLenum type, const ShaderSource& source);
+    static GLuint Link(const ShaderSource& vertexSource,
+                       const ShaderSource& fragmentSource);
+
+    void Release(Entry *entry);
+
+    // Entries don't move around in an unordered_map, so the handles
+    // can point right at them.
+    std::unordered_map<ProgramKey, Entry, ProgramKeyHash> programs;
+
+    size_t compiles = 0;
+    size_t hits = 0;
+};
+
+
+// Keeps a program from the cache alive
+class ProgramHandle
+{
+public:
+    ProgramHandle() {}
+    ~ProgramHandle() { Reset(); }
+
+    ProgramHandle(const ProgramHandle&) = delete;
+    ProgramHandle& operator=(const ProgramHandle&) = delete;
+
+    ProgramHandle(ProgramHandle&& other);
+    ProgramHandle& operator=(ProgramHandle&& other);
+
+    GLuint Program() const
+    {
+        return (entry != nullptr) ? entry->program.ID() : 0;
+    }
+    explicit operator bool() const { return Program() != 0; }
+
+    // Let go of the program
+    void Reset();
+
+private:
+    friend class ProgramCache;
+
+    ProgramHandle(ProgramCache *cache, ProgramCache::Entry *entry)
+        : cache(cache), entry(entry) {}
+
+    ProgramCache *cache = nullptr;
+    ProgramCache::Entry *entry = nullptr;
+};
+
+#endif /* PROGRAMCACHE_HPP_ */
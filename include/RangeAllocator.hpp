@@ -0,0 +1,99 @@
+//============================================================================
+// Name        : RangeAllocator.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Hands out ranges of a big block (a GPU buffer, usually)
+//               that somebody else owns.  It only does the bookkeeping, in
+//               whatever units the caller likes (vertices, indices, bytes),
+//               and never touches the block itself.
+//               - Free space is kept by offset, so a freed range merges
+//                 with the free ranges on either side of it, and by size,
+//                 so an allocation takes the smallest free range it fits
+//                 in (best fit), which leaves the big ones for big meshes.
+//               - When enough has been freed that the free space is in
+//                 lots of little pieces, Compact() slides everything down
+//                 to the start of the block, and returns the moves it made
+//                 so the caller can copy its data along.
+//               - Grow() makes the block bigger, with the new space free.
+//============================================================================
+
+#ifndef RANGEALLOCATOR_HPP_
+#define RANGEALLOCATOR_HPP_
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+
+class RangeAllocator
+{
+public:
+    // What Allocate() returns when nothing fits
+    static const size_t Invalid = ~(size_t)0;
+
+    // A range that Compact() moved from one offset to another
+    struct Move
+    {
+        size_t from;
+        size_t to;
+        size_t size;
+    };
+
+    explicit RangeAllocator(size_t capacity = 0);
+
+    // The offset of a free range of this size, or Invalid.  Ranges of
+    // size 0 aren't a thing; those are Invalid too.
+    size_t Allocate(size_t size);
+
+    // Give back a range that Allocate() returned
+    bool Free(size_t offset);
+
+    // The size of an allocated range, or 0 if there's none at the offset
+    size_t SizeOf(size_t offset) const;
+
+    // Free everything
+    void Clear();
+
+    // The block can only get bigger
+    void Grow(size_t newCapacity);
+
+    // Slide every range down, in order, so that all the free space is in
+    // one piece at the end.  The moves come in order of offset, and
+    // copying them in that order never overwrites a range that hasn't been
+    // copied yet (a range can overlap where it used to be, though, so copy
+    // it like memmove()).  Ranges that stay put aren't in the list.
+    std::vector<Move> Compact();
+
+    size_t Capacity() const { return capacity; }
+    size_t Used() const { return used; }
+    size_t Available() const { return capacity - used; }
+    size_t LargestFree() const;
+    size_t NumAllocations() const { return allocations.size(); }
+    size_t NumFreeRanges() const { return freeByOffset.size(); }
+
+    // Where the last allocated range ends
+    size_t End() const;
+
+    // How much of the free space can't be used for one big allocation,
+    // from 0 (all in one piece) to nearly 1 (all in little pieces)
+    double Fragmentation() const;
+
+private:
+    void AddFree(size_t offset, size_t size);
+    void RemoveFree(std::map<size_t, size_t>::iterator range);
+
+    size_t capacity;
+    size_t used = 0;
+
+    // offset -> size
+    std::map<size_t, size_t> allocations;
+    std::map<size_t, size_t> freeByOffset;
+
+    // (size, offset), smallest first
+    std::set<std::pair<size_t, size_t>> freeBySize;
+};
+
+#endif /* RANGEALLOCATOR_HPP_ */
@@ -0,0 +1,139 @@
+//============================================================================
+// Name        : ResourceRegistry.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Each demo has been loading its shaders and textures into
+//               locals, so nothing could find a resource by its name, and
+//               two parts of a program that wanted the same texture would
+//               each load their own.
+//
+//               A ResourceRegistry keeps the loaded resources of one kind
+//               (Texture, Shader, meshes, ...) by name.  The names get
+//               hashed with SpookyHash::Hash64() into the key of a HashMap,
+//               so a lookup is one hash and usually one probe.  Callers
+//               that look the same name up every frame can hash it once
+//               with Key(), and use the key from then on.
+//
+//               The resources are held by shared_ptr, so one that gets
+//               removed stays alive for whoever still has it.
+//
+//               Two names with the same hash can't both be in the registry;
+//               Add() refuses the second one, and says so.  With 64 bit
+//               hashes that shouldn't come up.
+//
+//               It isn't thread safe; for GL resources everything happens
+//               on the thread with the context anyway.
+//============================================================================
+
+#ifndef RESOURCEREGISTRY_HPP_
+#define RESOURCEREGISTRY_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <memory>
+#include <iostream>
+
+#include "HashMap.hpp"
+
+// SpookyHash::Hash64() of the name, with the registries' own seed
+uint64_t ResourceKey(const std::string& name);
+
+
+template <typename Resource>
+class ResourceRegistry
+{
+public:
+    // The key a name is stored under
+    static uint64_t Key(const std::string& name) { return ResourceKey(name); }
+
+    // The resource with this name, or null
+    std::shared_ptr<Resource> Find(const std::string& name) const
+    {
+        const Entry *entry = entries.Find(Key(name));
+        if (entry == nullptr || entry->name != name)
+            return std::shared_ptr<Resource>();
+
+        return entry->resource;
+    }
+
+    // The resource under a key from Key(), or null
+    std::shared_ptr<Resource> Find(uint64_t key) const
+    {
+        const Entry *entry = entries.Find(key);
+        return entry != nullptr ? entry->resource
+                                : std::shared_ptr<Resource>();
+    }
+
+    // False if there's already something by that name (or hash)
+    bool Add(const std::string& name,
+             const std::shared_ptr<Resource>& resource)
+    {
+        Entry entry;
+        entry.name = name;
+        entry.resource = resource;
+
+        std::pair<Entry *, bool> added = entries.Insert(Key(name),
+                                                        std::move(entry));
+        if (!added.second && added.first->name != name)
+            std::cout << "ResourceRegistry::Add(): " << name
+                      << " has the same hash as " << added.first->name
+                      << std::endl;
+
+        return added.second;
+    }
+
+    // The resource with this name, loading it with load() if it isn't
+    // here yet.  load() returns a shared_ptr<Resource>, or null if it
+    // failed, in which case nothing gets added and we return null too.
+    template <typename F>
+    std::shared_ptr<Resource> Load(const std::string& name, const F& load)
+    {
+        const Entry *entry = entries.Find(Key(name));
+        if (entry != nullptr && entry->name == name)
+            return entry->resource;
+
+        std::shared_ptr<Resource> resource = load();
+        if (resource == nullptr || !Add(name, resource))
+            return std::shared_ptr<Resource>();
+
+        return resource;
+    }
+
+    // False if there was nothing by that name
+    bool Remove(const std::string& name)
+    {
+        uint64_t key = Key(name);
+
+        const Entry *entry = entries.Find(key);
+        if (entry == nullptr || entry->name != name)
+            return false;
+
+        return entries.Erase(key);
+    }
+
+    void Clear() { entries.Clear(); }
+
+    size_t Size() const { return entries.Size(); }
+
+    // fn(name, resource) for everything in the registry
+    template <typename F>
+    void ForEach(const F& fn) const
+    {
+        entries.ForEach([&](uint64_t, const Entry& entry) {
+            fn(entry.name, entry.resource);
+        });
+    }
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::shared_ptr<Resource> resource;
+    };
+
+    HashMap<Entry> entries;
+};
+
+#endif /* RESOURCEREGISTRY_HPP_ */
@@ -0,0 +1,113 @@
+//============================================================================
+// Name        : SamplerCache.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : How a texture gets sampled (filtering, wrapping, anisotropy,
+//               LOD bias) used to be parameters of the texture itself, set
+//               with a glTexParameter*() call apiece when it was built.  So
+//               drawing the same texture two different ways meant changing
+//               the texture in between.
+//
+//               Sampler objects hold that state on their own, and get bound
+//               to a texture unit next to the texture, overriding its
+//               parameters.  A SamplerState describes one, and the
+//               SamplerCache keeps one GL sampler per distinct state, keyed
+//               by its hash.  Everything that samples the same way shares a
+//               sampler, and a different way of sampling is just a different
+//               sampler bound to the unit (see StateTracker.hpp).
+//
+//               The samplers live as long as the cache, which has to be
+//               used (and destroyed) with the GL context current.
+//============================================================================
+
+#ifndef SAMPLERCACHE_HPP_
+#define SAMPLERCACHE_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+#include "GLObject.hpp"
+
+
+// Everything about how we sample a texture.  The members are all four
+// bytes wide, so there's no padding, and we can hash the bytes.
+struct SamplerState
+{
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+
+    GLenum wrapS = GL_CLAMP_TO_BORDER;
+    GLenum wrapT = GL_CLAMP_TO_BORDER;
+    GLenum wrapR = GL_CLAMP_TO_BORDER;
+
+    // Required if we are clamping to border
+    GLfloat borderColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+    // 1 is no anisotropic filtering.  It gets clamped to what the
+    // hardware can do.
+    GLfloat maxAnisotropy = 1.0f;
+
+    GLfloat lodBias = 0.0f;
+    GLfloat minLod = -1000.0f;
+    GLfloat maxLod = 1000.0f;
+
+    // a few ways of changing one thing at a time
+    SamplerState& Filter(GLenum min, GLenum mag);
+    SamplerState& Wrap(GLenum mode);
+    SamplerState& Anisotropy(GLfloat max);
+    SamplerState& LodBias(GLfloat bias);
+
+    uint64_t Hash() const;
+
+    bool operator==(const SamplerState& other) const;
+    bool operator!=(const SamplerState& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+
+class SamplerCache
+{
+public:
+    // Asks GL how much anisotropy it can do, so the context needs to
+    // be current.
+    SamplerCache();
+
+    SamplerCache(const SamplerCache&) = delete;
+    SamplerCache& operator=(const SamplerCache&) = delete;
+
+    // The sampler for this state, created the first time we see it
+    GLuint Get(const SamplerState& state);
+
+    GLfloat MaxAnisotropy() const { return maxAnisotropy; }
+
+    // stats
+    size_t NumSamplers() const { return samplers.size(); }
+    size_t Creates() const { return creates; }
+    size_t Hits() const { return hits; }
+
+private:
+    struct SamplerStateHash
+    {
+        size_t operator()(const SamplerState& state) const {
+            return (size_t)state.Hash();
+        }
+    };
+
+    GLSampler Create(const SamplerState& state);
+
+    std::unordered_map<SamplerState, GLSampler, SamplerStateHash> samplers;
+
+    // 0 if we can't do anisotropic filtering at all
+    GLfloat maxAnisotropy = 0.0f;
+
+    size_t creates = 0;
+    size_t hits = 0;
+};
+
+#endif /* SAMPLERCACHE_HPP_ */
@@ -0,0 +1,117 @@
+//============================================================================
+// Name        : SceneGraph.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : So far our model transforms have just been loose Affine3f
+//               variables in main(), with no notion of one object being
+//               attached to another.  This SceneGraph keeps a hierarchy of
+//               transforms.
+//
+//               Instead of a tree of node objects, we keep the transforms
+//               in flat arrays (a structure of arrays), sorted by depth.
+//               So by the time we get to a node, its parent's world matrix
+//               has already been computed, and we can just walk the arrays
+//               front to back.  All the nodes at one depth are independent
+//               of each other, so big levels get split up over the
+//               JobSystem.
+//
+//               Only nodes that were changed, and the subtrees below them,
+//               get recomputed on Update().
+//
+//               The world matrices are kept as contiguous column-major 4x4
+//               floats, which is the layout of a per-instance mat4 vertex
+//               attribute.  So they can be copied straight into an instance
+//               buffer.
+//
+//               Nodes are referred to by a handle that stays the same when
+//               the nodes get re-sorted.
+//============================================================================
+
+#ifndef SCENEGRAPH_HPP_
+#define SCENEGRAPH_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+using Eigen::Matrix4f;
+using Eigen::Affine3f;
+
+#include "JobSystem.hpp"
+
+typedef uint32_t SceneNode;
+
+
+class SceneGraph
+{
+public:
+    static const SceneNode None = 0xffffffff;
+
+    // Levels with fewer nodes than this are not worth splitting up
+    static const size_t DefaultParallelThreshold = 4096;
+
+    // If jobs is null, everything is updated on the calling thread.
+    explicit SceneGraph(JobSystem *jobs = nullptr);
+
+    SceneNode AddNode(SceneNode parent = None,
+                      const Affine3f& local = Affine3f::Identity());
+
+    void SetLocal(SceneNode node, const Affine3f& local);
+    const Affine3f& Local(SceneNode node) const;
+
+    // valid as of the last Update()
+    const Matrix4f& World(SceneNode node) const;
+
+    SceneNode Parent(SceneNode node) const { return nodeParent[node]; }
+    size_t Size() const { return nodeParent.size(); }
+    size_t Depth() const { return levelStart.size() - 1; }
+
+    // Re-sort if we added nodes, and recompute the world matrices of
+    // everything that changed since the last update.
+    // Returns the number of world matrices that were recomputed.
+    size_t Update();
+
+    // The world matrices, 16 floats per node, in depth order.
+    const float *InstanceData() const;
+    size_t InstanceStride() const { return sizeof(Matrix4f); }
+    size_t InstanceIndex(SceneNode node) const { return handleToIndex[node]; }
+
+    // The range of instances touched by the last Update(), so we only
+    // have to upload that part of the instance buffer.
+    void UpdatedRange(size_t &first, size_t &count) const;
+
+    void SetParallelThreshold(size_t numNodes) { parallelThreshold = numNodes; }
+
+private:
+    void SortByDepth();
+    size_t UpdateRange(size_t begin, size_t end, bool isRoot);
+
+    JobSystem *jobs;
+    size_t parallelThreshold = DefaultParallelThreshold;
+
+    // Per handle.  These don't move when we sort.
+    std::vector<SceneNode> nodeParent;
+    std::vector<uint32_t> nodeDepth;
+    std::vector<uint32_t> handleToIndex;
+
+    // Per index, sorted by depth.
+    std::vector<Affine3f, Eigen::aligned_allocator<Affine3f>> local;
+    std::vector<Matrix4f, Eigen::aligned_allocator<Matrix4f>> world;
+    std::vector<uint32_t> parent;  // index of the parent, or None
+    std::vector<uint8_t> dirty;    // set when changed, or parent updated
+    std::vector<SceneNode> indexToHandle;
+
+    // the index of the first node of each level, plus one past the end
+    std::vector<size_t> levelStart;
+    std::vector<uint8_t> levelDirty;
+
+    bool needsSort = false;
+
+    size_t updatedFirst = 0;
+    size_t updatedEnd = 0;
+};
+
+#endif /* SCENEGRAPH_HPP_ */
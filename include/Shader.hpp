@@ -29,27 +29,83 @@
 
 #include <GL/glew.h> // Include glew to get all the required OpenGL headers
 
+#include "AssetPack.hpp"
+#include "ShaderSource.hpp"
+#include "ProgramCache.hpp"
+#include "StateTracker.hpp"
+
 class Shader
 {
 public:
     // The program ID
     GLuint Program = 0;
 
-    // Constructor reads and builds the shader
+    // Constructor reads and builds the shader.  The sources can
+    // #include other files (see ShaderSource.hpp).
+    // Shaders built from the same sources share one program, which goes
+    // away with the last of them (see ProgramCache.hpp).
     Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
 
+    // Or builds it with a loader of our own, and the given #defines
+    // ("NAME" or "NAME=VALUE").  With a loader made from an asset pack,
+    // the sources get handed to GL straight out of the pack, without
+    // copying them.  Keep one loader per pack, and use it for all of the
+    // pack's shaders, so their shared headers only get scanned once.
+    Shader(ShaderSourceLoader& loader,
+           const GLchar* vertexPath, const GLchar* fragmentPath,
+           const std::vector<std::string>& defines =
+               std::vector<std::string>());
+
+    // Or uses a program that somebody else owns (or none)
+    explicit Shader(GLuint program = 0) : Program(program) {}
+
+    // A Shader can be moved, but copying one would leave two of them
+    // thinking they own the program.
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    Shader(Shader&& other);
+    Shader& operator=(Shader&& other);
+
+    // The cache all of our shaders share
+    static ProgramCache& DefaultCache();
+
     std::string ReadFile(const GLchar *path);
-    GLuint CreateVertexShader(const GLchar *code);
-    GLuint CreateFragmentShader(const GLchar *code);
+
+    // if length is negative, the code is null terminated
+    GLuint CreateVertexShader(const GLchar *code, GLint length = -1);
+    GLuint CreateFragmentShader(const GLchar *code, GLint length = -1);
+
+    // multiple source strings, like glShaderSource() takes
+    GLuint CreateVertexShader(GLsizei count, const GLchar *const *code,
+                              const GLint *lengths);
+    GLuint CreateFragmentShader(GLsizei count, const GLchar *const *code,
+                                const GLint *lengths);
+
+    GLuint CreateVertexShader(const ShaderSource& source);
+    GLuint CreateFragmentShader(const ShaderSource& source);
     void CreateShaderProgram();
 
     void UseTexture(GLuint texture = 0, GLuint textureUnitIdx = 0);
+
+    // Or binds the texture, and the sampler to read it with (0 uses the
+    // texture's own parameters), through a state tracker.  Drawing the
+    // same texture with a different sampler doesn't touch the texture.
+    void UseTexture(StateTracker& state, GLuint texture,
+                    GLuint textureUnitIdx = 0, GLuint sampler = 0);
     void UseTransform(const GLfloat *transform, GLuint transformIdx = 0);
 
     // Use the program
     void Use() { glUseProgram(this->Program); }
 
 private:
+    static ShaderSourceLoader& DefaultLoader();
+
+    void Build(const ShaderSource *vertexSource,
+               const ShaderSource *fragmentSource);
+
+    ProgramHandle handle;
+
     GLuint vertexShader = 0;
     GLuint fragmentShader = 0;
 };
@@ -0,0 +1,189 @@
+//============================================================================
+// Name        : ShaderLibrary.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : A Shader compiles one vertex/fragment pair in its
+//               constructor, and waits for the compiler to finish.  That's
+//               fine for one shader, but once we have variants (instancing,
+//               number of textures, lighting, ...) startup ends up waiting
+//               on each of them in turn.
+//
+//               The ShaderLibrary declares the variants of a shader up
+//               front, from sets of keywords, and starts compiling all of
+//               them at once.  How it does that depends on the driver:
+//               - With GL_KHR_parallel_shader_compile (or the ARB version)
+//                 the driver compiles on its own threads, and we just ask
+//                 whether each program is done yet.
+//               - Otherwise a worker thread compiles them in a hidden
+//                 window whose context shares objects with ours.
+//               - Without a window to share with, we compile right away,
+//                 just like Shader does.
+//
+//               Update() checks on the compiles once a frame, without ever
+//               waiting.  Get() hands out the variant we asked for if it's
+//               ready, and otherwise the closest variant that is, so the
+//               render loop can keep drawing while the rest link.
+//
+//               With hot reloading turned on, a variant gets compiled again
+//               when one of its files changes, the same way as above.  The
+//               new program replaces the old one in Update(), and if it
+//               doesn't compile we just keep the old one.
+//============================================================================
+
+#ifndef SHADERLIBRARY_HPP_
+#define SHADERLIBRARY_HPP_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "Shader.hpp"
+#include "ShaderSource.hpp"
+#include "FileWatcher.hpp"
+
+
+class ShaderLibrary
+{
+public:
+    enum CompileMode { Parallel, Worker, Synchronous };
+
+    // The window is the one we render with, and its context has to be
+    // current.  If the driver can't compile in parallel, we make a hidden
+    // window that shares with it for our worker thread.
+    explicit ShaderLibrary(ShaderSourceLoader& loader,
+                           GLFWwindow *window = nullptr);
+    ~ShaderLibrary();
+
+    ShaderLibrary(const ShaderLibrary&) = delete;
+    ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+    // Stop the worker, and delete all our shaders and programs.  The
+    // render context has to still be current, and GLFW still running, so
+    // call this before glfwTerminate() if we'd outlive it.  The destructor
+    // does the same, and after this there's nothing left to do.
+    void Shutdown();
+
+    // Declare a shader and its variants.  Each keyword set is a choice
+    // between #defines ("NAME" or "NAME=VALUE"), where an empty string
+    // means define nothing, and we get a variant for every combination.
+    // For example {{"", "INSTANCED"}, {"TEXTURES=1", "TEXTURES=2"}} makes
+    // four variants.  The first choice of every set is the base variant.
+    // Returns the number of variants, or 0 if the sources can't be loaded.
+    size_t Declare(const std::string& name,
+                   const std::string& vertexPath,
+                   const std::string& fragmentPath,
+                   const std::vector<std::vector<std::string>>& keywordSets =
+                       std::vector<std::vector<std::string>>());
+
+    // Start compiling everything that was declared since the last call
+    void CompileAll();
+
+    // Check on the compiles, and swap in any programs that were
+    // reloaded.  Call it once a frame, it doesn't block.
+    void Update();
+
+    // Watch the source files of all our variants, and recompile them when
+    // they change.  This only works for files on disk, not asset packs.
+    bool EnableHotReload();
+
+    // Wait for all the compiles to finish
+    void WaitAll();
+
+    // The variant with these keywords, if it has linked.  Otherwise the
+    // ready variant that has the most keywords in common with it, or null
+    // if none of them are ready yet.
+    Shader *Get(const std::string& name,
+                const std::vector<std::string>& keywords =
+                    std::vector<std::string>());
+
+    // Has the variant with exactly these keywords linked?
+    bool IsReady(const std::string& name,
+                 const std::vector<std::string>& keywords =
+                     std::vector<std::string>()) const;
+
+    CompileMode Mode() const { return mode; }
+
+    size_t NumVariants() const;
+    size_t NumReady() const;
+    size_t NumPending() const;
+    size_t NumFailed() const;
+
+private:
+    enum VariantState { Declared, Compiling, Ready, Failed };
+
+    struct Variant
+    {
+        std::vector<std::string> keywords;  // sorted, no empty strings
+        std::vector<std::string> files;     // on disk, for hot reloading
+        const ShaderSource *vertexSource = nullptr;
+        const ShaderSource *fragmentSource = nullptr;
+
+        GLuint vertex = 0;
+        GLuint fragment = 0;
+        GLuint program = 0;                 // the one being compiled
+
+        std::atomic<int> state;
+        Shader shader;                      // the one we're using
+
+        Variant() : state(Declared) {}
+    };
+
+    struct ShaderEntry
+    {
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::vector<std::unique_ptr<Variant>> variants;
+    };
+
+    static std::vector<std::string> SortedKeywords(
+        const std::vector<std::string>& keywords);
+
+    const ShaderEntry *FindEntry(const std::string& name) const;
+    const Variant *FindVariant(const ShaderEntry& entry,
+                               const std::vector<std::string>& keywords) const;
+
+    bool LoadSources(const ShaderEntry& entry, Variant& variant);
+    void WatchFiles(const Variant& variant);
+    void ReloadChanged();
+
+    void StartCompile(Variant& variant);
+    bool FinishCompile(Variant& variant);
+    void DiscardCompile(const std::string& name, Variant& variant);
+    void PrintErrors(const std::string& name, const Variant& variant) const;
+
+    void WorkerLoop();
+
+    ShaderSourceLoader& loader;
+    CompileMode mode = Synchronous;
+
+    std::map<std::string, ShaderEntry> entries;
+    std::vector<std::pair<std::string, Variant *>> declared;
+    std::vector<std::pair<std::string, Variant *>> pending;
+
+    // for hot reloading
+    std::unique_ptr<FileWatcher> watcher;
+    std::set<std::string> changedFiles;
+
+    // for the Worker mode
+    GLFWwindow *workerWindow = nullptr;
+    std::thread worker;
+    std::mutex workMutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    std::deque<std::pair<std::string, Variant *>> workQueue;
+    size_t workInFlight = 0;
+    bool stopWorker = false;
+};
+
+#endif /* SHADERLIBRARY_HPP_ */
@@ -0,0 +1,166 @@
+//============================================================================
+// Name        : ShaderSource.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Loads GLSL sources, and resolves their #include directives
+//               and #define based variants, without copying the text.
+//
+//               The files are memory mapped (or found in an AssetPack), and
+//               a resolved ShaderSource is just a list of segments pointing
+//               into them, in the order the compiler should see them.  That
+//               list goes straight to glShaderSource(), which takes any
+//               number of strings.  The only text we generate ourselves is
+//               the block of #defines, and #line directives so compile
+//               errors point at the right file and line.
+//
+//               How the preprocessing works:
+//               - '#include "file"' is replaced by the file, which is looked
+//                 up next to the including file, and then at the root.
+//                 A file only gets included once per shader, so headers
+//                 don't need include guards.
+//               - The first '#version' line we come across, usually from a
+//                 shared header, goes first.  The #defines for the variant
+//                 go right after it.
+//               - Everything else (#if, #ifdef, ...) is left for the GLSL
+//                 compiler, so an #include inside an #if is always pulled in.
+//
+//               Each file gets scanned once per loader, memoized by the hash
+//               of its contents, and each (file, defines) combination gets
+//               resolved once.  So shared headers are only processed once
+//               per run.  The loader is thread safe.
+//============================================================================
+
+#ifndef SHADERSOURCE_HPP_
+#define SHADERSOURCE_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+#include "MappedFile.hpp"
+#include "AssetPack.hpp"
+
+
+// A resolved shader, ready for glShaderSource()
+class ShaderSource
+{
+public:
+    int NumSegments() const { return (int)strings.size(); }
+    const char *const *Strings() const { return strings.data(); }
+    const int *Lengths() const { return lengths.data(); }
+
+    // the hash of the whole resolved text
+    uint64_t Hash() const { return hash; }
+
+    // The files this was built from.  The index is the source string
+    // number in the #line directives (and in the compiler's errors).
+    const std::vector<std::string>& Files() const { return files; }
+
+    // the whole thing as one string, for debugging
+    std::string Flatten() const;
+
+private:
+    friend class ShaderSourceLoader;
+
+    void Append(const char *data, size_t length);
+    void AppendGenerated(const std::string& text);
+
+    std::vector<const char *> strings;
+    std::vector<int> lengths;
+    std::deque<std::string> generated;  // deque, so the text doesn't move
+    std::vector<std::string> files;
+    uint64_t hash = 0;
+};
+
+
+class ShaderSourceLoader
+{
+public:
+    // Files are read from a folder (or relative to the working
+    // directory if rootPath is empty) ...
+    explicit ShaderSourceLoader(const std::string& rootPath = "");
+
+    // ... or from an asset pack, which has to stay open.
+    explicit ShaderSourceLoader(const AssetPack& pack);
+
+    ShaderSourceLoader(const ShaderSourceLoader&) = delete;
+    ShaderSourceLoader& operator=(const ShaderSourceLoader&) = delete;
+
+    // Resolve a shader.  Defines are "NAME" or "NAME=VALUE".
+    // Returns null if the file (or something it includes) can't be found.
+    // The result stays valid until the loader goes away or is cleared.
+    const ShaderSource *Load(const std::string& path,
+                             const std::vector<std::string>& defines =
+                                 std::vector<std::string>());
+
+    // Forget everything, so changed files get read again
+    void Clear();
+
+    // Where a file from ShaderSource::Files() is on disk, or an empty
+    // string if it came out of an asset pack
+    std::string FilePath(const std::string& path) const;
+
+    // stats
+    size_t FilesScanned() const { return filesScanned; }
+    size_t CacheHits() const { return cacheHits; }
+
+private:
+    enum PieceType { Text, Include, Version };
+
+    struct Piece
+    {
+        PieceType type;
+        size_t offset;
+        size_t length;
+        int line;             // the line the piece starts on
+        std::string include;  // for Include pieces
+    };
+
+    struct ScannedFile
+    {
+        std::vector<Piece> pieces;
+    };
+
+    struct SourceFile
+    {
+        AssetSpan contents;
+        uint64_t contentHash;
+        const ScannedFile *scanned;
+    };
+
+    struct ResolveState
+    {
+        ShaderSource *source;
+        std::vector<std::string> included;
+        AssetSpan version;
+    };
+
+    bool Exists(const std::string& path) const;
+    const SourceFile *GetFile(const std::string& path);
+    bool FindInclude(const std::string& includer, const std::string& name,
+                     std::string& resolvedPath);
+    bool Resolve(const std::string& path, ResolveState& state);
+
+    static void Scan(const AssetSpan& contents, ScannedFile& scanned);
+
+    std::string rootPath;
+    const AssetPack *pack = nullptr;
+
+    std::mutex mutex;
+
+    std::map<std::string, MappedFile> mappedFiles;
+    std::map<std::string, SourceFile> files;
+    std::unordered_map<uint64_t, ScannedFile> scannedFiles;
+    std::unordered_map<uint64_t, std::unique_ptr<ShaderSource>> resolved;
+
+    size_t filesScanned = 0;
+    size_t cacheHits = 0;
+};
+
+#endif /* SHADERSOURCE_HPP_ */
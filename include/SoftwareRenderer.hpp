@@ -0,0 +1,212 @@
+//============================================================================
+// Name        : SoftwareRenderer.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : A CPU rendering backend for our demo scenes.  It consumes
+//               the same vertex, index and texture data, and the same
+//               model/view/projection matrices, that we hand to OpenGL in
+//               the TransformCube demo.  So we can produce frames (and
+//               compare them to known good images) without needing any GL
+//               driver, and we have a performance baseline to compare the
+//               GL path against.
+//
+//               It works kind of like a tiled GPU:
+//               - Vertices get transformed, triangles get clipped against
+//                 the near plane and set up in screen space, and then
+//                 binned into screen tiles.
+//               - On Flush(), each tile gets rasterized as its own job.
+//                 Coverage, depth and the attribute planes are evaluated
+//                 4 pixels at a time with SSE.
+//               - Attributes are interpolated perspective-correct, and
+//                 textures get bilinear sampling between the two nearest
+//                 mipmap levels (trilinear).
+//               - There is a depth buffer with a 'less than' test.
+//
+//               Triangles are kept in submission order within each tile,
+//               so the result is the same no matter how many threads we
+//               render with.
+//
+//               The 'fragment shader' is fixed, and mirrors our GLSL
+//               shaders.  With no textures, we output the vertex color.
+//               With one texture, we output the texture color.  With two
+//               we mix them, like TextureFragmentShader.glsl does.
+//============================================================================
+
+#ifndef SOFTWARERENDERER_HPP_
+#define SOFTWARERENDERER_HPP_
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+#include <Eigen/Dense>
+
+using Eigen::Matrix4f;
+
+#include "JobSystem.hpp"
+
+
+// An RGBA8 texture with its full mipmap chain
+class SoftwareTexture
+{
+public:
+    SoftwareTexture() {}
+
+    // pixels are 8 bits per channel, with 1 to 4 channels, starting from
+    // the top-left corner (like SOIL gives us)
+    SoftwareTexture(const unsigned char *pixels,
+                    int width, int height, int channels);
+
+    void SetImage(const unsigned char *pixels,
+                  int width, int height, int channels);
+
+    // Trilinear sample at (u, v) with the given level of detail.
+    // Coordinates are clamped to the edge.  Output is RGBA in [0, 1]
+    void Sample(float u, float v, float lod, float *rgba) const;
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    size_t NumLevels() const { return levels.size(); }
+
+private:
+    void SampleBilinear(size_t level, float u, float v, float *rgba) const;
+
+    int width = 0;
+    int height = 0;
+
+    std::vector<std::vector<uint32_t>> levels;
+    std::vector<int> levelWidth;
+    std::vector<int> levelHeight;
+};
+
+
+// The attributes of a mesh, the way we hand them to glVertexAttribPointer()
+struct SoftwareVertexData
+{
+    const float *positions = nullptr;  // x, y, z
+    const float *colors = nullptr;     // r, g, b       (optional)
+    const float *texCoords = nullptr;  // s, t          (optional)
+    size_t numVertices = 0;
+};
+
+
+class SoftwareRenderer
+{
+public:
+    static const int TileSize = 64;
+
+    // If jobs is null, everything runs on the calling thread.
+    SoftwareRenderer(int width, int height, JobSystem *jobs = nullptr);
+
+    SoftwareRenderer(const SoftwareRenderer&) = delete;
+    SoftwareRenderer& operator=(const SoftwareRenderer&) = delete;
+
+    void Clear(float red, float green, float blue, float alpha = 1.0f);
+
+    // Like Shader::UseTransform(), the transform indices are
+    // 0: model, 1: view, 2: projection.  Column major 4x4 floats.
+    void UseTransform(const float *transform, unsigned transformIdx = 0);
+
+    // Like Shader::UseTexture().  Pass null to unbind.
+    void UseTexture(const SoftwareTexture *texture, unsigned textureUnitIdx = 0);
+
+    // How much of texture 1 to mix into texture 0
+    void SetTextureMix(float mix) { textureMix = mix; }
+
+    // Our shaders flip the t coordinate, since SOIL images start at the
+    // top-left.  We do the same by default.
+    void SetFlipTexCoords(bool flip) { flipTexCoords = flip; }
+
+    // Queue up indexed triangles with the current state.  The textures
+    // have to stay around until the next Flush().
+    void DrawElements(const SoftwareVertexData& vertices,
+                      const uint32_t *indices, size_t count);
+
+    // Rasterize everything we have queued up.
+    void Flush();
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    // RGBA8 pixels, starting at the bottom-left like glReadPixels()
+    const uint32_t *ColorBuffer() const { return color.data(); }
+    const float *DepthBuffer() const { return depth.data(); }
+
+    // Write out the color buffer as a binary PPM image (top-down)
+    bool WritePPM(const std::string& path) const;
+
+    // Stats since the last Clear()
+    size_t TrianglesSubmitted() const { return trianglesSubmitted; }
+    size_t TrianglesRasterized() const { return trianglesRasterized; }
+    size_t PixelsShaded() const { return pixelsShaded; }
+
+private:
+    // Per draw call state that the triangles refer to
+    struct DrawState
+    {
+        const SoftwareTexture *textures[2];
+        float textureMix;
+        bool useColors;
+        bool useTexCoords;
+    };
+
+    // A clip space vertex with its attributes
+    struct ClipVertex
+    {
+        float x, y, z, w;
+        float attr[5];  // s, t, r, g, b
+    };
+
+    // A triangle set up in screen space.  Each interpolated quantity is
+    // a plane a*x + b*y + c, with the attributes divided by w.
+    struct Triangle
+    {
+        float minX, minY, maxX, maxY;
+        float edgeA[3], edgeB[3], edgeC[3];
+        float z[3];     // depth plane
+        float invW[3];  // 1/w plane
+        float attr[5][3];
+        uint32_t state;
+    };
+
+    void ClipAndSetup(const ClipVertex& v0, const ClipVertex& v1,
+                      const ClipVertex& v2, uint32_t state,
+                      std::vector<Triangle>& out) const;
+    bool SetupTriangle(const ClipVertex& v0, const ClipVertex& v1,
+                       const ClipVertex& v2, uint32_t state,
+                       Triangle& tri) const;
+    void BinTriangle(uint32_t index);
+    size_t RasterizeTile(int tile);
+    size_t RasterizeTriangle(const Triangle& tri, int tileX0, int tileY0,
+                             int tileX1, int tileY1);
+    uint32_t Shade(const Triangle& tri, float px, float py) const;
+
+    JobSystem *jobs;
+
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+
+    Matrix4f transforms[3];
+    const SoftwareTexture *textures[2] = {nullptr, nullptr};
+    float textureMix = 0.2f;
+    bool flipTexCoords = true;
+
+    std::vector<DrawState> states;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<uint32_t>> tileBins;
+
+    size_t trianglesSubmitted = 0;
+    size_t trianglesRasterized = 0;
+    size_t pixelsShaded = 0;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+#endif /* SOFTWARERENDERER_HPP_ */
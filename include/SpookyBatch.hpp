@@ -0,0 +1,47 @@
+//============================================================================
+// Name        : SpookyBatch.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : SpookyHash::Hash64() hashes one message at a time, and for
+//               the short keys we hash most (names, shader sources' pieces,
+//               sampler and state keys), its time all goes to ShortMix()
+//               and ShortEnd(), which work through their adds, xors and
+//               rotates one 64 bit word at a time.
+//
+//               These hash a lot of independent messages at once instead,
+//               each message in a lane of its own, 4 to an AVX2 register,
+//               and 2 registers at a time, so the work of 8 messages goes
+//               through the same instructions.  With AVX-512 (VL) the
+//               rotates are a single instruction too.  That's decided when
+//               the library gets compiled (-mavx2, or -march=native); built
+//               without AVX2, these just hash one message after another.
+//
+//               The hashes are the same as SpookyHash's, bit for bit.
+//               Messages of different lengths can be mixed; the lanes that
+//               run out of blocks before the others just keep their state.
+//               Messages too long for SpookyHash's short hash get its long
+//               one, one at a time.
+//============================================================================
+
+#ifndef SPOOKYBATCH_HPP_
+#define SPOOKYBATCH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+// hashes[i] = SpookyHash::Hash64(messages[i], lengths[i], seed)
+void SpookyHash64Batch(const void *const *messages, const size_t *lengths,
+                       size_t count, uint64_t seed, uint64_t *hashes);
+
+// Like SpookyHash::Hash128(), hash1[i] and hash2[i] are message i's seeds
+// going in, and its hash coming out.
+void SpookyHash128Batch(const void *const *messages, const size_t *lengths,
+                        size_t count, uint64_t *hash1, uint64_t *hash2);
+
+// How many messages get hashed together, which is what the library was
+// built for, not what the caller was.  Batches of a multiple of this waste
+// nothing.
+size_t SpookyBatchLanes();
+
+#endif /* SPOOKYBATCH_HPP_ */
@@ -0,0 +1,71 @@
+//============================================================================
+// Name        : StateTracker.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Remembers what we have bound in the GL context, so binding
+//               something that is already bound doesn't cost a driver call.
+//               It covers the program, the vertex array, and the 2D texture
+//               and the sampler on each texture unit.
+//
+//               The tracker can only know about the binds that go through
+//               it.  When something else changes the bindings (building a
+//               texture binds it, for example), call Invalidate() and it
+//               will bind everything again the next time it is asked to.
+//
+//               Like everything else that talks to GL, it's for the thread
+//               with the context.
+//============================================================================
+
+#ifndef STATETRACKER_HPP_
+#define STATETRACKER_HPP_
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+
+class StateTracker
+{
+public:
+    // GL guarantees at least this many texture units.  Units past these
+    // get bound every time.
+    static const GLuint MaxTextureUnits = 16;
+
+    StateTracker() { Invalidate(); }
+
+    StateTracker(const StateTracker&) = delete;
+    StateTracker& operator=(const StateTracker&) = delete;
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vertexArray);
+
+    // A 2D texture, and the sampler that overrides its parameters
+    // (0 for none), on a texture unit
+    void BindTexture(GLuint unit, GLuint texture);
+    void BindSampler(GLuint unit, GLuint sampler);
+
+    // Forget what we think is bound
+    void Invalidate();
+
+    // stats
+    size_t Binds() const { return binds; }
+    size_t SkippedBinds() const { return skippedBinds; }
+
+private:
+    void ActiveTexture(GLuint unit);
+
+    // What we don't know is bound
+    static const GLuint Unknown = ~0u;
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint activeUnit;
+    GLuint textures[MaxTextureUnits];
+    GLuint samplers[MaxTextureUnits];
+
+    size_t binds = 0;
+    size_t skippedBinds = 0;
+};
+
+#endif /* STATETRACKER_HPP_ */
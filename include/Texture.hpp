@@ -33,6 +33,13 @@
 
 #include <SOIL/SOIL.h>
 
+#include "AssetPack.hpp"
+#include "GLObject.hpp"
+#include "SamplerCache.hpp"
+#include "ImageDecoder.hpp"
+
+class MipmapGenerator;
+
 class Texture
 {
 public:
@@ -41,13 +48,81 @@ public:
     // Constructor reads and builds the texture
     Texture(const char *imagePath);
 
+    // Or decodes the image straight out of an asset pack
+    Texture(const AssetPack& pack, const char *imagePath);
+
+    // The texture gets deleted along with us, so we can be moved but
+    // not copied.
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
+    Texture(Texture&& other);
+    Texture& operator=(Texture&& other);
+
     unsigned char *ReadFile(const char *path,
                             int &width, int &height);
+    unsigned char *ReadAsset(const AssetPack& pack, const char *path,
+                             int &width, int &height);
+    // Swap in a new image, which we take care of freeing.  If it doesn't
+    // make a texture, we keep the one we have.
+    bool Replace(unsigned char *image, int width, int height);
+
+    // Or an image the Decoder() decoded, in the DecodeLayout()
+    bool Replace(const ImageDecoder::Image& image);
+
+    // How our pixels get handed to GL: the internal format we allocate,
+    // and the format and type of the pixels we upload
+    struct UploadFormat
+    {
+        GLenum internalFormat;
+        GLenum format;
+        GLenum type;
+    };
+
+    // The driver's favorite, asked for once.  Needs a current context.
+    static const UploadFormat& PreferredFormat();
+
+    static GLsizei MipLevels(int width, int height);
+
+    // Make the mip levels of the textures we build with this, and upload
+    // them, instead of having GL generate them.  The default (nullptr) is
+    // glGenerateMipmap().  The generator has to outlive the textures that
+    // get built, including any that get reloaded.
+    static void SetMipmapGenerator(const MipmapGenerator *generator);
+
+    // Decode JPEGs and PNGs with this, straight into the pixels we upload,
+    // instead of with SOIL, which then only gets the other formats.  The
+    // default (nullptr) is a decoder of our own, on the calling thread.
+    // The decoder has to outlive the textures that get built.
+    static void SetImageDecoder(const ImageDecoder *decoder);
+
+    // The decoder that is, and the layout to decode into for the
+    // PreferredFormat() (which needs a current context)
+    static const ImageDecoder& Decoder();
+    static ImageDecoder::Layout DecodeLayout();
+
     GLuint GenTexture();
     GLenum SetPixelStorageModes();
-    GLenum SetTextureWrappingModes();
+    // The texture's own sampling parameters, which are what we get when
+    // there's no sampler bound with it (see SamplerCache.hpp)
+    GLenum SetTextureWrappingModes(const SamplerState& state = SamplerState());
 
 private:
+    static UploadFormat QueryPreferredFormat();
+
+    static const MipmapGenerator *mipmapGenerator;
+    static const ImageDecoder *imageDecoder;
+
+    // Build the texture from an image file in memory, if it's one the
+    // image decoder knows.  False if it's something for SOIL, or if it
+    // didn't decode, so SOIL can have a go.
+    bool BuildEncoded(const unsigned char *data, size_t size);
+
+    void Build(unsigned char *image, int width, int height);
+    void Upload(const unsigned char *pixels, int width, int height);
+
+    GLTexture texture;
+
     GLuint vertexShader = 0;
     GLuint fragmentShader = 0;
 };
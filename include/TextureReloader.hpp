@@ -0,0 +1,71 @@
+//============================================================================
+// Name        : TextureReloader.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Reloads our textures when their image files change, so we
+//               can see an edit without restarting the demo.
+//
+//               A FileWatcher tells us which images have been written.  We
+//               decode them on a thread of their own, with the same
+//               ImageDecoder and into the same layout as Texture does (so a
+//               PNG keeps its alpha), and the next Update() after that (at
+//               the start of a frame) uploads the image to a new texture
+//               and swaps its ID in.  If the image can't be loaded, the
+//               texture we had stays put.
+//============================================================================
+
+#ifndef TEXTURERELOADER_HPP_
+#define TEXTURERELOADER_HPP_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <future>
+
+#include "Texture.hpp"
+#include "FileWatcher.hpp"
+
+
+class TextureReloader
+{
+public:
+    TextureReloader() {}
+    ~TextureReloader();
+
+    TextureReloader(const TextureReloader&) = delete;
+    TextureReloader& operator=(const TextureReloader&) = delete;
+
+    // Reload the texture whenever the image changes.  The texture has to
+    // stay around as long as we do.  One texture per image file.
+    bool Watch(Texture& texture, const std::string& imagePath);
+
+    // Swap in any images that have been decoded.  Call it once a frame.
+    // Returns true if any texture was replaced, since building one
+    // changes the texture bindings (see StateTracker::Invalidate()).
+    bool Update();
+
+private:
+    struct DecodedImage
+    {
+        ImageDecoder::Image image;
+        bool decoded = false;
+    };
+
+    struct PendingImage
+    {
+        std::string path;
+        const ImageDecoder *decoder = nullptr;  // to give the pixels back
+        std::future<DecodedImage> decoded;
+    };
+
+    static DecodedImage Decode(const std::string& path,
+                               const ImageDecoder *decoder,
+                               ImageDecoder::Layout layout);
+
+    FileWatcher watcher;
+    std::map<std::string, Texture *> textures;
+    std::vector<PendingImage> pending;
+};
+
+#endif /* TEXTURERELOADER_HPP_ */
@@ -0,0 +1,185 @@
+//============================================================================
+// Name        : TextureStreamer.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : A Texture stays on the GPU at full resolution for as long
+//               as we have it, so the more images we load, the more video
+//               memory we use, whether they are on screen or not.
+//
+//               The TextureStreamer keeps the mip chains of its textures in
+//               system memory, and only puts on the GPU the levels that are
+//               needed, within a memory budget:
+//               - Every frame, we tell it how big each texture we draw is
+//                 on the screen (or just the mip level we want), and it
+//                 works out the finest level worth having.
+//               - Update() then loads the levels that are wanted, finest
+//                 first.  When that doesn't fit in the budget, it evicts
+//                 the high resolution levels of whatever was used the
+//                 longest time ago.
+//               - The small levels at the end of each chain always stay,
+//                 so there is always something to draw.
+//
+//               Changing the levels a texture has means making it again
+//               with the new size, so its ID changes after an Update().
+//
+//               The GPU side goes through a TextureBackend, so the budget
+//               logic can be tried out without any GL at all.
+//============================================================================
+
+#ifndef TEXTURESTREAMER_HPP_
+#define TEXTURESTREAMER_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <Eigen/Dense>
+
+using Eigen::Matrix4f;
+using Eigen::Vector3f;
+
+#include "MipmapGenerator.hpp"
+#include "Camera.hpp"
+
+
+// Where the levels go
+class TextureBackend
+{
+public:
+    virtual ~TextureBackend() {}
+
+    // Whether the pixels should be in BGRA order, instead of RGBA
+    virtual bool WantsBGRA() const { return false; }
+
+    // A texture with room for this many levels, the first of them being
+    // width x height.  0 if it can't be made.
+    virtual GLuint Create(int width, int height, int numLevels) = 0;
+
+    // Fill one of its levels with 4 byte pixels
+    virtual void Upload(GLuint texture, int level, int width, int height,
+                        const unsigned char *pixels) = 0;
+
+    virtual void Destroy(GLuint texture) = 0;
+};
+
+
+// The real thing, immutable GL textures.  Needs a current context.
+// Destroy() deletes the texture right away, rather than retiring its
+// name to the pool, so an eviction really gives the memory back.
+class GLTextureBackend : public TextureBackend
+{
+public:
+    bool WantsBGRA() const;
+
+    GLuint Create(int width, int height, int numLevels);
+    void Upload(GLuint texture, int level, int width, int height,
+                const unsigned char *pixels);
+    void Destroy(GLuint texture);
+};
+
+
+typedef uint32_t StreamedTexture;
+
+
+class TextureStreamer
+{
+public:
+    static const StreamedTexture None = 0xffffffff;
+
+    // Levels this small (on their longest side) and smaller are always
+    // resident.
+    static const int MinResidentSize = 32;
+
+    struct Stats
+    {
+        size_t bytesResident = 0;
+        size_t texturesResident = 0;  // textures the backend has made
+        size_t bytesRequested = 0;  // what last frame's requests add up to
+        size_t bytesUploaded = 0;
+        size_t misses = 0;  // requests for levels that weren't resident
+        size_t evictions = 0;  // levels taken off the GPU
+    };
+
+    // The backend and the generator have to outlive the streamer
+    TextureStreamer(TextureBackend& backend, size_t budgetBytes,
+                    const MipmapGenerator& generator);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Take an image of 4 byte pixels (in the backend's order), and load
+    // the smallest levels of it.
+    StreamedTexture Add(const unsigned char *pixels, int width, int height);
+
+    // Or read one from a file, None if it won't load.  JPEGs and PNGs go
+    // through Texture::Decoder(), the rest through SOIL.
+    StreamedTexture Load(const char *imagePath);
+
+    // The texture to draw with, which can change with every Update()
+    GLuint ID(StreamedTexture texture) const;
+
+    // The finest level on the GPU, and the number of levels there are
+    int ResidentLevel(StreamedTexture texture) const;
+    int NumLevels(StreamedTexture texture) const;
+
+    // We'd like to draw the texture with this level this frame
+    void Request(StreamedTexture texture, int level);
+
+    // Or work out the level from how big a bounding sphere the texture
+    // is stretched over looks on the screen
+    void Request(StreamedTexture texture,
+                 const Matrix4f& view, const Matrix4f& projection,
+                 const Vector3f& center, float radius, float viewportHeight);
+    void Request(StreamedTexture texture, Camera& camera,
+                 const Vector3f& center, float radius, float viewportHeight);
+
+    // The level to use for an image of this size that covers this many
+    // pixels on the screen
+    static int LevelForScreenSize(int width, int height, float screenPixels);
+
+    // Load and evict levels for this frame's requests.  Call it once a
+    // frame, after the requests.
+    void Update();
+
+    void SetBudget(size_t budgetBytes) { budget = budgetBytes; }
+    size_t Budget() const { return budget; }
+
+    const Stats& GetStats() const { return stats; }
+    size_t NumTextures() const { return textures.size(); }
+
+private:
+    struct Entry
+    {
+        std::vector<MipmapGenerator::Level> levels;  // level 0 included
+
+        GLuint id = 0;
+        int resident = 0;  // finest level on the GPU
+        int tail = 0;  // the coarsest level we'd ever have as the finest
+
+        // the finest level asked for in the frame it was last used in
+        int requested = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    // Bytes of the levels from 'level' on down
+    static size_t Bytes(const Entry& entry, int level);
+
+    // Make the texture again with 'level' as its finest
+    void MakeResident(Entry& entry, int level);
+
+    TextureBackend& backend;
+    const MipmapGenerator& generator;
+    size_t budget;
+
+    std::vector<Entry> textures;
+
+    uint64_t frame = 1;
+
+    Stats stats;
+};
+
+#endif /* TEXTURESTREAMER_HPP_ */
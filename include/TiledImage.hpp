@@ -0,0 +1,183 @@
+//============================================================================
+// Name        : TiledImage.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Shows a tiled image file (see TiledImageFile.hpp) of any
+//               size, bigger than GL_MAX_TEXTURE_SIZE, or than the video
+//               memory we have, by keeping only the tiles we can see on
+//               the GPU, each in a texture of its own.
+//
+//               The image is a unit square, x going right and y going down
+//               the image, placed in the world by a model matrix.  Every
+//               frame, Update() walks down the levels from the top,
+//               skipping tiles outside the view, until the tiles have at
+//               least as many texels across as they take pixels on the
+//               screen.  The tiles that aren't resident get read on a
+//               thread of our own:
+//               - the reading thread touches the tile in the mapped file,
+//                 which pages it in from the disk, and converts it to 4
+//                 byte pixels, into one of a few buffers,
+//               - Update() uploads a few of the finished ones each frame,
+//                 and hands their buffers back.
+//               So the memory we use is bounded by the buffers and the
+//               number of resident tiles, whatever the size of the image.
+//               Until a tile gets there, we draw that part of the image
+//               with the finest resident tile above it.  The top level is
+//               always kept, so there is always something.
+//
+//               Tiles() then has what to draw: a texture, the part of the
+//               image it covers, and the texture coordinates for that.
+//
+//               Everything but the reading happens on the thread with the
+//               GL context.
+//============================================================================
+
+#ifndef TILEDIMAGE_HPP_
+#define TILEDIMAGE_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include <GL/glew.h>
+
+#include <Eigen/Dense>
+
+using Eigen::Matrix4f;
+using Eigen::Vector2f;
+
+#include "TiledImageFile.hpp"
+#include "GLObject.hpp"
+#include "Camera.hpp"
+
+
+class TiledImage
+{
+public:
+    static const size_t DefaultMaxResident = 256;
+    static const int DefaultUploadsPerFrame = 8;
+
+    // Tiles that can be read ahead of being uploaded
+    static const int NumBuffers = 16;
+
+    struct DrawTile
+    {
+        GLuint texture;
+        int level;  // of the texture, which is coarser if it's a stand-in
+        Vector2f imageMin;  // the part of the image, in [0, 1]
+        Vector2f imageMax;
+        Vector2f uvMin;  // and where it is in the texture
+        Vector2f uvMax;
+    };
+
+    struct Stats
+    {
+        size_t tilesResident = 0;
+        size_t tilesUploaded = 0;
+        size_t tilesEvicted = 0;
+        size_t misses = 0;  // tiles we wanted that weren't there yet
+    };
+
+    explicit TiledImage(size_t maxResident = DefaultMaxResident,
+                        int uploadsPerFrame = DefaultUploadsPerFrame);
+    ~TiledImage();
+
+    TiledImage(const TiledImage&) = delete;
+    TiledImage& operator=(const TiledImage&) = delete;
+
+    // Needs a current GL context
+    bool Open(const std::string& path);
+    void Close();
+
+    int Width() const { return file.Width(); }
+    int Height() const { return file.Height(); }
+    int NumLevels() const { return file.NumLevels(); }
+
+    // Where the unit square of the image goes in the world
+    void SetModel(const Matrix4f& model) { this->model = model; }
+    const Matrix4f& Model() const { return model; }
+
+    // Pick the tiles for this view, upload what's been read and ask for
+    // what's missing.  Once a frame.
+    void Update(const Matrix4f& view, const Matrix4f& projection,
+                float viewportWidth, float viewportHeight);
+    void Update(Camera& camera, float viewportWidth, float viewportHeight);
+
+    const std::vector<DrawTile>& Tiles() const { return drawList; }
+
+    const Stats& GetStats() const { return stats; }
+
+    // What the read buffers take, in bytes
+    size_t BufferBytes() const;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+    typedef uint64_t TileKey;
+
+    static TileKey Key(int level, int tileX, int tileY);
+    static int KeyLevel(TileKey key) { return (int)(key >> 48); }
+    static int KeyX(TileKey key) { return (int)(key & 0xffffff); }
+    static int KeyY(TileKey key) { return (int)((key >> 24) & 0xffffff); }
+
+    struct Resident
+    {
+        GLTexture texture;
+        uint64_t lastUsed = 0;
+    };
+
+    struct ReadTile
+    {
+        TileKey key;
+        int buffer;
+    };
+
+    // The part of the image a tile covers
+    void TileRect(int level, int tileX, int tileY,
+                  Vector2f& imageMin, Vector2f& imageMax) const;
+
+    void Select(int level, int tileX, int tileY, const Matrix4f& mvp,
+                float viewportWidth, float viewportHeight);
+    void AddDrawTile(int level, int tileX, int tileY);
+
+    void Upload(const ReadTile& read);
+    void Evict();
+
+    void ReadLoop();
+
+    TiledImageFile file;
+    Matrix4f model = Matrix4f::Identity();
+
+    size_t maxResident;
+    int uploadsPerFrame;
+    bool bgra = false;
+
+    std::unordered_map<TileKey, Resident> resident;
+    std::vector<TileKey> missing;
+    std::vector<DrawTile> drawList;
+    uint64_t frame = 1;
+
+    Stats stats;
+
+    // Shared with the reading thread
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<TileKey> requests;
+    std::unordered_set<TileKey> busy;  // being read, or waiting to upload
+    std::vector<std::vector<unsigned char>> buffers;
+    std::vector<int> freeBuffers;
+    std::deque<ReadTile> finished;
+    bool stopping = false;
+
+    std::thread thread;
+};
+
+#endif /* TILEDIMAGE_HPP_ */
@@ -0,0 +1,159 @@
+//============================================================================
+// Name        : TiledImageFile.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : An image too big to decode in one piece, or to fit in one
+//               texture, gets cut up into square tiles and written out as a
+//               tiled image file.  The file has the whole image, and a
+//               pyramid of smaller and smaller copies of it, down to the
+//               level that fits in one tile.  So we can look at any part of
+//               it, at any size, by reading a handful of tiles.
+//
+//               The layout of a tiled image file is:
+//               - A 64 byte header
+//               - The tiles of level 0 (the full image), row by row, then
+//                 the tiles of level 1 (half the size), and so on, starting
+//                 on a 64 byte boundary.
+//               Every tile is tileSize x tileSize tightly packed RGB pixels.
+//               Tiles on the right and bottom edges that hang off the image
+//               repeat its last column and row.  Each level is half the size
+//               of the one above it, rounded down, like GL's mip levels.
+//
+//               The TiledImageWriter takes the image a few rows at a time,
+//               so it never needs more than a band of tiles for each level
+//               in memory.  The TiledImageFile memory maps the result.
+//
+//               Everything is little-endian.
+//============================================================================
+
+#ifndef TILEDIMAGEFILE_HPP_
+#define TILEDIMAGEFILE_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "MappedFile.hpp"
+
+
+struct TiledImageHeader
+{
+    static const uint32_t Magic = 0x454c4954;  // "TILE"
+    static const uint32_t Version = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    uint32_t numLevels;
+    uint64_t dataOffset;
+    uint64_t fileSize;
+    uint64_t padding[3];
+};
+
+struct TiledImageLevel
+{
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+    uint64_t offset;  // of its first tile, from the start of the file
+};
+
+
+class TiledImageFile
+{
+public:
+    static const int DefaultTileSize = 256;
+
+    // The levels of an image this size, and where they go in the file
+    static std::vector<TiledImageLevel> Levels(int width, int height,
+                                               int tileSize,
+                                               uint64_t dataOffset);
+
+    TiledImageFile() {}
+
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return file.IsOpen(); }
+
+    int Width() const { return levels.empty() ? 0 : levels[0].width; }
+    int Height() const { return levels.empty() ? 0 : levels[0].height; }
+    int TileSize() const { return tileSize; }
+    size_t TileBytes() const { return (size_t)tileSize * tileSize * 3; }
+
+    int NumLevels() const { return (int)levels.size(); }
+    const TiledImageLevel& Level(int level) const { return levels[level]; }
+
+    // A tile's pixels, straight out of the mapping.  Touching them is what
+    // reads them from the disk.
+    const unsigned char *Tile(int level, int tileX, int tileY) const;
+
+private:
+    MappedFile file;
+    int tileSize = 0;
+    std::vector<TiledImageLevel> levels;
+};
+
+
+// Writes a tiled image file from rows of RGB pixels, top to bottom
+class TiledImageWriter
+{
+public:
+    TiledImageWriter() {}
+    ~TiledImageWriter() { Close(); }
+
+    TiledImageWriter(const TiledImageWriter&) = delete;
+    TiledImageWriter& operator=(const TiledImageWriter&) = delete;
+
+    bool Open(const std::string& path, int width, int height,
+              int tileSize = TiledImageFile::DefaultTileSize);
+
+    // The next rows of the image, tightly packed RGB
+    bool WriteRows(const unsigned char *rgb, int numRows);
+
+    // Finish the file.  False if we didn't get every row, or couldn't
+    // write them.
+    bool Close();
+
+    // What we're holding on to, in bytes
+    size_t BufferBytes() const;
+
+    // Tile a binary PPM (P6) file, reading it a band at a time
+    static bool ConvertPPM(const std::string& ppmPath,
+                           const std::string& tiledPath,
+                           int tileSize = TiledImageFile::DefaultTileSize);
+
+private:
+    // The rows of one level that haven't made it into tiles yet
+    struct LevelState
+    {
+        TiledImageLevel level;
+        std::vector<unsigned char> band;  // up to tileSize rows
+        int bandRows = 0;
+        int bandIndex = 0;  // which row of tiles it is
+        int rowsDone = 0;
+
+        // The smaller level is made from pairs of rows
+        std::vector<unsigned char> pendingRow;
+        bool hasPendingRow = false;
+        std::vector<unsigned char> halfRow;
+    };
+
+    void AddRow(int level, const unsigned char *row);
+    void FlushBand(LevelState& state);
+
+    std::ofstream output;
+    std::string path;
+    int tileSize = 0;
+
+    std::vector<LevelState> levels;
+    std::vector<unsigned char> tile;
+};
+
+#endif /* TILEDIMAGEFILE_HPP_ */
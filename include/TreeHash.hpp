@@ -0,0 +1,59 @@
+//============================================================================
+// Name        : TreeHash.hpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Hashing a big file with SpookyHash's Init()/Update()/Final()
+//               goes through it one block after another, on one thread, so
+//               checking a multi-gigabyte asset pack takes as long as one
+//               core takes to get through it.
+//
+//               A TreeHash cuts the bytes into chunks of a fixed size, and
+//               hashes each chunk with SpookyHash::Hash128(), one chunk per
+//               job on a JobSystem.  The root hash is the Hash128() of the
+//               chunk hashes, in order, seeded with the total size and the
+//               chunk size.  Since the chunks don't depend on each other
+//               or on which thread got them, the hash is the same however
+//               many threads there are.  It does depend on the chunk size,
+//               so hashes are only comparable if they used the same one.
+//
+//               It isn't SpookyHash's hash of the bytes, and isn't meant to
+//               be.
+//============================================================================
+
+#ifndef TREEHASH_HPP_
+#define TREEHASH_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "JobSystem.hpp"
+
+
+class TreeHash
+{
+public:
+    static const size_t DefaultChunkSize = 4 * 1024 * 1024;
+
+    // With no JobSystem, the chunks get hashed on the calling thread.  The
+    // jobs have to outlive us.
+    explicit TreeHash(JobSystem *jobs = nullptr,
+                      size_t chunkSize = DefaultChunkSize);
+
+    size_t ChunkSize() const { return chunkSize; }
+
+    // Like SpookyHash::Hash128(), but there are no seeds going in
+    void Hash(const void *data, size_t size,
+              uint64_t& hash1, uint64_t& hash2) const;
+
+    // The whole file, memory mapped.  False if it can't be opened.
+    bool HashFile(const std::string& path,
+                  uint64_t& hash1, uint64_t& hash2) const;
+
+private:
+    JobSystem *jobs;
+    size_t chunkSize;
+};
+
+#endif /* TREEHASH_HPP_ */
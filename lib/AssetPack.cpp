@@ -0,0 +1,340 @@
+//============================================================================
+// Name        : AssetPack.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Our demos open every shader and image as a separate file,
+//               with a path pasted together from the resource folder.
+//               An asset pack puts all of them in one file instead, which
+//               we memory map once and then hand out pieces of it without
+//               copying anything.
+//============================================================================
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "SpookyV2.h"
+#include "AssetPack.hpp"
+
+static_assert(sizeof(AssetPackHeader) == 64, "pack header must be 64 bytes");
+static_assert(sizeof(AssetPackEntry) == 32, "pack entries must be 32 bytes");
+
+const uint32_t AssetPackHeader::Magic;
+const uint32_t AssetPackHeader::Version;
+const size_t AssetPack::Alignment;
+const uint64_t AssetPack::HashSeed;
+
+namespace {
+    uint64_t AlignUp(uint64_t offset)
+    {
+        return (offset + AssetPack::Alignment - 1) &
+               ~(uint64_t)(AssetPack::Alignment - 1);
+    }
+}
+
+
+uint64_t AssetPack::HashPath(const std::string& logicalPath)
+{
+    return SpookyHash::Hash64(logicalPath.data(), logicalPath.size(),
+                              HashSeed);
+}
+
+
+bool AssetPack::Open(const std::string& packPath)
+{
+    Close();
+
+    if (!file.Open(packPath))
+        return false;
+
+    const unsigned char *base = file.Data();
+    size_t fileSize = file.Size();
+
+    AssetPackHeader header;
+
+    if (fileSize < sizeof(header)) {
+        cout << "AssetPack::Open(): " << packPath
+             << " is too small to be a pack" << endl;
+        Close();
+        return false;
+    }
+
+    std::memcpy(&header, base, sizeof(header));
+
+    if (header.magic != AssetPackHeader::Magic ||
+            header.version != AssetPackHeader::Version)
+    {
+        cout << "AssetPack::Open(): " << packPath
+             << " is not a version " << AssetPackHeader::Version
+             << " asset pack" << endl;
+        Close();
+        return false;
+    }
+
+    uint64_t indexEnd = header.indexOffset +
+                        (uint64_t)header.numEntries * sizeof(AssetPackEntry);
+
+    if (header.fileSize != fileSize || header.hashSeed != HashSeed ||
+            header.indexOffset % alignof(AssetPackEntry) != 0 ||
+            indexEnd > header.pathsOffset ||
+            header.pathsOffset > header.payloadOffset ||
+            header.payloadOffset > fileSize)
+    {
+        cout << "AssetPack::Open(): " << packPath
+             << " has a bad header" << endl;
+        Close();
+        return false;
+    }
+
+    entries = reinterpret_cast<const AssetPackEntry *>(base +
+                                                       header.indexOffset);
+    paths = reinterpret_cast<const char *>(base + header.pathsOffset);
+    numEntries = header.numEntries;
+
+    // Make sure nothing points outside the file, so we don't have to
+    // check on every lookup.
+    uint64_t pathsSize = header.payloadOffset - header.pathsOffset;
+
+    for (size_t i = 0; i < numEntries; i++) {
+        const AssetPackEntry& entry = entries[i];
+
+        if (entry.offset < header.payloadOffset ||
+                entry.offset + entry.size > fileSize ||
+                (uint64_t)entry.pathOffset + entry.pathLength > pathsSize ||
+                (i > 0 && entries[i - 1].hash > entry.hash))
+        {
+            cout << "AssetPack::Open(): " << packPath
+                 << " has a bad index entry (" << i << ")" << endl;
+            Close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void AssetPack::Close()
+{
+    file.Close();
+
+    entries = nullptr;
+    paths = nullptr;
+    numEntries = 0;
+}
+
+
+AssetSpan AssetPack::Find(const std::string& logicalPath) const
+{
+    AssetSpan span;
+
+    if (entries == nullptr)
+        return span;
+
+    uint64_t hash = HashPath(logicalPath);
+
+    const AssetPackEntry *end = entries + numEntries;
+    const AssetPackEntry *entry = std::lower_bound(entries, end, hash,
+        [](const AssetPackEntry& e, uint64_t h) { return e.hash < h; });
+
+    // The writer refuses real collisions, but a path that isn't in the
+    // pack could still land on somebody else's hash.
+    for (; entry != end && entry->hash == hash; entry++) {
+        if (entry->pathLength == logicalPath.size() &&
+                std::memcmp(paths + entry->pathOffset, logicalPath.data(),
+                            logicalPath.size()) == 0)
+        {
+            span.data = file.Data() + entry->offset;
+            span.size = entry->size;
+            break;
+        }
+    }
+
+    return span;
+}
+
+
+bool AssetPack::Contains(const std::string& logicalPath) const
+{
+    return !Find(logicalPath).empty();
+}
+
+
+std::string AssetPack::AssetPath(size_t idx) const
+{
+    if (idx >= numEntries)
+        return std::string();
+
+    return std::string(paths + entries[idx].pathOffset,
+                       entries[idx].pathLength);
+}
+
+
+AssetSpan AssetPack::Asset(size_t idx) const
+{
+    AssetSpan span;
+
+    if (idx < numEntries) {
+        span.data = file.Data() + entries[idx].offset;
+        span.size = entries[idx].size;
+    }
+
+    return span;
+}
+
+
+//
+// AssetPackWriter
+//
+
+bool AssetPackWriter::AddFile(const std::string& logicalPath,
+                              const std::string& filePath)
+{
+    std::ifstream input(filePath.c_str(), std::ios::in | std::ios::binary);
+
+    if (!input) {
+        cout << "AssetPackWriter::AddFile(): could not open "
+             << filePath << endl;
+        return false;
+    }
+
+    std::vector<unsigned char> contents(
+        (std::istreambuf_iterator<char>(input)),
+        std::istreambuf_iterator<char>());
+
+    if (input.bad()) {
+        cout << "AssetPackWriter::AddFile(): could not read "
+             << filePath << endl;
+        return false;
+    }
+
+    return AddData(logicalPath, contents.data(), contents.size());
+}
+
+
+bool AssetPackWriter::AddData(const std::string& logicalPath,
+                              const void *data, size_t size)
+{
+    uint64_t hash = AssetPack::HashPath(logicalPath);
+
+    for (const PendingAsset& asset : assets) {
+        if (asset.hash != hash)
+            continue;
+
+        if (asset.path == logicalPath)
+            cout << "AssetPackWriter::AddData(): " << logicalPath
+                 << " was already added" << endl;
+        else
+            cout << "AssetPackWriter::AddData(): " << logicalPath
+                 << " has the same hash as " << asset.path << endl;
+
+        return false;
+    }
+
+    PendingAsset asset;
+    asset.path = logicalPath;
+    asset.hash = hash;
+    asset.data.assign(static_cast<const unsigned char *>(data),
+                      static_cast<const unsigned char *>(data) + size);
+
+    assets.push_back(std::move(asset));
+
+    return true;
+}
+
+
+bool AssetPackWriter::Write(const std::string& packPath) const
+{
+    // The index is sorted by hash, so we can binary search it
+    std::vector<size_t> order(assets.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return assets[a].hash < assets[b].hash;
+    });
+
+    AssetPackHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    header.magic = AssetPackHeader::Magic;
+    header.version = AssetPackHeader::Version;
+    header.numEntries = (uint32_t)assets.size();
+    header.indexOffset = sizeof(header);
+    header.pathsOffset = header.indexOffset +
+                         assets.size() * sizeof(AssetPackEntry);
+    header.hashSeed = AssetPack::HashSeed;
+
+    std::string paths;
+    std::vector<AssetPackEntry> entries(assets.size());
+
+    for (size_t i = 0; i < order.size(); i++) {
+        const PendingAsset& asset = assets[order[i]];
+
+        entries[i].hash = asset.hash;
+        entries[i].size = asset.data.size();
+        entries[i].pathOffset = (uint32_t)paths.size();
+        entries[i].pathLength = (uint32_t)asset.path.size();
+
+        paths += asset.path;
+    }
+
+    header.payloadOffset = AlignUp(header.pathsOffset + paths.size());
+
+    uint64_t offset = header.payloadOffset;
+    for (size_t i = 0; i < order.size(); i++) {
+        entries[i].offset = offset;
+        offset = AlignUp(offset + entries[i].size);
+    }
+
+    header.fileSize = offset;
+
+    std::ofstream output(packPath.c_str(),
+                         std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!output) {
+        cout << "AssetPackWriter::Write(): could not open "
+             << packPath << endl;
+        return false;
+    }
+
+    const char zeros[AssetPack::Alignment] = {0};
+    uint64_t written = 0;
+
+    auto writeBytes = [&](const void *bytes, size_t size) {
+        output.write(static_cast<const char *>(bytes), size);
+        written += size;
+    };
+
+    auto padTo = [&](uint64_t target) {
+        writeBytes(zeros, (size_t)(target - written));
+    };
+
+    writeBytes(&header, sizeof(header));
+    writeBytes(entries.data(), entries.size() * sizeof(AssetPackEntry));
+    writeBytes(paths.data(), paths.size());
+
+    for (size_t i = 0; i < order.size(); i++) {
+        const PendingAsset& asset = assets[order[i]];
+
+        padTo(entries[i].offset);
+        writeBytes(asset.data.data(), asset.data.size());
+    }
+
+    padTo(header.fileSize);
+
+    if (!output.good()) {
+        cout << "AssetPackWriter::Write(): could not write "
+             << packPath << endl;
+        return false;
+    }
+
+    return true;
+}
@@ -268,3 +268,23 @@ void Camera::setPerspective()
 }
 
 
+
+
+// Gribb and Hartmann's "Fast Extraction of Viewing Frustum Planes from the
+// World-View-Projection Matrix".  A point is inside the clip volume when
+// -w <= x, y, z <= w, and each of those six is a plane made of the rows
+// of the matrix.
+void Camera::FrustumPlanes(Vector4f planes[6])
+{
+    Matrix4f mx = ViewProjection();
+
+    planes[0] = mx.row(3) + mx.row(0);
+    planes[1] = mx.row(3) - mx.row(0);
+    planes[2] = mx.row(3) + mx.row(1);
+    planes[3] = mx.row(3) - mx.row(1);
+    planes[4] = mx.row(3) + mx.row(2);
+    planes[5] = mx.row(3) - mx.row(2);
+
+    for (int i = 0; i < 6; i++)
+        planes[i] /= planes[i].head<3>().norm();
+}
@@ -0,0 +1,160 @@
+//============================================================================
+// Name        : FileWatcher.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Tells us when files we care about have been written, using
+//               inotify on the folders they are in.
+//============================================================================
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "FileWatcher.hpp"
+
+
+FileWatcher::FileWatcher()
+    : changed(false)
+{
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        cout << "FileWatcher: inotify_init1() failed: "
+             << std::strerror(errno) << endl;
+        return;
+    }
+
+    // Writing to this pipe wakes the thread up so it can quit
+    if (pipe2(stopPipe, O_CLOEXEC) != 0) {
+        cout << "FileWatcher: pipe2() failed: "
+             << std::strerror(errno) << endl;
+        close(inotifyFd);
+        inotifyFd = -1;
+        return;
+    }
+
+    thread = std::thread(&FileWatcher::Run, this);
+}
+
+
+FileWatcher::~FileWatcher()
+{
+    if (thread.joinable()) {
+        char stop = 1;
+        while (write(stopPipe[1], &stop, 1) < 0 && errno == EINTR)
+            ;
+        thread.join();
+    }
+
+    if (stopPipe[0] >= 0) {
+        close(stopPipe[0]);
+        close(stopPipe[1]);
+    }
+
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+}
+
+
+bool FileWatcher::Watch(const std::string& path)
+{
+    if (inotifyFd < 0)
+        return false;
+
+    std::string::size_type slash = path.rfind('/');
+    std::string folder = (slash == std::string::npos) ? "."
+                                                      : path.substr(0, slash + 1);
+    std::string name = (slash == std::string::npos) ? path
+                                                    : path.substr(slash + 1);
+
+    // The same folder spelled differently gets the same watch descriptor
+    int wd = inotify_add_watch(inotifyFd, folder.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+        cout << "FileWatcher: could not watch " << folder << ": "
+             << std::strerror(errno) << endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    watches[wd][name].insert(path);
+
+    return true;
+}
+
+
+std::vector<std::string> FileWatcher::TakeChanges()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<std::string> taken(changes.begin(), changes.end());
+    changes.clear();
+    changed.store(false, std::memory_order_release);
+
+    return taken;
+}
+
+
+void FileWatcher::Run()
+{
+    // big enough for a bunch of events with their names
+    alignas(struct inotify_event) char buffer[16 * 1024];
+
+    struct pollfd fds[2];
+    fds[0].fd = inotifyFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stopPipe[0];
+    fds[1].events = POLLIN;
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+
+            cout << "FileWatcher: poll() failed: "
+                 << std::strerror(errno) << endl;
+            return;
+        }
+
+        if (fds[1].revents != 0)
+            return;
+
+        if ((fds[0].revents & POLLIN) == 0)
+            continue;
+
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (char *ptr = buffer; ptr < buffer + length; ) {
+                const struct inotify_event *event =
+                    reinterpret_cast<const struct inotify_event *>(ptr);
+                ptr += sizeof(struct inotify_event) + event->len;
+
+                if (event->len == 0)
+                    continue;
+
+                auto folder = watches.find(event->wd);
+                if (folder == watches.end())
+                    continue;
+
+                auto file = folder->second.find(event->name);
+                if (file == folder->second.end())
+                    continue;
+
+                changes.insert(file->second.begin(), file->second.end());
+                changed.store(true, std::memory_order_release);
+            }
+        }
+    }
+}
@@ -0,0 +1,126 @@
+//============================================================================
+// Name        : GLObject.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Pools of GL object names, so we generate them (and delete
+//               the ones without storage) in batches instead of one driver
+//               call at a time.
+//============================================================================
+
+#include <iostream>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "GLObject.hpp"
+
+const size_t GLNamePool::BatchSize;
+
+
+// The pools live until the program exits.  By then the context is
+// usually gone, so they don't try to delete anything on the way out.
+GLNamePool& GLNamePool::Get(Kind kind)
+{
+    static GLNamePool *pools[NumKinds] = {
+        new GLNamePool(Buffers),
+        new GLNamePool(Textures),
+        new GLNamePool(VertexArrays),
+        new GLNamePool(Samplers),
+    };
+
+    return *pools[kind];
+}
+
+
+void GLNamePool::FlushAll()
+{
+    for (int kind = 0; kind < NumKinds; kind++)
+        Get((Kind)kind).Flush();
+}
+
+
+GLuint GLNamePool::Allocate()
+{
+    if (freeNames.empty()) {
+        freeNames.resize(BatchSize);
+        Generate((GLsizei)BatchSize, freeNames.data());
+    }
+
+    GLuint name = freeNames.back();
+    freeNames.pop_back();
+
+    return name;
+}
+
+
+void GLNamePool::Release(GLuint name)
+{
+    if (kind == Buffers || kind == Textures) {
+        Delete(1, &name);
+        return;
+    }
+
+    retiredNames.push_back(name);
+
+    if (retiredNames.size() >= BatchSize)
+        Flush();
+}
+
+
+void GLNamePool::Flush()
+{
+    if (retiredNames.empty())
+        return;
+
+    Delete((GLsizei)retiredNames.size(), retiredNames.data());
+    retiredNames.clear();
+}
+
+
+void GLNamePool::Generate(GLsizei count, GLuint *names)
+{
+    genCalls++;
+
+    switch (kind) {
+    case Buffers:
+        glGenBuffers(count, names);
+        break;
+    case Textures:
+        glGenTextures(count, names);
+        break;
+    case VertexArrays:
+        glGenVertexArrays(count, names);
+        break;
+    case Samplers:
+        glGenSamplers(count, names);
+        break;
+    default:
+        break;
+    }
+}
+
+
+void GLNamePool::Delete(GLsizei count, const GLuint *names)
+{
+    deleteCalls++;
+
+    switch (kind) {
+    case Buffers:
+        glDeleteBuffers(count, names);
+        break;
+    case Textures:
+        glDeleteTextures(count, names);
+        break;
+    case VertexArrays:
+        glDeleteVertexArrays(count, names);
+        break;
+    case Samplers:
+        glDeleteSamplers(count, names);
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,190 @@
+//============================================================================
+// Name        : GameLoop.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Up to now our demos have advanced their animation and camera
+//               by whatever deltaTime the render loop happened to measure.
+//               That couples the simulation to the frame rate; a heavy
+//               frame makes for a big, jerky simulation step, and a fast
+//               GPU makes us simulate far more often than we need to.
+//
+//               This GameLoop runs the simulation on its own thread at a
+//               fixed tick rate.  Each tick produces a SimulationState,
+//               and the renderer asks for a blend of the two most recent
+//               states based upon how far into the current tick we are.
+//============================================================================
+
+#include <algorithm>
+
+#include "GameLoop.hpp"
+
+using Eigen::Matrix3f;
+using Eigen::Vector3f;
+using Eigen::Quaternionf;
+
+
+Affine3f interpolate(const Affine3f& from, const Affine3f& to, float alpha)
+{
+    Matrix3f fromRot, fromScale;
+    Matrix3f toRot, toScale;
+
+    from.computeRotationScaling(&fromRot, &fromScale);
+    to.computeRotationScaling(&toRot, &toScale);
+
+    Quaternionf rot = Quaternionf(fromRot).slerp(alpha, Quaternionf(toRot));
+    Matrix3f scale = fromScale + (toScale - fromScale) * alpha;
+    Vector3f trans = from.translation()
+                   + (to.translation() - from.translation()) * alpha;
+
+    Affine3f result = Affine3f::Identity();
+    result.linear() = rot.toRotationMatrix() * scale;
+    result.translation() = trans;
+
+    return result;
+}
+
+
+GameLoop::GameLoop(double ticksPerSecond, unsigned maxCatchUpTicks)
+    : tickNanoseconds(0), maxCatchUpTicks(0)
+{
+    setTickRate(ticksPerSecond);
+    setMaxCatchUpTicks(maxCatchUpTicks);
+}
+
+
+GameLoop::~GameLoop()
+{
+    stop();
+}
+
+
+void GameLoop::setTickRate(double ticksPerSecond)
+{
+    // anything less than one tick per minute is probably a mistake
+    ticksPerSecond = std::max(ticksPerSecond, 1.0 / 60.0);
+
+    tickNanoseconds = (int64_t)(1.0e9 / ticksPerSecond);
+}
+
+
+void GameLoop::setMaxCatchUpTicks(unsigned maxTicks)
+{
+    // we always need to be able to run at least one tick
+    maxCatchUpTicks = std::max(maxTicks, 1u);
+}
+
+
+double GameLoop::TickRate() const
+{
+    return 1.0e9 / tickNanoseconds;
+}
+
+
+float GameLoop::TickInterval() const
+{
+    return tickNanoseconds * 1.0e-9;
+}
+
+
+void GameLoop::start(const SimulationState& initialState, TickFunction tick)
+{
+    stop();
+
+    tickFunction = tick;
+    working = initialState;
+
+    // Until the first tick we just have the initial state to show.
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        previous = initialState;
+        current = initialState;
+        currentTime = Clock::now();
+    }
+
+    running = true;
+    simThread = std::thread(&GameLoop::run, this);
+}
+
+
+void GameLoop::stop()
+{
+    running = false;
+
+    if (simThread.joinable())
+        simThread.join();
+}
+
+
+void GameLoop::interpolate(SimulationState& out) const
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+
+    std::chrono::duration<float> sinceTick = Clock::now() - currentTime;
+    float alpha = std::min(std::max(sinceTick.count() / TickInterval(), 0.0f),
+                           1.0f);
+
+    out.tick = current.tick;
+    out.matrices = current.matrices;
+    out.transforms.resize(current.transforms.size());
+
+    for (size_t i = 0; i < current.transforms.size(); i++) {
+        if (i < previous.transforms.size())
+            out.transforms[i] = ::interpolate(previous.transforms[i],
+                                              current.transforms[i],
+                                              alpha);
+        else
+            out.transforms[i] = current.transforms[i];
+    }
+}
+
+
+void GameLoop::run()
+{
+    Clock::time_point prevTime = Clock::now();
+    Clock::duration accumulator(0);
+
+    while (running) {
+        Clock::duration interval = std::chrono::nanoseconds(tickNanoseconds);
+        Clock::duration maxBacklog = interval * (int64_t)maxCatchUpTicks;
+
+        Clock::time_point now = Clock::now();
+        accumulator += now - prevTime;
+        prevTime = now;
+
+        // If we have fallen too far behind, we drop the ticks we can't
+        // afford instead of trying to run all of them.  Otherwise a slow
+        // tick makes the next frame slower, and so on.
+        if (accumulator > maxBacklog) {
+            ticksDropped += (accumulator - maxBacklog) / interval;
+            accumulator = maxBacklog;
+        }
+
+        float deltaTime = std::chrono::duration<float>(interval).count();
+
+        while (accumulator >= interval && running) {
+            tickFunction(working, deltaTime);
+            working.tick++;
+            ticksRun++;
+
+            accumulator -= interval;
+
+            publish(working);
+        }
+
+        std::this_thread::sleep_until(now + (interval - accumulator));
+    }
+}
+
+
+void GameLoop::publish(const SimulationState& state)
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+
+    // swap instead of copying twice, so we reuse the vector storage
+    std::swap(previous, current);
+    current.tick = state.tick;
+    current.transforms = state.transforms;
+    current.matrices = state.matrices;
+    currentTime = Clock::now();
+}
@@ -0,0 +1,431 @@
+//============================================================================
+// Name        : GeometryArena.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Lots of meshes in one vertex buffer and one index buffer,
+//               drawn with base vertices, and packed together again on the
+//               GPU when enough of them have been removed.
+//============================================================================
+
+#include <iostream>
+#include <algorithm>
+#include <cstddef>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "GeometryArena.hpp"
+#include "MeshOptimizer.hpp"
+
+const GeometryArena::Handle GeometryArena::InvalidHandle;
+
+namespace {
+    bool MovedFrom(const RangeAllocator::Move& move, size_t offset)
+    {
+        return move.from < offset;
+    }
+}
+
+
+VertexLayout GeometryArena::MeshVertexLayout()
+{
+    VertexLayout layout;
+
+    layout.stride = sizeof(MeshVertex);
+    layout.attributes = {
+        { 0, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, position) },
+        { 1, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, normal) },
+        { 2, 2, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, texCoord) }
+    };
+
+    return layout;
+}
+
+
+VertexLayout GeometryArena::QuantizedVertexLayout()
+{
+    VertexLayout layout;
+
+    layout.stride = sizeof(QuantizedVertex);
+    layout.attributes = {
+        { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+          offsetof(QuantizedVertex, position) },
+        { 1, 3, GL_BYTE, GL_TRUE, offsetof(QuantizedVertex, normal) },
+        { 2, 2, GL_UNSIGNED_SHORT, GL_TRUE,
+          offsetof(QuantizedVertex, texCoord) }
+    };
+
+    return layout;
+}
+
+
+GeometryArena::GeometryArena(const VertexLayout& layout,
+                             size_t vertexCapacity, size_t indexCapacity)
+    : layout(layout),
+      vertexRanges(vertexCapacity),
+      indexRanges(indexCapacity)
+{
+    vertexArray = GLVertexArray::Create();
+
+    if (!CreateBuffer(vertexBuffer, vertexCapacity * layout.stride) ||
+        !CreateBuffer(indexBuffer, indexCapacity * sizeof(uint32_t))) {
+        vertexRanges = RangeAllocator();
+        indexRanges = RangeAllocator();
+    }
+
+    SetupVertexArray();
+}
+
+
+GeometryArena::Handle GeometryArena::Add(const void *vertices,
+                                         size_t numVertices,
+                                         const uint32_t *indices,
+                                         size_t numIndices)
+{
+    if (vertices == nullptr || indices == nullptr ||
+        numVertices == 0 || numIndices == 0)
+        return InvalidHandle;
+
+    // An index past the mesh's vertices would draw some other mesh's
+    for (size_t i = 0; i < numIndices; i++) {
+        if (indices[i] >= numVertices) {
+            cout << "GeometryArena::Add(): index " << indices[i]
+                 << " is past the " << numVertices << " vertices" << endl;
+            return InvalidHandle;
+        }
+    }
+
+    // Compacting for the indices can only make more room for the vertices
+    if (!MakeRoom(vertexRanges, numVertices) ||
+        !MakeRoom(indexRanges, numIndices))
+        return InvalidHandle;
+
+    Range range;
+    range.firstVertex = vertexRanges.Allocate(numVertices);
+    range.numVertices = numVertices;
+    range.firstIndex = indexRanges.Allocate(numIndices);
+    range.numIndices = numIndices;
+
+    // The copy targets aren't part of any vertex array's state, so this
+    // doesn't disturb whatever is bound
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer.ID());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range.firstVertex * layout.stride,
+                    numVertices * layout.stride, vertices);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer.ID());
+    glBufferSubData(GL_COPY_WRITE_BUFFER,
+                    range.firstIndex * sizeof(uint32_t),
+                    numIndices * sizeof(uint32_t), indices);
+
+    Handle handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+        meshes[handle] = range;
+    }
+    else {
+        handle = (Handle)meshes.size();
+        meshes.push_back(range);
+    }
+
+    numMeshes++;
+    allChanged = true;
+
+    return handle;
+}
+
+
+GeometryArena::Handle GeometryArena::Add(const Mesh& mesh)
+{
+    if (layout.stride != sizeof(MeshVertex)) {
+        cout << "GeometryArena::Add(): the arena's vertices aren't "
+             << "MeshVertex" << endl;
+        return InvalidHandle;
+    }
+
+    return Add(mesh.Vertices(), mesh.NumVertices(),
+               mesh.Indices(), mesh.NumIndices());
+}
+
+
+void GeometryArena::Remove(Handle handle)
+{
+    if (!Contains(handle))
+        return;
+
+    Range& range = meshes[handle];
+
+    vertexRanges.Free(range.firstVertex);
+    indexRanges.Free(range.firstIndex);
+
+    range = Range();
+    freeHandles.push_back(handle);
+
+    numMeshes--;
+    allChanged = true;
+}
+
+
+bool GeometryArena::Contains(Handle handle) const
+{
+    return handle < meshes.size() && meshes[handle].numIndices != 0;
+}
+
+
+size_t GeometryArena::Compact()
+{
+    // Both new buffers first, so that running out of memory leaves
+    // everything the way it was
+    GLBuffer vertices;
+    GLBuffer indices;
+
+    if (!CreateBuffer(vertices, vertexRanges.Capacity() * layout.stride) ||
+        !CreateBuffer(indices, indexRanges.Capacity() * sizeof(uint32_t)))
+        return 0;
+
+    std::vector<RangeAllocator::Move> vertexMoves = vertexRanges.Compact();
+    std::vector<RangeAllocator::Move> indexMoves = indexRanges.Compact();
+
+    if (vertexMoves.empty() && indexMoves.empty())
+        return 0;
+
+    size_t copied = 0;
+
+    // Where the first move goes, everything before it stayed put
+    if (!vertexMoves.empty()) {
+        copied += CopyRanges(vertexBuffer, vertices, layout.stride,
+                             vertexMoves[0].to, vertexMoves);
+        vertexBuffer = std::move(vertices);
+    }
+
+    if (!indexMoves.empty()) {
+        copied += CopyRanges(indexBuffer, indices, sizeof(uint32_t),
+                             indexMoves[0].to, indexMoves);
+        indexBuffer = std::move(indices);
+    }
+
+    // The moves are in order of where they came from
+    for (Range& range : meshes) {
+        if (range.numIndices == 0)
+            continue;
+
+        auto vertexMove = std::lower_bound(vertexMoves.begin(),
+                                           vertexMoves.end(),
+                                           range.firstVertex, MovedFrom);
+        if (vertexMove != vertexMoves.end() &&
+            vertexMove->from == range.firstVertex)
+            range.firstVertex = vertexMove->to;
+
+        auto indexMove = std::lower_bound(indexMoves.begin(),
+                                          indexMoves.end(),
+                                          range.firstIndex, MovedFrom);
+        if (indexMove != indexMoves.end() &&
+            indexMove->from == range.firstIndex)
+            range.firstIndex = indexMove->to;
+    }
+
+    SetupVertexArray();
+
+    compactions++;
+    bytesCopied += copied;
+    allChanged = true;
+
+    return copied;
+}
+
+
+double GeometryArena::Fragmentation() const
+{
+    return std::max(vertexRanges.Fragmentation(),
+                    indexRanges.Fragmentation());
+}
+
+
+void GeometryArena::Bind() const
+{
+    glBindVertexArray(vertexArray.ID());
+}
+
+
+void GeometryArena::Bind(StateTracker& state) const
+{
+    state.BindVertexArray(vertexArray.ID());
+}
+
+
+void GeometryArena::Draw(Handle handle, GLenum mode) const
+{
+    if (!Contains(handle))
+        return;
+
+    const Range& range = meshes[handle];
+
+    glDrawElementsBaseVertex(mode, (GLsizei)range.numIndices,
+                             GL_UNSIGNED_INT,
+                             (const void *)(range.firstIndex *
+                                            sizeof(uint32_t)),
+                             (GLint)range.firstVertex);
+}
+
+
+void GeometryArena::Draw(const Handle *handles, size_t numHandles,
+                         GLenum mode)
+{
+    counts.clear();
+    offsets.clear();
+    baseVertices.clear();
+
+    for (size_t i = 0; i < numHandles; i++) {
+        if (!Contains(handles[i]))
+            continue;
+
+        const Range& range = meshes[handles[i]];
+
+        counts.push_back((GLsizei)range.numIndices);
+        offsets.push_back((const void *)(range.firstIndex *
+                                         sizeof(uint32_t)));
+        baseVertices.push_back((GLint)range.firstVertex);
+    }
+
+    if (counts.empty())
+        return;
+
+    glMultiDrawElementsBaseVertex(mode, counts.data(), GL_UNSIGNED_INT,
+                                  offsets.data(), (GLsizei)counts.size(),
+                                  baseVertices.data());
+}
+
+
+void GeometryArena::DrawAll(GLenum mode)
+{
+    if (allChanged) {
+        allHandles.clear();
+
+        for (Handle handle = 0; handle < meshes.size(); handle++) {
+            if (Contains(handle))
+                allHandles.push_back(handle);
+        }
+
+        // In the order they are in the index buffer
+        std::sort(allHandles.begin(), allHandles.end(),
+                  [this](Handle a, Handle b) {
+                      return meshes[a].firstIndex < meshes[b].firstIndex;
+                  });
+
+        allChanged = false;
+    }
+
+    Draw(allHandles.data(), allHandles.size(), mode);
+}
+
+
+bool GeometryArena::MakeRoom(RangeAllocator& ranges, size_t size)
+{
+    if (ranges.LargestFree() >= size)
+        return true;
+
+    if (ranges.Available() >= size) {
+        Compact();
+
+        if (ranges.LargestFree() >= size)
+            return true;
+    }
+
+    // Double, or enough to fit after the last range, whichever is more
+    size_t capacity = std::max(ranges.Capacity() * 2, ranges.End() + size);
+
+    bool isVertices = (&ranges == &vertexRanges);
+    GLBuffer& buffer = isVertices ? vertexBuffer : indexBuffer;
+    size_t elementSize = isVertices ? layout.stride : sizeof(uint32_t);
+
+    GLBuffer grown;
+    if (!CreateBuffer(grown, capacity * elementSize))
+        return false;
+
+    bytesCopied += CopyRanges(buffer, grown, elementSize, ranges.End(),
+                              std::vector<RangeAllocator::Move>());
+    buffer = std::move(grown);
+    ranges.Grow(capacity);
+
+    SetupVertexArray();
+    grows++;
+
+    return true;
+}
+
+
+bool GeometryArena::CreateBuffer(GLBuffer& buffer, size_t bytes)
+{
+    GLenum err;
+
+    buffer = GLBuffer::Create();
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.ID());
+    glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+
+    if ((err = glGetError()) != GL_NO_ERROR) {
+        cout << "GeometryArena::CreateBuffer(): error: " << err
+             << " making a buffer of " << bytes << " bytes" << endl;
+        buffer.Reset();
+        return false;
+    }
+
+    return true;
+}
+
+
+size_t GeometryArena::CopyRanges(const GLBuffer& from, const GLBuffer& to,
+                                 size_t elementSize, size_t keep,
+                                 const std::vector<RangeAllocator::Move>&
+                                     moves)
+{
+    size_t copied = 0;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, from.ID());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, to.ID());
+
+    if (keep > 0) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            0, 0, keep * elementSize);
+        copied += keep * elementSize;
+    }
+
+    // Moves that were next to each other still are, so they can go in
+    // one copy
+    for (size_t i = 0; i < moves.size(); ) {
+        size_t from = moves[i].from;
+        size_t to = moves[i].to;
+        size_t size = moves[i].size;
+
+        for (i++; i < moves.size() && moves[i].from == from + size; i++)
+            size += moves[i].size;
+
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            from * elementSize, to * elementSize,
+                            size * elementSize);
+        copied += size * elementSize;
+    }
+
+    return copied;
+}
+
+
+void GeometryArena::SetupVertexArray()
+{
+    glBindVertexArray(vertexArray.ID());
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.ID());
+
+    for (const VertexAttribute& attribute : layout.attributes) {
+        glVertexAttribPointer(attribute.index, attribute.size,
+                              attribute.type, attribute.normalized,
+                              (GLsizei)layout.stride,
+                              (const void *)attribute.offset);
+        glEnableVertexAttribArray(attribute.index);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.ID());
+    glBindVertexArray(0);
+}
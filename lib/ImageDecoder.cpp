@@ -0,0 +1,621 @@
+//============================================================================
+// Name        : ImageDecoder.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Decodes JPEG and PNG images with libjpeg and libpng, into
+//               the caller's memory, on as many threads as we have.
+//============================================================================
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <csetjmp>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include "ImageDecoder.hpp"
+#include "PixelConvert.hpp"
+
+const size_t ImageBufferPool::DefaultMaxBuffers;
+const int ImageDecoder::MinSplitRows;
+
+
+std::vector<unsigned char> ImageBufferPool::Acquire(size_t size)
+{
+    std::vector<unsigned char> buffer;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        size_t best = buffers.size();
+
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (buffers[i].capacity() >= size &&
+                    (best == buffers.size() ||
+                     buffers[i].capacity() < buffers[best].capacity()))
+            {
+                best = i;
+            }
+        }
+
+        if (best < buffers.size()) {
+            buffer = std::move(buffers[best]);
+            buffers.erase(buffers.begin() + best);
+            hits++;
+        }
+        else {
+            misses++;
+        }
+    }
+
+    buffer.resize(size);
+    return buffer;
+}
+
+
+void ImageBufferPool::Release(std::vector<unsigned char>&& buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (buffers.size() < maxBuffers && buffer.capacity() > 0)
+        buffers.push_back(std::move(buffer));
+}
+
+
+size_t ImageBufferPool::NumFree() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return buffers.size();
+}
+
+
+namespace {
+    // libjpeg's default is to print the error and exit(), so we jump back
+    // out of it instead
+    struct JPEGError
+    {
+        jpeg_error_mgr manager;
+        jmp_buf jump;
+        char message[JMSG_LENGTH_MAX];
+    };
+
+    void JPEGErrorExit(j_common_ptr cinfo)
+    {
+        JPEGError *error = reinterpret_cast<JPEGError *>(cinfo->err);
+
+        (*cinfo->err->format_message)(cinfo, error->message);
+        longjmp(error->jump, 1);
+    }
+
+    // The warnings are about data it could get past, so we keep quiet
+    void JPEGOutputMessage(j_common_ptr)
+    {
+    }
+
+    bool JPEGColorSpace(ImageDecoder::Layout layout, J_COLOR_SPACE& space)
+    {
+#ifdef JCS_EXTENSIONS
+        switch (layout) {
+        case ImageDecoder::RGBA:
+            space = JCS_EXT_RGBA;
+            return true;
+        case ImageDecoder::BGRA:
+            space = JCS_EXT_BGRA;
+            return true;
+        default:
+            break;
+        }
+#endif
+        // Anything else gets converted from RGB a row at a time
+        space = JCS_RGB;
+        return layout == ImageDecoder::RGB;
+    }
+
+
+    // Decode numRows rows of a JPEG (or all of them, if it's negative)
+    // into pixels, after decoding skipRows rows and throwing them away.
+    bool DecodeJPEGRows(const unsigned char *data, size_t size,
+                        ImageDecoder::Layout layout,
+                        int skipRows, int numRows,
+                        unsigned char *pixels, size_t stride)
+    {
+        jpeg_decompress_struct cinfo;
+        JPEGError error;
+
+        cinfo.err = jpeg_std_error(&error.manager);
+        error.manager.error_exit = JPEGErrorExit;
+        error.manager.output_message = JPEGOutputMessage;
+
+        jpeg_create_decompress(&cinfo);
+
+        if (setjmp(error.jump)) {
+            cout << "ImageDecoder::Decode(): " << error.message << endl;
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
+
+        jpeg_mem_src(&cinfo, data, (unsigned long)size);
+        jpeg_read_header(&cinfo, TRUE);
+
+        J_COLOR_SPACE space;
+        bool direct = JPEGColorSpace(layout, space);
+
+        cinfo.out_color_space = space;
+        jpeg_start_decompress(&cinfo);
+
+        // Somewhere for the rows we skip, and the ones we convert.  It
+        // goes away with the decompressor.
+        JSAMPARRAY scratch = (*cinfo.mem->alloc_sarray)(
+            (j_common_ptr)&cinfo, JPOOL_IMAGE,
+            cinfo.output_width * cinfo.output_components, 1);
+
+        JDIMENSION end = cinfo.output_height;
+        if (numRows >= 0)
+            end = std::min(end, (JDIMENSION)(skipRows + numRows));
+
+        while (cinfo.output_scanline < (JDIMENSION)skipRows)
+            jpeg_read_scanlines(&cinfo, scratch, 1);
+
+        while (cinfo.output_scanline < end) {
+            unsigned char *dst = pixels +
+                                 (cinfo.output_scanline - skipRows) * stride;
+
+            JSAMPROW row = direct ? dst : scratch[0];
+            jpeg_read_scanlines(&cinfo, &row, 1);
+
+            if (direct)
+                continue;
+
+            if (layout == ImageDecoder::BGRA)
+                ConvertRGBToBGRA(scratch[0], dst, cinfo.output_width);
+            else
+                ConvertRGBToRGBA(scratch[0], dst, cinfo.output_width);
+        }
+
+        if (end == cinfo.output_height)
+            jpeg_finish_decompress(&cinfo);
+        else
+            jpeg_abort_decompress(&cinfo);
+
+        jpeg_destroy_decompress(&cinfo);
+
+        return true;
+    }
+
+
+    // Where the pieces of a baseline JPEG are, so we can cut it up at its
+    // restart markers
+    struct JPEGLayout
+    {
+        size_t heightOffset = 0;  // of the height in the frame header
+        size_t dataStart = 0;  // of the scan's entropy coded data
+        size_t dataEnd = 0;  // where the EOI marker is
+        int height = 0;
+        int intervalRows = 0;  // pixel rows between restart markers
+        std::vector<size_t> restarts;  // where each marker is
+    };
+
+    // False if it can't be cut up: it's progressive, or has more than one
+    // scan, or no restart markers, or they aren't at the ends of rows.
+    bool ParseJPEGLayout(const unsigned char *data, size_t size,
+                         JPEGLayout& layout)
+    {
+        if (size < 4 || data[0] != 0xff || data[1] != 0xd8)
+            return false;
+
+        int width = 0;
+        int numComponents = 0;
+        int maxH = 1;
+        int maxV = 1;
+        int interval = 0;
+        bool haveFrame = false;
+
+        size_t pos = 2;
+
+        while (true) {
+            if (pos + 4 > size || data[pos] != 0xff)
+                return false;
+
+            unsigned char marker = data[pos + 1];
+
+            // fill bytes
+            if (marker == 0xff) {
+                pos++;
+                continue;
+            }
+
+            size_t length = (data[pos + 2] << 8) | data[pos + 3];
+            const unsigned char *segment = data + pos + 4;
+
+            if (length < 2 || pos + 2 + length > size)
+                return false;
+
+            if (marker == 0xc0 || marker == 0xc1) {
+                if (length < 8)
+                    return false;
+
+                layout.heightOffset = pos + 5;
+                layout.height = (segment[1] << 8) | segment[2];
+                width = (segment[3] << 8) | segment[4];
+                numComponents = segment[5];
+
+                if (length < 8 + 3 * (size_t)numComponents)
+                    return false;
+
+                for (int c = 0; c < numComponents; c++) {
+                    unsigned char sampling = segment[6 + c * 3 + 1];
+                    maxH = std::max(maxH, sampling >> 4);
+                    maxV = std::max(maxV, sampling & 0xf);
+                }
+
+                haveFrame = true;
+            }
+            else if (marker >= 0xc2 && marker <= 0xcf && marker != 0xc4 &&
+                    marker != 0xc8)
+            {
+                // progressive, lossless or arithmetic coded
+                return false;
+            }
+            else if (marker == 0xdd) {
+                if (length < 4)
+                    return false;
+
+                interval = (segment[0] << 8) | segment[1];
+            }
+            else if (marker == 0xda) {
+                // The one scan has to have everything in it
+                if (!haveFrame || length < 3 || segment[0] != numComponents)
+                    return false;
+
+                layout.dataStart = pos + 2 + length;
+                break;
+            }
+
+            pos += 2 + length;
+        }
+
+        // Find the markers in the scan.  An 0xff in the data itself is
+        // always followed by a 0.
+        const unsigned char *end = data + size;
+        const unsigned char *p = data + layout.dataStart;
+
+        while (true) {
+            p = static_cast<const unsigned char *>(
+                std::memchr(p, 0xff, end - p));
+
+            if (p == nullptr || p + 1 >= end)
+                return false;
+
+            unsigned char next = p[1];
+
+            if (next == 0x00 || next == 0xff) {
+                p++;
+            }
+            else if (next >= 0xd0 && next <= 0xd7) {
+                layout.restarts.push_back(p - data);
+                p += 2;
+            }
+            else if (next == 0xd9) {
+                layout.dataEnd = p - data;
+                break;
+            }
+            else {
+                // another scan, or a DNL
+                return false;
+            }
+        }
+
+        if (layout.height == 0 || width == 0 || interval == 0)
+            return false;
+
+        // A scan of one component doesn't interleave, so its MCUs are
+        // single blocks
+        if (numComponents == 1) {
+            maxH = 1;
+            maxV = 1;
+        }
+
+        int mcuWidth = 8 * maxH;
+        int mcuHeight = 8 * maxV;
+        int mcusPerRow = (width + mcuWidth - 1) / mcuWidth;
+        int mcuRows = (layout.height + mcuHeight - 1) / mcuHeight;
+
+        if (interval % mcusPerRow != 0)
+            return false;
+
+        int intervalMCURows = interval / mcusPerRow;
+        size_t numIntervals = (mcuRows + intervalMCURows - 1) /
+                              intervalMCURows;
+
+        if (layout.restarts.size() + 1 != numIntervals)
+            return false;
+
+        layout.intervalRows = intervalMCURows * mcuHeight;
+
+        return true;
+    }
+
+
+    // A JPEG of just the restart intervals [first, last), which is
+    // 'height' rows high
+    std::vector<unsigned char> MakeJPEGBand(const unsigned char *data,
+                                            const JPEGLayout& layout,
+                                            size_t first, size_t last,
+                                            int height)
+    {
+        size_t numIntervals = layout.restarts.size() + 1;
+
+        size_t start = (first == 0) ? layout.dataStart
+                                    : layout.restarts[first - 1] + 2;
+        size_t end = (last == numIntervals) ? layout.dataEnd
+                                            : layout.restarts[last - 1];
+
+        std::vector<unsigned char> band;
+        band.reserve(layout.dataStart + (end - start) + 2);
+
+        band.insert(band.end(), data, data + layout.dataStart);
+        band.insert(band.end(), data + start, data + end);
+        band.push_back(0xff);
+        band.push_back(0xd9);
+
+        band[layout.heightOffset] = (unsigned char)(height >> 8);
+        band[layout.heightOffset + 1] = (unsigned char)(height & 0xff);
+
+        // The decoder wants the markers to count up from RST0 again
+        for (size_t k = first; k + 1 < last; k++) {
+            size_t offset = layout.dataStart + layout.restarts[k] - start;
+            band[offset + 1] = (unsigned char)(0xd0 + ((k - first) & 7));
+        }
+
+        return band;
+    }
+
+
+    bool DecodePNG(const unsigned char *data, size_t size,
+                   ImageDecoder::Layout layout,
+                   unsigned char *pixels, size_t stride)
+    {
+        png_image image;
+        std::memset(&image, 0, sizeof(image));
+        image.version = PNG_IMAGE_VERSION;
+
+        if (!png_image_begin_read_from_memory(&image, data, size)) {
+            cout << "ImageDecoder::Decode(): " << image.message << endl;
+            return false;
+        }
+
+        switch (layout) {
+        case ImageDecoder::RGB:
+            image.format = PNG_FORMAT_RGB;
+            break;
+        case ImageDecoder::RGBA:
+            image.format = PNG_FORMAT_RGBA;
+            break;
+        case ImageDecoder::BGRA:
+            image.format = PNG_FORMAT_BGRA;
+            break;
+        }
+
+        // The stride is in components, which are bytes for us
+        if (!png_image_finish_read(&image, nullptr, pixels,
+                                   (png_int_32)stride, nullptr))
+        {
+            cout << "ImageDecoder::Decode(): " << image.message << endl;
+            png_image_free(&image);
+            return false;
+        }
+
+        return true;
+    }
+}
+
+
+ImageDecoder::Format ImageDecoder::Identify(const unsigned char *data,
+                                            size_t size)
+{
+    static const unsigned char pngSignature[8] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+    };
+
+    if (size >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff)
+        return JPEG;
+
+    if (size >= 8 && std::memcmp(data, pngSignature, 8) == 0)
+        return PNG;
+
+    return Unknown;
+}
+
+
+bool ImageDecoder::ReadInfo(const unsigned char *data, size_t size,
+                            Info& info)
+{
+    info = Info();
+
+    switch (Identify(data, size)) {
+    case JPEG:
+    {
+        jpeg_decompress_struct cinfo;
+        JPEGError error;
+
+        cinfo.err = jpeg_std_error(&error.manager);
+        error.manager.error_exit = JPEGErrorExit;
+        error.manager.output_message = JPEGOutputMessage;
+
+        jpeg_create_decompress(&cinfo);
+
+        if (setjmp(error.jump)) {
+            cout << "ImageDecoder::ReadInfo(): " << error.message << endl;
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
+
+        jpeg_mem_src(&cinfo, data, (unsigned long)size);
+        jpeg_read_header(&cinfo, TRUE);
+
+        info.format = JPEG;
+        info.width = cinfo.image_width;
+        info.height = cinfo.image_height;
+
+        jpeg_destroy_decompress(&cinfo);
+        return true;
+    }
+    case PNG:
+    {
+        png_image image;
+        std::memset(&image, 0, sizeof(image));
+        image.version = PNG_IMAGE_VERSION;
+
+        if (!png_image_begin_read_from_memory(&image, data, size)) {
+            cout << "ImageDecoder::ReadInfo(): " << image.message << endl;
+            return false;
+        }
+
+        info.format = PNG;
+        info.width = image.width;
+        info.height = image.height;
+
+        png_image_free(&image);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+
+bool ImageDecoder::Decode(const unsigned char *data, size_t size,
+                          Layout layout, unsigned char *pixels,
+                          size_t stride) const
+{
+    switch (Identify(data, size)) {
+    case JPEG:
+        return DecodeJPEG(data, size, layout, pixels, stride);
+    case PNG:
+        return DecodePNG(data, size, layout, pixels, stride);
+    default:
+        cout << "ImageDecoder::Decode(): not a JPEG or a PNG" << endl;
+        return false;
+    }
+}
+
+
+bool ImageDecoder::Decode(const unsigned char *data, size_t size,
+                          Layout layout, Image& image) const
+{
+    Info info;
+    if (!ReadInfo(data, size, info))
+        return false;
+
+    size_t stride = (size_t)info.width * BytesPerPixel(layout);
+    size_t bytes = stride * info.height;
+
+    Release(image);
+
+    if (pool != nullptr)
+        image.pixels = pool->Acquire(bytes);
+    else
+        image.pixels.resize(bytes);
+
+    image.width = info.width;
+    image.height = info.height;
+
+    if (!Decode(data, size, layout, image.pixels.data(), stride)) {
+        Release(image);
+        return false;
+    }
+
+    return true;
+}
+
+
+void ImageDecoder::DecodeBatch(std::vector<Request>& requests,
+                               Layout layout) const
+{
+    auto decode = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Request& request = requests[i];
+            request.decoded = Decode(request.data, request.size, layout,
+                                     request.image);
+        }
+    };
+
+    if (jobs != nullptr)
+        jobs->ParallelFor(0, requests.size(), 1, decode);
+    else
+        decode(0, requests.size());
+}
+
+
+void ImageDecoder::Release(Image& image) const
+{
+    if (pool != nullptr)
+        pool->Release(std::move(image.pixels));
+
+    image.pixels.clear();
+    image.width = 0;
+    image.height = 0;
+}
+
+
+bool ImageDecoder::DecodeJPEG(const unsigned char *data, size_t size,
+                              Layout layout, unsigned char *pixels,
+                              size_t stride) const
+{
+    JPEGLayout scan;
+
+    if (jobs == nullptr || jobs->NumThreads() < 2 ||
+            !ParseJPEGLayout(data, size, scan) ||
+            scan.height < MinSplitRows)
+    {
+        return DecodeJPEGRows(data, size, layout, 0, -1, pixels, stride);
+    }
+
+    // A couple of bands a thread, to balance with
+    size_t numIntervals = scan.restarts.size() + 1;
+    size_t numBands = std::min(numIntervals, (size_t)jobs->NumThreads() * 2);
+
+    if (numBands < 2)
+        return DecodeJPEGRows(data, size, layout, 0, -1, pixels, stride);
+
+    std::atomic<bool> decoded(true);
+
+    jobs->ParallelFor(0, numBands, 1, [&](size_t begin, size_t end) {
+        for (size_t band = begin; band < end; band++) {
+            size_t first = numIntervals * band / numBands;
+            size_t last = numIntervals * (band + 1) / numBands;
+
+            // With an interval on either side, so the upsampling sees the
+            // rows next to the band
+            size_t from = (first > 0) ? first - 1 : 0;
+            size_t to = std::min(last + 1, numIntervals);
+
+            int top = (int)first * scan.intervalRows;
+            int bottom = std::min((int)last * scan.intervalRows, scan.height);
+            int pieceTop = (int)from * scan.intervalRows;
+            int pieceBottom = std::min((int)to * scan.intervalRows,
+                                       scan.height);
+
+            std::vector<unsigned char> piece =
+                MakeJPEGBand(data, scan, from, to, pieceBottom - pieceTop);
+
+            if (!DecodeJPEGRows(piece.data(), piece.size(), layout,
+                                top - pieceTop, bottom - top,
+                                pixels + top * stride, stride))
+            {
+                decoded = false;
+            }
+        }
+    });
+
+    return decoded;
+}
@@ -0,0 +1,468 @@
+//============================================================================
+// Name        : IndirectRenderer.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Frustum culling in a compute shader (or on the CPU) that
+//               writes indirect draw commands, and one multi-draw for all
+//               of them.
+//============================================================================
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "IndirectRenderer.hpp"
+
+const GLuint IndirectRenderer::ObjectBinding;
+const GLuint IndirectRenderer::CommandBinding;
+const GLuint IndirectRenderer::ObjectIndexAttribute;
+const GLuint IndirectRenderer::GroupSize;
+
+namespace {
+    // The box test is the same as CullCpu()'s.  The bindings and the group
+    // size have to match the ones in the class.
+    const char *CullShaderSource = R"(
+#version 430
+
+layout(local_size_x = 64) in;
+
+struct Object
+{
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uint count;
+    uint firstIndex;
+    int baseVertex;
+    uint padding;
+};
+
+struct Command
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer Objects { Object objects[]; };
+layout(std430, binding = 1) writeonly buffer Commands { Command commands[]; };
+
+uniform vec4 planes[6];
+uniform uint numObjects;
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= numObjects)
+        return;
+
+    Object object = objects[i];
+
+    // The box in world space is around where its center went, and as big
+    // as its half sizes along the model's axes add up to
+    vec3 center = 0.5 * (object.boundsMin.xyz + object.boundsMax.xyz);
+    vec3 extent = 0.5 * (object.boundsMax.xyz - object.boundsMin.xyz);
+
+    center = (object.model * vec4(center, 1.0)).xyz;
+    extent = abs(object.model[0].xyz) * extent.x +
+             abs(object.model[1].xyz) * extent.y +
+             abs(object.model[2].xyz) * extent.z;
+
+    bool visible = true;
+    for (int p = 0; p < 6; p++) {
+        if (dot(planes[p].xyz, center) + planes[p].w +
+            dot(abs(planes[p].xyz), extent) < 0.0)
+            visible = false;
+    }
+
+    commands[i] = Command(object.count, visible ? 1u : 0u,
+                          object.firstIndex, object.baseVertex, i);
+}
+)";
+}
+
+
+bool IndirectRenderer::Supported()
+{
+    return GLEW_VERSION_4_3 ||
+           (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance &&
+            GLEW_ARB_shader_storage_buffer_object);
+}
+
+
+bool IndirectRenderer::ComputeSupported()
+{
+    return GLEW_VERSION_4_3 || GLEW_ARB_compute_shader;
+}
+
+
+IndirectRenderer::IndirectRenderer(GeometryArena& arena)
+    : arena(arena), mode(CpuCull)
+{
+    // Without these, Draw() would call a function the driver doesn't have
+    if (!Supported()) {
+        cout << "IndirectRenderer: needs GL 4.3, or multi-draw indirect "
+             << "and shader storage buffers" << endl;
+        return;
+    }
+
+    valid = true;
+    vertexArray = GLVertexArray::Create();
+
+    if (ComputeSupported() && BuildCullProgram())
+        mode = GpuCull;
+}
+
+
+IndirectRenderer::Object IndirectRenderer::Add(GeometryArena::Handle mesh,
+                                               const float boundsMin[3],
+                                               const float boundsMax[3],
+                                               const Matrix4f& model)
+{
+    IndirectObject object = {};
+
+    std::copy(model.data(), model.data() + 16, object.model);
+    std::copy(boundsMin, boundsMin + 3, object.boundsMin);
+    std::copy(boundsMax, boundsMax + 3, object.boundsMax);
+
+    if (arena.Contains(mesh)) {
+        const GeometryArena::Range& range = arena.RangeOf(mesh);
+
+        object.count = (GLuint)range.numIndices;
+        object.firstIndex = (GLuint)range.firstIndex;
+        object.baseVertex = (GLint)range.firstVertex;
+    }
+
+    Object handle = (Object)objects.size();
+
+    objects.push_back(object);
+    meshes.push_back(mesh);
+
+    firstDirty = std::min(firstDirty, (size_t)handle);
+    lastDirty = objects.size();
+
+    return handle;
+}
+
+
+void IndirectRenderer::SetTransform(Object object, const Matrix4f& model)
+{
+    if (object >= objects.size())
+        return;
+
+    std::copy(model.data(), model.data() + 16, objects[object].model);
+
+    firstDirty = std::min(firstDirty, (size_t)object);
+    lastDirty = std::max(lastDirty, (size_t)object + 1);
+}
+
+
+void IndirectRenderer::Clear()
+{
+    objects.clear();
+    meshes.clear();
+
+    firstDirty = lastDirty = 0;
+    numCommands = 0;
+    numVisible = 0;
+}
+
+
+void IndirectRenderer::SetCullMode(CullMode mode)
+{
+    this->mode = (mode == GpuCull && cullProgram) ? GpuCull : CpuCull;
+}
+
+
+void IndirectRenderer::Cull(Camera& camera)
+{
+    Vector4f planes[6];
+
+    camera.FrustumPlanes(planes);
+    Cull(planes);
+}
+
+
+void IndirectRenderer::Cull(const Vector4f planes[6])
+{
+    if (!valid)
+        return;
+
+    Update();
+
+    numCommands = objects.size();
+    if (numCommands == 0)
+        return;
+
+    if (mode == GpuCull)
+        CullGpu(planes);
+    else
+        CullCpu(planes);
+}
+
+
+void IndirectRenderer::Draw(GLenum mode)
+{
+    if (!valid || numCommands == 0)
+        return;
+
+    glBindVertexArray(vertexArray.ID());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ObjectBinding,
+                     objectBuffer.ID());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer.ID());
+
+    glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr,
+                                (GLsizei)numCommands, 0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+
+std::vector<DrawElementsIndirectCommand>
+IndirectRenderer::ReadCommands() const
+{
+    std::vector<DrawElementsIndirectCommand> result(numCommands);
+
+    if (numCommands > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, commandBuffer.ID());
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0,
+                           numCommands * sizeof(DrawElementsIndirectCommand),
+                           result.data());
+    }
+
+    return result;
+}
+
+
+void IndirectRenderer::Update()
+{
+    // Compacting moves the meshes, and compacting or growing makes new
+    // buffers
+    if (arena.Compactions() != arenaCompactions ||
+        arena.Grows() != arenaGrows) {
+        for (size_t i = 0; i < objects.size(); i++) {
+            IndirectObject& object = objects[i];
+
+            if (arena.Contains(meshes[i])) {
+                const GeometryArena::Range& range = arena.RangeOf(meshes[i]);
+
+                object.count = (GLuint)range.numIndices;
+                object.firstIndex = (GLuint)range.firstIndex;
+                object.baseVertex = (GLint)range.firstVertex;
+            }
+            else {
+                object.count = 0;
+            }
+        }
+
+        arenaCompactions = arena.Compactions();
+        arenaGrows = arena.Grows();
+
+        firstDirty = 0;
+        lastDirty = objects.size();
+
+        SetupVertexArray();
+    }
+
+    if (objects.size() > capacity) {
+        capacity = std::max(objects.size(), capacity * 2);
+        capacity = std::max(capacity, (size_t)GroupSize);
+
+        objectBuffer = GLBuffer::Create();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, objectBuffer.ID());
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(IndirectObject),
+                     nullptr, GL_DYNAMIC_DRAW);
+
+        commandBuffer = GLBuffer::Create();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer.ID());
+        glBufferData(GL_COPY_WRITE_BUFFER,
+                     capacity * sizeof(DrawElementsIndirectCommand),
+                     nullptr, GL_DYNAMIC_DRAW);
+
+        // The instanced attribute that turns baseInstance into the
+        // object's index
+        std::vector<GLuint> indices(capacity);
+        for (size_t i = 0; i < capacity; i++)
+            indices[i] = (GLuint)i;
+
+        objectIndexBuffer = GLBuffer::Create();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, objectIndexBuffer.ID());
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(GLuint),
+                     indices.data(), GL_STATIC_DRAW);
+
+        firstDirty = 0;
+        lastDirty = objects.size();
+
+        SetupVertexArray();
+    }
+
+    if (firstDirty < lastDirty) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, objectBuffer.ID());
+        glBufferSubData(GL_COPY_WRITE_BUFFER,
+                        firstDirty * sizeof(IndirectObject),
+                        (lastDirty - firstDirty) * sizeof(IndirectObject),
+                        objects.data() + firstDirty);
+    }
+
+    firstDirty = objects.size();
+    lastDirty = 0;
+}
+
+
+void IndirectRenderer::SetupVertexArray()
+{
+    const VertexLayout& layout = arena.Layout();
+
+    glBindVertexArray(vertexArray.ID());
+    glBindBuffer(GL_ARRAY_BUFFER, arena.VertexBuffer());
+
+    for (const VertexAttribute& attribute : layout.attributes) {
+        glVertexAttribPointer(attribute.index, attribute.size,
+                              attribute.type, attribute.normalized,
+                              (GLsizei)layout.stride,
+                              (const void *)attribute.offset);
+        glEnableVertexAttribArray(attribute.index);
+    }
+
+    if (objectIndexBuffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, objectIndexBuffer.ID());
+        glVertexAttribIPointer(ObjectIndexAttribute, 1, GL_UNSIGNED_INT,
+                               sizeof(GLuint), nullptr);
+        glVertexAttribDivisor(ObjectIndexAttribute, 1);
+        glEnableVertexAttribArray(ObjectIndexAttribute);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.IndexBuffer());
+    glBindVertexArray(0);
+}
+
+
+bool IndirectRenderer::BuildCullProgram()
+{
+    GLchar infoLog[512];
+    GLint success;
+
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &CullShaderSource, nullptr);
+    glCompileShader(shader);
+
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        cout << "IndirectRenderer::BuildCullProgram(): "
+             << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n\t"
+             << infoLog << endl;
+        glDeleteShader(shader);
+        return false;
+    }
+
+    GLProgram program = GLProgram::Create();
+    glAttachShader(program.ID(), shader);
+    glLinkProgram(program.ID());
+    glDeleteShader(shader);
+
+    glGetProgramiv(program.ID(), GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program.ID(), 512, NULL, infoLog);
+        cout << "IndirectRenderer::BuildCullProgram(): "
+             << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n\t"
+             << infoLog << endl;
+        return false;
+    }
+
+    planesLocation = glGetUniformLocation(program.ID(), "planes");
+    numObjectsLocation = glGetUniformLocation(program.ID(), "numObjects");
+    cullProgram = std::move(program);
+
+    return true;
+}
+
+
+void IndirectRenderer::CullCpu(const Vector4f planes[6])
+{
+    commands.resize(objects.size());
+    numVisible = 0;
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        const IndirectObject& object = objects[i];
+        const float *m = object.model;
+
+        float center[3];
+        float extent[3];
+        for (int axis = 0; axis < 3; axis++) {
+            center[axis] = 0.5f * (object.boundsMin[axis] +
+                                   object.boundsMax[axis]);
+            extent[axis] = 0.5f * (object.boundsMax[axis] -
+                                   object.boundsMin[axis]);
+        }
+
+        // the same as the shader, a row at a time
+        float worldCenter[3];
+        float worldExtent[3];
+        for (int row = 0; row < 3; row++) {
+            worldCenter[row] = m[row] * center[0] + m[4 + row] * center[1] +
+                               m[8 + row] * center[2] + m[12 + row];
+            worldExtent[row] = std::fabs(m[row]) * extent[0] +
+                               std::fabs(m[4 + row]) * extent[1] +
+                               std::fabs(m[8 + row]) * extent[2];
+        }
+
+        bool visible = true;
+        for (int p = 0; p < 6 && visible; p++) {
+            const Vector4f& plane = planes[p];
+
+            float distance = plane[0] * worldCenter[0] +
+                             plane[1] * worldCenter[1] +
+                             plane[2] * worldCenter[2] + plane[3];
+            float radius = std::fabs(plane[0]) * worldExtent[0] +
+                           std::fabs(plane[1]) * worldExtent[1] +
+                           std::fabs(plane[2]) * worldExtent[2];
+
+            visible = distance + radius >= 0.0f;
+        }
+
+        DrawElementsIndirectCommand& command = commands[i];
+        command.count = object.count;
+        command.instanceCount = visible ? 1 : 0;
+        command.firstIndex = object.firstIndex;
+        command.baseVertex = object.baseVertex;
+        command.baseInstance = (GLuint)i;
+
+        numVisible += visible;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer.ID());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0,
+                    commands.size() * sizeof(DrawElementsIndirectCommand),
+                    commands.data());
+}
+
+
+void IndirectRenderer::CullGpu(const Vector4f planes[6])
+{
+    GLuint numObjects = (GLuint)objects.size();
+
+    glUseProgram(cullProgram.ID());
+    glUniform4fv(planesLocation, 6, planes[0].data());
+    glUniform1ui(numObjectsLocation, numObjects);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ObjectBinding,
+                     objectBuffer.ID());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandBinding,
+                     commandBuffer.ID());
+
+    glDispatchCompute((numObjects + GroupSize - 1) / GroupSize, 1, 1);
+
+    // The commands get read by the draw, or by ReadCommands()
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glUseProgram(0);
+}
@@ -0,0 +1,369 @@
+//============================================================================
+// Name        : JobSystem.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Everything we have built so far runs on a single thread.
+//               This is a general purpose work-stealing job system that the
+//               rest of the libraries can use to fan out work across cores.
+//
+//               Each worker thread owns a Chase-Lev deque.  The owner
+//               pushes and pops jobs at the bottom, and idle workers steal
+//               from the top of somebody else's deque.  The thread that
+//               constructs the JobSystem is worker 0, and when it waits on
+//               a job it helps out by running jobs instead of blocking.
+//============================================================================
+
+#include "JobSystem.hpp"
+
+#include <iostream>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+
+// Which JobSystem the current thread is a worker of, and which worker
+namespace {
+    thread_local JobSystem *tlsJobSystem = nullptr;
+    thread_local int tlsWorkerIndex = -1;
+    thread_local uint32_t tlsRandomState = 0x9e3779b9;
+
+    // quick & dirty xorshift, good enough for picking a victim
+    uint32_t NextRandom(uint32_t &state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Grab the next free job out of a ring of pooled jobs.
+    // A slot is free once its job (and all of its children) has finished.
+    Job *AllocateFromPool(Job *pool, size_t &allocated)
+    {
+        const size_t mask = JobSystem::MaxJobsPerThread - 1;
+
+        for (size_t i = 0; i < JobSystem::MaxJobsPerThread; i++) {
+            Job *job = &pool[allocated++ & mask];
+
+            if (job->unfinishedJobs.load(std::memory_order_acquire) == 0)
+                return job;
+        }
+
+        return nullptr;
+    }
+}
+
+
+WorkStealingQueue::WorkStealingQueue()
+    : top(0), bottom(0)
+{
+    for (size_t i = 0; i < Capacity; i++)
+        jobs[i].store(nullptr, std::memory_order_relaxed);
+}
+
+
+bool WorkStealingQueue::Push(Job *job)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+
+    if (b - t > (int64_t)Mask)
+        return false;
+
+    jobs[b & Mask].store(job, std::memory_order_relaxed);
+
+    // publish the job (and its data) to any thieves
+    bottom.store(b + 1, std::memory_order_release);
+
+    return true;
+}
+
+
+Job *WorkStealingQueue::Pop()
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // the queue was already empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job *job = jobs[b & Mask].load(std::memory_order_relaxed);
+
+    if (t == b) {
+        // This is the last job in the queue, so we race any thieves for it
+        if (!top.compare_exchange_strong(t, t + 1,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed))
+            job = nullptr;
+
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+
+Job *WorkStealingQueue::Steal()
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b)
+        return nullptr;
+
+    Job *job = jobs[t & Mask].load(std::memory_order_relaxed);
+
+    if (!top.compare_exchange_strong(t, t + 1,
+                                     std::memory_order_seq_cst,
+                                     std::memory_order_relaxed))
+        return nullptr;  // somebody else got it first
+
+    return job;
+}
+
+
+size_t WorkStealingQueue::Size() const
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    return b > t ? (size_t)(b - t) : 0;
+}
+
+
+JobSystem::JobSystem(unsigned numThreads)
+{
+    if (numThreads == 0)
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (unsigned i = 0; i < numThreads; i++) {
+        Worker *worker = new Worker();
+
+        worker->jobPool = new Job[MaxJobsPerThread];
+        for (size_t j = 0; j < MaxJobsPerThread; j++)
+            worker->jobPool[j].unfinishedJobs = 0;
+
+        worker->randomState = 0x9e3779b9 * (i + 1);
+
+        workers.push_back(worker);
+    }
+
+    sharedPool = new Job[MaxJobsPerThread];
+    for (size_t j = 0; j < MaxJobsPerThread; j++)
+        sharedPool[j].unfinishedJobs = 0;
+
+    // The calling thread is worker 0
+    tlsJobSystem = this;
+    tlsWorkerIndex = 0;
+
+    for (unsigned i = 1; i < numThreads; i++)
+        workers[i]->thread = std::thread(&JobSystem::WorkerLoop, this, i);
+}
+
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running = false;
+    }
+    wakeUp.notify_all();
+
+    for (Worker *worker : workers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+
+    for (Worker *worker : workers) {
+        delete[] worker->jobPool;
+        delete worker;
+    }
+
+    delete[] sharedPool;
+
+    if (tlsJobSystem == this) {
+        tlsJobSystem = nullptr;
+        tlsWorkerIndex = -1;
+    }
+}
+
+
+int JobSystem::WorkerIndex() const
+{
+    if (tlsJobSystem == this)
+        return tlsWorkerIndex;
+    else
+        return -1;
+}
+
+
+Job *JobSystem::CreateJob(JobFunction function, Job *parent)
+{
+    int index = WorkerIndex();
+    Job *job = nullptr;
+
+    while (job == nullptr) {
+        if (index >= 0) {
+            Worker *worker = workers[index];
+            job = AllocateFromPool(worker->jobPool, worker->allocated);
+        }
+        else {
+            std::lock_guard<std::mutex> lock(sharedMutex);
+            job = AllocateFromPool(sharedPool, sharedAllocated);
+        }
+
+        if (job == nullptr) {
+            // Every job in our pool is still in flight.  Help out until
+            // one of them finishes.
+            Job *next = GetJob();
+            if (next != nullptr)
+                Execute(next);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    job->function = function;
+    job->parent = parent;
+    job->unfinishedJobs.store(1, std::memory_order_relaxed);
+
+    if (parent != nullptr)
+        parent->unfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+
+    return job;
+}
+
+
+void JobSystem::Run(Job *job)
+{
+    int index = WorkerIndex();
+
+    if (index >= 0) {
+        if (!workers[index]->queue.Push(job)) {
+            // Our queue is full.  Just run it ourselves.
+            Execute(job);
+            return;
+        }
+    }
+    else {
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        sharedQueue.push_back(job);
+        sharedQueued++;
+    }
+
+    pendingJobs.fetch_add(1);
+
+    if (sleepingWorkers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeUp.notify_one();
+    }
+}
+
+
+void JobSystem::Wait(const Job *job)
+{
+    while (!IsFinished(job)) {
+        Job *next = GetJob();
+
+        if (next != nullptr)
+            Execute(next);
+        else
+            std::this_thread::yield();
+    }
+}
+
+
+void JobSystem::WorkerLoop(unsigned index)
+{
+    tlsJobSystem = this;
+    tlsWorkerIndex = index;
+
+    while (running) {
+        Job *job = GetJob();
+
+        if (job != nullptr) {
+            Execute(job);
+            continue;
+        }
+
+        // Nothing to do.  Go to sleep until somebody runs a job.
+        std::unique_lock<std::mutex> lock(sleepMutex);
+
+        sleepingWorkers.fetch_add(1);
+        wakeUp.wait(lock, [this] {
+            return pendingJobs.load() > 0 || !running;
+        });
+        sleepingWorkers.fetch_sub(1);
+    }
+}
+
+
+Job *JobSystem::GetJob()
+{
+    int index = WorkerIndex();
+    Job *job = nullptr;
+
+    if (index >= 0)
+        job = workers[index]->queue.Pop();
+
+    if (job == nullptr && sharedQueued.load() > 0) {
+        std::lock_guard<std::mutex> lock(sharedMutex);
+
+        if (!sharedQueue.empty()) {
+            job = sharedQueue.front();
+            sharedQueue.pop_front();
+            sharedQueued--;
+        }
+    }
+
+    if (job == nullptr && workers.size() > 1) {
+        // try to steal from somebody else, starting at a random victim
+        uint32_t &state = (index >= 0) ? workers[index]->randomState
+                                       : tlsRandomState;
+        size_t victim = NextRandom(state) % workers.size();
+
+        for (size_t i = 0; i < workers.size() && job == nullptr; i++) {
+            size_t v = (victim + i) % workers.size();
+
+            if ((int)v != index)
+                job = workers[v]->queue.Steal();
+        }
+    }
+
+    if (job != nullptr)
+        pendingJobs.fetch_sub(1);
+
+    return job;
+}
+
+
+void JobSystem::Execute(Job *job)
+{
+    job->function(job, job->data);
+
+    Finish(job);
+}
+
+
+void JobSystem::Finish(Job *job)
+{
+    // Once we decrement, the job slot can be reused, so we grab the
+    // parent first.
+    Job *parent = job->parent;
+
+    int32_t unfinished = job->unfinishedJobs.fetch_sub(1,
+                                                       std::memory_order_acq_rel) - 1;
+
+    if (unfinished == 0 && parent != nullptr)
+        Finish(parent);
+}
@@ -0,0 +1,256 @@
+//============================================================================
+// Name        : LodSelector.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Picking levels of detail by their error on the screen.
+//============================================================================
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "LodSelector.hpp"
+
+const size_t LodSelector::MaxLevels;
+const size_t LodSelector::BatchSize;
+
+namespace {
+    // Objects the camera is inside of still get a distance
+    const float MinDistance = 1e-4f;
+
+    const float NoLevel = std::numeric_limits<float>::infinity();
+}
+
+
+LodSelector::LodSelector(float threshold, float hysteresis)
+    : threshold(threshold), hysteresis(hysteresis)
+{
+}
+
+
+void LodSelector::Grow()
+{
+    size_t size = numObjects + BatchSize;
+
+    centerX.resize(size, 0.0f);
+    centerY.resize(size, 0.0f);
+    centerZ.resize(size, 0.0f);
+    radius.resize(size, 0.0f);
+    for (size_t l = 0; l < MaxLevels - 1; l++)
+        errors[l].resize(size, NoLevel);
+    levels.resize(size, 0);
+}
+
+
+LodSelector::Object LodSelector::Add(const Vector3f& center, float radius,
+                                     const float *errors, size_t numLevels)
+{
+    if (numObjects % BatchSize == 0)
+        Grow();
+
+    Object object = (Object)numObjects++;
+
+    centerX[object] = center.x();
+    centerY[object] = center.y();
+    centerZ[object] = center.z();
+    this->radius[object] = radius;
+
+    numLevels = std::min(numLevels, MaxLevels);
+    for (size_t l = 1; l < numLevels; l++)
+        this->errors[l - 1][object] = errors[l];
+    for (size_t l = std::max(numLevels, (size_t)1); l < MaxLevels; l++)
+        this->errors[l - 1][object] = NoLevel;
+
+    levels[object] = 0;
+    return object;
+}
+
+
+LodSelector::Object LodSelector::Add(const LodMesh& mesh,
+                                     const Matrix4f& model)
+{
+    float scale = std::max(model.col(0).head<3>().norm(),
+                           std::max(model.col(1).head<3>().norm(),
+                                    model.col(2).head<3>().norm()));
+
+    const float *c = mesh.Center();
+    Vector3f center = (model * Eigen::Vector4f(c[0], c[1], c[2], 1.0f))
+                          .head<3>();
+
+    float levelErrors[MaxLevels];
+    size_t numLevels = std::min(mesh.NumLevels(), MaxLevels);
+    for (size_t l = 0; l < numLevels; l++)
+        levelErrors[l] = mesh.Level(l).error * scale;
+
+    return Add(center, mesh.Radius() * scale, levelErrors, numLevels);
+}
+
+
+void LodSelector::Clear()
+{
+    numObjects = 0;
+    numChanged = 0;
+
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+    for (size_t l = 0; l < MaxLevels - 1; l++)
+        errors[l].clear();
+    levels.clear();
+}
+
+
+void LodSelector::SetThreshold(float threshold, float hysteresis)
+{
+    this->threshold = threshold;
+    this->hysteresis = hysteresis;
+    std::fill(levels.begin(), levels.end(), 0);
+}
+
+
+float LodSelector::ProjectionScale(Camera& camera, float viewportHeight)
+{
+    return camera.Projection()(1, 1) * viewportHeight * 0.5f;
+}
+
+
+void LodSelector::Select(Camera& camera, float viewportHeight)
+{
+    Select(camera.Position(), ProjectionScale(camera, viewportHeight));
+}
+
+
+void LodSelector::Select(const Vector3f& eye, float projectionScale)
+{
+#if defined(__AVX__)
+    const __m256 ex = _mm256_set1_ps(eye.x());
+    const __m256 ey = _mm256_set1_ps(eye.y());
+    const __m256 ez = _mm256_set1_ps(eye.z());
+    const __m256 scale = _mm256_set1_ps(projectionScale);
+    const __m256 allowedLimit = _mm256_set1_ps(threshold);
+    const __m256 wantedLimit = _mm256_set1_ps(threshold * (1 - hysteresis));
+    const __m256 minDistance = _mm256_set1_ps(MinDistance);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    size_t changed = 0;
+    for (size_t i = 0; i < numObjects; i += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&centerX[i]), ex);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&centerY[i]), ey);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&centerZ[i]), ez);
+        __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+            _mm256_mul_ps(dz, dz)));
+        distance = _mm256_max_ps(
+            _mm256_sub_ps(distance, _mm256_loadu_ps(&radius[i])),
+            minDistance);
+
+        __m256 allowedDistance = _mm256_mul_ps(distance, allowedLimit);
+        __m256 wantedDistance = _mm256_mul_ps(distance, wantedLimit);
+
+        // The coarsest level we may use, and the one we'd go to
+        __m256 allowed = _mm256_setzero_ps();
+        __m256 wanted = _mm256_setzero_ps();
+        for (size_t l = 0; l < MaxLevels - 1; l++) {
+            __m256 error = _mm256_mul_ps(_mm256_loadu_ps(&errors[l][i]),
+                                         scale);
+            allowed = _mm256_add_ps(allowed, _mm256_and_ps(one,
+                _mm256_cmp_ps(error, allowedDistance, _CMP_LE_OQ)));
+            wanted = _mm256_add_ps(wanted, _mm256_and_ps(one,
+                _mm256_cmp_ps(error, wantedDistance, _CMP_LE_OQ)));
+        }
+
+        __m256 old = _mm256_cvtepi32_ps(
+            _mm256_loadu_si256((const __m256i *)&levels[i]));
+        __m256 level = _mm256_min_ps(_mm256_max_ps(old, wanted), allowed);
+        _mm256_storeu_si256((__m256i *)&levels[i],
+                            _mm256_cvttps_epi32(level));
+
+        changed += __builtin_popcount(_mm256_movemask_ps(
+            _mm256_cmp_ps(old, level, _CMP_NEQ_OQ)));
+    }
+
+    // the padding at the end never changes
+    numChanged = changed;
+#elif defined(__SSE2__)
+    const __m128 ex = _mm_set1_ps(eye.x());
+    const __m128 ey = _mm_set1_ps(eye.y());
+    const __m128 ez = _mm_set1_ps(eye.z());
+    const __m128 scale = _mm_set1_ps(projectionScale);
+    const __m128 allowedLimit = _mm_set1_ps(threshold);
+    const __m128 wantedLimit = _mm_set1_ps(threshold * (1 - hysteresis));
+    const __m128 minDistance = _mm_set1_ps(MinDistance);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    size_t changed = 0;
+    for (size_t i = 0; i < numObjects; i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&centerX[i]), ex);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&centerY[i]), ey);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&centerZ[i]), ez);
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+            _mm_mul_ps(dz, dz)));
+        distance = _mm_max_ps(_mm_sub_ps(distance, _mm_loadu_ps(&radius[i])),
+                              minDistance);
+
+        __m128 allowedDistance = _mm_mul_ps(distance, allowedLimit);
+        __m128 wantedDistance = _mm_mul_ps(distance, wantedLimit);
+
+        __m128 allowed = _mm_setzero_ps();
+        __m128 wanted = _mm_setzero_ps();
+        for (size_t l = 0; l < MaxLevels - 1; l++) {
+            __m128 error = _mm_mul_ps(_mm_loadu_ps(&errors[l][i]), scale);
+            allowed = _mm_add_ps(allowed, _mm_and_ps(one,
+                _mm_cmple_ps(error, allowedDistance)));
+            wanted = _mm_add_ps(wanted, _mm_and_ps(one,
+                _mm_cmple_ps(error, wantedDistance)));
+        }
+
+        __m128 old = _mm_cvtepi32_ps(
+            _mm_loadu_si128((const __m128i *)&levels[i]));
+        __m128 level = _mm_min_ps(_mm_max_ps(old, wanted), allowed);
+        _mm_storeu_si128((__m128i *)&levels[i], _mm_cvttps_epi32(level));
+
+        changed += __builtin_popcount(_mm_movemask_ps(
+            _mm_cmpneq_ps(old, level)));
+    }
+
+    numChanged = changed;
+#else
+    SelectScalar(eye, projectionScale);
+#endif
+}
+
+
+void LodSelector::SelectScalar(const Vector3f& eye, float projectionScale)
+{
+    float allowedLimit = threshold;
+    float wantedLimit = threshold * (1 - hysteresis);
+
+    numChanged = 0;
+    for (size_t i = 0; i < numObjects; i++) {
+        float dx = centerX[i] - eye.x();
+        float dy = centerY[i] - eye.y();
+        float dz = centerZ[i] - eye.z();
+        float distance = std::max(
+            std::sqrt(dx * dx + dy * dy + dz * dz) - radius[i],
+            MinDistance);
+
+        int allowed = 0;
+        int wanted = 0;
+        for (size_t l = 0; l < MaxLevels - 1; l++) {
+            float error = errors[l][i] * projectionScale;
+            allowed += error <= distance * allowedLimit;
+            wanted += error <= distance * wantedLimit;
+        }
+
+        int level = std::min(std::max(levels[i], wanted), allowed);
+        numChanged += level != levels[i];
+        levels[i] = level;
+    }
+}
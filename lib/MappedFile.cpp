@@ -0,0 +1,118 @@
+//============================================================================
+// Name        : MappedFile.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : A read-only memory mapped file.  Instead of reading a file
+//               into a buffer of our own, we let the kernel page it in as
+//               we touch it.  The mapping goes away with the object.
+//============================================================================
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "MappedFile.hpp"
+
+// We can't mmap() an empty file, so empty files all point here
+static const unsigned char emptyFile[1] = {0};
+
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+
+MappedFile::MappedFile(MappedFile&& other)
+    : data(other.data), size(other.size), path(std::move(other.path))
+{
+    other.data = nullptr;
+    other.size = 0;
+}
+
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+    if (this != &other) {
+        Close();
+
+        data = other.data;
+        size = other.size;
+        path = std::move(other.path);
+
+        other.data = nullptr;
+        other.size = 0;
+    }
+
+    return *this;
+}
+
+
+bool MappedFile::Open(const std::string& filePath)
+{
+    Close();
+
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cout << "MappedFile::Open(): could not open " << filePath
+             << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        cout << "MappedFile::Open(): could not stat " << filePath
+             << ": " << strerror(errno) << endl;
+        close(fd);
+        return false;
+    }
+
+    if (info.st_size == 0) {
+        close(fd);
+
+        data = emptyFile;
+        size = 0;
+        path = filePath;
+        return true;
+    }
+
+    void *mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ,
+                         MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        cout << "MappedFile::Open(): could not map " << filePath
+             << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    data = static_cast<const unsigned char *>(mapping);
+    size = (size_t)info.st_size;
+    path = filePath;
+
+    return true;
+}
+
+
+void MappedFile::Close()
+{
+    if (data != nullptr && data != emptyFile)
+        munmap(const_cast<unsigned char *>(data), size);
+
+    data = nullptr;
+    size = 0;
+    path.clear();
+}
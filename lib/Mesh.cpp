@@ -0,0 +1,110 @@
+//============================================================================
+// Name        : Mesh.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : An indexed triangle mesh, in our own arrays or in a mapped
+//               mesh cache.
+//============================================================================
+
+#include <algorithm>
+
+#include "Mesh.hpp"
+
+
+Mesh::Mesh(Mesh&& other)
+{
+    Take(other);
+}
+
+
+Mesh& Mesh::operator=(Mesh&& other)
+{
+    if (this != &other)
+        Take(other);
+
+    return *this;
+}
+
+
+void Mesh::Take(Mesh& other)
+{
+    // Moving the vectors and the mapping doesn't move what they point at,
+    // so the pointers stay good
+    vertexStorage = std::move(other.vertexStorage);
+    indexStorage = std::move(other.indexStorage);
+    file = std::move(other.file);
+
+    vertices = other.vertices;
+    indices = other.indices;
+    numVertices = other.numVertices;
+    numIndices = other.numIndices;
+
+    std::copy(other.boundsMin, other.boundsMin + 3, boundsMin);
+    std::copy(other.boundsMax, other.boundsMax + 3, boundsMax);
+
+    other.Clear();
+}
+
+
+void Mesh::Assign(std::vector<MeshVertex>&& newVertices,
+                  std::vector<uint32_t>&& newIndices)
+{
+    Clear();
+
+    vertexStorage = std::move(newVertices);
+    indexStorage = std::move(newIndices);
+
+    vertices = vertexStorage.data();
+    indices = indexStorage.data();
+    numVertices = vertexStorage.size();
+    numIndices = indexStorage.size();
+
+    for (size_t i = 0; i < numVertices; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            float value = vertices[i].position[axis];
+
+            boundsMin[axis] = i == 0 ? value
+                                     : std::min(boundsMin[axis], value);
+            boundsMax[axis] = i == 0 ? value
+                                     : std::max(boundsMax[axis], value);
+        }
+    }
+}
+
+
+void Mesh::Assign(MappedFile&& mapped,
+                  const MeshVertex *newVertices, size_t newNumVertices,
+                  const uint32_t *newIndices, size_t newNumIndices,
+                  const float newBoundsMin[3], const float newBoundsMax[3])
+{
+    Clear();
+
+    file = std::move(mapped);
+
+    vertices = newVertices;
+    indices = newIndices;
+    numVertices = newNumVertices;
+    numIndices = newNumIndices;
+
+    std::copy(newBoundsMin, newBoundsMin + 3, boundsMin);
+    std::copy(newBoundsMax, newBoundsMax + 3, boundsMax);
+}
+
+
+void Mesh::Clear()
+{
+    vertexStorage.clear();
+    vertexStorage.shrink_to_fit();
+    indexStorage.clear();
+    indexStorage.shrink_to_fit();
+    file.Close();
+
+    vertices = nullptr;
+    indices = nullptr;
+    numVertices = 0;
+    numIndices = 0;
+
+    std::fill(boundsMin, boundsMin + 3, 0.0f);
+    std::fill(boundsMax, boundsMax + 3, 0.0f);
+}
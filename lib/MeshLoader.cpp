@@ -0,0 +1,1072 @@
+//============================================================================
+// Name        : MeshLoader.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Parses OBJ files on a JobSystem, and .glb files, into
+//               indexed Meshes, and reads and writes the mesh cache.
+//============================================================================
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "HashMap.hpp"
+#include "MappedFile.hpp"
+#include "MeshLoader.hpp"
+#include "MeshOptimizer.hpp"
+
+const uint32_t MeshCacheHeader::Magic;
+const uint32_t MeshCacheHeader::Version;
+const size_t MeshLoader::Alignment;
+
+namespace {
+    // One corner of a triangle, as indices into the positions, texture
+    // coordinates and normals.  Missing ones are -1.  Until they get
+    // resolved, the ones with their bit set in 'relative' count from the
+    // start of their piece of the file instead of the start of the file.
+    struct ObjCorner
+    {
+        int32_t index[3];
+        uint32_t relative;
+    };
+
+    // What one job parsed out of its piece of an OBJ file
+    struct ObjPiece
+    {
+        std::vector<float> attributes[3];  // positions, texcoords, normals
+        std::vector<ObjCorner> corners;    // three to a triangle
+        std::vector<uint64_t> keys;        // one for each corner
+        bool failed = false;
+    };
+
+    const size_t AttributeSizes[3] = { 3, 2, 3 };
+
+    uint64_t AlignUp(uint64_t offset)
+    {
+        return (offset + MeshLoader::Alignment - 1) &
+               ~(uint64_t)(MeshLoader::Alignment - 1);
+    }
+
+    bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    const char *SkipSpaces(const char *p, const char *end)
+    {
+        while (p < end && IsSpace(*p))
+            p++;
+        return p;
+    }
+
+    const char *NextLine(const char *p, const char *end)
+    {
+        const char *newline = (const char *)std::memchr(p, '\n', end - p);
+        return newline != nullptr ? newline + 1 : end;
+    }
+
+    // strtof() wants a terminated string, and looks up the locale on
+    // every call.  This just does the digits.  Returns where the number
+    // ended, or null if there wasn't one.
+    const char *ParseFloat(const char *p, const char *end, float& value)
+    {
+        static const double powers[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        bool any = false;
+
+        for (; p < end && *p >= '0' && *p <= '9'; p++, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+            } else {
+                exponent++;
+            }
+        }
+
+        if (p < end && *p == '.') {
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++, any = true) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    digits += mantissa != 0;
+                    exponent--;
+                }
+            }
+        }
+
+        if (!any)
+            return nullptr;
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            const char *q = p + 1;
+            bool negativeExponent = false;
+            if (q < end && (*q == '-' || *q == '+'))
+                negativeExponent = *q++ == '-';
+
+            if (q < end && *q >= '0' && *q <= '9') {
+                int e = 0;
+                for (; q < end && *q >= '0' && *q <= '9'; q++)
+                    e = std::min(e * 10 + (*q - '0'), 10000);
+
+                exponent += negativeExponent ? -e : e;
+                p = q;
+            }
+        }
+
+        double result = (double)mantissa;
+        if (exponent < 0 && exponent >= -22)
+            result /= powers[-exponent];
+        else if (exponent > 0 && exponent <= 22)
+            result *= powers[exponent];
+        else if (exponent != 0)
+            result *= std::pow(10.0, exponent);
+
+        value = (float)(negative ? -result : result);
+        return p;
+    }
+
+    const char *ParseInt(const char *p, const char *end, int64_t& value)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+
+        if (p >= end || *p < '0' || *p > '9')
+            return nullptr;
+
+        int64_t result = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+            result = std::min<int64_t>(result * 10 + (*p - '0'), INT32_MAX);
+
+        value = negative ? -result : result;
+        return p;
+    }
+
+    // "v", "v/vt", "v//vn" or "v/vt/vn"
+    const char *ParseCorner(const char *p, const char *end,
+                            const ObjPiece& piece, ObjCorner& corner)
+    {
+        corner.index[0] = corner.index[1] = corner.index[2] = -1;
+        corner.relative = 0;
+
+        for (int attribute = 0; attribute < 3; attribute++) {
+            if (attribute > 0) {
+                if (p >= end || *p != '/')
+                    break;
+                p++;
+
+                // an empty texcoord, as in "v//vn"
+                if (attribute == 1 && p < end && *p == '/')
+                    continue;
+            }
+
+            int64_t value;
+            p = ParseInt(p, end, value);
+            if (p == nullptr || value == 0)
+                return nullptr;
+
+            if (value > 0) {
+                corner.index[attribute] = (int32_t)(value - 1);
+            } else {
+                // Counting back from here, so from the start of our
+                // piece it's this many in, which can be negative
+                size_t count = piece.attributes[attribute].size() /
+                               AttributeSizes[attribute];
+                corner.index[attribute] = (int32_t)((int64_t)count + value);
+                corner.relative |= 1u << attribute;
+            }
+        }
+
+        return p;
+    }
+
+    // Parse the lines in [begin, end), which starts at the start of a line
+    void ParseObjPiece(const char *begin, const char *end, ObjPiece& piece)
+    {
+        std::vector<ObjCorner> polygon;
+
+        for (const char *p = begin; p < end; p = NextLine(p, end)) {
+            p = SkipSpaces(p, end);
+            if (p + 1 >= end)
+                break;
+
+            int attribute = -1;
+            if (p[0] == 'v' && IsSpace(p[1])) {
+                attribute = 0;
+                p += 1;
+            } else if (p[0] == 'v' && p[1] == 't' && p + 2 < end &&
+                       IsSpace(p[2])) {
+                attribute = 1;
+                p += 2;
+            } else if (p[0] == 'v' && p[1] == 'n' && p + 2 < end &&
+                       IsSpace(p[2])) {
+                attribute = 2;
+                p += 2;
+            } else if (p[0] != 'f' || !IsSpace(p[1])) {
+                // comments, groups, materials, lines, ...
+                continue;
+            }
+
+            if (attribute >= 0) {
+                std::vector<float>& values = piece.attributes[attribute];
+
+                for (size_t i = 0; i < AttributeSizes[attribute]; i++) {
+                    float value = 0;
+                    const char *next = ParseFloat(SkipSpaces(p, end), end,
+                                                  value);
+
+                    // texture coordinates can leave out v
+                    if (next == nullptr && !(attribute == 1 && i == 1)) {
+                        piece.failed = true;
+                        return;
+                    }
+
+                    values.push_back(value);
+                    p = next != nullptr ? next : p;
+                }
+
+                continue;
+            }
+
+            // A face: fan the polygon out into triangles
+            polygon.clear();
+            p++;
+
+            while (true) {
+                p = SkipSpaces(p, end);
+                if (p >= end || *p == '\n' || *p == '#')
+                    break;
+
+                ObjCorner corner;
+                p = ParseCorner(p, end, piece, corner);
+                if (p == nullptr) {
+                    piece.failed = true;
+                    return;
+                }
+
+                polygon.push_back(corner);
+            }
+
+            for (size_t i = 2; i < polygon.size(); i++) {
+                piece.corners.push_back(polygon[0]);
+                piece.corners.push_back(polygon[i - 1]);
+                piece.corners.push_back(polygon[i]);
+            }
+        }
+    }
+
+    // A corner as the key to look its vertex up by.  The indices are
+    // already resolved, so they're all positive or -1.
+    uint64_t CornerKey(const ObjCorner& corner)
+    {
+        uint64_t key = (uint64_t)(uint32_t)corner.index[0] |
+                       (uint64_t)(uint32_t)corner.index[1] << 32;
+        key ^= (uint64_t)(uint32_t)corner.index[2] * 0x9e3779b97f4a7c15ULL;
+
+        // murmur3's finalizer, since HashMap wants keys that look random
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    bool SameCorner(const ObjCorner& a, const ObjCorner& b)
+    {
+        return a.index[0] == b.index[0] && a.index[1] == b.index[1] &&
+               a.index[2] == b.index[2];
+    }
+
+    // The average of each vertex's triangles' normals, for the vertices
+    // whose 'needsNormal' is set.  Bigger triangles count for more.
+    void AverageNormals(std::vector<MeshVertex>& vertices,
+                        const std::vector<uint32_t>& indices,
+                        const std::vector<bool>& needsNormal)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            const float *a = vertices[indices[i]].position;
+            const float *b = vertices[indices[i + 1]].position;
+            const float *c = vertices[indices[i + 2]].position;
+
+            float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float n[3] = { u[1] * v[2] - u[2] * v[1],
+                           u[2] * v[0] - u[0] * v[2],
+                           u[0] * v[1] - u[1] * v[0] };
+
+            for (size_t corner = 0; corner < 3; corner++) {
+                uint32_t index = indices[i + corner];
+                if (!needsNormal[index])
+                    continue;
+
+                for (int axis = 0; axis < 3; axis++)
+                    vertices[index].normal[axis] += n[axis];
+            }
+        }
+
+        for (size_t i = 0; i < vertices.size(); i++) {
+            if (!needsNormal[i])
+                continue;
+
+            float *n = vertices[i].normal;
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length > 0) {
+                n[0] /= length;
+                n[1] /= length;
+                n[2] /= length;
+            }
+        }
+    }
+
+    // Just enough JSON for a glTF file's chunk
+    struct JsonValue
+    {
+        enum Type { Null, Bool, Number, String, Array, Object };
+
+        Type type = Null;
+        double number = 0;
+        std::string string;
+        std::vector<JsonValue> items;
+        std::vector<std::pair<std::string, JsonValue>> members;
+
+        const JsonValue *Member(const char *name) const
+        {
+            for (const auto& member : members) {
+                if (member.first == name)
+                    return &member.second;
+            }
+            return nullptr;
+        }
+
+        double NumberOf(const char *name, double fallback) const
+        {
+            const JsonValue *member = Member(name);
+            return member != nullptr && member->type == Number
+                ? member->number : fallback;
+        }
+
+        const JsonValue *Item(double index) const
+        {
+            if (type != Array || index < 0 || index >= items.size())
+                return nullptr;
+            return &items[(size_t)index];
+        }
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const char *text, size_t size)
+            : p(text), end(text + size) {}
+
+        bool Parse(JsonValue& value, int depth = 0)
+        {
+            SkipWhitespace();
+            if (p >= end || depth > 64)
+                return false;
+
+            if (*p == '{') {
+                value.type = JsonValue::Object;
+                p++;
+
+                SkipWhitespace();
+                if (p < end && *p == '}') {
+                    p++;
+                    return true;
+                }
+
+                while (true) {
+                    std::pair<std::string, JsonValue> member;
+
+                    SkipWhitespace();
+                    if (!ParseString(member.first) || !Expect(':') ||
+                        !Parse(member.second, depth + 1))
+                        return false;
+
+                    value.members.push_back(std::move(member));
+
+                    if (Expect('}'))
+                        return true;
+                    if (!Expect(','))
+                        return false;
+                }
+            }
+
+            if (*p == '[') {
+                value.type = JsonValue::Array;
+                p++;
+
+                SkipWhitespace();
+                if (p < end && *p == ']') {
+                    p++;
+                    return true;
+                }
+
+                while (true) {
+                    value.items.push_back(JsonValue());
+                    if (!Parse(value.items.back(), depth + 1))
+                        return false;
+
+                    if (Expect(']'))
+                        return true;
+                    if (!Expect(','))
+                        return false;
+                }
+            }
+
+            if (*p == '"') {
+                value.type = JsonValue::String;
+                return ParseString(value.string);
+            }
+
+            if (Word("true") || Word("false")) {
+                value.type = JsonValue::Bool;
+                value.number = p[-2] == 'u';
+                return true;
+            }
+
+            if (Word("null"))
+                return true;
+
+            // Numbers in glTF are counts and offsets, and the odd float
+            char *numberEnd;
+            std::string number(p, std::min<size_t>(end - p, 64));
+            value.type = JsonValue::Number;
+            value.number = std::strtod(number.c_str(), &numberEnd);
+            if (numberEnd == number.c_str())
+                return false;
+
+            p += numberEnd - number.c_str();
+            return true;
+        }
+
+    private:
+        void SkipWhitespace()
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' ||
+                               *p == '\r'))
+                p++;
+        }
+
+        bool Expect(char c)
+        {
+            SkipWhitespace();
+            if (p >= end || *p != c)
+                return false;
+            p++;
+            return true;
+        }
+
+        bool Word(const char *word)
+        {
+            size_t length = std::strlen(word);
+            if ((size_t)(end - p) < length || std::strncmp(p, word, length))
+                return false;
+            p += length;
+            return true;
+        }
+
+        // The names we look for are plain ASCII, so escapes are kept
+        // as they are, apart from \" and \\ which could end things early
+        bool ParseString(std::string& string)
+        {
+            if (p >= end || *p != '"')
+                return false;
+
+            for (p++; p < end && *p != '"'; p++) {
+                if (*p == '\\' && p + 1 < end)
+                    p++;
+                string += *p;
+            }
+
+            if (p >= end)
+                return false;
+
+            p++;
+            return true;
+        }
+
+        const char *p;
+        const char *end;
+    };
+
+    // A glTF accessor, checked against the binary chunk
+    struct GlbAccessor
+    {
+        const unsigned char *data = nullptr;
+        size_t count = 0;
+        size_t stride = 0;
+        int componentType = 0;
+        int components = 0;
+    };
+
+    bool ReadAccessor(const JsonValue& json, double index,
+                      const unsigned char *bin, size_t binSize,
+                      GlbAccessor& accessor)
+    {
+        const JsonValue *accessors = json.Member("accessors");
+        const JsonValue *views = json.Member("bufferViews");
+        const JsonValue *info = accessors ? accessors->Item(index) : nullptr;
+        if (info == nullptr || views == nullptr)
+            return false;
+
+        const JsonValue *view = views->Item(info->NumberOf("bufferView", -1));
+        const JsonValue *type = info->Member("type");
+        if (view == nullptr || type == nullptr || view->NumberOf("buffer", 0))
+            return false;
+
+        static const char *types[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+        accessor.components = 0;
+        for (int i = 0; i < 4; i++) {
+            if (type->string == types[i])
+                accessor.components = i + 1;
+        }
+
+        accessor.componentType = (int)info->NumberOf("componentType", 0);
+        accessor.count = (size_t)info->NumberOf("count", 0);
+
+        size_t componentSize = accessor.componentType == 5121 ? 1
+                              : accessor.componentType == 5123 ? 2
+                              : accessor.componentType == 5125 ||
+                                accessor.componentType == 5126 ? 4 : 0;
+        if (accessor.components == 0 || componentSize == 0)
+            return false;
+
+        size_t elementSize = componentSize * accessor.components;
+        size_t offset = (size_t)view->NumberOf("byteOffset", 0) +
+                        (size_t)info->NumberOf("byteOffset", 0);
+        size_t viewEnd = (size_t)view->NumberOf("byteOffset", 0) +
+                         (size_t)view->NumberOf("byteLength", 0);
+
+        accessor.stride = (size_t)view->NumberOf("byteStride", 0);
+        if (accessor.stride == 0)
+            accessor.stride = elementSize;
+
+        if (accessor.count > 0 &&
+            (viewEnd > binSize || accessor.stride < elementSize ||
+             offset + (accessor.count - 1) * accessor.stride + elementSize >
+                 viewEnd))
+            return false;
+
+        accessor.data = bin + offset;
+        return true;
+    }
+
+    int64_t ModificationTime(const struct stat& info)
+    {
+        return (int64_t)info.st_mtim.tv_sec * 1000000000 +
+               info.st_mtim.tv_nsec;
+    }
+}
+
+
+MeshLoader::Format MeshLoader::FormatOf(const std::string& path)
+{
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    for (char& c : extension)
+        c = (char)std::tolower(c);
+
+    if (extension == "obj")
+        return Obj;
+    if (extension == "glb")
+        return Glb;
+
+    return Unknown;
+}
+
+
+std::string MeshLoader::CachePath(const std::string& path)
+{
+    return path + ".meshcache";
+}
+
+
+bool MeshLoader::Load(const std::string& path, Mesh& mesh)
+{
+    fromCache = false;
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        cout << "MeshLoader::Load(): could not find " << path << endl;
+        return false;
+    }
+
+    std::string cachePath = CachePath(path);
+    uint32_t flags = optimize ? MeshCacheHeader::Optimized : 0;
+
+    if (ReadCache(cachePath, mesh, (uint64_t)info.st_size,
+                  ModificationTime(info), flags)) {
+        fromCache = true;
+        return true;
+    }
+
+    if (!Import(path, mesh))
+        return false;
+
+    WriteCache(cachePath, mesh, (uint64_t)info.st_size,
+               ModificationTime(info), flags);
+    return true;
+}
+
+
+bool MeshLoader::Import(const std::string& path, Mesh& mesh) const
+{
+    Format format = FormatOf(path);
+    if (format == Unknown) {
+        cout << "MeshLoader::Import(): don't know the format of " << path
+             << endl;
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.Open(path))
+        return false;
+
+    bool parsed = format == Obj ? ParseObj((const char *)file.Data(),
+                                           file.Size(), mesh)
+                                : ParseGlb(file.Data(), file.Size(), mesh);
+    if (!parsed) {
+        cout << "MeshLoader::Import(): could not parse " << path << endl;
+        return false;
+    }
+
+    if (optimize)
+        OptimizeMesh(mesh);
+
+    return true;
+}
+
+
+bool MeshLoader::ParseObj(const char *text, size_t size, Mesh& mesh) const
+{
+    // A few pieces per thread, so a piece with more faces than the others
+    // doesn't leave the rest waiting, but big enough that the lines cut at
+    // the ends are nothing
+    size_t numThreads = jobs != nullptr ? jobs->NumThreads() : 1;
+    size_t numPieces = std::max<size_t>(std::min(numThreads * 4,
+                                                 size / (256 * 1024)), 1);
+
+    std::vector<size_t> starts(numPieces + 1, size);
+    starts[0] = 0;
+    for (size_t i = 1; i < numPieces; i++) {
+        const char *start = text + std::max(size * i / numPieces,
+                                            starts[i - 1]);
+        starts[i] = NextLine(start, text + size) - text;
+    }
+
+    std::vector<ObjPiece> pieces(numPieces);
+
+    auto parsePieces = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            ParseObjPiece(text + starts[i], text + starts[i + 1], pieces[i]);
+    };
+
+    if (jobs != nullptr && numPieces > 1)
+        jobs->ParallelFor(0, numPieces, 1, parsePieces);
+    else
+        parsePieces(0, numPieces);
+
+    // Where each piece's attributes start in the whole file's
+    std::vector<std::vector<int64_t>> bases(numPieces,
+                                            std::vector<int64_t>(3, 0));
+    int64_t totals[3] = { 0, 0, 0 };
+    size_t numCorners = 0;
+
+    for (size_t i = 0; i < numPieces; i++) {
+        if (pieces[i].failed)
+            return false;
+
+        for (int a = 0; a < 3; a++) {
+            bases[i][a] = totals[a];
+            totals[a] += pieces[i].attributes[a].size() / AttributeSizes[a];
+        }
+
+        numCorners += pieces[i].corners.size();
+    }
+
+    // Make the corners' indices global, and work out their keys, a piece
+    // per job again
+    auto resolvePieces = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            ObjPiece& piece = pieces[i];
+            piece.keys.resize(piece.corners.size());
+
+            for (size_t c = 0; c < piece.corners.size(); c++) {
+                ObjCorner& corner = piece.corners[c];
+
+                for (int a = 0; a < 3; a++) {
+                    int64_t index = corner.index[a];
+                    if (corner.relative & (1u << a))
+                        index += bases[i][a];
+                    else if (index < 0)
+                        continue;
+
+                    if (index < 0 || index >= totals[a])
+                        piece.failed = true;
+
+                    corner.index[a] = (int32_t)index;
+                }
+
+                // Only a position is a must
+                if (corner.index[0] < 0)
+                    piece.failed = true;
+
+                piece.keys[c] = CornerKey(corner);
+            }
+        }
+    };
+
+    if (jobs != nullptr && numPieces > 1)
+        jobs->ParallelFor(0, numPieces, 1, resolvePieces);
+    else
+        resolvePieces(0, numPieces);
+
+    std::vector<float> attributes[3];
+    for (int a = 0; a < 3; a++) {
+        attributes[a].reserve(totals[a] * AttributeSizes[a]);
+        for (const ObjPiece& piece : pieces)
+            attributes[a].insert(attributes[a].end(),
+                                 piece.attributes[a].begin(),
+                                 piece.attributes[a].end());
+    }
+
+    // Each distinct corner is a vertex.  The keys are hashes of the
+    // corners, so a key can be somebody else's; then we step to another
+    // key until we find ours or an empty one.
+    HashMap<uint32_t> vertexOf(numCorners / 4);
+    std::vector<ObjCorner> vertexCorners;
+    std::vector<uint32_t> indices;
+    indices.reserve(numCorners);
+
+    for (ObjPiece& piece : pieces) {
+        if (piece.failed)
+            return false;
+
+        for (size_t c = 0; c < piece.corners.size(); c++) {
+            const ObjCorner& corner = piece.corners[c];
+            uint64_t key = piece.keys[c];
+
+            while (true) {
+                std::pair<uint32_t *, bool> found = vertexOf.Insert(
+                    key, (uint32_t)vertexCorners.size());
+
+                if (found.second) {
+                    vertexCorners.push_back(corner);
+                } else if (!SameCorner(vertexCorners[*found.first], corner)) {
+                    key = key * 0x9e3779b97f4a7c15ULL + 1;
+                    continue;
+                }
+
+                indices.push_back(*found.first);
+                break;
+            }
+        }
+
+        piece = ObjPiece();
+    }
+
+    std::vector<MeshVertex> vertices(vertexCorners.size());
+    std::vector<bool> needsNormal(vertexCorners.size(), false);
+    bool anyMissing = false;
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const ObjCorner& corner = vertexCorners[i];
+        MeshVertex& vertex = vertices[i];
+
+        std::memset(&vertex, 0, sizeof(vertex));
+
+        for (int a = 0; a < 3; a++) {
+            if (corner.index[a] < 0)
+                continue;
+
+            const float *values = &attributes[a][corner.index[a] *
+                                                 AttributeSizes[a]];
+            float *target = a == 0 ? vertex.position
+                          : a == 1 ? vertex.texCoord : vertex.normal;
+            std::copy(values, values + AttributeSizes[a], target);
+        }
+
+        needsNormal[i] = corner.index[2] < 0;
+        anyMissing = anyMissing || needsNormal[i];
+    }
+
+    if (anyMissing)
+        AverageNormals(vertices, indices, needsNormal);
+
+    mesh.Assign(std::move(vertices), std::move(indices));
+    return true;
+}
+
+
+bool MeshLoader::ParseGlb(const unsigned char *data, size_t size,
+                          Mesh& mesh) const
+{
+    uint32_t header[3];
+    if (size < sizeof(header) + 8)
+        return false;
+
+    std::memcpy(header, data, sizeof(header));
+    if (header[0] != 0x46546c67 || header[1] != 2 || header[2] > size)
+        return false;
+
+    // The JSON chunk comes first, and then the binary one, if any
+    const char *text = nullptr;
+    size_t textSize = 0;
+    const unsigned char *bin = nullptr;
+    size_t binSize = 0;
+
+    for (size_t offset = sizeof(header); offset + 8 <= header[2]; ) {
+        uint32_t chunk[2];
+        std::memcpy(chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+
+        if (chunk[0] > header[2] - offset)
+            return false;
+
+        if (chunk[1] == 0x4e4f534a && text == nullptr) {
+            text = (const char *)data + offset;
+            textSize = chunk[0];
+        } else if (chunk[1] == 0x004e4942 && bin == nullptr) {
+            bin = data + offset;
+            binSize = chunk[0];
+        }
+
+        offset += chunk[0];
+    }
+
+    JsonValue json;
+    if (text == nullptr || !JsonParser(text, textSize).Parse(json))
+        return false;
+
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<bool> needsNormal;
+    bool anyMissing = false;
+
+    const JsonValue *meshes = json.Member("meshes");
+    size_t numMeshes = meshes != nullptr ? meshes->items.size() : 0;
+
+    for (size_t m = 0; m < numMeshes; m++) {
+        const JsonValue *primitives = meshes->items[m].Member("primitives");
+        size_t numPrimitives = primitives != nullptr
+            ? primitives->items.size() : 0;
+
+        for (size_t p = 0; p < numPrimitives; p++) {
+            const JsonValue& primitive = primitives->items[p];
+            const JsonValue *attributes = primitive.Member("attributes");
+
+            // triangles only
+            if (primitive.NumberOf("mode", 4) != 4 || attributes == nullptr)
+                continue;
+
+            GlbAccessor accessors[3];
+            const char *names[3] = { "POSITION", "TEXCOORD_0", "NORMAL" };
+
+            for (int a = 0; a < 3; a++) {
+                double index = attributes->NumberOf(names[a], -1);
+                if (index < 0 && a > 0)
+                    continue;
+
+                if (!ReadAccessor(json, index, bin, binSize, accessors[a]) ||
+                    accessors[a].componentType != 5126 ||
+                    accessors[a].components < (int)AttributeSizes[a] ||
+                    accessors[a].count != accessors[0].count)
+                    return false;
+            }
+
+            size_t base = vertices.size();
+            vertices.resize(base + accessors[0].count);
+            needsNormal.resize(vertices.size(), accessors[2].data == nullptr);
+            anyMissing = anyMissing || accessors[2].data == nullptr;
+
+            for (size_t i = 0; i < accessors[0].count; i++) {
+                MeshVertex& vertex = vertices[base + i];
+                std::memset(&vertex, 0, sizeof(vertex));
+
+                for (int a = 0; a < 3; a++) {
+                    if (accessors[a].data == nullptr)
+                        continue;
+
+                    float *target = a == 0 ? vertex.position
+                                  : a == 1 ? vertex.texCoord : vertex.normal;
+                    std::memcpy(target,
+                                accessors[a].data + i * accessors[a].stride,
+                                AttributeSizes[a] * sizeof(float));
+                }
+            }
+
+            double indexAccessor = primitive.NumberOf("indices", -1);
+
+            if (indexAccessor < 0) {
+                for (size_t i = 0; i < accessors[0].count; i++)
+                    indices.push_back((uint32_t)(base + i));
+                continue;
+            }
+
+            GlbAccessor index;
+            if (!ReadAccessor(json, indexAccessor, bin, binSize, index) ||
+                index.components != 1 || index.componentType == 5126)
+                return false;
+
+            for (size_t i = 0; i < index.count; i++) {
+                const unsigned char *at = index.data + i * index.stride;
+                uint32_t value;
+
+                if (index.componentType == 5121) {
+                    value = *at;
+                } else if (index.componentType == 5123) {
+                    uint16_t shortValue;
+                    std::memcpy(&shortValue, at, sizeof(shortValue));
+                    value = shortValue;
+                } else {
+                    std::memcpy(&value, at, sizeof(value));
+                }
+
+                if (value >= accessors[0].count)
+                    return false;
+
+                indices.push_back((uint32_t)(base + value));
+            }
+        }
+    }
+
+    // Leftovers from a strip of triangles that didn't come out even
+    indices.resize(indices.size() / 3 * 3);
+
+    if (anyMissing)
+        AverageNormals(vertices, indices, needsNormal);
+
+    mesh.Assign(std::move(vertices), std::move(indices));
+    return true;
+}
+
+
+bool MeshLoader::WriteCache(const std::string& cachePath, const Mesh& mesh,
+                            uint64_t sourceSize, int64_t sourceTime,
+                            uint32_t flags)
+{
+    MeshCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    header.magic = MeshCacheHeader::Magic;
+    header.version = MeshCacheHeader::Version;
+    header.vertexSize = sizeof(MeshVertex);
+    header.indexSize = sizeof(uint32_t);
+    header.numVertices = mesh.NumVertices();
+    header.numIndices = mesh.NumIndices();
+    header.vertexOffset = AlignUp(sizeof(header));
+    header.indexOffset = AlignUp(header.vertexOffset + mesh.VertexBytes());
+    header.fileSize = header.indexOffset + mesh.IndexBytes();
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.flags = flags;
+
+    std::copy(mesh.BoundsMin(), mesh.BoundsMin() + 3, header.boundsMin);
+    std::copy(mesh.BoundsMax(), mesh.BoundsMax() + 3, header.boundsMax);
+
+    std::ofstream output(cachePath.c_str(),
+                         std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!output) {
+        cout << "MeshLoader::WriteCache(): could not open " << cachePath
+             << endl;
+        return false;
+    }
+
+    const char zeros[Alignment] = {0};
+    uint64_t written = 0;
+
+    auto writeBytes = [&](const void *bytes, size_t size) {
+        output.write(static_cast<const char *>(bytes), size);
+        written += size;
+    };
+
+    writeBytes(&header, sizeof(header));
+    writeBytes(zeros, (size_t)(header.vertexOffset - written));
+    writeBytes(mesh.Vertices(), mesh.VertexBytes());
+    writeBytes(zeros, (size_t)(header.indexOffset - written));
+    writeBytes(mesh.Indices(), mesh.IndexBytes());
+
+    if (!output) {
+        cout << "MeshLoader::WriteCache(): could not write " << cachePath
+             << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool MeshLoader::ReadCache(const std::string& cachePath, Mesh& mesh,
+                           uint64_t sourceSize, int64_t sourceTime,
+                           uint32_t flags)
+{
+    // No cache is the usual reason to be here, so that's not worth a word
+    struct stat info;
+    if (stat(cachePath.c_str(), &info) != 0)
+        return false;
+
+    MappedFile file;
+    if (!file.Open(cachePath))
+        return false;
+
+    MeshCacheHeader header;
+    if (file.Size() < sizeof(header))
+        return false;
+
+    std::memcpy(&header, file.Data(), sizeof(header));
+
+    if (header.magic != MeshCacheHeader::Magic ||
+        header.version != MeshCacheHeader::Version ||
+        header.vertexSize != sizeof(MeshVertex) ||
+        header.indexSize != sizeof(uint32_t) ||
+        header.fileSize != file.Size())
+        return false;
+
+    // Out of date, which isn't an error either
+    if (header.sourceSize != sourceSize || header.sourceTime != sourceTime ||
+        header.flags != flags)
+        return false;
+
+    if (header.vertexOffset % Alignment != 0 ||
+        header.indexOffset % Alignment != 0 ||
+        header.vertexOffset + header.numVertices * sizeof(MeshVertex) >
+            header.indexOffset ||
+        header.indexOffset + header.numIndices * sizeof(uint32_t) >
+            header.fileSize) {
+        cout << "MeshLoader::ReadCache(): " << cachePath
+             << " is corrupt" << endl;
+        return false;
+    }
+
+    const unsigned char *data = file.Data();
+
+    mesh.Assign(std::move(file),
+                (const MeshVertex *)(data + header.vertexOffset),
+                (size_t)header.numVertices,
+                (const uint32_t *)(data + header.indexOffset),
+                (size_t)header.numIndices,
+                header.boundsMin, header.boundsMax);
+    return true;
+}
@@ -0,0 +1,460 @@
+//============================================================================
+// Name        : MeshLod.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Quadric edge collapse simplification, and the levels of
+//               detail of a mesh.
+//============================================================================
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "MeshLod.hpp"
+#include "MeshOptimizer.hpp"
+#include "HashMap.hpp"
+
+const size_t LodMesh::MaxLevels;
+
+namespace {
+    // The symmetric 4x4 matrix of a sum of plane equations: for a point p
+    // the error is p'Ap + 2b'p + c.  weight is the area that went in, to
+    // turn the error into an average.
+    struct Quadric
+    {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+        double weight;
+
+        Quadric()
+            : a00(0), a01(0), a02(0), a11(0), a12(0), a22(0),
+              b0(0), b1(0), b2(0), c(0), weight(0) {}
+
+        // The plane n.p + d = 0, with n of unit length
+        void AddPlane(const double n[3], double d, double w)
+        {
+            a00 += w * n[0] * n[0];
+            a01 += w * n[0] * n[1];
+            a02 += w * n[0] * n[2];
+            a11 += w * n[1] * n[1];
+            a12 += w * n[1] * n[2];
+            a22 += w * n[2] * n[2];
+            b0 += w * n[0] * d;
+            b1 += w * n[1] * d;
+            b2 += w * n[2] * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        Quadric& operator+=(const Quadric& other)
+        {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12; a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+            return *this;
+        }
+
+        // The average squared distance to the planes
+        double Error(const float p[3]) const
+        {
+            double x = p[0], y = p[1], z = p[2];
+            double error = a00 * x * x + a11 * y * y + a22 * z * z +
+                           2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                           2 * (b0 * x + b1 * y + b2 * z) + c;
+            return weight > 0 ? std::max(error, 0.0) / weight : 0.0;
+        }
+    };
+
+    // Moving vertex from onto vertex to (both by position)
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        double error;
+
+        bool operator<(const Collapse& other) const
+        {
+            return error < other.error;
+        }
+    };
+
+    // A directed edge between two positions.  murmur3's finalizer can be
+    // undone, so different edges never get the same key.
+    uint64_t EdgeKey(uint32_t a, uint32_t b)
+    {
+        uint64_t key = (uint64_t)a << 32 | b;
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    void Normal(const float *p0, const float *p1, const float *p2,
+                double n[3])
+    {
+        double e1[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1],
+                         (double)p1[2] - p0[2] };
+        double e2[3] = { (double)p2[0] - p0[0], (double)p2[1] - p0[1],
+                         (double)p2[2] - p0[2] };
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    // Number every vertex by the first vertex with the same position
+    void WeldPositions(const MeshVertex *vertices, size_t numVertices,
+                       std::vector<uint32_t>& positionOf)
+    {
+        std::vector<uint32_t> order(numVertices);
+        for (size_t i = 0; i < numVertices; i++)
+            order[i] = (uint32_t)i;
+
+        auto less = [vertices](uint32_t a, uint32_t b) {
+            int c = std::memcmp(vertices[a].position, vertices[b].position,
+                                sizeof(vertices[a].position));
+            return c != 0 ? c < 0 : a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        positionOf.resize(numVertices);
+        for (size_t i = 0; i < numVertices; i++) {
+            uint32_t v = order[i];
+            bool same = i > 0 &&
+                std::memcmp(vertices[v].position,
+                            vertices[order[i - 1]].position,
+                            sizeof(vertices[v].position)) == 0;
+            positionOf[v] = same ? positionOf[order[i - 1]] : v;
+        }
+    }
+
+    // Mark the positions we mustn't move: ones with more than one vertex,
+    // and ones on an edge that doesn't have exactly one triangle on each
+    // side
+    void FindLocked(const uint32_t *indices, size_t numIndices,
+                    const std::vector<uint32_t>& positionOf,
+                    std::vector<uint8_t>& locked)
+    {
+        size_t numVertices = positionOf.size();
+        locked.assign(numVertices, 0);
+
+        for (size_t v = 0; v < numVertices; v++) {
+            if (positionOf[v] != v)
+                locked[positionOf[v]] = 1;
+        }
+
+        HashMap<uint32_t> edges(numIndices);
+        for (size_t i = 0; i < numIndices; i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = positionOf[indices[i + k]];
+                uint32_t b = positionOf[indices[i + (k + 1) % 3]];
+                if (a != b)
+                    edges[EdgeKey(a, b)]++;
+            }
+        }
+
+        for (size_t i = 0; i < numIndices; i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = positionOf[indices[i + k]];
+                uint32_t b = positionOf[indices[i + (k + 1) % 3]];
+                if (a == b)
+                    continue;
+
+                const uint32_t *twin = edges.Find(EdgeKey(b, a));
+                if (*edges.Find(EdgeKey(a, b)) != 1 ||
+                    twin == nullptr || *twin != 1) {
+                    locked[a] = 1;
+                    locked[b] = 1;
+                }
+            }
+        }
+    }
+}
+
+
+size_t SimplifyMesh(uint32_t *indices, size_t numIndices,
+                    const MeshVertex *vertices, size_t numVertices,
+                    size_t targetIndices, float maxError,
+                    float *resultError)
+{
+    double worst = 0;
+    double maxErrorSquared = (double)maxError * maxError;
+
+    std::vector<uint32_t> positionOf;
+    WeldPositions(vertices, numVertices, positionOf);
+
+    std::vector<uint8_t> locked;
+    FindLocked(indices, numIndices, positionOf, locked);
+
+    std::vector<Quadric> quadrics(numVertices);
+    for (size_t i = 0; i < numIndices; i += 3) {
+        uint32_t p[3];
+        for (int k = 0; k < 3; k++)
+            p[k] = positionOf[indices[i + k]];
+
+        double n[3];
+        Normal(vertices[p[0]].position, vertices[p[1]].position,
+               vertices[p[2]].position, n);
+        double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0)
+            continue;
+
+        for (int k = 0; k < 3; k++)
+            n[k] /= length;
+        const float *p0 = vertices[p[0]].position;
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+
+        for (int k = 0; k < 3; k++)
+            quadrics[p[k]].AddPlane(n, d, 0.5 * length);
+    }
+
+    // The triangles around each position, and where each vertex goes
+    std::vector<uint32_t> firstTriangle(numVertices + 1);
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> remap(numVertices);
+    std::vector<uint8_t> changed(numVertices);
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> neighbours;
+
+    while (numIndices > targetIndices) {
+        size_t numTriangles = numIndices / 3;
+
+        std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+        for (size_t i = 0; i < numIndices; i++)
+            firstTriangle[positionOf[indices[i]] + 1]++;
+        for (size_t v = 0; v < numVertices; v++)
+            firstTriangle[v + 1] += firstTriangle[v];
+
+        triangles.resize(numIndices);
+        std::vector<uint32_t> filled(firstTriangle.begin(),
+                                     firstTriangle.end() - 1);
+        for (size_t i = 0; i < numIndices; i++)
+            triangles[filled[positionOf[indices[i]]]++] = (uint32_t)(i / 3);
+
+        // Every way an edge could go, cheapest first
+        collapses.clear();
+        for (size_t i = 0; i < numIndices; i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = positionOf[indices[i + k]];
+                uint32_t b = positionOf[indices[i + (k + 1) % 3]];
+                if (a == b)
+                    continue;
+
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                if (!locked[a])
+                    collapses.push_back({ a, b, q.Error(
+                        vertices[b].position) });
+                if (!locked[b])
+                    collapses.push_back({ b, a, q.Error(
+                        vertices[a].position) });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end());
+
+        for (size_t v = 0; v < numVertices; v++)
+            remap[v] = (uint32_t)v;
+        std::fill(changed.begin(), changed.end(), 0);
+
+        // Collapse as many as we can that don't touch each other's
+        // triangles, since the checks below assume those stay put
+        size_t removed = 0;
+        size_t numCollapsed = 0;
+        for (const Collapse& collapse : collapses) {
+            if ((numTriangles - removed) * 3 <= targetIndices ||
+                collapse.error > maxErrorSquared)
+                break;
+
+            uint32_t a = collapse.from;
+            uint32_t b = collapse.to;
+            if (changed[a] || changed[b])
+                continue;
+
+            // The vertex of b that a's triangles use, which has to be the
+            // same one in all of them, and a's neighbours
+            uint32_t target = ~0u;
+            size_t shared = 0;
+            bool ok = true;
+            neighbours.clear();
+
+            for (uint32_t t = firstTriangle[a];
+                 ok && t < firstTriangle[a + 1]; t++) {
+                const uint32_t *corner = indices + 3 * triangles[t];
+                bool hasB = false;
+
+                for (int k = 0; k < 3; k++) {
+                    uint32_t p = positionOf[corner[k]];
+                    if (p == b) {
+                        hasB = true;
+                        if (target != ~0u && target != corner[k])
+                            ok = false;
+                        target = corner[k];
+                    }
+                    if (p != a)
+                        neighbours.push_back(p);
+                }
+
+                if (hasB) {
+                    shared++;
+                    continue;
+                }
+
+                // The triangle mustn't flip over when a moves
+                const float *p[3];
+                const float *q[3];
+                for (int k = 0; k < 3; k++) {
+                    uint32_t v = positionOf[corner[k]];
+                    p[k] = vertices[v].position;
+                    q[k] = v == a ? vertices[b].position : p[k];
+                }
+
+                double before[3], after[3];
+                Normal(p[0], p[1], p[2], before);
+                Normal(q[0], q[1], q[2], after);
+                bool degenerate = before[0] == 0 && before[1] == 0 &&
+                                  before[2] == 0;
+                if (!degenerate && before[0] * after[0] +
+                    before[1] * after[1] + before[2] * after[2] <= 0)
+                    ok = false;
+            }
+
+            if (!ok || shared == 0)
+                continue;
+
+            // The positions next to both a and b have to be just the ones
+            // across the triangles we're removing, or the mesh would
+            // fold onto itself
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(),
+                                         neighbours.end()),
+                             neighbours.end());
+
+            size_t common = 0;
+            for (uint32_t t = firstTriangle[b];
+                 t < firstTriangle[b + 1]; t++) {
+                const uint32_t *corner = indices + 3 * triangles[t];
+                for (int k = 0; k < 3; k++) {
+                    uint32_t p = positionOf[corner[k]];
+                    if (p != a && p != b &&
+                        std::binary_search(neighbours.begin(),
+                                           neighbours.end(), p)) {
+                        common++;
+                    }
+                }
+            }
+
+            // each common neighbour is in two of b's triangles
+            if (common != 2 * shared)
+                continue;
+
+            remap[a] = target;
+            quadrics[b] += quadrics[a];
+            for (uint32_t p : neighbours)
+                changed[p] = 1;
+            changed[a] = 1;
+
+            worst = std::max(worst, collapse.error);
+            removed += shared;
+            numCollapsed++;
+        }
+
+        if (numCollapsed == 0)
+            break;
+
+        // Move the vertices, and drop the triangles that got squashed
+        size_t count = 0;
+        for (size_t i = 0; i < numIndices; i += 3) {
+            uint32_t v[3];
+            for (int k = 0; k < 3; k++)
+                v[k] = remap[indices[i + k]];
+
+            uint32_t p0 = positionOf[v[0]];
+            uint32_t p1 = positionOf[v[1]];
+            uint32_t p2 = positionOf[v[2]];
+            if (p0 == p1 || p1 == p2 || p2 == p0)
+                continue;
+
+            for (int k = 0; k < 3; k++)
+                indices[count++] = v[k];
+        }
+        numIndices = count;
+    }
+
+    if (resultError != nullptr)
+        *resultError = (float)std::sqrt(worst);
+
+    return numIndices;
+}
+
+
+void LodMesh::Build(const Mesh& source, size_t maxLevels, float ratio,
+                    float maxError)
+{
+    Clear();
+
+    const MeshVertex *vertices = source.Vertices();
+    size_t numVertices = source.NumVertices();
+
+    std::vector<MeshVertex> vertexStorage(vertices, vertices + numVertices);
+    std::vector<uint32_t> indexStorage(source.Indices(),
+                                       source.Indices() +
+                                       source.NumIndices());
+    OptimizeVertexCache(indexStorage.data(), indexStorage.size(),
+                        numVertices);
+    levels.push_back({ 0, indexStorage.size(), 0.0f });
+
+    std::vector<uint32_t> level;
+    while (levels.size() < std::min(maxLevels, MaxLevels)) {
+        const LodLevel& previous = levels.back();
+        size_t target = (size_t)(previous.numIndices / 3 * ratio) * 3;
+
+        // Always from the original, so the errors are against that
+        level.assign(source.Indices(),
+                     source.Indices() + source.NumIndices());
+        float error = 0;
+        size_t count = SimplifyMesh(level.data(), level.size(),
+                                    vertices, numVertices,
+                                    target, maxError, &error);
+
+        // Not even half the way there isn't worth a level
+        if (count == 0 ||
+            previous.numIndices - count < (previous.numIndices - target) / 2)
+            break;
+
+        OptimizeVertexCache(level.data(), count, numVertices);
+        levels.push_back({ indexStorage.size(), count,
+                           std::max(error, previous.error) });
+        indexStorage.insert(indexStorage.end(), level.begin(),
+                            level.begin() + count);
+    }
+
+    mesh.Assign(std::move(vertexStorage), std::move(indexStorage));
+
+    for (int k = 0; k < 3; k++)
+        center[k] = 0.5f * (mesh.BoundsMin()[k] + mesh.BoundsMax()[k]);
+
+    float radiusSquared = 0;
+    for (size_t i = 0; i < numVertices; i++) {
+        const float *p = vertices[i].position;
+        float dx = p[0] - center[0];
+        float dy = p[1] - center[1];
+        float dz = p[2] - center[2];
+        radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+    }
+    radius = std::sqrt(radiusSquared);
+}
+
+
+void LodMesh::Clear()
+{
+    mesh.Clear();
+    levels.clear();
+    center[0] = center[1] = center[2] = 0;
+    radius = 0;
+}
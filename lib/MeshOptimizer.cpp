@@ -0,0 +1,507 @@
+//============================================================================
+// Name        : MeshOptimizer.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Vertex cache, overdraw and vertex fetch ordering of mesh
+//               indices, and quantizing mesh vertices.
+//============================================================================
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "MeshOptimizer.hpp"
+
+namespace {
+    // Forsyth's numbers
+    const size_t LruCacheSize = 32;
+    const float CacheDecayPower = 1.5f;
+    const float LastTriangleScore = 0.75f;
+    const float ValenceBoostScale = 2.0f;
+    const float ValenceBoostPower = 0.5f;
+    const size_t MaxValence = 64;
+
+    const uint32_t Unused = ~0u;
+    const size_t NoTriangle = ~(size_t)0;
+
+    // The score of a vertex at this cache position (-1 is not in the
+    // cache) with this many triangles left to draw, out of tables, since
+    // it gets worked out a lot
+    struct VertexScores
+    {
+        float cache[LruCacheSize];
+        float valence[MaxValence];
+
+        VertexScores()
+        {
+            for (size_t i = 0; i < LruCacheSize; i++) {
+                // the last triangle's vertices get a fixed score, so that
+                // which of them came first doesn't matter
+                cache[i] = i < 3 ? LastTriangleScore
+                    : std::pow(1.0f - (float)(i - 3) / (LruCacheSize - 3),
+                               CacheDecayPower);
+            }
+
+            for (size_t i = 0; i < MaxValence; i++)
+                valence[i] = Boost(i);
+        }
+
+        static float Boost(size_t remaining)
+        {
+            return remaining == 0 ? 0.0f
+                : ValenceBoostScale *
+                  std::pow((float)remaining, -ValenceBoostPower);
+        }
+
+        float operator()(int cachePosition, uint32_t remaining) const
+        {
+            if (remaining == 0)
+                return -1.0f;
+
+            float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+            return score + (remaining < MaxValence ? valence[remaining]
+                                                   : Boost(remaining));
+        }
+    };
+
+    const float *Position(const MeshVertex *vertices, uint32_t index)
+    {
+        return vertices[index].position;
+    }
+
+    // How many of a triangle's vertices miss a FIFO cache.  A vertex is
+    // in the cache if fewer than 'cacheSize' misses happened since its
+    // own, so moving 'time' on past that empties the cache.
+    uint32_t TriangleMisses(const uint32_t *triangle,
+                            std::vector<uint32_t>& timestamps,
+                            uint32_t& time, size_t cacheSize)
+    {
+        uint32_t misses = 0;
+
+        for (size_t corner = 0; corner < 3; corner++) {
+            uint32_t v = triangle[corner];
+
+            if (time - timestamps[v] > cacheSize) {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+
+        return misses;
+    }
+
+    void CountMisses(const uint32_t *indices, size_t numTriangles,
+                     size_t numVertices, size_t cacheSize,
+                     std::vector<uint8_t>& misses)
+    {
+        std::vector<uint32_t> timestamps(numVertices, 0);
+        uint32_t time = (uint32_t)cacheSize + 1;
+
+        misses.resize(numTriangles);
+        for (size_t t = 0; t < numTriangles; t++)
+            misses[t] = (uint8_t)TriangleMisses(indices + t * 3, timestamps,
+                                                time, cacheSize);
+    }
+}
+
+
+double AverageCacheMissRatio(const uint32_t *indices, size_t numIndices,
+                             size_t numVertices, size_t cacheSize)
+{
+    size_t numTriangles = numIndices / 3;
+    if (numTriangles == 0)
+        return 0.0;
+
+    std::vector<uint8_t> misses;
+    CountMisses(indices, numTriangles, numVertices, cacheSize, misses);
+
+    size_t total = 0;
+    for (uint8_t count : misses)
+        total += count;
+
+    return (double)total / numTriangles;
+}
+
+
+void OptimizeVertexCache(uint32_t *indices, size_t numIndices,
+                         size_t numVertices)
+{
+    static const VertexScores vertexScore;
+
+    size_t numTriangles = numIndices / 3;
+    if (numTriangles == 0)
+        return;
+
+    // Each vertex's triangles.  The first 'remaining' of them are the
+    // ones that haven't been drawn yet.
+    std::vector<uint32_t> remaining(numVertices, 0);
+    for (size_t i = 0; i < numTriangles * 3; i++)
+        remaining[indices[i]]++;
+
+    std::vector<uint32_t> offsets(numVertices + 1, 0);
+    for (size_t v = 0; v < numVertices; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    std::vector<uint32_t> adjacency(numTriangles * 3);
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < numTriangles * 3; i++)
+        adjacency[filled[indices[i]]++] = (uint32_t)(i / 3);
+
+    std::vector<int> cachePosition(numVertices, -1);
+    std::vector<float> score(numVertices);
+    for (size_t v = 0; v < numVertices; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(numTriangles);
+    std::vector<bool> drawn(numTriangles, false);
+    size_t best = 0;
+
+    for (size_t t = 0; t < numTriangles; t++) {
+        triangleScore[t] = score[indices[t * 3]] +
+                           score[indices[t * 3 + 1]] +
+                           score[indices[t * 3 + 2]];
+
+        if (triangleScore[t] > triangleScore[best])
+            best = t;
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(numTriangles * 3);
+
+    uint32_t cache[LruCacheSize + 3];
+    size_t cacheCount = 0;
+    size_t cursor = 0;
+
+    while (output.size() < numTriangles * 3) {
+        // Nothing in the cache has triangles left, so start somewhere new
+        if (best == NoTriangle) {
+            while (drawn[cursor])
+                cursor++;
+            best = cursor;
+        }
+
+        const uint32_t *triangle = indices + best * 3;
+        output.insert(output.end(), triangle, triangle + 3);
+        drawn[best] = true;
+
+        // It's drawn, so it's no longer one of its vertices' triangles
+        for (size_t corner = 0; corner < 3; corner++) {
+            uint32_t v = triangle[corner];
+            uint32_t *list = &adjacency[offsets[v]];
+            uint32_t *last = list + remaining[v] - 1;
+
+            std::iter_swap(std::find(list, last, (uint32_t)best), last);
+            remaining[v]--;
+        }
+
+        // Its vertices go to the front of the cache, and whatever falls
+        // off the end is out
+        uint32_t newCache[LruCacheSize + 3];
+        size_t newCount = 0;
+
+        for (size_t corner = 0; corner < 3; corner++) {
+            uint32_t v = triangle[corner];
+            if (std::find(newCache, newCache + newCount, v) ==
+                newCache + newCount)
+                newCache[newCount++] = v;
+        }
+
+        for (size_t i = 0; i < cacheCount; i++) {
+            uint32_t v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache[newCount++] = v;
+        }
+
+        for (size_t i = 0; i < newCount; i++) {
+            uint32_t v = newCache[i];
+            cachePosition[v] = i < LruCacheSize ? (int)i : -1;
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+
+        // Only the triangles of the vertices we just scored can have
+        // changed, and the best of them is next
+        best = NoTriangle;
+        float bestScore = -1.0f;
+
+        for (size_t i = 0; i < newCount; i++) {
+            uint32_t v = newCache[i];
+
+            for (uint32_t j = 0; j < remaining[v]; j++) {
+                uint32_t t = adjacency[offsets[v] + j];
+                triangleScore[t] = score[indices[t * 3]] +
+                                   score[indices[t * 3 + 1]] +
+                                   score[indices[t * 3 + 2]];
+
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = std::min(newCount, LruCacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+
+void OptimizeOverdraw(uint32_t *indices, size_t numIndices,
+                      const MeshVertex *vertices, size_t numVertices,
+                      float threshold)
+{
+    const size_t cacheSize = 16;
+
+    size_t numTriangles = numIndices / 3;
+    if (numTriangles == 0)
+        return;
+
+    std::vector<uint8_t> misses;
+    CountMisses(indices, numTriangles, numVertices, cacheSize, misses);
+
+    // Hard boundaries are where the cache order started over anyway, all
+    // three vertices missed
+    std::vector<size_t> hard;
+    for (size_t t = 0; t < numTriangles; t++) {
+        if (t == 0 || misses[t] == 3)
+            hard.push_back(t);
+    }
+    hard.push_back(numTriangles);
+
+    // Within those, we can start a new cluster (with an empty cache) as
+    // soon as the triangles so far are within the threshold of the
+    // whole's miss ratio
+    std::vector<size_t> clusters;
+    std::vector<uint32_t> timestamps(numVertices, 0);
+    uint32_t time = 0;
+
+    for (size_t h = 0; h + 1 < hard.size(); h++) {
+        size_t begin = hard[h];
+        size_t end = hard[h + 1];
+
+        size_t total = 0;
+        for (size_t t = begin; t < end; t++)
+            total += misses[t];
+
+        double target = threshold * total / (end - begin);
+
+        size_t start = begin;
+        while (start < end) {
+            clusters.push_back(start);
+            time += (uint32_t)cacheSize + 1;
+
+            size_t count = 0;
+            size_t t = start;
+            while (t < end) {
+                count += TriangleMisses(indices + t++ * 3, timestamps, time,
+                                        cacheSize);
+                if (t - start >= 8 && count <= target * (t - start))
+                    break;
+            }
+
+            start = t;
+        }
+    }
+    clusters.push_back(numTriangles);
+
+    // The middle of the mesh, by its triangles' corners
+    double middle[3] = {0, 0, 0};
+    for (size_t i = 0; i < numTriangles * 3; i++) {
+        for (int axis = 0; axis < 3; axis++)
+            middle[axis] += Position(vertices, indices[i])[axis];
+    }
+    for (int axis = 0; axis < 3; axis++)
+        middle[axis] /= numTriangles * 3;
+
+    // How far out each cluster faces: its area weighted normal, dotted
+    // with the way from the middle to its centre
+    size_t numClusters = clusters.size() - 1;
+    std::vector<float> facing(numClusters);
+
+    for (size_t c = 0; c < numClusters; c++) {
+        double centre[3] = {0, 0, 0};
+        double normal[3] = {0, 0, 0};
+        double area = 0;
+
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const float *a = Position(vertices, indices[t * 3]);
+            const float *b = Position(vertices, indices[t * 3 + 1]);
+            const float *d = Position(vertices, indices[t * 3 + 2]);
+
+            double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            double v[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+            double n[3] = { u[1] * v[2] - u[2] * v[1],
+                            u[2] * v[0] - u[0] * v[2],
+                            u[0] * v[1] - u[1] * v[0] };
+            double weight = std::sqrt(n[0] * n[0] + n[1] * n[1] +
+                                      n[2] * n[2]);
+
+            for (int axis = 0; axis < 3; axis++) {
+                centre[axis] += weight * (a[axis] + b[axis] + d[axis]) / 3;
+                normal[axis] += n[axis];
+            }
+            area += weight;
+        }
+
+        double length = std::sqrt(normal[0] * normal[0] +
+                                  normal[1] * normal[1] +
+                                  normal[2] * normal[2]);
+        if (area <= 0 || length <= 0) {
+            facing[c] = 0;
+            continue;
+        }
+
+        facing[c] = (float)(((centre[0] / area - middle[0]) * normal[0] +
+                             (centre[1] / area - middle[1]) * normal[1] +
+                             (centre[2] / area - middle[2]) * normal[2]) /
+                            length);
+    }
+
+    std::vector<size_t> order(numClusters);
+    for (size_t c = 0; c < numClusters; c++)
+        order[c] = c;
+
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return facing[a] > facing[b];
+    });
+
+    std::vector<uint32_t> output;
+    output.reserve(numTriangles * 3);
+
+    for (size_t c : order)
+        output.insert(output.end(), indices + clusters[c] * 3,
+                      indices + clusters[c + 1] * 3);
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+
+size_t OptimizeVertexFetch(MeshVertex *vertices, size_t numVertices,
+                           uint32_t *indices, size_t numIndices)
+{
+    std::vector<uint32_t> remap(numVertices, Unused);
+    uint32_t next = 0;
+
+    for (size_t i = 0; i < numIndices; i++) {
+        uint32_t& index = remap[indices[i]];
+        if (index == Unused)
+            index = next++;
+
+        indices[i] = index;
+    }
+
+    std::vector<MeshVertex> reordered(next);
+    for (size_t v = 0; v < numVertices; v++) {
+        if (remap[v] != Unused)
+            reordered[remap[v]] = vertices[v];
+    }
+
+    std::copy(reordered.begin(), reordered.end(), vertices);
+    return next;
+}
+
+
+void OptimizeMesh(Mesh& mesh, float overdrawThreshold)
+{
+    std::vector<MeshVertex> vertices(mesh.Vertices(),
+                                     mesh.Vertices() + mesh.NumVertices());
+    std::vector<uint32_t> indices(mesh.Indices(),
+                                  mesh.Indices() + mesh.NumIndices());
+
+    OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+    OptimizeOverdraw(indices.data(), indices.size(), vertices.data(),
+                     vertices.size(), overdrawThreshold);
+    vertices.resize(OptimizeVertexFetch(vertices.data(), vertices.size(),
+                                        indices.data(), indices.size()));
+
+    mesh.Assign(std::move(vertices), std::move(indices));
+}
+
+
+void QuantizedMesh::Quantize(const Mesh& mesh)
+{
+    const MeshVertex *source = mesh.Vertices();
+    size_t count = mesh.NumVertices();
+
+    float texCoordMin[2] = {0, 0};
+    float texCoordMax[2] = {0, 0};
+
+    for (size_t i = 0; i < count; i++) {
+        for (int axis = 0; axis < 2; axis++) {
+            float value = source[i].texCoord[axis];
+            texCoordMin[axis] = i == 0 ? value
+                                       : std::min(texCoordMin[axis], value);
+            texCoordMax[axis] = i == 0 ? value
+                                       : std::max(texCoordMax[axis], value);
+        }
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+        positionOffset[axis] = mesh.BoundsMin()[axis];
+        positionScale[axis] = mesh.BoundsMax()[axis] - mesh.BoundsMin()[axis];
+    }
+    for (int axis = 0; axis < 2; axis++) {
+        texCoordOffset[axis] = texCoordMin[axis];
+        texCoordScale[axis] = texCoordMax[axis] - texCoordMin[axis];
+    }
+
+    auto unorm16 = [](float value, float offset, float scale) {
+        float normalized = scale > 0 ? (value - offset) / scale : 0.0f;
+        normalized = std::min(std::max(normalized, 0.0f), 1.0f);
+        return (uint16_t)std::lround(normalized * 65535.0f);
+    };
+
+    auto snorm8 = [](float value) {
+        value = std::min(std::max(value, -1.0f), 1.0f);
+        return (int8_t)std::lround(value * 127.0f);
+    };
+
+    vertices.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        QuantizedVertex& vertex = vertices[i];
+
+        for (int axis = 0; axis < 3; axis++) {
+            vertex.position[axis] = unorm16(source[i].position[axis],
+                                            positionOffset[axis],
+                                            positionScale[axis]);
+            vertex.normal[axis] = snorm8(source[i].normal[axis]);
+        }
+        for (int axis = 0; axis < 2; axis++)
+            vertex.texCoord[axis] = unorm16(source[i].texCoord[axis],
+                                            texCoordOffset[axis],
+                                            texCoordScale[axis]);
+
+        vertex.position[3] = 0;
+        vertex.normal[3] = 0;
+    }
+
+    numIndices = mesh.NumIndices();
+    shortIndices.clear();
+    indices.clear();
+
+    if (count <= 65536)
+        shortIndices.assign(mesh.Indices(), mesh.Indices() + numIndices);
+    else
+        indices.assign(mesh.Indices(), mesh.Indices() + numIndices);
+}
+
+
+MeshVertex QuantizedMesh::Dequantize(size_t index) const
+{
+    const QuantizedVertex& vertex = vertices[index];
+    MeshVertex result;
+
+    for (int axis = 0; axis < 3; axis++) {
+        result.position[axis] = positionOffset[axis] + positionScale[axis] *
+                                vertex.position[axis] / 65535.0f;
+        result.normal[axis] = std::max(vertex.normal[axis] / 127.0f, -1.0f);
+    }
+    for (int axis = 0; axis < 2; axis++)
+        result.texCoord[axis] = texCoordOffset[axis] + texCoordScale[axis] *
+                                vertex.texCoord[axis] / 65535.0f;
+
+    return result;
+}
@@ -0,0 +1,460 @@
+//============================================================================
+// Name        : MipmapGenerator.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Builds mip chains on the CPU.  The plain box filter works
+//               on the bytes, 4 pixels at a time with SSE2.  Everything
+//               else (sRGB, or the Kaiser filter) gets filtered as floats,
+//               a pixel to an SSE register, in two separable passes.
+//============================================================================
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "MipmapGenerator.hpp"
+
+namespace {
+    // Levels smaller than this get done on the calling thread
+    const size_t MinParallelPixels = 64 * 1024;
+
+    // and the bigger ones get split into jobs of about this many pixels
+    const size_t PixelsPerJob = 16 * 1024;
+
+    // The Kaiser filter covers 4 source pixels on either side of the
+    // destination pixel's center.
+    const int MaxTaps = 8;
+    const double KaiserRadius = 4.0;
+    const double KaiserBeta = 4.0;
+
+    // The linear value to byte table is indexed by this many steps.
+    // It needs to be fine enough for the dark end of sRGB.
+    const int EncodeTableSize = 16384;
+
+    struct Taps
+    {
+        int first;  // relative to twice the destination coordinate
+        int count;
+        float weights[MaxTaps];
+    };
+
+    struct ColorTables
+    {
+        float decode[256];
+        unsigned char encode[EncodeTableSize];
+    };
+
+    double BesselI0(double x)
+    {
+        // the series converges quickly for the betas we use
+        double sum = 1.0;
+        double term = 1.0;
+
+        for (int k = 1; k < 32; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    Taps MakeBoxTaps()
+    {
+        Taps taps = { 0, 2, { 0.5f, 0.5f } };
+        return taps;
+    }
+
+    Taps MakeKaiserTaps()
+    {
+        const double pi = 3.14159265358979323846;
+
+        Taps taps;
+        taps.first = 1 - MaxTaps / 2;
+        taps.count = MaxTaps;
+
+        double sum = 0.0;
+        double weights[MaxTaps];
+
+        for (int k = 0; k < MaxTaps; k++) {
+            // from the source pixel's center to the destination's
+            double d = (taps.first + k) - 0.5;
+
+            // half the source frequency, so the sinc is stretched by 2
+            double x = pi * d / 2.0;
+            double sinc = (x == 0.0) ? 1.0 : std::sin(x) / x;
+
+            double r = d / KaiserRadius;
+            double window = BesselI0(KaiserBeta * std::sqrt(1.0 - r * r)) /
+                            BesselI0(KaiserBeta);
+
+            weights[k] = sinc * window;
+            sum += weights[k];
+        }
+
+        for (int k = 0; k < MaxTaps; k++)
+            taps.weights[k] = (float)(weights[k] / sum);
+
+        return taps;
+    }
+
+    ColorTables MakeColorTables(bool srgb)
+    {
+        ColorTables tables;
+
+        for (int i = 0; i < 256; i++) {
+            double c = i / 255.0;
+
+            if (srgb) {
+                c = (c <= 0.04045) ? c / 12.92
+                                   : std::pow((c + 0.055) / 1.055, 2.4);
+            }
+
+            tables.decode[i] = (float)c;
+        }
+
+        for (int i = 0; i < EncodeTableSize; i++) {
+            double c = (double)i / (EncodeTableSize - 1);
+
+            if (srgb) {
+                c = (c <= 0.0031308) ? c * 12.92
+                                     : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+            }
+
+            tables.encode[i] = (unsigned char)(c * 255.0 + 0.5);
+        }
+
+        return tables;
+    }
+
+    const Taps& BoxTaps()
+    {
+        static const Taps taps = MakeBoxTaps();
+        return taps;
+    }
+
+    const Taps& KaiserTaps()
+    {
+        static const Taps taps = MakeKaiserTaps();
+        return taps;
+    }
+
+    const ColorTables& LinearTables()
+    {
+        static const ColorTables tables = MakeColorTables(false);
+        return tables;
+    }
+
+    const ColorTables& SRGBTables()
+    {
+        static const ColorTables tables = MakeColorTables(true);
+        return tables;
+    }
+
+    inline int Clamp(int value, int high)
+    {
+        return (value < 0) ? 0 : (value > high) ? high : value;
+    }
+
+    // One pixel, as 4 floats
+#ifdef __SSE2__
+    struct Texel
+    {
+        __m128 v;
+    };
+
+    inline Texel TexelZero()
+    {
+        Texel texel = { _mm_setzero_ps() };
+        return texel;
+    }
+
+    inline Texel TexelMulAdd(Texel sum, Texel texel, float weight)
+    {
+        sum.v = _mm_add_ps(sum.v, _mm_mul_ps(texel.v, _mm_set1_ps(weight)));
+        return sum;
+    }
+
+    inline Texel TexelLoad(const unsigned char *p, const ColorTables& tables)
+    {
+        Texel texel = { _mm_setr_ps(tables.decode[p[0]], tables.decode[p[1]],
+                                    tables.decode[p[2]],
+                                    p[3] * (1.0f / 255.0f)) };
+        return texel;
+    }
+
+    inline void TexelStore(Texel texel, unsigned char *p,
+                           const ColorTables& tables)
+    {
+        // The Kaiser filter's lobes can overshoot
+        __m128 v = _mm_min_ps(_mm_max_ps(texel.v, _mm_setzero_ps()),
+                              _mm_set1_ps(1.0f));
+
+        alignas(16) int index[4];
+        _mm_store_si128((__m128i *)index,
+                        _mm_cvtps_epi32(_mm_mul_ps(v,
+                            _mm_set1_ps((float)(EncodeTableSize - 1)))));
+
+        p[0] = tables.encode[index[0]];
+        p[1] = tables.encode[index[1]];
+        p[2] = tables.encode[index[2]];
+
+        float alpha = _mm_cvtss_f32(_mm_shuffle_ps(v, v, 3));
+        p[3] = (unsigned char)(alpha * 255.0f + 0.5f);
+    }
+#else
+    struct Texel
+    {
+        float c[4];
+    };
+
+    inline Texel TexelZero()
+    {
+        Texel texel = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+        return texel;
+    }
+
+    inline Texel TexelMulAdd(Texel sum, Texel texel, float weight)
+    {
+        for (int i = 0; i < 4; i++)
+            sum.c[i] += texel.c[i] * weight;
+
+        return sum;
+    }
+
+    inline Texel TexelLoad(const unsigned char *p, const ColorTables& tables)
+    {
+        Texel texel = { { tables.decode[p[0]], tables.decode[p[1]],
+                          tables.decode[p[2]], p[3] * (1.0f / 255.0f) } };
+        return texel;
+    }
+
+    inline void TexelStore(Texel texel, unsigned char *p,
+                           const ColorTables& tables)
+    {
+        for (int i = 0; i < 4; i++)
+            texel.c[i] = std::min(std::max(texel.c[i], 0.0f), 1.0f);
+
+        for (int i = 0; i < 3; i++) {
+            int index = (int)(texel.c[i] * (EncodeTableSize - 1) + 0.5f);
+            p[i] = tables.encode[index];
+        }
+
+        p[3] = (unsigned char)(texel.c[3] * 255.0f + 0.5f);
+    }
+#endif
+} // namespace
+
+
+MipmapGenerator::MipmapGenerator(Filter filter, bool srgb, JobSystem *jobs)
+    : filter(filter), srgb(srgb), jobs(jobs)
+{
+}
+
+
+std::vector<MipmapGenerator::Level>
+MipmapGenerator::Generate(const unsigned char *pixels,
+                          int width, int height) const
+{
+    std::vector<Level> levels;
+
+    int numLevels = 0;
+    for (int size = std::max(width, height); size > 1; size >>= 1)
+        numLevels++;
+
+    levels.reserve(numLevels);
+
+    const unsigned char *src = pixels;
+
+    while (width > 1 || height > 1) {
+        Level level;
+        level.width = std::max(width / 2, 1);
+        level.height = std::max(height / 2, 1);
+        level.pixels.resize((size_t)level.width * level.height * 4);
+
+        Downsample(src, width, height, level.pixels.data());
+
+        levels.push_back(std::move(level));
+
+        src = levels.back().pixels.data();
+        width = levels.back().width;
+        height = levels.back().height;
+    }
+
+    return levels;
+}
+
+
+void MipmapGenerator::Downsample(const unsigned char *src,
+                                 int srcWidth, int srcHeight,
+                                 unsigned char *dst) const
+{
+    bool parallel = (jobs != nullptr &&
+                     (size_t)srcWidth * srcHeight >= MinParallelPixels);
+
+    if (filter == Box && !srgb)
+        DownsampleBox(src, srcWidth, srcHeight, dst, parallel);
+    else
+        DownsampleFiltered(src, srcWidth, srcHeight, dst, parallel);
+}
+
+
+template <typename F>
+void MipmapGenerator::ForRows(int numRows, int rowWidth, bool parallel,
+                              const F& fn) const
+{
+    if (!parallel) {
+        fn((size_t)0, (size_t)numRows);
+        return;
+    }
+
+    size_t grainSize = std::max<size_t>(PixelsPerJob / rowWidth, 1);
+    jobs->ParallelFor(0, numRows, grainSize, fn);
+}
+
+
+// Average each 2x2 block of bytes, rounding to nearest.  An odd last row
+// or column gets left out, unless it's all there is.
+void MipmapGenerator::DownsampleBox(const unsigned char *src,
+                                    int srcWidth, int srcHeight,
+                                    unsigned char *dst, bool parallel) const
+{
+    int dstWidth = std::max(srcWidth / 2, 1);
+    int dstHeight = std::max(srcHeight / 2, 1);
+
+    ForRows(dstHeight, dstWidth, parallel, [=](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            size_t rowSize = (size_t)srcWidth * 4;
+            const unsigned char *rowA =
+                src + Clamp(2 * (int)y, srcHeight - 1) * rowSize;
+            const unsigned char *rowB =
+                src + Clamp(2 * (int)y + 1, srcHeight - 1) * rowSize;
+            unsigned char *out = dst + y * dstWidth * 4;
+
+            int x = 0;
+
+#ifdef __SSE2__
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i two = _mm_set1_epi16(2);
+
+            // 8 source pixels from each row make 4 destination pixels
+            for (; x + 4 <= dstWidth && 2 * (x + 4) <= srcWidth; x += 4) {
+                const unsigned char *a = rowA + x * 8;
+                const unsigned char *b = rowB + x * 8;
+
+                __m128i a0 = _mm_loadu_si128((const __m128i *)a);
+                __m128i a1 = _mm_loadu_si128((const __m128i *)(a + 16));
+                __m128i b0 = _mm_loadu_si128((const __m128i *)b);
+                __m128i b1 = _mm_loadu_si128((const __m128i *)(b + 16));
+
+                // Add the rows as 16 bit values.  Each of these has the
+                // 2 source pixels of one destination pixel.
+                __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero),
+                                           _mm_unpacklo_epi8(b0, zero));
+                __m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero),
+                                           _mm_unpackhi_epi8(b0, zero));
+                __m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero),
+                                           _mm_unpacklo_epi8(b1, zero));
+                __m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero),
+                                           _mm_unpackhi_epi8(b1, zero));
+
+                // and then the pixels of each pair
+                __m128i d01 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1),
+                                            _mm_unpackhi_epi64(s0, s1));
+                __m128i d23 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3),
+                                            _mm_unpackhi_epi64(s2, s3));
+
+                d01 = _mm_srli_epi16(_mm_add_epi16(d01, two), 2);
+                d23 = _mm_srli_epi16(_mm_add_epi16(d23, two), 2);
+
+                _mm_storeu_si128((__m128i *)(out + x * 4),
+                                 _mm_packus_epi16(d01, d23));
+            }
+#endif
+
+            for (; x < dstWidth; x++) {
+                int x0 = Clamp(2 * x, srcWidth - 1) * 4;
+                int x1 = Clamp(2 * x + 1, srcWidth - 1) * 4;
+
+                for (int c = 0; c < 4; c++) {
+                    out[x * 4 + c] = (unsigned char)
+                        ((rowA[x0 + c] + rowA[x1 + c] +
+                          rowB[x0 + c] + rowB[x1 + c] + 2) >> 2);
+                }
+            }
+        }
+    });
+}
+
+
+// Separable filtering as floats, first across each source row, and then
+// down the columns of that.
+void MipmapGenerator::DownsampleFiltered(const unsigned char *src,
+                                         int srcWidth, int srcHeight,
+                                         unsigned char *dst,
+                                         bool parallel) const
+{
+    const Taps& taps = (filter == Kaiser) ? KaiserTaps() : BoxTaps();
+    const ColorTables& tables = srgb ? SRGBTables() : LinearTables();
+
+    int dstWidth = std::max(srcWidth / 2, 1);
+    int dstHeight = std::max(srcHeight / 2, 1);
+
+    std::vector<Texel> filtered((size_t)srcHeight * dstWidth);
+    Texel *rows = filtered.data();
+
+    // The decoded row gets the edge pixels repeated on either side, so
+    // the taps never have to be clamped.
+    int padLeft = -taps.first;
+    int padRight = taps.first + taps.count;
+
+    ForRows(srcHeight, srcWidth, parallel, [&](size_t begin, size_t end) {
+        std::vector<Texel> row(padLeft + srcWidth + padRight);
+
+        for (size_t y = begin; y < end; y++) {
+            const unsigned char *in = src + y * srcWidth * 4;
+
+            for (int x = -padLeft; x < srcWidth + padRight; x++) {
+                row[padLeft + x] = TexelLoad(in + Clamp(x, srcWidth - 1) * 4,
+                                             tables);
+            }
+
+            Texel *out = rows + y * dstWidth;
+
+            for (int x = 0; x < dstWidth; x++) {
+                const Texel *taken = &row[padLeft + 2 * x + taps.first];
+                Texel sum = TexelZero();
+
+                for (int k = 0; k < taps.count; k++)
+                    sum = TexelMulAdd(sum, taken[k], taps.weights[k]);
+
+                out[x] = sum;
+            }
+        }
+    });
+
+    ForRows(dstHeight, dstWidth, parallel, [&](size_t begin, size_t end) {
+        std::vector<Texel> sums(dstWidth);
+
+        for (size_t y = begin; y < end; y++) {
+            std::fill(sums.begin(), sums.end(), TexelZero());
+
+            for (int k = 0; k < taps.count; k++) {
+                int sy = Clamp(2 * (int)y + taps.first + k, srcHeight - 1);
+                const Texel *in = rows + (size_t)sy * dstWidth;
+                float weight = taps.weights[k];
+
+                for (int x = 0; x < dstWidth; x++)
+                    sums[x] = TexelMulAdd(sums[x], in[x], weight);
+            }
+
+            unsigned char *out = dst + y * dstWidth * 4;
+
+            for (int x = 0; x < dstWidth; x++)
+                TexelStore(sums[x], out + x * 4, tables);
+        }
+    });
+}
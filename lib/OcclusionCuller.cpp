@@ -0,0 +1,522 @@
+//============================================================================
+// Name        : OcclusionCuller.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Testing objects against the view frustum still submits
+//               everything that is hidden behind something big.  This is a
+//               CPU occlusion culler that draws a few large occluder meshes
+//               into a small depth buffer, and then tests the bounding
+//               boxes of objects against it.
+//
+//               The rasterizer is tile based.  Triangles are transformed and
+//               binned to screen tiles, and then each tile gets rasterized
+//               as its own job, 4 pixels at a time with SSE.  From the depth
+//               buffer we build a hierarchical pyramid where each texel is
+//               the farthest depth of the 2x2 texels below it.
+//============================================================================
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "OcclusionCuller.hpp"
+
+using Eigen::Vector4f;
+
+const int OcclusionCuller::TileWidth;
+const int OcclusionCuller::TileHeight;
+
+namespace {
+    // anything closer than this to the eye, we can't project
+    const float MinW = 1.0e-5f;
+}
+
+
+OcclusionCuller::OcclusionCuller(JobSystem *jobs, int width, int height)
+    : jobs(jobs)
+{
+    tilesX = std::max((width + TileWidth - 1) / TileWidth, 1);
+    tilesY = std::max((height + TileHeight - 1) / TileHeight, 1);
+
+    this->width = tilesX * TileWidth;
+    this->height = tilesY * TileHeight;
+
+    tileBins.resize(tilesX * tilesY);
+
+    front = new DepthTarget();
+    back = new DepthTarget();
+
+    // Until we render something, nothing is occluded
+    for (DepthTarget *target : {front, back}) {
+        target->viewProjection.setIdentity();
+        target->levels.push_back(std::vector<float>(this->width * this->height,
+                                                    1.0f));
+        target->levelWidth.push_back(this->width);
+        target->levelHeight.push_back(this->height);
+        BuildPyramid(*target);
+    }
+}
+
+
+OcclusionCuller::~OcclusionCuller()
+{
+    Finish();
+
+    delete front;
+    delete back;
+}
+
+
+void OcclusionCuller::AddOccluder(const float *vertices, size_t numVertices,
+                                  const uint32_t *indices, size_t numIndices,
+                                  const Matrix4f& model)
+{
+    Occluder occluder;
+
+    occluder.vertices = vertices;
+    occluder.numVertices = numVertices;
+    occluder.indices = indices;
+    occluder.numIndices = numIndices;
+    occluder.model = model;
+
+    occluders.push_back(occluder);
+}
+
+
+void OcclusionCuller::ClearOccluders()
+{
+    Finish();
+    occluders.clear();
+}
+
+
+void OcclusionCuller::Render(const Matrix4f& viewProjection)
+{
+    RenderAsync(viewProjection);
+    Finish();
+}
+
+
+void OcclusionCuller::RenderAsync(const Matrix4f& viewProjection)
+{
+    // we only have the one back buffer
+    Finish();
+
+    back->viewProjection = viewProjection;
+
+    rendering = true;
+
+    if (jobs == nullptr) {
+        RenderTarget(*back);
+        return;
+    }
+
+    renderJob = jobs->CreateJob([this](Job *) {
+        RenderTarget(*back);
+    });
+
+    jobs->Run(renderJob);
+}
+
+
+void OcclusionCuller::Finish()
+{
+    if (!rendering)
+        return;
+
+    if (renderJob != nullptr) {
+        jobs->Wait(renderJob);
+        renderJob = nullptr;
+    }
+
+    std::swap(front, back);
+    rendering = false;
+}
+
+
+void OcclusionCuller::RenderTarget(DepthTarget& target)
+{
+    SetupTriangles(target.viewProjection);
+
+    target.numTriangles = triangles.size();
+
+    if (jobs != nullptr) {
+        jobs->ParallelFor(0, tileBins.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t tile = begin; tile < end; tile++)
+                RasterizeTile(target, (int)tile);
+        });
+    }
+    else {
+        for (size_t tile = 0; tile < tileBins.size(); tile++)
+            RasterizeTile(target, (int)tile);
+    }
+
+    BuildPyramid(target);
+}
+
+
+// Transform the occluders into screen space and sort the triangles into
+// the tiles they touch.
+void OcclusionCuller::SetupTriangles(const Matrix4f& viewProjection)
+{
+    std::vector<Vector4f, Eigen::aligned_allocator<Vector4f>> clip;
+
+    triangles.clear();
+    for (std::vector<uint32_t>& bin : tileBins)
+        bin.clear();
+
+    for (const Occluder& occluder : occluders) {
+        Matrix4f mvp = viewProjection * occluder.model;
+
+        clip.resize(occluder.numVertices);
+        for (size_t v = 0; v < occluder.numVertices; v++) {
+            const float *p = &occluder.vertices[v * 3];
+            clip[v] = mvp * Vector4f(p[0], p[1], p[2], 1.0f);
+        }
+
+        for (size_t i = 0; i + 2 < occluder.numIndices; i += 3) {
+            Triangle tri;
+            bool rejected = false;
+
+            for (int corner = 0; corner < 3 && !rejected; corner++) {
+                const Vector4f& c = clip[occluder.indices[i + corner]];
+
+                // We don't bother clipping against the near plane.
+                // Dropping an occluder triangle is always safe, we
+                // just cull a bit less.
+                if (c.w() < MinW) {
+                    rejected = true;
+                    break;
+                }
+
+                float invW = 1.0f / c.w();
+
+                tri.x[corner] = (c.x() * invW * 0.5f + 0.5f) * width;
+                tri.y[corner] = (c.y() * invW * 0.5f + 0.5f) * height;
+                tri.z[corner] = c.z() * invW * 0.5f + 0.5f;
+
+                if (tri.z[corner] < 0.0f || tri.z[corner] > 1.0f)
+                    rejected = true;
+            }
+
+            if (rejected)
+                continue;
+
+            float minX = std::min({tri.x[0], tri.x[1], tri.x[2]});
+            float maxX = std::max({tri.x[0], tri.x[1], tri.x[2]});
+            float minY = std::min({tri.y[0], tri.y[1], tri.y[2]});
+            float maxY = std::max({tri.y[0], tri.y[1], tri.y[2]});
+
+            if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+                continue;
+
+            int tileX0 = std::max((int)minX / TileWidth, 0);
+            int tileY0 = std::max((int)minY / TileHeight, 0);
+            int tileX1 = std::min((int)maxX / TileWidth, tilesX - 1);
+            int tileY1 = std::min((int)maxY / TileHeight, tilesY - 1);
+
+            uint32_t index = (uint32_t)triangles.size();
+            triangles.push_back(tri);
+
+            for (int ty = tileY0; ty <= tileY1; ty++) {
+                for (int tx = tileX0; tx <= tileX1; tx++)
+                    tileBins[ty * tilesX + tx].push_back(index);
+            }
+        }
+    }
+}
+
+
+void OcclusionCuller::RasterizeTile(DepthTarget& target, int tile)
+{
+    float *depth = target.levels[0].data();
+
+    int tileX0 = (tile % tilesX) * TileWidth;
+    int tileY0 = (tile / tilesX) * TileHeight;
+    int tileX1 = tileX0 + TileWidth;
+    int tileY1 = tileY0 + TileHeight;
+
+    for (int y = tileY0; y < tileY1; y++)
+        std::fill(depth + y * width + tileX0, depth + y * width + tileX1, 1.0f);
+
+    for (uint32_t index : tileBins[tile])
+        RasterizeTriangle(depth, triangles[index],
+                          tileX0, tileY0, tileX1, tileY1);
+}
+
+
+// Rasterize a triangle into one tile with edge functions, keeping the
+// nearest depth.  Pixels are sampled at their centers.
+void OcclusionCuller::RasterizeTriangle(float *depth, const Triangle& tri,
+                                        int tileX0, int tileY0,
+                                        int tileX1, int tileY1)
+{
+    float x0 = tri.x[0], y0 = tri.y[0], z0 = tri.z[0];
+    float x1 = tri.x[1], y1 = tri.y[1], z1 = tri.z[1];
+    float x2 = tri.x[2], y2 = tri.y[2], z2 = tri.z[2];
+
+    float area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+    if (std::fabs(area) < 1.0e-8f)
+        return;
+
+    // We don't cull back faces, we just flip them around so that the
+    // inside of every triangle is where all the edge functions >= 0
+    if (area < 0.0f) {
+        std::swap(x1, x2);
+        std::swap(y1, y2);
+        std::swap(z1, z2);
+        area = -area;
+    }
+
+    // edge functions E(x, y) = A*x + B*y + C
+    float a0 = y0 - y1, b0 = x1 - x0, c0 = (y1 - y0) * x0 - (x1 - x0) * y0;
+    float a1 = y1 - y2, b1 = x2 - x1, c1 = (y2 - y1) * x1 - (x2 - x1) * y1;
+    float a2 = y2 - y0, b2 = x0 - x2, c2 = (y0 - y2) * x2 - (x0 - x2) * y2;
+
+    // depth plane, from the barycentric weights
+    float invArea = 1.0f / area;
+    float za = (z0 * a1 + z1 * a2 + z2 * a0) * invArea;
+    float zb = (z0 * b1 + z1 * b2 + z2 * b0) * invArea;
+    float zc = (z0 * c1 + z1 * c2 + z2 * c0) * invArea;
+
+    int minX = std::max((int)std::floor(std::min({x0, x1, x2})), tileX0);
+    int maxX = std::min((int)std::ceil(std::max({x0, x1, x2})), tileX1 - 1);
+    int minY = std::max((int)std::floor(std::min({y0, y1, y2})), tileY0);
+    int maxY = std::min((int)std::ceil(std::max({y0, y1, y2})), tileY1 - 1);
+
+    // We step 4 pixels at a time, and the tiles are a multiple of 4 wide
+    minX &= ~3;
+
+#ifdef __SSE2__
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        float *row = depth + y * width;
+
+        __m128 e0Row = _mm_set1_ps(b0 * py + c0);
+        __m128 e1Row = _mm_set1_ps(b1 * py + c1);
+        __m128 e2Row = _mm_set1_ps(b2 * py + c2);
+        __m128 zRow = _mm_set1_ps(zb * py + zc);
+
+        for (int x = minX; x <= maxX; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), e0Row);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), e1Row);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), e2Row);
+
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero),
+                                                  _mm_cmpge_ps(e1, zero)),
+                                       _mm_cmpge_ps(e2, zero));
+
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), zRow);
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 nearest = _mm_min_ps(old, z);
+
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest),
+                                             _mm_andnot_ps(inside, old)));
+        }
+    }
+#else
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        float *row = depth + y * width;
+
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f;
+
+            if (a0 * px + b0 * py + c0 >= 0.0f &&
+                    a1 * px + b1 * py + c1 >= 0.0f &&
+                    a2 * px + b2 * py + c2 >= 0.0f)
+            {
+                float z = za * px + zb * py + zc;
+                row[x] = std::min(row[x], z);
+            }
+        }
+    }
+#endif
+}
+
+
+// Each level of the pyramid keeps the farthest depth of the 2x2 texels
+// below it, so it is a conservative bound of the occluders it covers.
+void OcclusionCuller::BuildPyramid(DepthTarget& target)
+{
+    target.levels.resize(1);
+    target.levelWidth.resize(1);
+    target.levelHeight.resize(1);
+
+    while (target.levelWidth.back() > 1 || target.levelHeight.back() > 1) {
+        const std::vector<float>& src = target.levels.back();
+        int srcWidth = target.levelWidth.back();
+        int srcHeight = target.levelHeight.back();
+
+        int dstWidth = std::max((srcWidth + 1) / 2, 1);
+        int dstHeight = std::max((srcHeight + 1) / 2, 1);
+        std::vector<float> dst(dstWidth * dstHeight);
+
+        for (int y = 0; y < dstHeight; y++) {
+            int sy0 = std::min(y * 2, srcHeight - 1);
+            int sy1 = std::min(y * 2 + 1, srcHeight - 1);
+
+            for (int x = 0; x < dstWidth; x++) {
+                int sx0 = std::min(x * 2, srcWidth - 1);
+                int sx1 = std::min(x * 2 + 1, srcWidth - 1);
+
+                dst[y * dstWidth + x] = std::max(
+                        std::max(src[sy0 * srcWidth + sx0],
+                                 src[sy0 * srcWidth + sx1]),
+                        std::max(src[sy1 * srcWidth + sx0],
+                                 src[sy1 * srcWidth + sx1]));
+            }
+        }
+
+        target.levels.push_back(std::move(dst));
+        target.levelWidth.push_back(dstWidth);
+        target.levelHeight.push_back(dstHeight);
+    }
+}
+
+
+bool OcclusionCuller::IsVisible(const Vector3f& boxMin,
+                                const Vector3f& boxMax) const
+{
+    const DepthTarget& target = *front;
+
+    float minX = 1.0e30f, maxX = -1.0e30f;
+    float minY = 1.0e30f, maxY = -1.0e30f;
+    float minZ = 1.0e30f;
+    int numBehind = 0;
+
+    for (int corner = 0; corner < 8; corner++) {
+        Vector4f p((corner & 1) ? boxMax.x() : boxMin.x(),
+                   (corner & 2) ? boxMax.y() : boxMin.y(),
+                   (corner & 4) ? boxMax.z() : boxMin.z(),
+                   1.0f);
+        Vector4f c = target.viewProjection * p;
+
+        if (c.w() < MinW) {
+            numBehind++;
+            continue;
+        }
+
+        float invW = 1.0f / c.w();
+        float x = (c.x() * invW * 0.5f + 0.5f) * width;
+        float y = (c.y() * invW * 0.5f + 0.5f) * height;
+        float z = c.z() * invW * 0.5f + 0.5f;
+
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, z);
+    }
+
+    // The box is either completely behind us, or it crosses the near
+    // plane, which means it is right in our face
+    if (numBehind == 8)
+        return false;
+    else if (numBehind > 0)
+        return true;
+
+    // outside of the screen
+    if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height ||
+            minZ > 1.0f)
+        return false;
+
+    if (minZ < 0.0f)
+        return true;
+
+    int x0 = std::max((int)minX, 0);
+    int y0 = std::max((int)minY, 0);
+    int x1 = std::min((int)maxX, width - 1);
+    int y1 = std::min((int)maxY, height - 1);
+
+    // Pick the level where the box covers no more than about 2x2 texels
+    size_t level = 0;
+    int extent = std::max(x1 - x0, y1 - y0);
+
+    while (extent > 1 && level + 1 < target.levels.size()) {
+        extent >>= 1;
+        level++;
+    }
+
+    int levelWidth = target.levelWidth[level];
+    const std::vector<float>& depth = target.levels[level];
+
+    x0 >>= level; x1 >>= level;
+    y0 >>= level; y1 >>= level;
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (minZ <= depth[y * levelWidth + x])
+                return true;
+        }
+    }
+
+    return false;
+}
+
+
+size_t OcclusionCuller::TestBoxes(const Vector3f *boxMins,
+                                  const Vector3f *boxMaxs,
+                                  size_t numBoxes, uint8_t *visible) const
+{
+    std::atomic<size_t> numVisible(0);
+
+    auto testRange = [&](size_t begin, size_t end) {
+        size_t count = 0;
+
+        for (size_t i = begin; i < end; i++) {
+            visible[i] = IsVisible(boxMins[i], boxMaxs[i]) ? 1 : 0;
+            count += visible[i];
+        }
+
+        numVisible += count;
+    };
+
+    if (jobs != nullptr)
+        jobs->ParallelFor(0, numBoxes, 1024, testRange);
+    else
+        testRange(0, numBoxes);
+
+    return numVisible;
+}
+
+
+const float *OcclusionCuller::DepthBuffer() const
+{
+    return front->levels[0].data();
+}
+
+
+size_t OcclusionCuller::NumLevels() const
+{
+    return front->levels.size();
+}
+
+
+const float *OcclusionCuller::Level(size_t level,
+                                    int &levelWidth, int &levelHeight) const
+{
+    levelWidth = front->levelWidth[level];
+    levelHeight = front->levelHeight[level];
+
+    return front->levels[level].data();
+}
+
+
+size_t OcclusionCuller::TrianglesRendered() const
+{
+    return front->numTriangles;
+}
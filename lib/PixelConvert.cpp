@@ -0,0 +1,68 @@
+//============================================================================
+// Name        : PixelConvert.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Expands 3 byte RGB pixels into 4 byte pixels.
+//============================================================================
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "PixelConvert.hpp"
+
+namespace {
+
+// The byte order of the 4 byte pixel, as offsets into the RGB pixel
+template <int c0, int c1, int c2>
+void ConvertRGB(const unsigned char *src, unsigned char *dst,
+                size_t numPixels)
+{
+    size_t pixel = 0;
+
+#ifdef __SSSE3__
+    // Each of the 4 output pixels takes its bytes from the 3 byte pixel
+    // at the same position, and the alpha byte (-1) comes out as zero,
+    // and gets set after.
+    const __m128i shuffle = _mm_setr_epi8(c0, c1, c2, -1,
+                                          3 + c0, 3 + c1, 3 + c2, -1,
+                                          6 + c0, 6 + c1, 6 + c2, -1,
+                                          9 + c0, 9 + c1, 9 + c2, -1);
+    const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+
+    // We load 16 bytes to get 12, so we stop while there are still
+    // enough pixels left to not read past the end.
+    for (; pixel + 6 <= numPixels; pixel += 4) {
+        __m128i rgb = _mm_loadu_si128((const __m128i *)(src + pixel * 3));
+        __m128i out = _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha);
+        _mm_storeu_si128((__m128i *)(dst + pixel * 4), out);
+    }
+#endif
+
+    for (; pixel < numPixels; pixel++) {
+        const unsigned char *in = src + pixel * 3;
+        unsigned char *out = dst + pixel * 4;
+
+        out[0] = in[c0];
+        out[1] = in[c1];
+        out[2] = in[c2];
+        out[3] = 0xff;
+    }
+}
+
+} // namespace
+
+
+void ConvertRGBToRGBA(const unsigned char *src, unsigned char *dst,
+                      size_t numPixels)
+{
+    ConvertRGB<0, 1, 2>(src, dst, numPixels);
+}
+
+
+void ConvertRGBToBGRA(const unsigned char *src, unsigned char *dst,
+                      size_t numPixels)
+{
+    ConvertRGB<2, 1, 0>(src, dst, numPixels);
+}
@@ -0,0 +1,188 @@
+//============================================================================
+// Name        : ProgramCache.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Keeps one linked program per pair of shader sources, shared
+//               by reference counted handles.
+//============================================================================
+
+#include <iostream>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "ProgramCache.hpp"
+
+
+ProgramHandle ProgramCache::Acquire(const ShaderSource& vertexSource,
+                                    const ShaderSource& fragmentSource)
+{
+    ProgramKey key = { vertexSource.Hash(), fragmentSource.Hash() };
+
+    auto found = programs.find(key);
+    if (found != programs.end() && found->second.program) {
+        hits++;
+        found->second.refs++;
+        return ProgramHandle(this, &found->second);
+    }
+
+    GLuint program = Link(vertexSource, fragmentSource);
+    compiles++;
+
+    // We don't hang on to failures, so fixing the files and asking
+    // again will work.
+    if (program == 0)
+        return ProgramHandle();
+
+    // After a Clear(), the entry can still be here for the handles that
+    // had it, without a program.  They get the new one too.
+    if (found != programs.end()) {
+        found->second.program = GLProgram(program);
+        found->second.refs++;
+        return ProgramHandle(this, &found->second);
+    }
+
+    Entry &entry = programs[key];
+    entry.key = key;
+    entry.program = GLProgram(program);
+    entry.refs = 1;
+
+    return ProgramHandle(this, &entry);
+}
+
+
+void ProgramCache::Release(Entry *entry)
+{
+    if (--entry->refs > 0)
+        return;
+
+    // The program goes with the entry.  Copy the key, since erasing
+    // the entry takes the key with it.
+    ProgramKey key = entry->key;
+    programs.erase(key);
+}
+
+
+void ProgramCache::Clear()
+{
+    // The entries have to stay until their handles let go of them
+    for (auto& item : programs)
+        item.second.program.Reset();
+}
+
+
+GLuint ProgramCache::Compile(GLenum type, const ShaderSource& source)
+{
+    GLchar infoLog[512];
+    GLint success;
+
+    GLuint shader = glCreateShader(type);
+
+    glShaderSource(shader, source.NumSegments(), source.Strings(),
+                   source.Lengths());
+    glCompileShader(shader);
+
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        cout << ((type == GL_VERTEX_SHADER)
+                 ? "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n\t"
+                 : "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n\t")
+             << infoLog << endl;
+
+        // The compiler's errors refer to 'source string:line', and our
+        // #line directives number the source strings by file.
+        const std::vector<std::string>& files = source.Files();
+        for (size_t i = 0; i < files.size(); i++)
+            cout << "\tSource string " << i << ": " << files[i] << endl;
+
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+
+GLuint ProgramCache::Link(const ShaderSource& vertexSource,
+                          const ShaderSource& fragmentSource)
+{
+    GLchar infoLog[512];
+    GLint success;
+
+    GLuint vertex = Compile(GL_VERTEX_SHADER, vertexSource);
+    if (vertex == 0)
+        return 0;
+
+    GLuint fragment = Compile(GL_FRAGMENT_SHADER, fragmentSource);
+    if (fragment == 0) {
+        glDeleteShader(vertex);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+
+    glLinkProgram(program);
+
+    // The shaders are linked into our program now, and no longer needed
+    glDetachShader(program, vertex);
+    glDetachShader(program, fragment);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n\t"
+             << infoLog << endl;
+
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+
+//
+// ProgramHandle
+//
+
+ProgramHandle::ProgramHandle(ProgramHandle&& other)
+    : cache(other.cache), entry(other.entry)
+{
+    other.cache = nullptr;
+    other.entry = nullptr;
+}
+
+
+ProgramHandle& ProgramHandle::operator=(ProgramHandle&& other)
+{
+    if (this != &other) {
+        Reset();
+
+        cache = other.cache;
+        entry = other.entry;
+
+        other.cache = nullptr;
+        other.entry = nullptr;
+    }
+
+    return *this;
+}
+
+
+void ProgramHandle::Reset()
+{
+    if (entry != nullptr)
+        cache->Release(entry);
+
+    cache = nullptr;
+    entry = nullptr;
+}
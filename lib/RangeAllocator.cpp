@@ -0,0 +1,187 @@
+//============================================================================
+// Name        : RangeAllocator.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Best fit allocation of ranges of a block, with the free
+//               ranges merged as they are given back, and compaction.
+//============================================================================
+
+#include <algorithm>
+#include <iterator>
+
+#include "RangeAllocator.hpp"
+
+const size_t RangeAllocator::Invalid;
+
+
+RangeAllocator::RangeAllocator(size_t capacity) : capacity(capacity)
+{
+    if (capacity > 0)
+        AddFree(0, capacity);
+}
+
+
+size_t RangeAllocator::Allocate(size_t size)
+{
+    if (size == 0)
+        return Invalid;
+
+    // The smallest free range that's big enough
+    auto best = freeBySize.lower_bound(std::make_pair(size, (size_t)0));
+    if (best == freeBySize.end())
+        return Invalid;
+
+    size_t offset = best->second;
+    size_t rangeSize = best->first;
+
+    RemoveFree(freeByOffset.find(offset));
+    if (rangeSize > size)
+        AddFree(offset + size, rangeSize - size);
+
+    allocations[offset] = size;
+    used += size;
+
+    return offset;
+}
+
+
+bool RangeAllocator::Free(size_t offset)
+{
+    auto allocation = allocations.find(offset);
+    if (allocation == allocations.end())
+        return false;
+
+    size_t size = allocation->second;
+    allocations.erase(allocation);
+    used -= size;
+
+    // Merge with the free ranges on either side
+    auto next = freeByOffset.lower_bound(offset);
+
+    if (next != freeByOffset.begin()) {
+        auto previous = std::prev(next);
+
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            RemoveFree(previous);
+        }
+    }
+
+    if (next != freeByOffset.end() && offset + size == next->first) {
+        size += next->second;
+        RemoveFree(next);
+    }
+
+    AddFree(offset, size);
+    return true;
+}
+
+
+size_t RangeAllocator::SizeOf(size_t offset) const
+{
+    auto allocation = allocations.find(offset);
+    return allocation != allocations.end() ? allocation->second : 0;
+}
+
+
+void RangeAllocator::Clear()
+{
+    allocations.clear();
+    freeByOffset.clear();
+    freeBySize.clear();
+    used = 0;
+
+    if (capacity > 0)
+        AddFree(0, capacity);
+}
+
+
+void RangeAllocator::Grow(size_t newCapacity)
+{
+    if (newCapacity <= capacity)
+        return;
+
+    size_t offset = capacity;
+    size_t size = newCapacity - capacity;
+    capacity = newCapacity;
+
+    // The new space goes with the free range at the old end, if any
+    if (!freeByOffset.empty()) {
+        auto last = std::prev(freeByOffset.end());
+
+        if (last->first + last->second == offset) {
+            offset = last->first;
+            size += last->second;
+            RemoveFree(last);
+        }
+    }
+
+    AddFree(offset, size);
+}
+
+
+std::vector<RangeAllocator::Move> RangeAllocator::Compact()
+{
+    std::vector<Move> moves;
+    std::map<size_t, size_t> packed;
+    size_t end = 0;
+
+    for (const auto& allocation : allocations) {
+        if (allocation.first != end)
+            moves.push_back({ allocation.first, end, allocation.second });
+
+        packed.emplace_hint(packed.end(), end, allocation.second);
+        end += allocation.second;
+    }
+
+    allocations.swap(packed);
+
+    freeByOffset.clear();
+    freeBySize.clear();
+    if (end < capacity)
+        AddFree(end, capacity - end);
+
+    return moves;
+}
+
+
+size_t RangeAllocator::LargestFree() const
+{
+    return freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+}
+
+
+size_t RangeAllocator::End() const
+{
+    if (allocations.empty())
+        return 0;
+
+    auto last = std::prev(allocations.end());
+    return last->first + last->second;
+}
+
+
+double RangeAllocator::Fragmentation() const
+{
+    size_t available = capacity - used;
+    if (available == 0)
+        return 0.0;
+
+    return 1.0 - (double)LargestFree() / available;
+}
+
+
+void RangeAllocator::AddFree(size_t offset, size_t size)
+{
+    freeByOffset[offset] = size;
+    freeBySize.insert(std::make_pair(size, offset));
+}
+
+
+void RangeAllocator::RemoveFree(std::map<size_t, size_t>::iterator range)
+{
+    freeBySize.erase(std::make_pair(range->second, range->first));
+    freeByOffset.erase(range);
+}
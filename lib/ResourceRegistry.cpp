@@ -0,0 +1,21 @@
+//============================================================================
+// Name        : ResourceRegistry.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : The part of the ResourceRegistry that doesn't depend on
+//               the kind of resource.
+//============================================================================
+
+#include "SpookyV2.h"
+#include "ResourceRegistry.hpp"
+
+namespace {
+    const uint64 HashSeed = 0x5265736f75726365ULL;
+}
+
+
+uint64_t ResourceKey(const std::string& name)
+{
+    return SpookyHash::Hash64(name.data(), name.size(), HashSeed);
+}
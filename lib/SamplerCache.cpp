@@ -0,0 +1,135 @@
+//============================================================================
+// Name        : SamplerCache.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Keeps one GL sampler object per distinct sampler state.
+//============================================================================
+
+#include <iostream>
+#include <cstring>
+#include <type_traits>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "SpookyV2.h"
+#include "SamplerCache.hpp"
+
+static_assert(std::is_standard_layout<SamplerState>::value &&
+              sizeof(SamplerState) == 13 * 4,
+              "SamplerState gets hashed and compared as bytes, "
+              "so it can't have any padding");
+
+
+SamplerState& SamplerState::Filter(GLenum min, GLenum mag)
+{
+    minFilter = min;
+    magFilter = mag;
+    return *this;
+}
+
+
+SamplerState& SamplerState::Wrap(GLenum mode)
+{
+    wrapS = wrapT = wrapR = mode;
+    return *this;
+}
+
+
+SamplerState& SamplerState::Anisotropy(GLfloat max)
+{
+    maxAnisotropy = max;
+    return *this;
+}
+
+
+SamplerState& SamplerState::LodBias(GLfloat bias)
+{
+    lodBias = bias;
+    return *this;
+}
+
+
+uint64_t SamplerState::Hash() const
+{
+    return SpookyHash::Hash64(this, sizeof(*this), 0);
+}
+
+
+bool SamplerState::operator==(const SamplerState& other) const
+{
+    return memcmp(this, &other, sizeof(*this)) == 0;
+}
+
+
+SamplerCache::SamplerCache()
+{
+    if (GLEW_EXT_texture_filter_anisotropic)
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+}
+
+
+GLuint SamplerCache::Get(const SamplerState& state)
+{
+    auto found = samplers.find(state);
+    if (found != samplers.end()) {
+        hits++;
+        return found->second.ID();
+    }
+
+    GLSampler sampler = Create(state);
+    if (!sampler)
+        return 0;
+
+    GLuint id = sampler.ID();
+    samplers.emplace(state, std::move(sampler));
+
+    return id;
+}
+
+
+// The sampler's parameters only ever get set here, once
+GLSampler SamplerCache::Create(const SamplerState& state)
+{
+    GLenum err;
+
+    creates++;
+
+    GLSampler sampler = GLSampler::Create();
+    if (!sampler) {
+        cout << "Failed to generate sampler!!" << endl;
+        return sampler;
+    }
+
+    GLuint id = sampler.ID();
+
+    glSamplerParameteri(id, GL_TEXTURE_MIN_FILTER, state.minFilter);
+    glSamplerParameteri(id, GL_TEXTURE_MAG_FILTER, state.magFilter);
+
+    glSamplerParameteri(id, GL_TEXTURE_WRAP_S, state.wrapS);
+    glSamplerParameteri(id, GL_TEXTURE_WRAP_T, state.wrapT);
+    glSamplerParameteri(id, GL_TEXTURE_WRAP_R, state.wrapR);
+    glSamplerParameterfv(id, GL_TEXTURE_BORDER_COLOR, state.borderColor);
+
+    glSamplerParameterf(id, GL_TEXTURE_LOD_BIAS, state.lodBias);
+    glSamplerParameterf(id, GL_TEXTURE_MIN_LOD, state.minLod);
+    glSamplerParameterf(id, GL_TEXTURE_MAX_LOD, state.maxLod);
+
+    // Anisotropy is an extension, and asking for more than the hardware
+    // can do is an error.
+    if (maxAnisotropy > 0.0f && state.maxAnisotropy > 1.0f) {
+        GLfloat anisotropy = (state.maxAnisotropy < maxAnisotropy)
+                             ? state.maxAnisotropy : maxAnisotropy;
+        glSamplerParameterf(id, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy);
+    }
+
+    if ((err = glGetError()) != GL_NO_ERROR) {
+        cout << "glSamplerParameter(): error: " << err << endl;
+        sampler.Reset();
+    }
+
+    return sampler;
+}
@@ -0,0 +1,244 @@
+//============================================================================
+// Name        : SceneGraph.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : So far our model transforms have just been loose Affine3f
+//               variables in main(), with no notion of one object being
+//               attached to another.  This SceneGraph keeps a hierarchy of
+//               transforms.
+//
+//               Instead of a tree of node objects, we keep the transforms
+//               in flat arrays (a structure of arrays), sorted by depth.
+//               So by the time we get to a node, its parent's world matrix
+//               has already been computed, and we can just walk the arrays
+//               front to back.  All the nodes at one depth are independent
+//               of each other, so big levels get split up over the
+//               JobSystem.
+//============================================================================
+
+#include <algorithm>
+#include <mutex>
+#include <cstring>
+
+#include "SceneGraph.hpp"
+
+const SceneNode SceneGraph::None;
+const size_t SceneGraph::DefaultParallelThreshold;
+
+
+SceneGraph::SceneGraph(JobSystem *jobs)
+    : jobs(jobs)
+{
+    levelStart.push_back(0);
+}
+
+
+SceneNode SceneGraph::AddNode(SceneNode parentNode, const Affine3f& localTrans)
+{
+    SceneNode node = (SceneNode)nodeParent.size();
+    uint32_t depth = 0;
+
+    if (parentNode != None)
+        depth = nodeDepth[parentNode] + 1;
+
+    nodeParent.push_back(parentNode);
+    nodeDepth.push_back(depth);
+    handleToIndex.push_back((uint32_t)local.size());
+
+    // We just tack the new node on the end for now.
+    // It gets moved to where it belongs on the next Update()
+    local.push_back(localTrans);
+    world.push_back(localTrans.matrix());
+    parent.push_back(parentNode == None ? None : handleToIndex[parentNode]);
+    dirty.push_back(1);
+    indexToHandle.push_back(node);
+
+    needsSort = true;
+
+    return node;
+}
+
+
+void SceneGraph::SetLocal(SceneNode node, const Affine3f& localTrans)
+{
+    uint32_t index = handleToIndex[node];
+
+    local[index] = localTrans;
+    dirty[index] = 1;
+
+    if (!needsSort)
+        levelDirty[nodeDepth[node]] = 1;
+}
+
+
+const Affine3f& SceneGraph::Local(SceneNode node) const
+{
+    return local[handleToIndex[node]];
+}
+
+
+const Matrix4f& SceneGraph::World(SceneNode node) const
+{
+    return world[handleToIndex[node]];
+}
+
+
+const float *SceneGraph::InstanceData() const
+{
+    if (world.empty())
+        return nullptr;
+
+    return world[0].data();
+}
+
+
+void SceneGraph::UpdatedRange(size_t &first, size_t &count) const
+{
+    first = updatedFirst;
+    count = updatedEnd > updatedFirst ? updatedEnd - updatedFirst : 0;
+}
+
+
+size_t SceneGraph::Update()
+{
+    if (needsSort)
+        SortByDepth();
+
+    updatedFirst = world.size();
+    updatedEnd = 0;
+
+    size_t numUpdated = 0;
+    bool prevLevelUpdated = false;
+
+    for (size_t level = 0; level + 1 < levelStart.size(); level++) {
+        size_t begin = levelStart[level];
+        size_t end = levelStart[level + 1];
+        size_t levelUpdated = 0;
+
+        // Nothing in this level changed, and none of the parents did.
+        if (!levelDirty[level] && !prevLevelUpdated)
+            continue;
+
+        if (jobs != nullptr && end - begin >= parallelThreshold) {
+            std::mutex rangeMutex;
+            size_t grainSize = std::max<size_t>(parallelThreshold / 4, 1);
+
+            jobs->ParallelFor(begin, end, grainSize,
+                              [&](size_t b, size_t e) {
+                size_t count = UpdateRange(b, e, level == 0);
+
+                std::lock_guard<std::mutex> lock(rangeMutex);
+                levelUpdated += count;
+            });
+        }
+        else {
+            levelUpdated = UpdateRange(begin, end, level == 0);
+        }
+
+        levelDirty[level] = 0;
+        prevLevelUpdated = (levelUpdated > 0);
+        numUpdated += levelUpdated;
+
+        if (levelUpdated > 0) {
+            updatedFirst = std::min(updatedFirst, begin);
+            updatedEnd = std::max(updatedEnd, end);
+        }
+    }
+
+    // Clear the dirty flags for the next time around.
+    // We only ever set them inside the range we updated.
+    if (updatedEnd > updatedFirst)
+        std::memset(&dirty[updatedFirst], 0, updatedEnd - updatedFirst);
+
+    return numUpdated;
+}
+
+
+// Recompute the world matrices of the nodes in [begin, end) that changed,
+// or whose parent changed.  The nodes all have to be on the same level.
+size_t SceneGraph::UpdateRange(size_t begin, size_t end, bool isRoot)
+{
+    size_t numUpdated = 0;
+
+    if (isRoot) {
+        for (size_t i = begin; i < end; i++) {
+            if (dirty[i]) {
+                world[i] = local[i].matrix();
+                numUpdated++;
+            }
+        }
+    }
+    else {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t p = parent[i];
+
+            if (dirty[i] || dirty[p]) {
+                world[i].noalias() = world[p] * local[i].matrix();
+                dirty[i] = 1;  // so our children get updated too
+                numUpdated++;
+            }
+        }
+    }
+
+    return numUpdated;
+}
+
+
+// Counting sort of the nodes by depth.  It is stable, so nodes stay
+// in the order they were added within each level.
+void SceneGraph::SortByDepth()
+{
+    size_t numNodes = nodeParent.size();
+    uint32_t maxDepth = 0;
+
+    for (uint32_t depth : nodeDepth)
+        maxDepth = std::max(maxDepth, depth);
+
+    levelStart.assign(maxDepth + 2, 0);
+    for (uint32_t depth : nodeDepth)
+        levelStart[depth + 1]++;
+
+    for (size_t level = 1; level < levelStart.size(); level++)
+        levelStart[level] += levelStart[level - 1];
+
+    std::vector<size_t> cursor(levelStart.begin(), levelStart.end() - 1);
+    std::vector<SceneNode> newIndexToHandle(numNodes);
+
+    for (size_t i = 0; i < numNodes; i++) {
+        SceneNode node = indexToHandle[i];
+        newIndexToHandle[cursor[nodeDepth[node]]++] = node;
+    }
+
+    std::vector<Affine3f, Eigen::aligned_allocator<Affine3f>> newLocal(numNodes);
+    std::vector<Matrix4f, Eigen::aligned_allocator<Matrix4f>> newWorld(numNodes);
+    std::vector<uint8_t> newDirty(numNodes);
+    std::vector<uint32_t> newHandleToIndex(numNodes);
+
+    for (size_t i = 0; i < numNodes; i++) {
+        SceneNode node = newIndexToHandle[i];
+        uint32_t oldIndex = handleToIndex[node];
+
+        newLocal[i] = local[oldIndex];
+        newWorld[i] = world[oldIndex];
+        newDirty[i] = dirty[oldIndex];
+        newHandleToIndex[node] = (uint32_t)i;
+    }
+
+    parent.resize(numNodes);
+    for (size_t i = 0; i < numNodes; i++) {
+        SceneNode parentNode = nodeParent[newIndexToHandle[i]];
+        parent[i] = (parentNode == None) ? None : newHandleToIndex[parentNode];
+    }
+
+    local.swap(newLocal);
+    world.swap(newWorld);
+    dirty.swap(newDirty);
+    handleToIndex.swap(newHandleToIndex);
+    indexToHandle.swap(newIndexToHandle);
+
+    // everything needs at least a look after a re-sort
+    levelDirty.assign(maxDepth + 1, 1);
+
+    needsSort = false;
+}
@@ -31,31 +31,76 @@ using std::endl;
 
 Shader::Shader(const GLchar *vertexPath, const GLchar *fragmentPath)
 {
-    std::string vShaderCode = ReadFile(vertexPath);
-    if (vShaderCode.length() == 0)
-        return;
+    ShaderSourceLoader &loader = DefaultLoader();
 
-    std::string fShaderCode = ReadFile(fragmentPath);
-    if (fShaderCode.length() == 0)
-        return;
+    Build(loader.Load(vertexPath), loader.Load(fragmentPath));
+}
 
-    // 2. Compile shaders
-    GLuint vertex = CreateVertexShader(vShaderCode.c_str());
-    if (vertex == 0)
-        return;
 
-    GLuint fragment = CreateFragmentShader(fShaderCode.c_str());
-    if (fragment == 0) {
-        glDeleteShader(vertex);
-        return;
+Shader::Shader(ShaderSourceLoader& loader,
+               const GLchar *vertexPath, const GLchar *fragmentPath,
+               const std::vector<std::string>& defines)
+{
+    Build(loader.Load(vertexPath, defines), loader.Load(fragmentPath, defines));
+}
+
+
+// Shaders built from plain file paths share one loader, so the headers
+// they include only get read and scanned once.
+ShaderSourceLoader& Shader::DefaultLoader()
+{
+    static ShaderSourceLoader loader;
+
+    return loader;
+}
+
+
+ProgramCache& Shader::DefaultCache()
+{
+    static ProgramCache cache;
+
+    return cache;
+}
+
+
+Shader::Shader(Shader&& other)
+    : Program(other.Program),
+      handle(std::move(other.handle)),
+      vertexShader(other.vertexShader),
+      fragmentShader(other.fragmentShader)
+{
+    other.Program = 0;
+    other.vertexShader = 0;
+    other.fragmentShader = 0;
+}
+
+
+Shader& Shader::operator=(Shader&& other)
+{
+    if (this != &other) {
+        Program = other.Program;
+        handle = std::move(other.handle);
+        vertexShader = other.vertexShader;
+        fragmentShader = other.fragmentShader;
+
+        other.Program = 0;
+        other.vertexShader = 0;
+        other.fragmentShader = 0;
     }
 
-    CreateShaderProgram();
+    return *this;
+}
+
+
+void Shader::Build(const ShaderSource *vertexSource,
+                   const ShaderSource *fragmentSource)
+{
+    if (vertexSource == nullptr || fragmentSource == nullptr)
+        return;
 
-    // Delete the shaders as they're linked into our program now
-    // and no longer necessery
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    // 2. Compile shaders, unless we have them already
+    handle = DefaultCache().Acquire(*vertexSource, *fragmentSource);
+    this->Program = handle.Program();
 }
 
 
@@ -98,13 +143,25 @@ std::string Shader::ReadFile(const GLchar *path)
 }
 
 
-GLuint Shader::CreateVertexShader(const GLchar *code) {
+GLuint Shader::CreateVertexShader(const GLchar *code, GLint length) {
+    return CreateVertexShader(1, &code, (length < 0) ? NULL : &length);
+}
+
+
+GLuint Shader::CreateVertexShader(const ShaderSource& source) {
+    return CreateVertexShader(source.NumSegments(), source.Strings(),
+                              source.Lengths());
+}
+
+
+GLuint Shader::CreateVertexShader(GLsizei count, const GLchar *const *code,
+                                  const GLint *lengths) {
     GLchar infoLog[512];
     GLint success;
 
     GLuint vertex = glCreateShader(GL_VERTEX_SHADER);
 
-    glShaderSource(vertex, 1, &code, NULL);
+    glShaderSource(vertex, count, code, lengths);
     glCompileShader(vertex);
 
     glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
@@ -121,13 +178,25 @@ GLuint Shader::CreateVertexShader(const GLchar *code) {
 }
 
 
-GLuint Shader::CreateFragmentShader(const GLchar *code) {
+GLuint Shader::CreateFragmentShader(const GLchar *code, GLint length) {
+    return CreateFragmentShader(1, &code, (length < 0) ? NULL : &length);
+}
+
+
+GLuint Shader::CreateFragmentShader(const ShaderSource& source) {
+    return CreateFragmentShader(source.NumSegments(), source.Strings(),
+                                source.Lengths());
+}
+
+
+GLuint Shader::CreateFragmentShader(GLsizei count, const GLchar *const *code,
+                                    const GLint *lengths) {
     GLchar infoLog[512];
     GLint success;
 
     GLuint fragment = glCreateShader(GL_FRAGMENT_SHADER);
 
-    glShaderSource(fragment, 1, &code, NULL);
+    glShaderSource(fragment, count, code, lengths);
     glCompileShader(fragment);
 
     glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
@@ -181,6 +250,19 @@ void Shader::UseTexture(GLuint texture, GLuint textureUnitIdx)
 }
 
 
+void Shader::UseTexture(StateTracker& state, GLuint texture,
+                        GLuint textureUnitIdx, GLuint sampler)
+{
+    std::string uniformName = "ourTexture" + std::to_string(textureUnitIdx);
+
+    state.BindTexture(textureUnitIdx, texture);
+    state.BindSampler(textureUnitIdx, sampler);
+
+    glUniform1i(glGetUniformLocation(this->Program, uniformName.c_str()),
+                textureUnitIdx);
+}
+
+
 void Shader::UseTransform(const GLfloat *transform, GLuint transformIdx)
 {
     if (transform == nullptr) {
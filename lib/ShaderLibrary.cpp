@@ -0,0 +1,698 @@
+//============================================================================
+// Name        : ShaderLibrary.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Declares the variants of our shaders up front, and compiles
+//               them all at once, either on the driver's threads or on a
+//               worker thread with its own shared context.  The render loop
+//               polls for them, and uses whatever is ready in the meantime.
+//============================================================================
+
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "ShaderLibrary.hpp"
+
+// Older GLEW headers don't know about the KHR version of the extension.
+// The ARB version has the same token.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+
+ShaderLibrary::ShaderLibrary(ShaderSourceLoader& loader, GLFWwindow *window)
+    : loader(loader)
+{
+#ifdef GL_KHR_parallel_shader_compile
+    if (GLEW_KHR_parallel_shader_compile) {
+        // let the driver pick how many threads to use
+        glMaxShaderCompilerThreadsKHR(0xffffffff);
+        mode = Parallel;
+        return;
+    }
+#endif
+
+    if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xffffffff);
+        mode = Parallel;
+        return;
+    }
+
+    if (window == nullptr)
+        return;
+
+    // Windows have to be made on the main thread, but the worker can make
+    // its context current on its own.  We get the same context version,
+    // since the window hints are still set from creating the first window.
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    workerWindow = glfwCreateWindow(1, 1, "ShaderLibrary", nullptr, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    if (workerWindow == nullptr) {
+        cout << "ShaderLibrary: could not create a shared context, "
+             << "compiling synchronously" << endl;
+        return;
+    }
+
+    mode = Worker;
+    worker = std::thread(&ShaderLibrary::WorkerLoop, this);
+}
+
+
+ShaderLibrary::~ShaderLibrary()
+{
+    Shutdown();
+}
+
+
+void ShaderLibrary::Shutdown()
+{
+    // The worker lets go of its context on the way out, so that's gone
+    // before its window is
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(workMutex);
+            stopWorker = true;
+        }
+        workReady.notify_all();
+        worker.join();
+    }
+
+    if (workerWindow != nullptr) {
+        glfwDestroyWindow(workerWindow);
+        workerWindow = nullptr;
+    }
+
+    for (auto& entry : entries) {
+        for (auto& variant : entry.second.variants) {
+            if (variant->vertex != 0)
+                glDeleteShader(variant->vertex);
+            if (variant->fragment != 0)
+                glDeleteShader(variant->fragment);
+            if (variant->program != 0)
+                glDeleteProgram(variant->program);
+            if (variant->shader.Program != 0 &&
+                    variant->shader.Program != variant->program)
+                glDeleteProgram(variant->shader.Program);
+        }
+    }
+
+    entries.clear();
+    declared.clear();
+    pending.clear();
+    workQueue.clear();
+    workInFlight = 0;
+    watcher.reset();
+    changedFiles.clear();
+    mode = Synchronous;
+}
+
+
+size_t ShaderLibrary::Declare(const std::string& name,
+                              const std::string& vertexPath,
+                              const std::string& fragmentPath,
+                              const std::vector<std::vector<std::string>>& keywordSets)
+{
+    if (entries.count(name) != 0) {
+        cout << "ERROR::SHADERLIBRARY::ALREADY_DECLARED" << endl
+             << "\tShader: " << name << endl;
+        return 0;
+    }
+
+    // count through the combinations like an odometer
+    std::vector<size_t> choice(keywordSets.size(), 0);
+    size_t numVariants = 1;
+
+    for (const std::vector<std::string>& keywordSet : keywordSets) {
+        if (keywordSet.empty()) {
+            cout << "ERROR::SHADERLIBRARY::EMPTY_KEYWORD_SET" << endl
+                 << "\tShader: " << name << endl;
+            return 0;
+        }
+
+        numVariants *= keywordSet.size();
+    }
+
+    ShaderEntry entry;
+    entry.vertexPath = vertexPath;
+    entry.fragmentPath = fragmentPath;
+
+    for (size_t i = 0; i < numVariants; i++) {
+        std::unique_ptr<Variant> variant(new Variant());
+
+        std::vector<std::string> keywords;
+        for (size_t set = 0; set < keywordSets.size(); set++)
+            keywords.push_back(keywordSets[set][choice[set]]);
+
+        variant->keywords = SortedKeywords(keywords);
+
+        if (!LoadSources(entry, *variant))
+            return 0;
+
+        entry.variants.push_back(std::move(variant));
+
+        for (size_t set = 0; set < choice.size(); set++) {
+            if (++choice[set] < keywordSets[set].size())
+                break;
+            choice[set] = 0;
+        }
+    }
+
+    ShaderEntry& added = entries[name];
+    added = std::move(entry);
+
+    for (auto& variant : added.variants) {
+        WatchFiles(*variant);
+        declared.push_back(std::make_pair(name, variant.get()));
+    }
+
+    return numVariants;
+}
+
+
+void ShaderLibrary::CompileAll()
+{
+    switch (mode) {
+    case Parallel:
+        // The driver queues these up and returns right away
+        for (auto& item : declared) {
+            StartCompile(*item.second);
+            pending.push_back(item);
+        }
+        break;
+
+    case Worker:
+        {
+            std::lock_guard<std::mutex> lock(workMutex);
+
+            for (auto& item : declared) {
+                item.second->state = Compiling;
+                workQueue.push_back(item);
+                workInFlight++;
+                pending.push_back(item);
+            }
+        }
+        workReady.notify_all();
+        break;
+
+    case Synchronous:
+        for (auto& item : declared) {
+            StartCompile(*item.second);
+            if (!FinishCompile(*item.second))
+                PrintErrors(item.first, *item.second);
+            pending.push_back(item);
+        }
+        break;
+    }
+
+    declared.clear();
+}
+
+
+void ShaderLibrary::Update()
+{
+    // This is all it costs us when nothing has changed
+    if (watcher != nullptr && watcher->HasChanges()) {
+        for (const std::string& path : watcher->TakeChanges())
+            changedFiles.insert(path);
+    }
+
+    // Reloading clears out the loader, so we wait until none of its
+    // sources are being compiled.
+    if (!changedFiles.empty() && declared.empty() && pending.empty())
+        ReloadChanged();
+
+    auto done = std::remove_if(pending.begin(), pending.end(),
+        [this](std::pair<std::string, Variant *>& item) {
+            Variant& variant = *item.second;
+
+            if (mode == Parallel && variant.state == Compiling) {
+                GLint completed = GL_FALSE;
+                glGetProgramiv(variant.program, GL_COMPLETION_STATUS_KHR,
+                               &completed);
+
+                if (!completed)
+                    return false;
+
+                if (!FinishCompile(variant))
+                    PrintErrors(item.first, variant);
+            }
+
+            // The worker sets the state once the program is finished.
+            // This is where a reloaded program takes over from the old one.
+            switch (variant.state) {
+            case Ready:
+                if (variant.shader.Program != 0 &&
+                        variant.shader.Program != variant.program)
+                    glDeleteProgram(variant.shader.Program);
+
+                variant.shader.Program = variant.program;
+                return true;
+            case Failed:
+                DiscardCompile(item.first, variant);
+                return true;
+            default:
+                return false;
+            }
+        });
+
+    pending.erase(done, pending.end());
+}
+
+
+bool ShaderLibrary::EnableHotReload()
+{
+    if (watcher != nullptr)
+        return true;
+
+    watcher.reset(new FileWatcher());
+
+    if (!watcher->IsValid()) {
+        watcher.reset();
+        return false;
+    }
+
+    for (auto& entry : entries) {
+        for (auto& variant : entry.second.variants)
+            WatchFiles(*variant);
+    }
+
+    return true;
+}
+
+
+void ShaderLibrary::WaitAll()
+{
+    if (mode == Worker) {
+        std::unique_lock<std::mutex> lock(workMutex);
+        workDone.wait(lock, [this] { return workInFlight == 0; });
+    }
+    else if (mode == Parallel) {
+        // Asking for the link status waits for the driver
+        for (auto& item : pending) {
+            if (item.second->state == Compiling &&
+                    !FinishCompile(*item.second))
+                PrintErrors(item.first, *item.second);
+        }
+    }
+
+    Update();
+}
+
+
+Shader *ShaderLibrary::Get(const std::string& name,
+                           const std::vector<std::string>& keywords)
+{
+    const ShaderEntry *entry = FindEntry(name);
+    if (entry == nullptr)
+        return nullptr;
+
+    std::vector<std::string> wanted = SortedKeywords(keywords);
+
+    Variant *best = nullptr;
+    int bestScore = 0;
+
+    for (auto& variant : entry->variants) {
+        if (variant->shader.Program == 0)
+            continue;
+
+        if (variant->keywords == wanted)
+            return &variant->shader;
+
+        // Score the keywords we have in common, and break the ties in
+        // favor of the variant with fewer keywords we didn't ask for
+        std::vector<std::string> common;
+        std::set_intersection(wanted.begin(), wanted.end(),
+                              variant->keywords.begin(),
+                              variant->keywords.end(),
+                              std::back_inserter(common));
+
+        int score = (int)common.size() * 256 -
+                    (int)(variant->keywords.size() - common.size());
+
+        if (best == nullptr || score > bestScore) {
+            best = variant.get();
+            bestScore = score;
+        }
+    }
+
+    return (best != nullptr) ? &best->shader : nullptr;
+}
+
+
+bool ShaderLibrary::IsReady(const std::string& name,
+                            const std::vector<std::string>& keywords) const
+{
+    const ShaderEntry *entry = FindEntry(name);
+    if (entry == nullptr)
+        return false;
+
+    const Variant *variant = FindVariant(*entry, SortedKeywords(keywords));
+
+    return variant != nullptr && variant->shader.Program != 0;
+}
+
+
+size_t ShaderLibrary::NumVariants() const
+{
+    size_t count = 0;
+
+    for (auto& entry : entries)
+        count += entry.second.variants.size();
+
+    return count;
+}
+
+
+size_t ShaderLibrary::NumReady() const
+{
+    size_t count = 0;
+
+    for (auto& entry : entries) {
+        for (auto& variant : entry.second.variants) {
+            if (variant->shader.Program != 0)
+                count++;
+        }
+    }
+
+    return count;
+}
+
+
+size_t ShaderLibrary::NumPending() const
+{
+    return declared.size() + pending.size();
+}
+
+
+size_t ShaderLibrary::NumFailed() const
+{
+    size_t count = 0;
+
+    for (auto& entry : entries) {
+        for (auto& variant : entry.second.variants) {
+            if (variant->state == Failed)
+                count++;
+        }
+    }
+
+    return count;
+}
+
+
+// Keywords in a canonical order, so {"A", "B"} and {"B", "A"} are the
+// same variant.  Empty keywords mean 'define nothing'.
+std::vector<std::string> ShaderLibrary::SortedKeywords(
+    const std::vector<std::string>& keywords)
+{
+    std::vector<std::string> sorted;
+
+    for (const std::string& keyword : keywords) {
+        if (!keyword.empty())
+            sorted.push_back(keyword);
+    }
+
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    return sorted;
+}
+
+
+const ShaderLibrary::ShaderEntry *ShaderLibrary::FindEntry(const std::string& name) const
+{
+    auto found = entries.find(name);
+    if (found == entries.end())
+        return nullptr;
+
+    return &found->second;
+}
+
+
+const ShaderLibrary::Variant *ShaderLibrary::FindVariant(const ShaderEntry& entry,
+                                                         const std::vector<std::string>& keywords) const
+{
+    for (auto& variant : entry.variants) {
+        if (variant->keywords == keywords)
+            return variant.get();
+    }
+
+    return nullptr;
+}
+
+
+bool ShaderLibrary::LoadSources(const ShaderEntry& entry, Variant& variant)
+{
+    variant.vertexSource = loader.Load(entry.vertexPath, variant.keywords);
+    variant.fragmentSource = loader.Load(entry.fragmentPath, variant.keywords);
+
+    if (variant.vertexSource == nullptr || variant.fragmentSource == nullptr)
+        return false;
+
+    variant.files.clear();
+
+    for (const ShaderSource *source : { variant.vertexSource,
+                                        variant.fragmentSource }) {
+        for (const std::string& file : source->Files()) {
+            std::string path = loader.FilePath(file);
+
+            if (!path.empty())
+                variant.files.push_back(path);
+        }
+    }
+
+    return true;
+}
+
+
+void ShaderLibrary::WatchFiles(const Variant& variant)
+{
+    if (watcher == nullptr)
+        return;
+
+    for (const std::string& path : variant.files)
+        watcher->Watch(path);
+}
+
+
+// Compile the variants that use any of the changed files again.  The
+// others keep the programs they have.
+void ShaderLibrary::ReloadChanged()
+{
+    std::vector<std::pair<std::string, Variant *>> changed;
+
+    for (auto& entry : entries) {
+        for (auto& variant : entry.second.variants) {
+            for (const std::string& path : variant->files) {
+                if (changedFiles.count(path) != 0) {
+                    changed.push_back(std::make_pair(entry.first,
+                                                     variant.get()));
+                    break;
+                }
+            }
+        }
+    }
+
+    changedFiles.clear();
+
+    if (changed.empty())
+        return;
+
+    // Everything has been compiled already, so nobody needs the old
+    // sources anymore.
+    loader.Clear();
+
+    for (auto& entry : entries) {
+        for (auto& variant : entry.second.variants) {
+            variant->vertexSource = nullptr;
+            variant->fragmentSource = nullptr;
+        }
+    }
+
+    for (auto& item : changed) {
+        Variant& variant = *item.second;
+
+        cout << "ShaderLibrary: reloading " << item.first;
+        for (const std::string& keyword : variant.keywords)
+            cout << " " << keyword;
+        cout << endl;
+
+        if (!LoadSources(entries[item.first], variant)) {
+            cout << "ShaderLibrary: keeping the old program" << endl;
+            continue;
+        }
+
+        // The files might include something new now
+        WatchFiles(variant);
+        declared.push_back(item);
+    }
+
+    CompileAll();
+}
+
+
+// Hand the sources to the compiler, and link.  We don't ask about the
+// status here, since that's what would make us wait.
+void ShaderLibrary::StartCompile(Variant& variant)
+{
+    const ShaderSource& vertexSource = *variant.vertexSource;
+    const ShaderSource& fragmentSource = *variant.fragmentSource;
+
+    variant.vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(variant.vertex, vertexSource.NumSegments(),
+                   vertexSource.Strings(), vertexSource.Lengths());
+    glCompileShader(variant.vertex);
+
+    variant.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(variant.fragment, fragmentSource.NumSegments(),
+                   fragmentSource.Strings(), fragmentSource.Lengths());
+    glCompileShader(variant.fragment);
+
+    variant.program = glCreateProgram();
+    glAttachShader(variant.program, variant.vertex);
+    glAttachShader(variant.program, variant.fragment);
+    glLinkProgram(variant.program);
+
+    variant.state = Compiling;
+}
+
+
+// Check how the link went.  On failure we keep the shaders around until
+// we've printed their logs.
+bool ShaderLibrary::FinishCompile(Variant& variant)
+{
+    GLint success = GL_FALSE;
+    glGetProgramiv(variant.program, GL_LINK_STATUS, &success);
+
+    if (!success) {
+        variant.state = Failed;
+        return false;
+    }
+
+    glDetachShader(variant.program, variant.vertex);
+    glDetachShader(variant.program, variant.fragment);
+    glDeleteShader(variant.vertex);
+    glDeleteShader(variant.fragment);
+    variant.vertex = 0;
+    variant.fragment = 0;
+
+    variant.state = Ready;
+    return true;
+}
+
+
+// Throw away a compile that didn't work.  If this was a reload, we go
+// on using the program we had.
+void ShaderLibrary::DiscardCompile(const std::string& name, Variant& variant)
+{
+    if (variant.vertex != 0)
+        glDeleteShader(variant.vertex);
+    if (variant.fragment != 0)
+        glDeleteShader(variant.fragment);
+    if (variant.program != 0 && variant.program != variant.shader.Program)
+        glDeleteProgram(variant.program);
+
+    variant.vertex = 0;
+    variant.fragment = 0;
+    variant.program = variant.shader.Program;
+
+    if (variant.shader.Program != 0) {
+        cout << "ShaderLibrary: keeping the old program for " << name << endl;
+        variant.state = Ready;
+    }
+}
+
+
+void ShaderLibrary::PrintErrors(const std::string& name,
+                                const Variant& variant) const
+{
+    GLchar infoLog[512];
+    GLint success;
+
+    cout << "ERROR::SHADERLIBRARY::VARIANT_FAILED" << endl
+         << "\tShader: " << name;
+    for (const std::string& keyword : variant.keywords)
+        cout << " " << keyword;
+    cout << endl;
+
+    const GLuint shaders[] = { variant.vertex, variant.fragment };
+    const ShaderSource *sources[] = { variant.vertexSource,
+                                      variant.fragmentSource };
+
+    for (int i = 0; i < 2; i++) {
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &success);
+        if (success)
+            continue;
+
+        glGetShaderInfoLog(shaders[i], 512, NULL, infoLog);
+        cout << ((i == 0) ? "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n\t"
+                          : "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n\t")
+             << infoLog << endl;
+
+        const std::vector<std::string>& files = sources[i]->Files();
+        for (size_t file = 0; file < files.size(); file++)
+            cout << "\tSource string " << file << ": " << files[file] << endl;
+    }
+
+    glGetProgramInfoLog(variant.program, 512, NULL, infoLog);
+    cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n\t"
+         << infoLog << endl;
+}
+
+
+// Compiles whatever CompileAll() queued up, in our hidden window's context.
+void ShaderLibrary::WorkerLoop()
+{
+    glfwMakeContextCurrent(workerWindow);
+
+    std::unique_lock<std::mutex> lock(workMutex);
+
+    while (true) {
+        workReady.wait(lock, [this] {
+            return stopWorker || !workQueue.empty();
+        });
+
+        if (stopWorker)
+            break;
+
+        std::pair<std::string, Variant *> item = workQueue.front();
+        workQueue.pop_front();
+
+        lock.unlock();
+
+        Variant& variant = *item.second;
+
+        StartCompile(variant);
+
+        GLint success = GL_FALSE;
+        glGetProgramiv(variant.program, GL_LINK_STATUS, &success);
+
+        if (!success)
+            PrintErrors(item.first, variant);
+
+        // The program has to be completely done before the render
+        // context can use it.
+        glFinish();
+
+        // Only now does the render thread get to see the new state
+        if (success)
+            FinishCompile(variant);
+        else
+            variant.state = Failed;
+
+        lock.lock();
+
+        if (--workInFlight == 0)
+            workDone.notify_all();
+    }
+
+    lock.unlock();
+    glfwMakeContextCurrent(nullptr);
+}
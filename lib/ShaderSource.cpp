@@ -0,0 +1,470 @@
+//============================================================================
+// Name        : ShaderSource.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Loads GLSL sources, and resolves their #include directives
+//               and #define based variants, without copying the text.
+//               A resolved ShaderSource is a list of segments pointing into
+//               the memory mapped files, which goes straight to
+//               glShaderSource().
+//============================================================================
+
+#include <iostream>
+#include <cstring>
+
+#include <sys/stat.h>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "SpookyV2.h"
+#include "ShaderSource.hpp"
+
+namespace {
+    inline bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    // Is the line a '#<directive>'?  If so, pos ends up after the name.
+    bool IsDirective(const char *line, size_t length, const char *directive,
+                     size_t &pos)
+    {
+        size_t nameLength = std::strlen(directive);
+
+        pos = 0;
+        while (pos < length && IsSpace(line[pos]))
+            pos++;
+
+        if (pos == length || line[pos] != '#')
+            return false;
+
+        pos++;
+        while (pos < length && IsSpace(line[pos]))
+            pos++;
+
+        if (length - pos < nameLength ||
+                std::strncmp(line + pos, directive, nameLength) != 0)
+            return false;
+
+        pos += nameLength;
+
+        // '#includes' is not '#include'
+        return pos == length || IsSpace(line[pos]) || line[pos] == '\n' ||
+               line[pos] == '"' || line[pos] == '<';
+    }
+}
+
+
+//
+// ShaderSource
+//
+
+std::string ShaderSource::Flatten() const
+{
+    std::string text;
+
+    for (size_t i = 0; i < strings.size(); i++)
+        text.append(strings[i], lengths[i]);
+
+    return text;
+}
+
+
+void ShaderSource::Append(const char *data, size_t length)
+{
+    strings.push_back(data);
+    lengths.push_back((int)length);
+}
+
+
+void ShaderSource::AppendGenerated(const std::string& text)
+{
+    generated.push_back(text);
+    Append(generated.back().data(), generated.back().size());
+}
+
+
+//
+// ShaderSourceLoader
+//
+
+ShaderSourceLoader::ShaderSourceLoader(const std::string& rootPath)
+    : rootPath(rootPath)
+{
+    if (!this->rootPath.empty() && this->rootPath.back() != '/')
+        this->rootPath += "/";
+}
+
+
+ShaderSourceLoader::ShaderSourceLoader(const AssetPack& pack)
+    : pack(&pack)
+{
+}
+
+
+const ShaderSource *ShaderSourceLoader::Load(const std::string& path,
+                                             const std::vector<std::string>& defines)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const SourceFile *file = GetFile(path);
+    if (file == nullptr)
+        return nullptr;
+
+    // The key is the main file's contents, its path (includes are
+    // relative to it) and the defines.
+    std::string key = path;
+    for (const std::string& define : defines) {
+        key += '\0';
+        key += define;
+    }
+
+    uint64_t keyHash = SpookyHash::Hash64(key.data(), key.size(),
+                                          file->contentHash);
+
+    auto found = resolved.find(keyHash);
+    if (found != resolved.end()) {
+        cacheHits++;
+        return found->second.get();
+    }
+
+    std::unique_ptr<ShaderSource> source(new ShaderSource());
+
+    ResolveState state;
+    state.source = source.get();
+
+    if (!Resolve(path, state))
+        return nullptr;
+
+    // The #version has to come first, then our defines.  We put them
+    // in one string in front of everything else.
+    std::string header;
+
+    if (!state.version.empty()) {
+        header.append(state.version.chars(), state.version.size);
+        if (header.back() != '\n')
+            header += '\n';
+    }
+
+    for (const std::string& define : defines) {
+        std::string::size_type equals = define.find('=');
+
+        if (equals == std::string::npos)
+            header += "#define " + define + " 1\n";
+        else
+            header += "#define " + define.substr(0, equals) + " " +
+                      define.substr(equals + 1) + "\n";
+    }
+
+    if (!header.empty()) {
+        source->generated.push_back(header);
+        source->strings.insert(source->strings.begin(),
+                               source->generated.back().data());
+        source->lengths.insert(source->lengths.begin(),
+                               (int)source->generated.back().size());
+    }
+
+    SpookyHash hasher;
+    hasher.Init(0, 0);
+
+    for (size_t i = 0; i < source->strings.size(); i++)
+        hasher.Update(source->strings[i], source->lengths[i]);
+
+    uint64 hash1, hash2;
+    hasher.Final(&hash1, &hash2);
+    source->hash = hash1;
+
+    const ShaderSource *result = source.get();
+    resolved[keyHash] = std::move(source);
+
+    return result;
+}
+
+
+void ShaderSourceLoader::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    resolved.clear();
+    files.clear();
+    scannedFiles.clear();
+    mappedFiles.clear();
+}
+
+
+std::string ShaderSourceLoader::FilePath(const std::string& path) const
+{
+    if (pack != nullptr)
+        return std::string();
+
+    return rootPath + path;
+}
+
+
+bool ShaderSourceLoader::Exists(const std::string& path) const
+{
+    if (pack != nullptr)
+        return pack->Contains(path);
+
+    struct stat info;
+    return stat((rootPath + path).c_str(), &info) == 0 &&
+           S_ISREG(info.st_mode);
+}
+
+
+const ShaderSourceLoader::SourceFile *ShaderSourceLoader::GetFile(const std::string& path)
+{
+    auto found = files.find(path);
+    if (found != files.end())
+        return &found->second;
+
+    SourceFile file;
+
+    if (pack != nullptr) {
+        file.contents = pack->Find(path);
+
+        if (file.contents.empty()) {
+            cout << "ERROR::SHADER::ASSET_DOES_NOT_EXIST" << endl
+                 << "\tAsset Path: " << path << endl;
+            return nullptr;
+        }
+    }
+    else {
+        MappedFile &mapped = mappedFiles[path];
+
+        if (!mapped.Open(rootPath + path)) {
+            cout << "ERROR::SHADER::FILE_DOES_NOT_EXIST" << endl
+                 << "\tFile Path: " << rootPath + path << endl;
+            mappedFiles.erase(path);
+            return nullptr;
+        }
+
+        file.contents.data = mapped.Data();
+        file.contents.size = mapped.Size();
+    }
+
+    // Files with the same contents only get scanned once
+    file.contentHash = SpookyHash::Hash64(file.contents.data,
+                                          file.contents.size, 0);
+
+    auto scanned = scannedFiles.find(file.contentHash);
+    if (scanned == scannedFiles.end()) {
+        scanned = scannedFiles.insert(std::make_pair(file.contentHash,
+                                                     ScannedFile())).first;
+        Scan(file.contents, scanned->second);
+        filesScanned++;
+    }
+
+    file.scanned = &scanned->second;
+
+    return &(files[path] = file);
+}
+
+
+bool ShaderSourceLoader::FindInclude(const std::string& includer,
+                                     const std::string& name,
+                                     std::string& resolvedPath)
+{
+    std::string::size_type slash = includer.rfind('/');
+
+    if (slash != std::string::npos) {
+        std::string candidate = includer.substr(0, slash + 1) + name;
+
+        if (files.count(candidate) != 0 || Exists(candidate)) {
+            resolvedPath = candidate;
+            return true;
+        }
+    }
+
+    if (files.count(name) != 0 || Exists(name)) {
+        resolvedPath = name;
+        return true;
+    }
+
+    return false;
+}
+
+
+bool ShaderSourceLoader::Resolve(const std::string& path, ResolveState& state)
+{
+    for (const std::string& included : state.included) {
+        if (included == path)
+            return true;
+    }
+
+    const SourceFile *file = GetFile(path);
+    if (file == nullptr)
+        return false;
+
+    state.included.push_back(path);
+
+    ShaderSource *source = state.source;
+    std::string fileIdx = std::to_string(source->files.size());
+    source->files.push_back(path);
+
+    const char *text = file->contents.chars();
+    bool needsLine = true;
+    bool endsWithNewline = true;
+
+    for (const Piece& piece : file->scanned->pieces) {
+        switch (piece.type) {
+        case Text:
+            // keep the compiler's line numbers in step with the file
+            if (needsLine) {
+                source->AppendGenerated("#line " + std::to_string(piece.line) +
+                                        " " + fileIdx + "\n");
+                needsLine = false;
+            }
+
+            source->Append(text + piece.offset, piece.length);
+            endsWithNewline = (text[piece.offset + piece.length - 1] == '\n');
+            break;
+
+        case Version:
+            if (state.version.empty()) {
+                state.version.data = file->contents.data + piece.offset;
+                state.version.size = piece.length;
+            }
+            needsLine = true;
+            break;
+
+        case Include:
+            {
+                std::string includePath;
+
+                if (!FindInclude(path, piece.include, includePath)) {
+                    cout << "ERROR::SHADER::INCLUDE_NOT_FOUND" << endl
+                         << "\tFile Path: " << path << ":" << piece.line
+                         << endl
+                         << "\tInclude: " << piece.include << endl;
+                    return false;
+                }
+
+                if (!endsWithNewline)
+                    source->AppendGenerated("\n");
+
+                if (!Resolve(includePath, state))
+                    return false;
+
+                endsWithNewline = true;
+                needsLine = true;
+            }
+            break;
+        }
+    }
+
+    // so whatever comes next starts on its own line
+    if (!endsWithNewline)
+        source->AppendGenerated("\n");
+
+    return true;
+}
+
+
+// Split a file up into plain text, and the #include and #version lines
+// that we handle ourselves.  We skip over block comments, so a commented
+// out #include stays commented out.
+void ShaderSourceLoader::Scan(const AssetSpan& contents, ScannedFile& scanned)
+{
+    const char *text = contents.chars();
+    size_t size = contents.size;
+
+    size_t pos = 0;
+    size_t textStart = 0;
+    int line = 1;
+    int textLine = 1;
+    bool inComment = false;
+
+    while (pos < size) {
+        const char *newline = static_cast<const char *>(
+            std::memchr(text + pos, '\n', size - pos));
+        size_t lineEnd = newline ? (size_t)(newline - text) + 1 : size;
+        size_t lineLength = lineEnd - pos;
+
+        Piece piece;
+        size_t namePos = 0;
+        bool handled = false;
+
+        if (!inComment && IsDirective(text + pos, lineLength, "include",
+                                      namePos))
+        {
+            const char *rest = text + pos + namePos;
+            size_t restLength = lineLength - namePos;
+            size_t open = 0;
+
+            while (open < restLength && IsSpace(rest[open]))
+                open++;
+
+            char closing = (open < restLength && rest[open] == '<') ? '>' : '"';
+            const char *nameEnd = static_cast<const char *>(
+                std::memchr(rest + open + 1, closing, restLength - open - 1));
+
+            if (open < restLength && (rest[open] == '"' || rest[open] == '<') &&
+                    nameEnd != nullptr)
+            {
+                piece.type = Include;
+                piece.include.assign(rest + open + 1, nameEnd);
+                handled = true;
+            }
+        }
+        else if (!inComment && IsDirective(text + pos, lineLength, "version",
+                                           namePos))
+        {
+            piece.type = Version;
+            handled = true;
+        }
+
+        if (handled) {
+            if (pos > textStart) {
+                Piece textPiece;
+                textPiece.type = Text;
+                textPiece.offset = textStart;
+                textPiece.length = pos - textStart;
+                textPiece.line = textLine;
+                scanned.pieces.push_back(textPiece);
+            }
+
+            piece.offset = pos;
+            piece.length = lineLength;
+            piece.line = line;
+            scanned.pieces.push_back(piece);
+
+            textStart = lineEnd;
+            textLine = line + 1;
+        }
+        else {
+            // keep track of whether the next line starts inside a comment
+            for (size_t i = pos; i + 1 < lineEnd; i++) {
+                if (inComment) {
+                    if (text[i] == '*' && text[i + 1] == '/') {
+                        inComment = false;
+                        i++;
+                    }
+                }
+                else if (text[i] == '/' && text[i + 1] == '/') {
+                    break;
+                }
+                else if (text[i] == '/' && text[i + 1] == '*') {
+                    inComment = true;
+                    i++;
+                }
+            }
+        }
+
+        pos = lineEnd;
+        line++;
+    }
+
+    if (size > textStart) {
+        Piece textPiece;
+        textPiece.type = Text;
+        textPiece.offset = textStart;
+        textPiece.length = size - textStart;
+        textPiece.line = textLine;
+        scanned.pieces.push_back(textPiece);
+    }
+}
@@ -0,0 +1,857 @@
+//============================================================================
+// Name        : SoftwareRenderer.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : A CPU rendering backend for our demo scenes.  It consumes
+//               the same vertex, index and texture data, and the same
+//               model/view/projection matrices, that we hand to OpenGL in
+//               the TransformCube demo.
+//
+//               Triangles are clipped against the near plane, set up in
+//               screen space and binned into tiles as they are drawn.
+//               Flush() then rasterizes each tile as its own job, 4 pixels
+//               at a time with SSE.
+//============================================================================
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "SoftwareRenderer.hpp"
+
+using Eigen::Vector4f;
+
+const int SoftwareRenderer::TileSize;
+
+namespace {
+    // Drawing a lot of triangles, we set them up in chunks of this size
+    const size_t SetupChunkSize = 1024;
+
+    // and transform vertices in parallel when there are this many
+    const size_t ParallelVertexThreshold = 4096;
+
+    inline uint32_t PackColor(const float *rgba)
+    {
+        uint32_t packed = 0;
+
+        for (int c = 0; c < 4; c++) {
+            float value = std::min(std::max(rgba[c], 0.0f), 1.0f);
+            packed |= (uint32_t)(value * 255.0f + 0.5f) << (c * 8);
+        }
+
+        return packed;
+    }
+
+    inline void UnpackColor(uint32_t packed, float *rgba)
+    {
+        for (int c = 0; c < 4; c++)
+            rgba[c] = ((packed >> (c * 8)) & 0xff) * (1.0f / 255.0f);
+    }
+
+    // The mipmap level of detail, from the texture coordinate derivatives
+    // along x and y in screen space.
+    inline float TextureLod(const SoftwareTexture *texture,
+                            float dsdx, float dtdx, float dsdy, float dtdy)
+    {
+        float w = (float)texture->Width();
+        float h = (float)texture->Height();
+
+        float lengthX = (dsdx * w) * (dsdx * w) + (dtdx * h) * (dtdx * h);
+        float lengthY = (dsdy * w) * (dsdy * w) + (dtdy * h) * (dtdy * h);
+        float rhoSquared = std::max(lengthX, lengthY);
+
+        if (rhoSquared <= 1.0f)
+            return 0.0f;
+
+        // log2(sqrt(x)) == 0.5 * log2(x)
+        return 0.5f * std::log2(rhoSquared);
+    }
+}
+
+
+//
+// SoftwareTexture
+//
+
+SoftwareTexture::SoftwareTexture(const unsigned char *pixels,
+                                 int width, int height, int channels)
+{
+    SetImage(pixels, width, height, channels);
+}
+
+
+void SoftwareTexture::SetImage(const unsigned char *pixels,
+                               int width, int height, int channels)
+{
+    this->width = width;
+    this->height = height;
+
+    levels.clear();
+    levelWidth.clear();
+    levelHeight.clear();
+
+    if (pixels == nullptr || width <= 0 || height <= 0 ||
+            channels < 1 || channels > 4)
+    {
+        cout << "SoftwareTexture::SetImage(): bad image" << endl;
+        this->width = this->height = 0;
+        return;
+    }
+
+    std::vector<uint32_t> base(width * height);
+
+    for (int i = 0; i < width * height; i++) {
+        const unsigned char *p = pixels + i * channels;
+        uint32_t r, g, b, a = 0xff;
+
+        if (channels < 3) {
+            r = g = b = p[0];
+            if (channels == 2)
+                a = p[1];
+        }
+        else {
+            r = p[0];
+            g = p[1];
+            b = p[2];
+            if (channels == 4)
+                a = p[3];
+        }
+
+        base[i] = r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    levels.push_back(std::move(base));
+    levelWidth.push_back(width);
+    levelHeight.push_back(height);
+
+    // Build the mipmap chain with a 2x2 box filter, like glGenerateMipmap()
+    while (levelWidth.back() > 1 || levelHeight.back() > 1) {
+        const std::vector<uint32_t>& src = levels.back();
+        int srcW = levelWidth.back();
+        int srcH = levelHeight.back();
+        int dstW = std::max(srcW / 2, 1);
+        int dstH = std::max(srcH / 2, 1);
+
+        std::vector<uint32_t> dst(dstW * dstH);
+
+        for (int y = 0; y < dstH; y++) {
+            int y0 = std::min(y * 2, srcH - 1);
+            int y1 = std::min(y * 2 + 1, srcH - 1);
+
+            for (int x = 0; x < dstW; x++) {
+                int x0 = std::min(x * 2, srcW - 1);
+                int x1 = std::min(x * 2 + 1, srcW - 1);
+
+                uint32_t texels[4] = {src[y0 * srcW + x0], src[y0 * srcW + x1],
+                                      src[y1 * srcW + x0], src[y1 * srcW + x1]};
+                uint32_t packed = 0;
+
+                for (int c = 0; c < 4; c++) {
+                    uint32_t sum = 2;  // rounding
+
+                    for (uint32_t texel : texels)
+                        sum += (texel >> (c * 8)) & 0xff;
+
+                    packed |= (sum / 4) << (c * 8);
+                }
+
+                dst[y * dstW + x] = packed;
+            }
+        }
+
+        levels.push_back(std::move(dst));
+        levelWidth.push_back(dstW);
+        levelHeight.push_back(dstH);
+    }
+}
+
+
+void SoftwareTexture::Sample(float u, float v, float lod, float *rgba) const
+{
+    if (levels.empty()) {
+        rgba[0] = rgba[1] = rgba[2] = 0.0f;
+        rgba[3] = 1.0f;
+        return;
+    }
+
+    float maxLod = (float)(levels.size() - 1);
+    lod = std::min(std::max(lod, 0.0f), maxLod);
+
+    size_t level0 = (size_t)lod;
+    float blend = lod - (float)level0;
+
+    SampleBilinear(level0, u, v, rgba);
+
+    if (blend > 0.0f && level0 + 1 < levels.size()) {
+        float next[4];
+
+        SampleBilinear(level0 + 1, u, v, next);
+
+        for (int c = 0; c < 4; c++)
+            rgba[c] += (next[c] - rgba[c]) * blend;
+    }
+}
+
+
+void SoftwareTexture::SampleBilinear(size_t level, float u, float v,
+                                     float *rgba) const
+{
+    const std::vector<uint32_t>& texels = levels[level];
+    int w = levelWidth[level];
+    int h = levelHeight[level];
+
+    // texel centers are at half coordinates
+    float x = u * w - 0.5f;
+    float y = v * h - 0.5f;
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+    float wx = x - fx;
+    float wy = y - fy;
+
+    int x0 = std::min(std::max((int)fx, 0), w - 1);
+    int y0 = std::min(std::max((int)fy, 0), h - 1);
+    int x1 = std::min(std::max((int)fx + 1, 0), w - 1);
+    int y1 = std::min(std::max((int)fy + 1, 0), h - 1);
+
+#ifdef __SSE2__
+    // widen the 4 texels to floats, and blend all the channels at once
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+    auto load = [&](int texelX, int texelY) {
+        __m128i texel = _mm_cvtsi32_si128((int)texels[texelY * w + texelX]);
+
+        texel = _mm_unpacklo_epi8(texel, zero);
+        texel = _mm_unpacklo_epi16(texel, zero);
+
+        return _mm_mul_ps(_mm_cvtepi32_ps(texel), scale);
+    };
+
+    __m128 c00 = load(x0, y0);
+    __m128 c10 = load(x1, y0);
+    __m128 c01 = load(x0, y1);
+    __m128 c11 = load(x1, y1);
+
+    __m128 weightX = _mm_set1_ps(wx);
+    __m128 top = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c10, c00), weightX));
+    __m128 bottom = _mm_add_ps(c01, _mm_mul_ps(_mm_sub_ps(c11, c01), weightX));
+
+    _mm_storeu_ps(rgba, _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top),
+                                                   _mm_set1_ps(wy))));
+#else
+    float c00[4], c10[4], c01[4], c11[4];
+    UnpackColor(texels[y0 * w + x0], c00);
+    UnpackColor(texels[y0 * w + x1], c10);
+    UnpackColor(texels[y1 * w + x0], c01);
+    UnpackColor(texels[y1 * w + x1], c11);
+
+    for (int c = 0; c < 4; c++) {
+        float top = c00[c] + (c10[c] - c00[c]) * wx;
+        float bottom = c01[c] + (c11[c] - c01[c]) * wx;
+
+        rgba[c] = top + (bottom - top) * wy;
+    }
+#endif
+}
+
+
+//
+// SoftwareRenderer
+//
+
+SoftwareRenderer::SoftwareRenderer(int width, int height, JobSystem *jobs)
+    : jobs(jobs),
+      width(std::max(width, 1)),
+      height(std::max(height, 1))
+{
+    tilesX = (this->width + TileSize - 1) / TileSize;
+    tilesY = (this->height + TileSize - 1) / TileSize;
+
+    tileBins.resize(tilesX * tilesY);
+
+    color.assign(this->width * this->height, 0);
+    depth.assign(this->width * this->height, 1.0f);
+
+    for (Matrix4f& transform : transforms)
+        transform.setIdentity();
+}
+
+
+void SoftwareRenderer::Clear(float red, float green, float blue, float alpha)
+{
+    // anything that was drawn before the clear goes in first
+    Flush();
+
+    float rgba[4] = {red, green, blue, alpha};
+
+    std::fill(color.begin(), color.end(), PackColor(rgba));
+    std::fill(depth.begin(), depth.end(), 1.0f);
+
+    trianglesSubmitted = 0;
+    trianglesRasterized = 0;
+    pixelsShaded = 0;
+}
+
+
+void SoftwareRenderer::UseTransform(const float *transform,
+                                    unsigned transformIdx)
+{
+    if (transformIdx > 2) {
+        cout << "SoftwareRenderer::UseTransform(): bad index "
+             << transformIdx << endl;
+        return;
+    }
+
+    transforms[transformIdx] = Eigen::Map<const Matrix4f>(transform);
+}
+
+
+void SoftwareRenderer::UseTexture(const SoftwareTexture *texture,
+                                  unsigned textureUnitIdx)
+{
+    if (textureUnitIdx > 1) {
+        cout << "SoftwareRenderer::UseTexture(): bad texture unit "
+             << textureUnitIdx << endl;
+        return;
+    }
+
+    textures[textureUnitIdx] = texture;
+}
+
+
+void SoftwareRenderer::DrawElements(const SoftwareVertexData& vertices,
+                                    const uint32_t *indices, size_t count)
+{
+    if (vertices.positions == nullptr || indices == nullptr || count < 3)
+        return;
+
+    DrawState state;
+    state.textures[0] = textures[0];
+    state.textures[1] = textures[1];
+    state.textureMix = textureMix;
+    state.useColors = (vertices.colors != nullptr);
+    state.useTexCoords = (vertices.texCoords != nullptr &&
+                          textures[0] != nullptr &&
+                          textures[0]->NumLevels() > 0);
+
+    uint32_t stateIdx = (uint32_t)states.size();
+    states.push_back(state);
+
+    // The vertex stage, same as our TransTexVertexShader
+    Matrix4f mvp = transforms[2] * transforms[1] * transforms[0];
+    std::vector<ClipVertex> clip(vertices.numVertices);
+
+    auto transformVertices = [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            const float *p = &vertices.positions[v * 3];
+            Vector4f c = mvp * Vector4f(p[0], p[1], p[2], 1.0f);
+            ClipVertex &out = clip[v];
+
+            out.x = c.x();
+            out.y = c.y();
+            out.z = c.z();
+            out.w = c.w();
+
+            if (vertices.texCoords != nullptr) {
+                out.attr[0] = vertices.texCoords[v * 2];
+                out.attr[1] = vertices.texCoords[v * 2 + 1];
+
+                if (flipTexCoords)
+                    out.attr[1] = 1.0f - out.attr[1];
+            }
+            else {
+                out.attr[0] = out.attr[1] = 0.0f;
+            }
+
+            if (vertices.colors != nullptr) {
+                out.attr[2] = vertices.colors[v * 3];
+                out.attr[3] = vertices.colors[v * 3 + 1];
+                out.attr[4] = vertices.colors[v * 3 + 2];
+            }
+            else {
+                out.attr[2] = out.attr[3] = out.attr[4] = 1.0f;
+            }
+        }
+    };
+
+    if (jobs != nullptr && vertices.numVertices >= ParallelVertexThreshold)
+        jobs->ParallelFor(0, vertices.numVertices, 0, transformVertices);
+    else
+        transformVertices(0, vertices.numVertices);
+
+    // Clip and set up the triangles in chunks.  Each chunk has its own
+    // output, so we can bin them afterwards in the order they were drawn.
+    size_t numTriangles = count / 3;
+    size_t numChunks = (numTriangles + SetupChunkSize - 1) / SetupChunkSize;
+    std::vector<std::vector<Triangle>> chunks(numChunks);
+
+    auto setupChunks = [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            size_t first = chunk * SetupChunkSize;
+            size_t last = std::min(first + SetupChunkSize, numTriangles);
+
+            for (size_t t = first; t < last; t++) {
+                const uint32_t *i = &indices[t * 3];
+
+                if (i[0] >= clip.size() || i[1] >= clip.size() ||
+                        i[2] >= clip.size())
+                    continue;
+
+                ClipAndSetup(clip[i[0]], clip[i[1]], clip[i[2]], stateIdx,
+                             chunks[chunk]);
+            }
+        }
+    };
+
+    if (jobs != nullptr && numChunks > 1)
+        jobs->ParallelFor(0, numChunks, 1, setupChunks);
+    else
+        setupChunks(0, numChunks);
+
+    for (const std::vector<Triangle>& chunk : chunks) {
+        for (const Triangle& tri : chunk) {
+            uint32_t index = (uint32_t)triangles.size();
+
+            triangles.push_back(tri);
+            BinTriangle(index);
+        }
+    }
+
+    trianglesSubmitted += numTriangles;
+}
+
+
+void SoftwareRenderer::Flush()
+{
+    if (triangles.empty()) {
+        states.clear();
+        return;
+    }
+
+    std::vector<size_t> tilePixels(tileBins.size(), 0);
+
+    if (jobs != nullptr) {
+        jobs->ParallelFor(0, tileBins.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t tile = begin; tile < end; tile++)
+                tilePixels[tile] = RasterizeTile((int)tile);
+        });
+    }
+    else {
+        for (size_t tile = 0; tile < tileBins.size(); tile++)
+            tilePixels[tile] = RasterizeTile((int)tile);
+    }
+
+    for (size_t pixels : tilePixels)
+        pixelsShaded += pixels;
+
+    trianglesRasterized += triangles.size();
+
+    triangles.clear();
+    states.clear();
+    for (std::vector<uint32_t>& bin : tileBins)
+        bin.clear();
+}
+
+
+bool SoftwareRenderer::WritePPM(const std::string& path) const
+{
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+
+    if (!file.is_open()) {
+        cout << "SoftwareRenderer::WritePPM(): could not open "
+             << path << endl;
+        return false;
+    }
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+
+    // PPM images start at the top-left
+    std::vector<unsigned char> row(width * 3);
+
+    for (int y = height - 1; y >= 0; y--) {
+        const uint32_t *src = &color[y * width];
+
+        for (int x = 0; x < width; x++) {
+            row[x * 3] = src[x] & 0xff;
+            row[x * 3 + 1] = (src[x] >> 8) & 0xff;
+            row[x * 3 + 2] = (src[x] >> 16) & 0xff;
+        }
+
+        file.write((const char *)row.data(), row.size());
+    }
+
+    return file.good();
+}
+
+
+// Clip a triangle against the near plane (z >= -w), which can turn it
+// into a quad, and set up the results.  Triangles that are completely
+// off to one side of the view volume get dropped.  The other sides don't
+// need clipping; we only ever visit the pixels inside the screen.
+void SoftwareRenderer::ClipAndSetup(const ClipVertex& v0, const ClipVertex& v1,
+                                    const ClipVertex& v2, uint32_t state,
+                                    std::vector<Triangle>& out) const
+{
+    const ClipVertex *in[3] = {&v0, &v1, &v2};
+
+    if ((v0.x > v0.w && v1.x > v1.w && v2.x > v2.w) ||
+            (v0.x < -v0.w && v1.x < -v1.w && v2.x < -v2.w) ||
+            (v0.y > v0.w && v1.y > v1.w && v2.y > v2.w) ||
+            (v0.y < -v0.w && v1.y < -v1.w && v2.y < -v2.w) ||
+            (v0.z > v0.w && v1.z > v1.w && v2.z > v2.w))
+        return;
+
+    float dist[3];
+    int numInside = 0;
+
+    for (int i = 0; i < 3; i++) {
+        dist[i] = in[i]->z + in[i]->w;
+        if (dist[i] >= 0.0f)
+            numInside++;
+    }
+
+    Triangle tri;
+
+    if (numInside == 3) {
+        if (SetupTriangle(v0, v1, v2, state, tri))
+            out.push_back(tri);
+        return;
+    }
+
+    if (numInside == 0)
+        return;
+
+    // Sutherland-Hodgman against the one plane
+    ClipVertex polygon[4];
+    int numPoints = 0;
+
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+
+        if (dist[i] >= 0.0f)
+            polygon[numPoints++] = *in[i];
+
+        if ((dist[i] >= 0.0f) != (dist[j] >= 0.0f)) {
+            float t = dist[i] / (dist[i] - dist[j]);
+            const ClipVertex &a = *in[i];
+            const ClipVertex &b = *in[j];
+            ClipVertex &p = polygon[numPoints++];
+
+            p.x = a.x + (b.x - a.x) * t;
+            p.y = a.y + (b.y - a.y) * t;
+            p.z = a.z + (b.z - a.z) * t;
+            p.w = a.w + (b.w - a.w) * t;
+
+            for (int k = 0; k < 5; k++)
+                p.attr[k] = a.attr[k] + (b.attr[k] - a.attr[k]) * t;
+        }
+    }
+
+    for (int i = 1; i + 1 < numPoints; i++) {
+        if (SetupTriangle(polygon[0], polygon[i], polygon[i + 1], state, tri))
+            out.push_back(tri);
+    }
+}
+
+
+// Project a triangle to the screen and work out the edge functions and
+// the planes of everything we interpolate.
+bool SoftwareRenderer::SetupTriangle(const ClipVertex& v0, const ClipVertex& v1,
+                                     const ClipVertex& v2, uint32_t state,
+                                     Triangle& tri) const
+{
+    const ClipVertex *in[3] = {&v0, &v1, &v2};
+    float x[3], y[3], z[3], invW[3];
+
+    for (int i = 0; i < 3; i++) {
+        if (in[i]->w <= 0.0f)
+            return false;
+
+        invW[i] = 1.0f / in[i]->w;
+
+        x[i] = (in[i]->x * invW[i] * 0.5f + 0.5f) * width;
+        y[i] = (in[i]->y * invW[i] * 0.5f + 0.5f) * height;
+        z[i] = in[i]->z * invW[i] * 0.5f + 0.5f;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (std::fabs(area) < 1.0e-8f)
+        return false;
+
+    // We don't cull back faces (neither does our GL path), we just flip
+    // them around so that the inside is where all the edge functions >= 0
+    int i1 = 1, i2 = 2;
+    if (area < 0.0f) {
+        std::swap(i1, i2);
+        area = -area;
+    }
+
+    const int order[3] = {0, i1, i2};
+    float sx[3], sy[3];
+
+    for (int i = 0; i < 3; i++) {
+        sx[i] = x[order[i]];
+        sy[i] = y[order[i]];
+    }
+
+    tri.minX = std::min({sx[0], sx[1], sx[2]});
+    tri.maxX = std::max({sx[0], sx[1], sx[2]});
+    tri.minY = std::min({sy[0], sy[1], sy[2]});
+    tri.maxY = std::max({sy[0], sy[1], sy[2]});
+
+    if (tri.maxX < 0.0f || tri.maxY < 0.0f ||
+            tri.minX >= width || tri.minY >= height)
+        return false;
+
+    // keep the bounds sane for triangles that reach far off the screen
+    tri.minX = std::max(tri.minX, 0.0f);
+    tri.minY = std::max(tri.minY, 0.0f);
+    tri.maxX = std::min(tri.maxX, (float)width);
+    tri.maxY = std::min(tri.maxY, (float)height);
+
+    // edge functions E(x, y) = A*x + B*y + C
+    for (int e = 0; e < 3; e++) {
+        int a = e;
+        int b = (e + 1) % 3;
+
+        tri.edgeA[e] = sy[a] - sy[b];
+        tri.edgeB[e] = sx[b] - sx[a];
+        tri.edgeC[e] = (sy[b] - sy[a]) * sx[a] - (sx[b] - sx[a]) * sy[a];
+    }
+
+    // Any value that is linear in screen space is a plane built from the
+    // barycentric weights.  The weight of vertex 0 is edge 1 (v1 -> v2),
+    // vertex 1 is edge 2 and vertex 2 is edge 0.
+    float invArea = 1.0f / area;
+
+    auto plane = [&](const float *q, float *out) {
+        float q0 = q[order[0]], q1 = q[order[1]], q2 = q[order[2]];
+
+        out[0] = (q0 * tri.edgeA[1] + q1 * tri.edgeA[2] + q2 * tri.edgeA[0]) * invArea;
+        out[1] = (q0 * tri.edgeB[1] + q1 * tri.edgeB[2] + q2 * tri.edgeB[0]) * invArea;
+        out[2] = (q0 * tri.edgeC[1] + q1 * tri.edgeC[2] + q2 * tri.edgeC[0]) * invArea;
+    };
+
+    plane(z, tri.z);
+    plane(invW, tri.invW);
+
+    // For perspective-correct interpolation, the attributes are divided
+    // by w.  Dividing by the interpolated 1/w later gets them back.
+    for (int k = 0; k < 5; k++) {
+        float q[3];
+
+        for (int i = 0; i < 3; i++)
+            q[i] = in[i]->attr[k] * invW[i];
+
+        plane(q, tri.attr[k]);
+    }
+
+    tri.state = state;
+
+    return true;
+}
+
+
+void SoftwareRenderer::BinTriangle(uint32_t index)
+{
+    const Triangle& tri = triangles[index];
+
+    int tileX0 = std::max((int)tri.minX / TileSize, 0);
+    int tileY0 = std::max((int)tri.minY / TileSize, 0);
+    int tileX1 = std::min((int)tri.maxX / TileSize, tilesX - 1);
+    int tileY1 = std::min((int)tri.maxY / TileSize, tilesY - 1);
+
+    for (int ty = tileY0; ty <= tileY1; ty++) {
+        for (int tx = tileX0; tx <= tileX1; tx++)
+            tileBins[ty * tilesX + tx].push_back(index);
+    }
+}
+
+
+size_t SoftwareRenderer::RasterizeTile(int tile)
+{
+    int tileX0 = (tile % tilesX) * TileSize;
+    int tileY0 = (tile / tilesX) * TileSize;
+    int tileX1 = std::min(tileX0 + TileSize, width);
+    int tileY1 = std::min(tileY0 + TileSize, height);
+
+    size_t numPixels = 0;
+
+    for (uint32_t index : tileBins[tile])
+        numPixels += RasterizeTriangle(triangles[index],
+                                       tileX0, tileY0, tileX1, tileY1);
+
+    return numPixels;
+}
+
+
+// Rasterize a triangle into one tile, with a 'less than' depth test.
+// Pixels are sampled at their centers.  Coverage and depth are worked out
+// 4 pixels at a time, and then each covered pixel gets depth tested and
+// shaded.  Returns the number of pixels we shaded.
+size_t SoftwareRenderer::RasterizeTriangle(const Triangle& tri,
+                                           int tileX0, int tileY0,
+                                           int tileX1, int tileY1)
+{
+    int minX = std::max((int)std::floor(tri.minX), tileX0);
+    int maxX = std::min((int)std::ceil(tri.maxX), tileX1 - 1);
+    int minY = std::max((int)std::floor(tri.minY), tileY0);
+    int maxY = std::min((int)std::ceil(tri.maxY), tileY1 - 1);
+
+    if (minX > maxX || minY > maxY)
+        return 0;
+
+    // We step 4 pixels at a time.  The tiles start on a multiple of 4,
+    // so this never takes us into the tile to the left.
+    minX &= ~3;
+
+    size_t numPixels = 0;
+
+#ifdef __SSE2__
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 xEnd = _mm_set1_ps((float)(maxX + 1));
+
+    const __m128 a0 = _mm_set1_ps(tri.edgeA[0]);
+    const __m128 a1 = _mm_set1_ps(tri.edgeA[1]);
+    const __m128 a2 = _mm_set1_ps(tri.edgeA[2]);
+    const __m128 za = _mm_set1_ps(tri.z[0]);
+
+    alignas(16) float z[4];
+
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        float *depthRow = &depth[y * width];
+        uint32_t *colorRow = &color[y * width];
+
+        __m128 e0Row = _mm_set1_ps(tri.edgeB[0] * py + tri.edgeC[0]);
+        __m128 e1Row = _mm_set1_ps(tri.edgeB[1] * py + tri.edgeC[1]);
+        __m128 e2Row = _mm_set1_ps(tri.edgeB[2] * py + tri.edgeC[2]);
+        __m128 zRow = _mm_set1_ps(tri.z[1] * py + tri.z[2]);
+
+        for (int x = minX; x <= maxX; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), e0Row);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), e1Row);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), e2Row);
+
+            // the last step can hang over the end of the tile
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero),
+                                                  _mm_cmpge_ps(e1, zero)),
+                                       _mm_and_ps(_mm_cmpge_ps(e2, zero),
+                                                  _mm_cmplt_ps(px, xEnd)));
+
+            int mask = _mm_movemask_ps(inside);
+            if (mask == 0)
+                continue;
+
+            _mm_store_ps(z, _mm_add_ps(_mm_mul_ps(za, px), zRow));
+
+            for (int lane = 0; lane < 4; lane++) {
+                if (!(mask & (1 << lane)))
+                    continue;
+
+                int pixelX = x + lane;
+
+                if (z[lane] < 0.0f || z[lane] >= depthRow[pixelX])
+                    continue;
+
+                depthRow[pixelX] = z[lane];
+                colorRow[pixelX] = Shade(tri, pixelX + 0.5f, py);
+                numPixels++;
+            }
+        }
+    }
+#else
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        float *depthRow = &depth[y * width];
+        uint32_t *colorRow = &color[y * width];
+
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f;
+
+            if (tri.edgeA[0] * px + tri.edgeB[0] * py + tri.edgeC[0] >= 0.0f &&
+                    tri.edgeA[1] * px + tri.edgeB[1] * py + tri.edgeC[1] >= 0.0f &&
+                    tri.edgeA[2] * px + tri.edgeB[2] * py + tri.edgeC[2] >= 0.0f)
+            {
+                float z = tri.z[0] * px + tri.z[1] * py + tri.z[2];
+
+                if (z < 0.0f || z >= depthRow[x])
+                    continue;
+
+                depthRow[x] = z;
+                colorRow[x] = Shade(tri, px, py);
+                numPixels++;
+            }
+        }
+    }
+#endif
+
+    return numPixels;
+}
+
+
+// Our fixed function 'fragment shader'
+uint32_t SoftwareRenderer::Shade(const Triangle& tri, float px, float py) const
+{
+    const DrawState& state = states[tri.state];
+
+    float invW = tri.invW[0] * px + tri.invW[1] * py + tri.invW[2];
+    float w = 1.0f / invW;
+
+    float rgba[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    if (!state.useTexCoords) {
+        if (state.useColors) {
+            for (int c = 0; c < 3; c++) {
+                const float *attr = tri.attr[c + 2];
+                rgba[c] = (attr[0] * px + attr[1] * py + attr[2]) * w;
+            }
+        }
+
+        return PackColor(rgba);
+    }
+
+    const float *sPlane = tri.attr[0];
+    const float *tPlane = tri.attr[1];
+
+    float s = (sPlane[0] * px + sPlane[1] * py + sPlane[2]) * w;
+    float t = (tPlane[0] * px + tPlane[1] * py + tPlane[2]) * w;
+
+    // The derivatives of s = S/W along x are (dS/dx - s * dW/dx) / W,
+    // with S and W the interpolated s/w and 1/w.
+    float dsdx = (sPlane[0] - s * tri.invW[0]) * w;
+    float dtdx = (tPlane[0] - t * tri.invW[0]) * w;
+    float dsdy = (sPlane[1] - s * tri.invW[1]) * w;
+    float dtdy = (tPlane[1] - t * tri.invW[1]) * w;
+
+    const SoftwareTexture *texture0 = state.textures[0];
+    const SoftwareTexture *texture1 = state.textures[1];
+
+    texture0->Sample(s, t, TextureLod(texture0, dsdx, dtdx, dsdy, dtdy), rgba);
+
+    if (texture1 != nullptr && texture1->NumLevels() > 0) {
+        float other[4];
+
+        texture1->Sample(s, t, TextureLod(texture1, dsdx, dtdx, dsdy, dtdy),
+                         other);
+
+        for (int c = 0; c < 4; c++)
+            rgba[c] += (other[c] - rgba[c]) * state.textureMix;
+    }
+
+    return PackColor(rgba);
+}
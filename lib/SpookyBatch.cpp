@@ -0,0 +1,464 @@
+//============================================================================
+// Name        : SpookyBatch.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : SpookyHash's short hash, for a group of messages at once,
+//               one message to a lane.  This follows SpookyHash::Short()
+//               step for step, so if that ever changes, this has to too.
+//
+//               Without AVX2 there's nothing here; SSE2's two lanes don't
+//               make up for the rotates it doesn't have, so we just call
+//               SpookyHash for each message.
+//
+//               Each lane's bytes get loaded a block at a time and turned
+//               sideways in registers, so that a register holds the same
+//               word of every lane.  Going through memory instead, a word
+//               at a time, stalls every load on the stores before it.
+//============================================================================
+
+#include <cstring>
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "SpookyV2.h"
+#include "SpookyBatch.hpp"
+
+#ifdef __AVX2__
+namespace {
+    // SpookyHash's sc_const, which it keeps to itself
+    const uint64_t SpookyConst = 0xdeadbeefdeadbeefULL;
+
+    // Messages this long go to SpookyHash's long hash (its sc_bufSize)
+    const size_t LongLength = 192;
+
+    inline uint64_t Read64(const unsigned char *p)
+    {
+        uint64_t x;
+        std::memcpy(&x, p, sizeof(x));
+        return x;
+    }
+
+    inline uint64_t Read32(const unsigned char *p)
+    {
+        uint32_t x;
+        std::memcpy(&x, p, sizeof(x));
+        return x;
+    }
+
+    // What SpookyHash::Short() adds to c and d for the last 0..15 bytes and
+    // the length: the bytes, as two little endian words padded with zeros,
+    // and the length in the top byte of d.  We read them with loads that
+    // end at the end of the message, rather than a byte at a time.
+    inline void Tail(const unsigned char *message, size_t length,
+                     uint64_t& c, uint64_t& d)
+    {
+        const unsigned char *end = message + length;
+        size_t remainder = length % 16;
+
+        c = 0;
+        d = ((uint64_t)length) << 56;
+
+        if (remainder == 0) {
+            c += SpookyConst;
+            d += SpookyConst;
+        } else if (remainder >= 8) {
+            c = Read64(end - remainder);
+
+            if (remainder > 8)
+                d += Read64(end - 8) >> (8 * (16 - remainder));
+        } else if (length >= 8) {
+            c = Read64(end - 8) >> (8 * (8 - remainder));
+        } else if (length >= 4) {
+            c = Read32(message) |
+                ((Read32(end - 4) >> (8 * (8 - length))) << 32);
+        } else {
+            c = (uint64_t)message[0] |
+                ((uint64_t)message[length / 2] << (8 * (length / 2))) |
+                ((uint64_t)message[length - 1] << (8 * (length - 1)));
+        }
+    }
+
+    // A register's worth of lanes, and the registers we interleave, so one
+    // chain of rotates can go while the other waits on its last one.
+    //
+    // A Block is a lane's 32 bytes for one step of the hash, and a Pair is
+    // two words for a lane.  Transpose() turns a register's worth of them
+    // into a register for each word.
+    typedef __m256i Vector;
+    const int VectorLanes = 4;
+    const int NumVectors = 2;
+
+    typedef __m256i Block;
+    typedef __m128i Pair;
+
+    // The bytes of the block that are there, and zeros for the rest
+    inline Block LoadBlock(const unsigned char *p, size_t size)
+    {
+        if (size >= 32)
+            return _mm256_loadu_si256((const __m256i *)p);
+        else if (size >= 16)
+            return _mm256_inserti128_si256(_mm256_setzero_si256(),
+                       _mm_loadu_si128((const __m128i *)p), 0);
+        else
+            return _mm256_setzero_si256();
+    }
+
+    inline Pair MakePair(uint64_t x, uint64_t y)
+    {
+        return _mm_set_epi64x((long long)y, (long long)x);
+    }
+
+    inline void Transpose(const Block *blocks, Vector *words)
+    {
+        __m256i t0 = _mm256_unpacklo_epi64(blocks[0], blocks[1]);
+        __m256i t1 = _mm256_unpackhi_epi64(blocks[0], blocks[1]);
+        __m256i t2 = _mm256_unpacklo_epi64(blocks[2], blocks[3]);
+        __m256i t3 = _mm256_unpackhi_epi64(blocks[2], blocks[3]);
+
+        words[0] = _mm256_permute2x128_si256(t0, t2, 0x20);
+        words[1] = _mm256_permute2x128_si256(t1, t3, 0x20);
+        words[2] = _mm256_permute2x128_si256(t0, t2, 0x31);
+        words[3] = _mm256_permute2x128_si256(t1, t3, 0x31);
+    }
+
+    inline void Transpose(const Pair *pairs, Vector& x, Vector& y)
+    {
+        __m256i t0 = _mm256_inserti128_si256(
+                         _mm256_castsi128_si256(pairs[0]), pairs[2], 1);
+        __m256i t1 = _mm256_inserti128_si256(
+                         _mm256_castsi128_si256(pairs[1]), pairs[3], 1);
+
+        x = _mm256_unpacklo_epi64(t0, t1);
+        y = _mm256_unpackhi_epi64(t0, t1);
+    }
+
+    inline void Store(uint64_t *p, Vector v)
+    {
+        _mm256_storeu_si256((__m256i *)p, v);
+    }
+
+    inline Vector Splat(uint64_t x)
+    {
+        return _mm256_set1_epi64x((long long)x);
+    }
+
+    inline Vector Add(Vector a, Vector b) { return _mm256_add_epi64(a, b); }
+    inline Vector Xor(Vector a, Vector b) { return _mm256_xor_si256(a, b); }
+
+    template <int k>
+    inline Vector Rot(Vector x)
+    {
+#ifdef __AVX512VL__
+        return _mm256_rol_epi64(x, k);
+#else
+        return _mm256_or_si256(_mm256_slli_epi64(x, k),
+                               _mm256_srli_epi64(x, 64 - k));
+#endif
+    }
+
+    // All ones in the lanes where a > b
+    inline Vector Greater(Vector a, Vector b)
+    {
+        return _mm256_cmpgt_epi64(a, b);
+    }
+
+    // a in the lanes the mask is set in, b in the others
+    inline Vector Select(Vector mask, Vector a, Vector b)
+    {
+        return _mm256_blendv_epi8(b, a, mask);
+    }
+
+    const int Lanes = VectorLanes * NumVectors;
+
+    // One of SpookyHash's variables, for every lane
+    struct Variable
+    {
+        Vector v[NumVectors];
+    };
+
+    inline void Add(Variable& x, const Variable& y)
+    {
+        for (int i = 0; i < NumVectors; i++)
+            x.v[i] = Add(x.v[i], y.v[i]);
+    }
+
+    inline void Select(const Variable& mask, Variable& x, const Variable& old)
+    {
+        for (int i = 0; i < NumVectors; i++)
+            x.v[i] = Select(mask.v[i], x.v[i], old.v[i]);
+    }
+
+    // Two words for each lane, into a variable for each
+    inline void Transpose(const Pair *pairs, Variable& x, Variable& y)
+    {
+        for (int i = 0; i < NumVectors; i++)
+            Transpose(&pairs[i * VectorLanes], x.v[i], y.v[i]);
+    }
+
+    // x = Rot64(x, k);  x += y;  z ^= x;
+    template <int k>
+    inline void MixStep(Variable& x, const Variable& y, Variable& z)
+    {
+        for (int i = 0; i < NumVectors; i++) {
+            x.v[i] = Add(Rot<k>(x.v[i]), y.v[i]);
+            z.v[i] = Xor(z.v[i], x.v[i]);
+        }
+    }
+
+    // x ^= y;  y = Rot64(y, k);  x += y;
+    template <int k>
+    inline void EndStep(Variable& x, Variable& y)
+    {
+        for (int i = 0; i < NumVectors; i++) {
+            x.v[i] = Xor(x.v[i], y.v[i]);
+            y.v[i] = Rot<k>(y.v[i]);
+            x.v[i] = Add(x.v[i], y.v[i]);
+        }
+    }
+
+    // SpookyHash::ShortMix()
+    inline void ShortMix(Variable& h0, Variable& h1, Variable& h2,
+                         Variable& h3)
+    {
+        MixStep<50>(h2, h3, h0);
+        MixStep<52>(h3, h0, h1);
+        MixStep<30>(h0, h1, h2);
+        MixStep<41>(h1, h2, h3);
+        MixStep<54>(h2, h3, h0);
+        MixStep<48>(h3, h0, h1);
+        MixStep<38>(h0, h1, h2);
+        MixStep<37>(h1, h2, h3);
+        MixStep<62>(h2, h3, h0);
+        MixStep<34>(h3, h0, h1);
+        MixStep<5>(h0, h1, h2);
+        MixStep<36>(h1, h2, h3);
+    }
+
+    // SpookyHash::ShortEnd()
+    inline void ShortEnd(Variable& h0, Variable& h1, Variable& h2,
+                         Variable& h3)
+    {
+        EndStep<15>(h3, h2);
+        EndStep<52>(h0, h3);
+        EndStep<26>(h1, h0);
+        EndStep<51>(h2, h1);
+        EndStep<28>(h3, h2);
+        EndStep<9>(h0, h3);
+        EndStep<47>(h1, h0);
+        EndStep<54>(h2, h1);
+        EndStep<32>(h3, h2);
+        EndStep<25>(h0, h3);
+        EndStep<63>(h1, h0);
+    }
+
+    // SpookyHash::Short(), for a lane's worth of messages, all shorter
+    // than LongLength
+    void HashLanes(const void *const *messages, const size_t *lengths,
+                   uint64_t *hash1, uint64_t *hash2)
+    {
+        const unsigned char *bytes[Lanes];
+        Pair pairs[Lanes];
+
+        for (int lane = 0; lane < Lanes; lane++)
+            bytes[lane] = (const unsigned char *)messages[lane];
+
+        // Each complete set of 32 bytes is a step, and so are the 16+
+        // bytes after them, if there are that many; they go through the
+        // same mix, just with nothing to add to a and b after.
+        size_t minSteps = LongLength;
+        size_t maxSteps = 0;
+
+        for (int lane = 0; lane < Lanes; lane++) {
+            uint64_t steps = (lengths[lane] + 16) / 32;
+            minSteps = std::min(minSteps, (size_t)steps);
+            maxSteps = std::max(maxSteps, (size_t)steps);
+
+            // in both halves, for Greater()
+            pairs[lane] = MakePair(steps | (steps << 32), 0);
+        }
+
+        Variable laneSteps, unused;
+        Transpose(pairs, laneSteps, unused);
+
+        for (int lane = 0; lane < Lanes; lane++)
+            pairs[lane] = MakePair(hash1[lane], hash2[lane]);
+
+        Variable a, b, c, d;
+        Transpose(pairs, a, b);
+
+        for (int i = 0; i < NumVectors; i++)
+            c.v[i] = d.v[i] = Splat(SpookyConst);
+
+        // Once the shortest message runs out, the lanes that are out keep
+        // what they had.
+        for (size_t step = 0; step < maxSteps; step++) {
+            Block blocks[Lanes];
+
+            for (int lane = 0; lane < Lanes; lane++) {
+                size_t done = std::min(lengths[lane], step * 32);
+                blocks[lane] = LoadBlock(bytes[lane] + done,
+                                         lengths[lane] - done);
+            }
+
+            Variable words[4];
+
+            for (int i = 0; i < NumVectors; i++) {
+                Vector transposed[4];
+                Transpose(&blocks[i * VectorLanes], transposed);
+
+                for (int w = 0; w < 4; w++)
+                    words[w].v[i] = transposed[w];
+            }
+
+            Variable oldA = a, oldB = b, oldC = c, oldD = d;
+
+            Add(c, words[0]);
+            Add(d, words[1]);
+            ShortMix(a, b, c, d);
+            Add(a, words[2]);
+            Add(b, words[3]);
+
+            if (step >= minSteps) {
+                Variable mask;
+                Vector current = Splat(step | ((uint64_t)step << 32));
+
+                for (int i = 0; i < NumVectors; i++)
+                    mask.v[i] = Greater(laneSteps.v[i], current);
+
+                Select(mask, a, oldA);
+                Select(mask, b, oldB);
+                Select(mask, c, oldC);
+                Select(mask, d, oldD);
+            }
+        }
+
+        // The last 0..15 bytes, and the length
+        for (int lane = 0; lane < Lanes; lane++) {
+            uint64_t tailC, tailD;
+            Tail(bytes[lane], lengths[lane], tailC, tailD);
+            pairs[lane] = MakePair(tailC, tailD);
+        }
+
+        Variable tailC, tailD;
+        Transpose(pairs, tailC, tailD);
+
+        Add(c, tailC);
+        Add(d, tailD);
+        ShortEnd(a, b, c, d);
+
+        for (int i = 0; i < NumVectors; i++) {
+            Store(&hash1[i * VectorLanes], a.v[i]);
+            Store(&hash2[i * VectorLanes], b.v[i]);
+        }
+    }
+}
+#endif
+
+
+void SpookyHash128Batch(const void *const *messages, const size_t *lengths,
+                        size_t count, uint64_t *hash1, uint64_t *hash2)
+{
+#ifdef __AVX2__
+    // The short messages we've put aside so far, and where they came from
+    const void *laneMessages[Lanes];
+    size_t laneLengths[Lanes];
+    uint64_t laneHash1[Lanes];
+    uint64_t laneHash2[Lanes];
+    size_t laneIndex[Lanes];
+    int numLanes = 0;
+
+    size_t i = 0;
+
+    while (i < count || numLanes > 0) {
+        // A lane's worth of short messages in a row, which is the usual
+        // thing, gets hashed where it is
+        if (numLanes == 0 && i + Lanes <= count) {
+            bool allShort = true;
+
+            for (int lane = 0; lane < Lanes; lane++)
+                allShort = allShort && lengths[i + lane] < LongLength;
+
+            if (allShort) {
+                HashLanes(&messages[i], &lengths[i], &hash1[i], &hash2[i]);
+                i += Lanes;
+                continue;
+            }
+        }
+
+        if (i < count) {
+            if (lengths[i] >= LongLength) {
+                SpookyHash::Hash128(messages[i], lengths[i],
+                                    &hash1[i], &hash2[i]);
+            } else {
+                laneMessages[numLanes] = messages[i];
+                laneLengths[numLanes] = lengths[i];
+                laneHash1[numLanes] = hash1[i];
+                laneHash2[numLanes] = hash2[i];
+                laneIndex[numLanes] = i;
+                numLanes++;
+            }
+
+            i++;
+
+            if (numLanes < Lanes && i < count)
+                continue;
+        }
+
+        if (numLanes == 0)
+            continue;
+
+        // Empty messages in whatever lanes we didn't fill
+        for (int lane = numLanes; lane < Lanes; lane++) {
+            laneMessages[lane] = nullptr;
+            laneLengths[lane] = 0;
+            laneHash1[lane] = laneHash2[lane] = 0;
+        }
+
+        HashLanes(laneMessages, laneLengths, laneHash1, laneHash2);
+
+        for (int lane = 0; lane < numLanes; lane++) {
+            hash1[laneIndex[lane]] = laneHash1[lane];
+            hash2[laneIndex[lane]] = laneHash2[lane];
+        }
+
+        numLanes = 0;
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+        SpookyHash::Hash128(messages[i], lengths[i], &hash1[i], &hash2[i]);
+#endif
+}
+
+
+void SpookyHash64Batch(const void *const *messages, const size_t *lengths,
+                       size_t count, uint64_t seed, uint64_t *hashes)
+{
+    // A batch at a time, so the second half of the seeds can live on the
+    // stack
+    const size_t BatchSize = 256;
+    uint64_t seeds[BatchSize];
+
+    for (size_t first = 0; first < count; first += BatchSize) {
+        size_t n = std::min(BatchSize, count - first);
+
+        std::fill(hashes + first, hashes + first + n, seed);
+        std::fill(seeds, seeds + n, seed);
+
+        SpookyHash128Batch(messages + first, lengths + first, n,
+                           hashes + first, seeds);
+    }
+}
+
+
+size_t SpookyBatchLanes()
+{
+#ifdef __AVX2__
+    return Lanes;
+#else
+    return 1;
+#endif
+}
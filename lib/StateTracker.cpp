@@ -0,0 +1,93 @@
+//============================================================================
+// Name        : StateTracker.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Skips the GL binds that wouldn't change anything.
+//============================================================================
+
+#include "StateTracker.hpp"
+
+const GLuint StateTracker::MaxTextureUnits;
+const GLuint StateTracker::Unknown;
+
+
+void StateTracker::UseProgram(GLuint program)
+{
+    if (this->program == program) {
+        skippedBinds++;
+        return;
+    }
+
+    glUseProgram(program);
+    this->program = program;
+    binds++;
+}
+
+
+void StateTracker::BindVertexArray(GLuint vertexArray)
+{
+    if (this->vertexArray == vertexArray) {
+        skippedBinds++;
+        return;
+    }
+
+    glBindVertexArray(vertexArray);
+    this->vertexArray = vertexArray;
+    binds++;
+}
+
+
+void StateTracker::BindTexture(GLuint unit, GLuint texture)
+{
+    if (unit < MaxTextureUnits && textures[unit] == texture) {
+        skippedBinds++;
+        return;
+    }
+
+    ActiveTexture(unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    binds++;
+
+    if (unit < MaxTextureUnits)
+        textures[unit] = texture;
+}
+
+
+// Samplers get bound by unit number, without the active texture
+void StateTracker::BindSampler(GLuint unit, GLuint sampler)
+{
+    if (unit < MaxTextureUnits && samplers[unit] == sampler) {
+        skippedBinds++;
+        return;
+    }
+
+    glBindSampler(unit, sampler);
+    binds++;
+
+    if (unit < MaxTextureUnits)
+        samplers[unit] = sampler;
+}
+
+
+void StateTracker::Invalidate()
+{
+    program = Unknown;
+    vertexArray = Unknown;
+    activeUnit = Unknown;
+
+    for (GLuint unit = 0; unit < MaxTextureUnits; unit++) {
+        textures[unit] = Unknown;
+        samplers[unit] = Unknown;
+    }
+}
+
+
+void StateTracker::ActiveTexture(GLuint unit)
+{
+    if (activeUnit == unit)
+        return;
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+}
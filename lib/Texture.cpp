@@ -24,6 +24,8 @@
 // Simple OpenGL Image Library
 #include <iostream>
 #include <map>
+#include <vector>
+#include <algorithm>
 
 // this is just to make printing stuff a bit more concise
 // everything else in std, we can call explicitly
@@ -32,12 +34,23 @@ using std::cin;
 using std::endl;
 
 #include "Texture.hpp"
+#include "PixelConvert.hpp"
+#include "MipmapGenerator.hpp"
+#include "ImageDecoder.hpp"
+#include "MappedFile.hpp"
+
+const MipmapGenerator *Texture::mipmapGenerator = nullptr;
+const ImageDecoder *Texture::imageDecoder = nullptr;
 
 
 Texture::Texture(const char *imagePath)
 {
+    // JPEGs and PNGs we decode ourselves, straight out of the file
+    MappedFile file;
+    if (file.Open(imagePath) && BuildEncoded(file.Data(), file.Size()))
+        return;
+
     // Load and generate the texture
-    GLenum err = GL_NO_ERROR;
     int width = 0;
     int height = 0;
 
@@ -45,64 +58,205 @@ Texture::Texture(const char *imagePath)
     if (image == nullptr)
         return;
 
-    GLuint texture = GenTexture();
-    if (texture == 0) {
-        SOIL_free_image_data(image);
+    Build(image, width, height);
+}
+
+
+Texture::Texture(const AssetPack& pack, const char *imagePath)
+{
+    AssetSpan file = pack.Find(imagePath);
+    if (!file.empty() && BuildEncoded(file.data, file.size))
+        return;
+
+    int width = 0;
+    int height = 0;
+
+    unsigned char *image = ReadAsset(pack, imagePath, width, height);
+    if (image == nullptr)
+        return;
+
+    Build(image, width, height);
+}
+
+
+Texture::Texture(Texture&& other)
+    : ID(other.ID), texture(std::move(other.texture))
+{
+    other.ID = 0;
+}
+
+
+Texture& Texture::operator=(Texture&& other)
+{
+    if (this != &other) {
+        ID = other.ID;
+        texture = std::move(other.texture);
+
+        other.ID = 0;
+    }
+
+    return *this;
+}
+
+
+bool Texture::BuildEncoded(const unsigned char *data, size_t size)
+{
+    if (ImageDecoder::Identify(data, size) == ImageDecoder::Unknown)
+        return false;
+
+    const ImageDecoder& decoder = Decoder();
 
+    // Decoded right into the 4 byte layout the driver wants
+    ImageDecoder::Image image;
+
+    // SOIL gets a try at it after us
+    if (!decoder.Decode(data, size, DecodeLayout(), image)) {
+        cout << "ERROR::TEXTURE::DECODE_FAILED" << endl;
+        return false;
+    }
+
+    Upload(image.pixels.data(), image.width, image.height);
+    decoder.Release(image);
+
+    return true;
+}
+
+
+// Generate the texture from an image loaded by SOIL.  We take care of
+// freeing the image.
+void Texture::Build(unsigned char *image, int width, int height)
+{
+    const UploadFormat& upload = PreferredFormat();
+
+    // Expand the pixels to the 4 byte layout the driver wants, so it can
+    // copy them as they are.  We're done with the decoded image after.
+    std::vector<unsigned char> pixels((size_t)width * height * 4);
+
+    if (upload.format == GL_BGRA)
+        ConvertRGBToBGRA(image, pixels.data(), (size_t)width * height);
+    else
+        ConvertRGBToRGBA(image, pixels.data(), (size_t)width * height);
+
+    SOIL_free_image_data(image);
+
+    Upload(pixels.data(), width, height);
+}
+
+
+// Generate the texture from 4 byte pixels, in the layout PreferredFormat()
+// gives.  If anything goes wrong, the new texture gets deleted on the way
+// out, and we keep the one we had.
+void Texture::Upload(const unsigned char *pixels, int width, int height)
+{
+    GLenum err = GL_NO_ERROR;
+
+    const UploadFormat& upload = PreferredFormat();
+
+    GLTexture newTexture = GLTexture::Create();
+    if (!newTexture) {
+        cout << "Failed to generate texture!!" << endl;
         return;
     }
 
-    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindTexture(GL_TEXTURE_2D, newTexture.ID());
 
     if (SetPixelStorageModes() != GL_NO_ERROR) {
-        // cleanup our local texture objects
-        SOIL_free_image_data(image);
         glBindTexture(GL_TEXTURE_2D, 0);
-
         return;
     }
 
 
     if (SetTextureWrappingModes() != GL_NO_ERROR) {
-        // cleanup our local texture objects
-        SOIL_free_image_data(image);
         glBindTexture(GL_TEXTURE_2D, 0);
-
         return;
     }
 
-    // Generate the texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height,
-                 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+    // Generate the texture.  If we can, we allocate all of its mip levels
+    // up front, and the driver never has to wonder if we'll change them.
+    if (GLEW_ARB_texture_storage) {
+        glTexStorage2D(GL_TEXTURE_2D, MipLevels(width, height),
+                       upload.internalFormat, width, height);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                        upload.format, upload.type, pixels);
+    }
+    else {
+        glTexImage2D(GL_TEXTURE_2D, 0, upload.internalFormat, width, height,
+                     0, upload.format, upload.type, pixels);
+    }
+
     if ((err = glGetError()) != GL_NO_ERROR) {
         cout << "glTexImage2D(): error: " << err << endl;
 
         // cleanup our local texture objects
-        SOIL_free_image_data(image);
         glBindTexture(GL_TEXTURE_2D, 0);
 
         return;
     }
 
-    glGenerateMipmap(GL_TEXTURE_2D);
+    if (mipmapGenerator != nullptr) {
+        std::vector<MipmapGenerator::Level> levels =
+            mipmapGenerator->Generate(pixels, width, height);
+
+        for (size_t i = 0; i < levels.size(); i++) {
+            const MipmapGenerator::Level& level = levels[i];
+
+            if (GLEW_ARB_texture_storage) {
+                glTexSubImage2D(GL_TEXTURE_2D, (GLint)i + 1, 0, 0,
+                                level.width, level.height,
+                                upload.format, upload.type,
+                                level.pixels.data());
+            }
+            else {
+                glTexImage2D(GL_TEXTURE_2D, (GLint)i + 1,
+                             upload.internalFormat,
+                             level.width, level.height, 0,
+                             upload.format, upload.type,
+                             level.pixels.data());
+            }
+        }
+    }
+    else {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
     if ((err = glGetError()) != GL_NO_ERROR) {
-        cout << "glGenerateMipmap(): error: " << err << endl;
+        cout << "Mipmap generation: error: " << err << endl;
 
         // cleanup our local texture objects
-        SOIL_free_image_data(image);
         glBindTexture(GL_TEXTURE_2D, 0);
 
         return;
     }
 
-    this->ID = texture;
+    this->texture = std::move(newTexture);
+    this->ID = this->texture.ID();
 
-    // cleanup our local texture objects
-    SOIL_free_image_data(image);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 
+bool Texture::Replace(unsigned char *image, int width, int height)
+{
+    GLuint oldTexture = this->ID;
+
+    // Build() only takes over a new texture if it works out, and the
+    // old one gets deleted then.
+    Build(image, width, height);
+
+    return this->ID != oldTexture;
+}
+
+
+bool Texture::Replace(const ImageDecoder::Image& image)
+{
+    GLuint oldTexture = this->ID;
+
+    Upload(image.pixels.data(), image.width, image.height);
+
+    return this->ID != oldTexture;
+}
+
+
 unsigned char *Texture::ReadFile(const char *path,
                                  int &width, int &height)
 {
@@ -118,6 +272,29 @@ unsigned char *Texture::ReadFile(const char *path,
 }
 
 
+unsigned char *Texture::ReadAsset(const AssetPack& pack, const char *path,
+                                  int &width, int &height)
+{
+    AssetSpan file = pack.Find(path);
+    if (file.empty()) {
+        cout << "No image asset!!" << endl
+             << "\tAsset Path: " << path << endl;
+        return nullptr;
+    }
+
+    unsigned char *image = SOIL_load_image_from_memory(file.data,
+                                                       (int)file.size,
+                                                       &width, &height,
+                                                       0, SOIL_LOAD_RGB);
+    if (image == nullptr) {
+        cout << "No loaded image!!" << endl
+             << "libSOIL result: " << SOIL_last_result() << endl;
+    }
+
+    return image;
+}
+
+
 GLuint Texture::GenTexture()
 {
     GLenum err;
@@ -136,6 +313,92 @@ GLuint Texture::GenTexture()
 }
 
 
+void Texture::SetMipmapGenerator(const MipmapGenerator *generator)
+{
+    mipmapGenerator = generator;
+}
+
+
+void Texture::SetImageDecoder(const ImageDecoder *decoder)
+{
+    imageDecoder = decoder;
+}
+
+
+const ImageDecoder& Texture::Decoder()
+{
+    static const ImageDecoder serialDecoder;
+
+    return (imageDecoder != nullptr) ? *imageDecoder : serialDecoder;
+}
+
+
+ImageDecoder::Layout Texture::DecodeLayout()
+{
+    return (PreferredFormat().format == GL_BGRA) ? ImageDecoder::BGRA
+                                                 : ImageDecoder::RGBA;
+}
+
+
+// The levels in a full mip chain, down to 1x1
+GLsizei Texture::MipLevels(int width, int height)
+{
+    int size = std::max(width, height);
+    GLsizei levels = 1;
+
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+
+    return levels;
+}
+
+
+// RGBA8 is what we store, but the driver may have a better idea, and may
+// want the pixels handed to it in BGRA order.  Without a way to ask, BGRA
+// is the layout most hardware keeps its texels in.
+const Texture::UploadFormat& Texture::PreferredFormat()
+{
+    static UploadFormat preferred = QueryPreferredFormat();
+    return preferred;
+}
+
+
+Texture::UploadFormat Texture::QueryPreferredFormat()
+{
+    UploadFormat upload = { GL_RGBA8, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV };
+
+    if (!GLEW_ARB_internalformat_query2)
+        return upload;
+
+    GLint value = 0;
+
+    glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8,
+                          GL_INTERNALFORMAT_PREFERRED, 1, &value);
+    if (value != 0)
+        upload.internalFormat = (GLenum)value;
+
+    // We can only make the 4 byte layouts
+    value = 0;
+    glGetInternalformativ(GL_TEXTURE_2D, upload.internalFormat,
+                          GL_TEXTURE_IMAGE_FORMAT, 1, &value);
+    if (value == GL_RGBA || value == GL_BGRA)
+        upload.format = (GLenum)value;
+
+    value = 0;
+    glGetInternalformativ(GL_TEXTURE_2D, upload.internalFormat,
+                          GL_TEXTURE_IMAGE_TYPE, 1, &value);
+    if (value == GL_UNSIGNED_BYTE || value == GL_UNSIGNED_INT_8_8_8_8_REV)
+        upload.type = (GLenum)value;
+
+    // Asking about formats can leave an error behind on some drivers
+    glGetError();
+
+    return upload;
+}
+
+
 GLenum Texture::SetPixelStorageModes()
 {
     GLenum err;
@@ -147,7 +410,7 @@ GLenum Texture::SetPixelStorageModes()
             {GL_UNPACK_ROW_LENGTH, 0},  // tightly packed
             {GL_UNPACK_SKIP_PIXELS, 0},  // tightly packed
             {GL_UNPACK_SKIP_ROWS, 0},  // tightly packed
-            {GL_UNPACK_ALIGNMENT, 1},  // tightly aligned
+            {GL_UNPACK_ALIGNMENT, 4},  // our pixels are 4 bytes
     };
 
     for (auto param : pstorei_params) {
@@ -170,24 +433,20 @@ GLenum Texture::SetPixelStorageModes()
 }
 
 
-GLenum Texture::SetTextureWrappingModes()
+GLenum Texture::SetTextureWrappingModes(const SamplerState& state)
 {
     GLenum err;
 
     // Set the texture wrapping/filtering options (on the currently bound
-    // texture object)
-    // Note: We will want to make these configurable in the future
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-    // Required if we are clamping to border
-    float borderColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                    GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
-                    GL_LINEAR);
+    // texture object).  These are only the defaults, a sampler bound to
+    // the same texture unit overrides all of them.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, state.wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, state.wrapT);
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR,
+                     state.borderColor);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, state.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, state.magFilter);
 
     // we might want to check for errors after each parameter setting
     if ((err = glGetError()) != GL_NO_ERROR)
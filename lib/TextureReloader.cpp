@@ -0,0 +1,142 @@
+//============================================================================
+// Name        : TextureReloader.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Reloads our textures when their image files change.  The
+//               images get decoded off of the render thread, and swapped in
+//               at the start of a frame.
+//============================================================================
+
+#include <iostream>
+#include <chrono>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "TextureReloader.hpp"
+#include "MappedFile.hpp"
+#include "PixelConvert.hpp"
+
+
+TextureReloader::~TextureReloader()
+{
+    // The decodes can't be cancelled, so we wait and throw them away
+    for (PendingImage& image : pending) {
+        DecodedImage decoded = image.decoded.get();
+        image.decoder->Release(decoded.image);
+    }
+}
+
+
+bool TextureReloader::Watch(Texture& texture, const std::string& imagePath)
+{
+    if (textures.count(imagePath) != 0) {
+        cout << "TextureReloader: " << imagePath
+             << " is already being watched" << endl;
+        return false;
+    }
+
+    if (!watcher.Watch(imagePath))
+        return false;
+
+    textures[imagePath] = &texture;
+
+    return true;
+}
+
+
+bool TextureReloader::Update()
+{
+    bool replaced = false;
+
+    if (watcher.HasChanges()) {
+        // The layout has to be asked for here, with the context
+        const ImageDecoder *decoder = &Texture::Decoder();
+        ImageDecoder::Layout layout = Texture::DecodeLayout();
+
+        for (const std::string& path : watcher.TakeChanges()) {
+            PendingImage image;
+            image.path = path;
+            image.decoder = decoder;
+            image.decoded = std::async(std::launch::async,
+                                       &TextureReloader::Decode, path,
+                                       decoder, layout);
+
+            pending.push_back(std::move(image));
+        }
+    }
+
+    // Swap in whatever is done.  The rest can wait for the next frame.
+    for (auto image = pending.begin(); image != pending.end(); ) {
+        if (image->decoded.wait_for(std::chrono::seconds(0)) !=
+                std::future_status::ready)
+        {
+            ++image;
+            continue;
+        }
+
+        DecodedImage decoded = image->decoded.get();
+
+        bool reloaded = decoded.decoded &&
+                        textures[image->path]->Replace(decoded.image);
+        image->decoder->Release(decoded.image);
+
+        if (!reloaded) {
+            cout << "TextureReloader: could not reload " << image->path
+                 << ", keeping the old texture" << endl;
+        }
+        else {
+            cout << "TextureReloader: reloaded " << image->path << endl;
+            replaced = true;
+        }
+
+        image = pending.erase(image);
+    }
+
+    return replaced;
+}
+
+
+TextureReloader::DecodedImage TextureReloader::Decode(
+    const std::string& path, const ImageDecoder *decoder,
+    ImageDecoder::Layout layout)
+{
+    DecodedImage decoded;
+
+    // JPEGs and PNGs the way Texture loads them, straight out of the file
+    MappedFile file;
+    if (file.Open(path) &&
+            ImageDecoder::Identify(file.Data(), file.Size()) !=
+                ImageDecoder::Unknown) {
+        decoded.decoded = decoder->Decode(file.Data(), file.Size(), layout,
+                                          decoded.image);
+        if (decoded.decoded)
+            return decoded;
+    }
+
+    // Anything else goes through SOIL, and gets expanded to our layout
+    int width = 0;
+    int height = 0;
+    unsigned char *image = SOIL_load_image(path.c_str(), &width, &height,
+                                           0, SOIL_LOAD_RGB);
+    if (image == nullptr)
+        return decoded;
+
+    size_t numPixels = (size_t)width * height;
+    decoded.image.width = width;
+    decoded.image.height = height;
+    decoded.image.pixels.resize(numPixels * 4);
+
+    if (layout == ImageDecoder::BGRA)
+        ConvertRGBToBGRA(image, decoded.image.pixels.data(), numPixels);
+    else
+        ConvertRGBToRGBA(image, decoded.image.pixels.data(), numPixels);
+
+    SOIL_free_image_data(image);
+
+    decoded.decoded = true;
+    return decoded;
+}
@@ -0,0 +1,429 @@
+//============================================================================
+// Name        : TextureStreamer.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Keeps the mip levels our textures need on the GPU, within
+//               a memory budget.
+//============================================================================
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include <SOIL/SOIL.h>
+
+#include "TextureStreamer.hpp"
+#include "Texture.hpp"
+#include "GLObject.hpp"
+#include "PixelConvert.hpp"
+#include "ImageDecoder.hpp"
+#include "MappedFile.hpp"
+
+using Eigen::Vector4f;
+
+const StreamedTexture TextureStreamer::None;
+const int TextureStreamer::MinResidentSize;
+
+
+TextureStreamer::TextureStreamer(TextureBackend& backend, size_t budgetBytes,
+                                 const MipmapGenerator& generator)
+    : backend(backend), generator(generator), budget(budgetBytes)
+{
+}
+
+
+TextureStreamer::~TextureStreamer()
+{
+    for (Entry& entry : textures) {
+        if (entry.id != 0)
+            backend.Destroy(entry.id);
+    }
+}
+
+
+StreamedTexture TextureStreamer::Add(const unsigned char *pixels,
+                                     int width, int height)
+{
+    Entry entry;
+
+    MipmapGenerator::Level base;
+    base.width = width;
+    base.height = height;
+    base.pixels.assign(pixels, pixels + (size_t)width * height * 4);
+
+    entry.levels.push_back(std::move(base));
+
+    std::vector<MipmapGenerator::Level> mips =
+        generator.Generate(pixels, width, height);
+
+    for (MipmapGenerator::Level& level : mips)
+        entry.levels.push_back(std::move(level));
+
+    // Nothing's resident yet
+    entry.resident = (int)entry.levels.size();
+
+    entry.tail = (int)entry.levels.size() - 1;
+    for (int level = 0; level < (int)entry.levels.size(); level++) {
+        const MipmapGenerator::Level& mip = entry.levels[level];
+
+        if (std::max(mip.width, mip.height) <= MinResidentSize) {
+            entry.tail = level;
+            break;
+        }
+    }
+
+    entry.requested = entry.tail;
+
+    MakeResident(entry, entry.tail);
+
+    textures.push_back(std::move(entry));
+    return (StreamedTexture)(textures.size() - 1);
+}
+
+
+StreamedTexture TextureStreamer::Load(const char *imagePath)
+{
+    ImageDecoder::Layout layout = backend.WantsBGRA() ? ImageDecoder::BGRA
+                                                      : ImageDecoder::RGBA;
+
+    // JPEGs and PNGs go through the same decoder as Texture, straight
+    // into the layout we keep
+    MappedFile file;
+    if (file.Open(imagePath) &&
+            ImageDecoder::Identify(file.Data(), file.Size()) !=
+                ImageDecoder::Unknown) {
+        const ImageDecoder& decoder = Texture::Decoder();
+        ImageDecoder::Image image;
+
+        if (decoder.Decode(file.Data(), file.Size(), layout, image)) {
+            StreamedTexture texture = Add(image.pixels.data(),
+                                          image.width, image.height);
+            decoder.Release(image);
+            return texture;
+        }
+    }
+
+    int width = 0;
+    int height = 0;
+
+    unsigned char *image = SOIL_load_image(imagePath, &width, &height,
+                                           0, SOIL_LOAD_RGB);
+    if (image == nullptr) {
+        cout << "No loaded image!!" << endl
+             << "libSOIL result: " << SOIL_last_result() << endl;
+        return None;
+    }
+
+    std::vector<unsigned char> pixels((size_t)width * height * 4);
+
+    if (layout == ImageDecoder::BGRA)
+        ConvertRGBToBGRA(image, pixels.data(), (size_t)width * height);
+    else
+        ConvertRGBToRGBA(image, pixels.data(), (size_t)width * height);
+
+    SOIL_free_image_data(image);
+
+    return Add(pixels.data(), width, height);
+}
+
+
+GLuint TextureStreamer::ID(StreamedTexture texture) const
+{
+    return textures[texture].id;
+}
+
+
+int TextureStreamer::ResidentLevel(StreamedTexture texture) const
+{
+    return textures[texture].resident;
+}
+
+
+int TextureStreamer::NumLevels(StreamedTexture texture) const
+{
+    return (int)textures[texture].levels.size();
+}
+
+
+void TextureStreamer::Request(StreamedTexture texture, int level)
+{
+    Entry& entry = textures[texture];
+
+    level = std::min(std::max(level, 0), entry.tail);
+
+    if (entry.lastUsed != frame || level < entry.requested)
+        entry.requested = level;
+
+    entry.lastUsed = frame;
+
+    if (level < entry.resident)
+        stats.misses++;
+}
+
+
+void TextureStreamer::Request(StreamedTexture texture,
+                              const Matrix4f& view,
+                              const Matrix4f& projection,
+                              const Vector3f& center, float radius,
+                              float viewportHeight)
+{
+    const Entry& entry = textures[texture];
+
+    Vector4f position = view * Vector4f(center.x(), center.y(), center.z(),
+                                        1.0f);
+    float distance = -position.z();
+
+    // Behind us, it needs no detail at all
+    if (distance < -radius) {
+        Request(texture, entry.tail);
+        return;
+    }
+
+    // If we're inside of it, it's as big as it gets
+    if (distance <= radius) {
+        Request(texture, 0);
+        return;
+    }
+
+    // The projection scales y by cot(fov / 2), which maps to half of
+    // the viewport's height.
+    float screenPixels = radius * projection(1, 1) * viewportHeight /
+                         distance;
+
+    Request(texture, LevelForScreenSize(entry.levels[0].width,
+                                        entry.levels[0].height,
+                                        screenPixels));
+}
+
+
+void TextureStreamer::Request(StreamedTexture texture, Camera& camera,
+                              const Vector3f& center, float radius,
+                              float viewportHeight)
+{
+    Request(texture, camera.View(), camera.Projection(),
+            center, radius, viewportHeight);
+}
+
+
+int TextureStreamer::LevelForScreenSize(int width, int height,
+                                        float screenPixels)
+{
+    float texels = (float)std::max(width, height);
+
+    if (screenPixels >= texels)
+        return 0;
+    if (screenPixels < 1.0f)
+        screenPixels = 1.0f;
+
+    return (int)std::floor(std::log2(texels / screenPixels));
+}
+
+
+void TextureStreamer::Update()
+{
+    // Work out the finest level every texture gets this frame, and then
+    // make them so.
+    std::vector<int> target(textures.size());
+    std::vector<StreamedTexture> wanted;
+    std::vector<StreamedTexture> victims;
+
+    size_t planned = stats.bytesResident;
+    stats.bytesRequested = 0;
+
+    for (size_t i = 0; i < textures.size(); i++) {
+        const Entry& entry = textures[i];
+
+        target[i] = entry.resident;
+
+        if (entry.lastUsed == frame) {
+            stats.bytesRequested += Bytes(entry, entry.requested);
+
+            if (entry.requested < entry.resident)
+                wanted.push_back((StreamedTexture)i);
+        }
+
+        if (entry.resident < entry.tail)
+            victims.push_back((StreamedTexture)i);
+    }
+
+    // The textures missing the most levels get theirs first
+    std::sort(wanted.begin(), wanted.end(),
+              [this](StreamedTexture a, StreamedTexture b) {
+                  const Entry& ea = textures[a];
+                  const Entry& eb = textures[b];
+                  return ea.resident - ea.requested >
+                         eb.resident - eb.requested;
+              });
+
+    // and the ones that were used the longest time ago give theirs up
+    std::sort(victims.begin(), victims.end(),
+              [this](StreamedTexture a, StreamedTexture b) {
+                  return textures[a].lastUsed < textures[b].lastUsed;
+              });
+
+    size_t victim = 0;
+
+    // Drop levels, finest first, until 'needed' more bytes fit.  We don't
+    // take anything a texture needs for this frame.
+    auto makeRoom = [&](size_t needed) {
+        while (planned + needed > budget && victim < victims.size()) {
+            StreamedTexture v = victims[victim];
+            const Entry& entry = textures[v];
+
+            int keep = (entry.lastUsed == frame) ? entry.requested
+                                                 : entry.tail;
+
+            if (target[v] >= keep) {
+                victim++;
+                continue;
+            }
+
+            planned -= entry.levels[target[v]].pixels.size();
+            target[v]++;
+        }
+    };
+
+    // in case the budget went down
+    makeRoom(0);
+
+    for (StreamedTexture w : wanted) {
+        const Entry& entry = textures[w];
+
+        size_t have = Bytes(entry, target[w]);
+        makeRoom(Bytes(entry, entry.requested) - have);
+
+        // If it still doesn't fit, get as close as we can
+        int level = entry.requested;
+        while (level < target[w] &&
+                planned + Bytes(entry, level) - have > budget)
+        {
+            level++;
+        }
+
+        planned += Bytes(entry, level) - have;
+        target[w] = level;
+    }
+
+    for (size_t i = 0; i < textures.size(); i++) {
+        if (target[i] != textures[i].resident)
+            MakeResident(textures[i], target[i]);
+    }
+
+    frame++;
+}
+
+
+size_t TextureStreamer::Bytes(const Entry& entry, int level)
+{
+    size_t bytes = 0;
+
+    for (size_t i = level; i < entry.levels.size(); i++)
+        bytes += entry.levels[i].pixels.size();
+
+    return bytes;
+}
+
+
+// There is no taking levels off of a texture, or adding them, so we make
+// a new one with the levels we want.  If that fails, we keep the old one.
+void TextureStreamer::MakeResident(Entry& entry, int level)
+{
+    int numLevels = (int)entry.levels.size() - level;
+    const MipmapGenerator::Level& first = entry.levels[level];
+
+    GLuint id = backend.Create(first.width, first.height, numLevels);
+    if (id == 0)
+        return;
+
+    for (int i = 0; i < numLevels; i++) {
+        const MipmapGenerator::Level& mip = entry.levels[level + i];
+
+        backend.Upload(id, i, mip.width, mip.height, mip.pixels.data());
+        stats.bytesUploaded += mip.pixels.size();
+    }
+
+    if (entry.id != 0)
+        backend.Destroy(entry.id);
+    else
+        stats.texturesResident++;
+
+    if (level > entry.resident)
+        stats.evictions += level - entry.resident;
+
+    stats.bytesResident -= Bytes(entry, entry.resident);
+    stats.bytesResident += Bytes(entry, level);
+
+    entry.id = id;
+    entry.resident = level;
+}
+
+
+//
+// GLTextureBackend
+//
+
+bool GLTextureBackend::WantsBGRA() const
+{
+    return Texture::PreferredFormat().format == GL_BGRA;
+}
+
+
+GLuint GLTextureBackend::Create(int width, int height, int numLevels)
+{
+    GLenum err;
+    const Texture::UploadFormat& upload = Texture::PreferredFormat();
+
+    GLuint texture = GLNamePool::Get(GLNamePool::Textures).Allocate();
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    if (GLEW_ARB_texture_storage) {
+        glTexStorage2D(GL_TEXTURE_2D, numLevels, upload.internalFormat,
+                       width, height);
+    }
+    else {
+        for (int level = 0; level < numLevels; level++) {
+            glTexImage2D(GL_TEXTURE_2D, level, upload.internalFormat,
+                         std::max(width >> level, 1),
+                         std::max(height >> level, 1),
+                         0, upload.format, upload.type, nullptr);
+        }
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if ((err = glGetError()) != GL_NO_ERROR) {
+        cout << "GLTextureBackend::Create(): error: " << err << endl;
+        glDeleteTextures(1, &texture);
+        return 0;
+    }
+
+    return texture;
+}
+
+
+void GLTextureBackend::Upload(GLuint texture, int level,
+                              int width, int height,
+                              const unsigned char *pixels)
+{
+    const Texture::UploadFormat& upload = Texture::PreferredFormat();
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height,
+                    upload.format, upload.type, pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+void GLTextureBackend::Destroy(GLuint texture)
+{
+    glDeleteTextures(1, &texture);
+}
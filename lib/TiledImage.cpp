@@ -0,0 +1,460 @@
+//============================================================================
+// Name        : TiledImage.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Streams the visible tiles of a huge image onto the GPU.
+//============================================================================
+
+#include <iostream>
+#include <algorithm>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "TiledImage.hpp"
+#include "Texture.hpp"
+#include "PixelConvert.hpp"
+
+using Eigen::Vector4f;
+
+const size_t TiledImage::DefaultMaxResident;
+const int TiledImage::DefaultUploadsPerFrame;
+const int TiledImage::NumBuffers;
+
+
+TiledImage::TiledImage(size_t maxResident, int uploadsPerFrame)
+    : maxResident(maxResident), uploadsPerFrame(uploadsPerFrame)
+{
+}
+
+
+TiledImage::~TiledImage()
+{
+    Close();
+}
+
+
+bool TiledImage::Open(const std::string& path)
+{
+    Close();
+
+    if (!file.Open(path))
+        return false;
+
+    bgra = Texture::PreferredFormat().format == GL_BGRA;
+
+    size_t tileBytes = (size_t)file.TileSize() * file.TileSize() * 4;
+
+    buffers.resize(NumBuffers);
+    for (int i = 0; i < NumBuffers; i++) {
+        buffers[i].resize(tileBytes);
+        freeBuffers.push_back(i);
+    }
+
+    stopping = false;
+    thread = std::thread(&TiledImage::ReadLoop, this);
+
+    return true;
+}
+
+
+void TiledImage::Close()
+{
+    if (thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+        thread.join();
+    }
+
+    requests.clear();
+    busy.clear();
+    finished.clear();
+    freeBuffers.clear();
+    buffers.clear();
+
+    resident.clear();
+    missing.clear();
+    drawList.clear();
+    stats.tilesResident = 0;
+
+    file.Close();
+}
+
+
+size_t TiledImage::BufferBytes() const
+{
+    size_t bytes = 0;
+
+    for (const std::vector<unsigned char>& buffer : buffers)
+        bytes += buffer.capacity();
+
+    return bytes;
+}
+
+
+TiledImage::TileKey TiledImage::Key(int level, int tileX, int tileY)
+{
+    return ((TileKey)level << 48) | ((TileKey)tileY << 24) | (TileKey)tileX;
+}
+
+
+void TiledImage::TileRect(int level, int tileX, int tileY,
+                          Vector2f& imageMin, Vector2f& imageMax) const
+{
+    const TiledImageLevel& info = file.Level(level);
+    int tileSize = file.TileSize();
+
+    imageMin = Vector2f((float)(tileX * tileSize) / info.width,
+                        (float)(tileY * tileSize) / info.height);
+    imageMax = Vector2f(
+        (float)std::min((tileX + 1) * tileSize, info.width) / info.width,
+        (float)std::min((tileY + 1) * tileSize, info.height) / info.height);
+}
+
+
+void TiledImage::Update(const Matrix4f& view, const Matrix4f& projection,
+                        float viewportWidth, float viewportHeight)
+{
+    if (!file.IsOpen())
+        return;
+
+    // Upload some of what's been read.  The rest waits for the next frame,
+    // so a burst of tiles doesn't make one frame take forever.
+    std::vector<ReadTile> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        while (!finished.empty() && (int)ready.size() < uploadsPerFrame) {
+            ready.push_back(finished.front());
+            finished.pop_front();
+        }
+    }
+
+    for (const ReadTile& read : ready)
+        Upload(read);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (const ReadTile& read : ready) {
+            freeBuffers.push_back(read.buffer);
+            busy.erase(read.key);
+        }
+    }
+
+    // Pick the tiles to draw
+    missing.clear();
+    drawList.clear();
+
+    int top = file.NumLevels() - 1;
+    const TiledImageLevel& topLevel = file.Level(top);
+
+    for (int y = 0; y < topLevel.tilesY; y++) {
+        for (int x = 0; x < topLevel.tilesX; x++) {
+            if (resident.count(Key(top, x, y)) == 0)
+                missing.push_back(Key(top, x, y));
+        }
+    }
+
+    Matrix4f mvp = projection * view * model;
+
+    for (int y = 0; y < topLevel.tilesY; y++) {
+        for (int x = 0; x < topLevel.tilesX; x++)
+            Select(top, x, y, mvp, viewportWidth, viewportHeight);
+    }
+
+    // Ask for what's missing, coarsest first, so the stand-ins come
+    // quickly.  Whatever we asked for last frame and don't need any more
+    // gets dropped.
+    std::sort(missing.begin(), missing.end(), [](TileKey a, TileKey b) {
+        return KeyLevel(a) != KeyLevel(b) ? KeyLevel(a) > KeyLevel(b)
+                                          : a < b;
+    });
+    missing.erase(std::unique(missing.begin(), missing.end()),
+                  missing.end());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        requests.clear();
+        for (TileKey key : missing) {
+            if (busy.count(key) == 0)
+                requests.push_back(key);
+        }
+    }
+
+    wake.notify_one();
+
+    Evict();
+
+    stats.tilesResident = resident.size();
+    frame++;
+}
+
+
+void TiledImage::Update(Camera& camera, float viewportWidth,
+                        float viewportHeight)
+{
+    Update(camera.View(), camera.Projection(), viewportWidth, viewportHeight);
+}
+
+
+void TiledImage::Select(int level, int tileX, int tileY, const Matrix4f& mvp,
+                        float viewportWidth, float viewportHeight)
+{
+    Vector2f imageMin;
+    Vector2f imageMax;
+    TileRect(level, tileX, tileY, imageMin, imageMax);
+
+    Vector4f corners[4];
+    for (int i = 0; i < 4; i++) {
+        corners[i] = mvp * Vector4f((i & 1) ? imageMax.x() : imageMin.x(),
+                                    (i & 2) ? imageMax.y() : imageMin.y(),
+                                    0.0f, 1.0f);
+    }
+
+    // Outside the view if all of the corners are outside of one plane
+    for (int axis = 0; axis < 3; axis++) {
+        bool allBelow = true;
+        bool allAbove = true;
+
+        for (const Vector4f& c : corners) {
+            allBelow = allBelow && c[axis] < -c.w();
+            allAbove = allAbove && c[axis] > c.w();
+        }
+
+        if (allBelow || allAbove)
+            return;
+    }
+
+    // How many pixels its edges take on the screen, against how many
+    // texels they have.  If a corner is behind us we can't tell, and it's
+    // close enough to want all the detail there is.
+    bool refine = false;
+
+    if (level > 0) {
+        Vector2f screen[4];
+
+        for (int i = 0; i < 4; i++) {
+            if (corners[i].w() <= 1e-6f) {
+                refine = true;
+                break;
+            }
+
+            screen[i] = Vector2f(
+                corners[i].x() / corners[i].w() * 0.5f * viewportWidth,
+                corners[i].y() / corners[i].w() * 0.5f * viewportHeight);
+        }
+
+        if (!refine) {
+            const TiledImageLevel& info = file.Level(level);
+
+            float texelsX = (imageMax.x() - imageMin.x()) * info.width;
+            float texelsY = (imageMax.y() - imageMin.y()) * info.height;
+
+            float pixelsX = std::max((screen[1] - screen[0]).norm(),
+                                     (screen[3] - screen[2]).norm());
+            float pixelsY = std::max((screen[2] - screen[0]).norm(),
+                                     (screen[3] - screen[1]).norm());
+
+            refine = pixelsX > texelsX || pixelsY > texelsY;
+        }
+    }
+
+    if (refine) {
+        const TiledImageLevel& finer = file.Level(level - 1);
+
+        for (int y = tileY * 2; y < std::min(tileY * 2 + 2, finer.tilesY);
+                y++)
+        {
+            for (int x = tileX * 2;
+                    x < std::min(tileX * 2 + 2, finer.tilesX); x++)
+            {
+                Select(level - 1, x, y, mvp, viewportWidth, viewportHeight);
+            }
+        }
+
+        return;
+    }
+
+    AddDrawTile(level, tileX, tileY);
+}
+
+
+// Draw the tile with its own texture if we have it, and with the finest
+// one above it otherwise.
+void TiledImage::AddDrawTile(int level, int tileX, int tileY)
+{
+    std::unordered_map<TileKey, Resident>::iterator found =
+        resident.find(Key(level, tileX, tileY));
+
+    if (found == resident.end()) {
+        missing.push_back(Key(level, tileX, tileY));
+        stats.misses++;
+    }
+
+    int source = level;
+
+    while (found == resident.end() && ++source < file.NumLevels()) {
+        const TiledImageLevel& info = file.Level(source);
+
+        // The levels round down, so the last tiles can hang over the edge
+        // of the one above
+        int shift = source - level;
+        int x = std::min(tileX >> shift, info.tilesX - 1);
+        int y = std::min(tileY >> shift, info.tilesY - 1);
+
+        found = resident.find(Key(source, x, y));
+    }
+
+    if (found == resident.end())
+        return;
+
+    found->second.lastUsed = frame;
+
+    DrawTile draw;
+    draw.texture = found->second.texture.ID();
+    draw.level = source;
+    TileRect(level, tileX, tileY, draw.imageMin, draw.imageMax);
+
+    const TiledImageLevel& info = file.Level(source);
+    float tileSize = (float)file.TileSize();
+
+    Vector2f origin((float)KeyX(found->first) * tileSize,
+                    (float)KeyY(found->first) * tileSize);
+    Vector2f texels((float)info.width, (float)info.height);
+
+    draw.uvMin = (draw.imageMin.cwiseProduct(texels) - origin) / tileSize;
+    draw.uvMax = (draw.imageMax.cwiseProduct(texels) - origin) / tileSize;
+
+    drawList.push_back(draw);
+}
+
+
+void TiledImage::Upload(const ReadTile& read)
+{
+    GLenum err;
+
+    if (resident.count(read.key) != 0)
+        return;
+
+    const Texture::UploadFormat& upload = Texture::PreferredFormat();
+    int tileSize = file.TileSize();
+
+    Resident tile;
+    tile.texture = GLTexture::Create();
+    tile.lastUsed = frame;
+
+    glBindTexture(GL_TEXTURE_2D, tile.texture.ID());
+
+    // Neighbouring tiles don't share texels, so clamp, and don't let the
+    // filtering reach past the edge for mip levels we don't have.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (GLEW_ARB_texture_storage) {
+        glTexStorage2D(GL_TEXTURE_2D, 1, upload.internalFormat,
+                       tileSize, tileSize);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tileSize, tileSize,
+                        upload.format, upload.type,
+                        buffers[read.buffer].data());
+    }
+    else {
+        glTexImage2D(GL_TEXTURE_2D, 0, upload.internalFormat,
+                     tileSize, tileSize, 0, upload.format, upload.type,
+                     buffers[read.buffer].data());
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if ((err = glGetError()) != GL_NO_ERROR) {
+        cout << "TiledImage::Upload(): error: " << err << endl;
+        return;
+    }
+
+    resident[read.key] = std::move(tile);
+    stats.tilesUploaded++;
+}
+
+
+// Get down to maxResident tiles, taking the ones used the longest time ago.
+// We never take the top level, or anything we're drawing with.
+void TiledImage::Evict()
+{
+    if (resident.size() <= maxResident)
+        return;
+
+    int top = file.NumLevels() - 1;
+
+    std::vector<std::pair<uint64_t, TileKey>> victims;
+
+    for (const std::pair<const TileKey, Resident>& tile : resident) {
+        if (KeyLevel(tile.first) != top && tile.second.lastUsed != frame)
+            victims.push_back(std::make_pair(tile.second.lastUsed,
+                                             tile.first));
+    }
+
+    std::sort(victims.begin(), victims.end());
+
+    for (size_t i = 0; i < victims.size() && resident.size() > maxResident;
+            i++)
+    {
+        resident.erase(victims[i].second);
+        stats.tilesEvicted++;
+    }
+}
+
+
+void TiledImage::ReadLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wake.wait(lock, [this]() {
+            return stopping || (!requests.empty() && !freeBuffers.empty());
+        });
+
+        if (stopping)
+            return;
+
+        TileKey key = requests.front();
+        requests.pop_front();
+
+        int buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+
+        busy.insert(key);
+
+        lock.unlock();
+
+        // Reading the mapping is what goes to the disk, so it's done out
+        // here, with the lock let go
+        const unsigned char *rgb = file.Tile(KeyLevel(key), KeyX(key),
+                                             KeyY(key));
+        size_t numPixels = (size_t)file.TileSize() * file.TileSize();
+
+        if (bgra)
+            ConvertRGBToBGRA(rgb, buffers[buffer].data(), numPixels);
+        else
+            ConvertRGBToRGBA(rgb, buffers[buffer].data(), numPixels);
+
+        lock.lock();
+
+        ReadTile read;
+        read.key = key;
+        read.buffer = buffer;
+        finished.push_back(read);
+    }
+}
@@ -0,0 +1,474 @@
+//============================================================================
+// Name        : TiledImageFile.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Writing and reading tiled image files, for images that
+//               don't fit in memory or in a texture.
+//============================================================================
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+
+// this is just to make printing stuff a bit more concise
+// everything else in std, we can call explicitly
+using std::cout;
+using std::endl;
+
+#include "TiledImageFile.hpp"
+
+static_assert(sizeof(TiledImageHeader) == 64,
+              "tiled image header must be 64 bytes");
+
+const uint32_t TiledImageHeader::Magic;
+const uint32_t TiledImageHeader::Version;
+const int TiledImageFile::DefaultTileSize;
+
+
+std::vector<TiledImageLevel> TiledImageFile::Levels(int width, int height,
+                                                    int tileSize,
+                                                    uint64_t dataOffset)
+{
+    std::vector<TiledImageLevel> levels;
+
+    uint64_t offset = dataOffset;
+    uint64_t tileBytes = (uint64_t)tileSize * tileSize * 3;
+
+    while (true) {
+        TiledImageLevel level;
+        level.width = width;
+        level.height = height;
+        level.tilesX = (width + tileSize - 1) / tileSize;
+        level.tilesY = (height + tileSize - 1) / tileSize;
+        level.offset = offset;
+
+        levels.push_back(level);
+        offset += (uint64_t)level.tilesX * level.tilesY * tileBytes;
+
+        if (width <= tileSize && height <= tileSize)
+            break;
+
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    return levels;
+}
+
+
+bool TiledImageFile::Open(const std::string& path)
+{
+    Close();
+
+    if (!file.Open(path))
+        return false;
+
+    TiledImageHeader header;
+
+    if (file.Size() < sizeof(header)) {
+        cout << "TiledImageFile::Open(): " << path
+             << " is too small to be a tiled image" << endl;
+        Close();
+        return false;
+    }
+
+    std::memcpy(&header, file.Data(), sizeof(header));
+
+    if (header.magic != TiledImageHeader::Magic ||
+            header.version != TiledImageHeader::Version)
+    {
+        cout << "TiledImageFile::Open(): " << path
+             << " is not a version " << TiledImageHeader::Version
+             << " tiled image" << endl;
+        Close();
+        return false;
+    }
+
+    if (header.width == 0 || header.height == 0 || header.tileSize == 0 ||
+            header.dataOffset < sizeof(header))
+    {
+        cout << "TiledImageFile::Open(): " << path
+             << " has a bad header" << endl;
+        Close();
+        return false;
+    }
+
+    levels = Levels(header.width, header.height, header.tileSize,
+                    header.dataOffset);
+    tileSize = header.tileSize;
+
+    // Make sure every tile is in the file, so we don't have to check on
+    // every lookup.
+    const TiledImageLevel& last = levels.back();
+    uint64_t end = last.offset +
+                   (uint64_t)last.tilesX * last.tilesY * TileBytes();
+
+    if (levels.size() != header.numLevels || header.fileSize != end ||
+            file.Size() < end)
+    {
+        cout << "TiledImageFile::Open(): " << path
+             << " is the wrong size for its header" << endl;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void TiledImageFile::Close()
+{
+    file.Close();
+
+    tileSize = 0;
+    levels.clear();
+}
+
+
+const unsigned char *TiledImageFile::Tile(int level, int tileX,
+                                          int tileY) const
+{
+    const TiledImageLevel& info = levels[level];
+
+    return file.Data() + info.offset +
+           ((uint64_t)tileY * info.tilesX + tileX) * TileBytes();
+}
+
+
+//
+// TiledImageWriter
+//
+
+bool TiledImageWriter::Open(const std::string& path, int width, int height,
+                            int tileSize)
+{
+    Close();
+
+    if (width <= 0 || height <= 0 || tileSize <= 0) {
+        cout << "TiledImageWriter::Open(): can't make a " << width << "x"
+             << height << " image of " << tileSize << " pixel tiles" << endl;
+        return false;
+    }
+
+    output.open(path.c_str(),
+                std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!output) {
+        cout << "TiledImageWriter::Open(): could not open " << path << endl;
+        return false;
+    }
+
+    this->path = path;
+    this->tileSize = tileSize;
+
+    std::vector<TiledImageLevel> info =
+        TiledImageFile::Levels(width, height, tileSize,
+                               sizeof(TiledImageHeader));
+
+    levels.resize(info.size());
+
+    for (size_t i = 0; i < info.size(); i++) {
+        LevelState& state = levels[i];
+        size_t rowBytes = (size_t)info[i].width * 3;
+
+        state.level = info[i];
+        state.band.resize(rowBytes * std::min(tileSize, info[i].height));
+
+        if (i + 1 < info.size()) {
+            state.pendingRow.resize(rowBytes);
+            state.halfRow.resize((size_t)info[i + 1].width * 3);
+        }
+    }
+
+    tile.resize((size_t)tileSize * tileSize * 3);
+
+    // The header only goes in once we have every row, so a file we
+    // didn't finish won't open.  The tiles go wherever they belong, which
+    // isn't the order we make them in, so make the file its full size.
+    const TiledImageLevel& last = info.back();
+    uint64_t fileSize = last.offset +
+                        (uint64_t)last.tilesX * last.tilesY * tile.size();
+
+    TiledImageHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.seekp(fileSize - 1);
+    output.put(0);
+
+    if (!output.good()) {
+        cout << "TiledImageWriter::Open(): could not write " << path << endl;
+        output.close();
+        levels.clear();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool TiledImageWriter::WriteRows(const unsigned char *rgb, int numRows)
+{
+    if (!output.is_open())
+        return false;
+
+    const TiledImageLevel& full = levels[0].level;
+
+    if (levels[0].rowsDone + numRows > full.height) {
+        cout << "TiledImageWriter::WriteRows(): " << path << " only has "
+             << full.height << " rows" << endl;
+        return false;
+    }
+
+    size_t rowBytes = (size_t)full.width * 3;
+
+    for (int row = 0; row < numRows; row++)
+        AddRow(0, rgb + row * rowBytes);
+
+    if (!output.good()) {
+        cout << "TiledImageWriter::WriteRows(): could not write "
+             << path << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool TiledImageWriter::Close()
+{
+    if (!output.is_open())
+        return false;
+
+    bool complete = true;
+
+    for (const LevelState& state : levels) {
+        if (state.rowsDone != state.level.height)
+            complete = false;
+    }
+
+    if (complete) {
+        const TiledImageLevel& last = levels.back().level;
+
+        TiledImageHeader header;
+        std::memset(&header, 0, sizeof(header));
+
+        header.magic = TiledImageHeader::Magic;
+        header.version = TiledImageHeader::Version;
+        header.width = levels[0].level.width;
+        header.height = levels[0].level.height;
+        header.tileSize = tileSize;
+        header.numLevels = (uint32_t)levels.size();
+        header.dataOffset = sizeof(header);
+        header.fileSize = last.offset +
+                          (uint64_t)last.tilesX * last.tilesY * tile.size();
+
+        output.seekp(0);
+        output.write(reinterpret_cast<const char *>(&header),
+                     sizeof(header));
+    }
+    else {
+        cout << "TiledImageWriter::Close(): " << path << " only got "
+             << levels[0].rowsDone << " of its " << levels[0].level.height
+             << " rows" << endl;
+    }
+
+    output.close();
+
+    bool written = !output.fail();
+    if (!written)
+        cout << "TiledImageWriter::Close(): could not write " << path << endl;
+
+    levels.clear();
+    tile.clear();
+
+    return complete && written;
+}
+
+
+size_t TiledImageWriter::BufferBytes() const
+{
+    size_t bytes = tile.capacity();
+
+    for (const LevelState& state : levels) {
+        bytes += state.band.capacity() + state.pendingRow.capacity() +
+                 state.halfRow.capacity();
+    }
+
+    return bytes;
+}
+
+
+// Put the row in the band of its level, and once we have two of them,
+// average them down into a row of the next level.
+void TiledImageWriter::AddRow(int level, const unsigned char *row)
+{
+    LevelState& state = levels[level];
+    const TiledImageLevel& info = state.level;
+    size_t rowBytes = (size_t)info.width * 3;
+
+    std::memcpy(&state.band[state.bandRows * rowBytes], row, rowBytes);
+    state.bandRows++;
+    state.rowsDone++;
+
+    if (state.bandRows == tileSize || state.rowsDone == info.height)
+        FlushBand(state);
+
+    if (level + 1 == (int)levels.size())
+        return;
+
+    // A level one pixel high only shrinks across.  Otherwise, an odd row
+    // out at the bottom gets dropped, the same as GL does.
+    const unsigned char *above = row;
+
+    if (info.height > 1) {
+        if (!state.hasPendingRow) {
+            std::memcpy(state.pendingRow.data(), row, rowBytes);
+            state.hasPendingRow = true;
+            return;
+        }
+
+        above = state.pendingRow.data();
+        state.hasPendingRow = false;
+    }
+
+    int halfWidth = levels[level + 1].level.width;
+    unsigned char *half = state.halfRow.data();
+
+    for (int x = 0; x < halfWidth; x++) {
+        size_t left = (size_t)2 * x * 3;
+        size_t right = (size_t)std::min(2 * x + 1, info.width - 1) * 3;
+
+        for (int c = 0; c < 3; c++) {
+            half[x * 3 + c] = (unsigned char)
+                ((above[left + c] + above[right + c] +
+                  row[left + c] + row[right + c] + 2) >> 2);
+        }
+    }
+
+    AddRow(level + 1, half);
+}
+
+
+// Cut a full band of rows into tiles, and write them where they go
+void TiledImageWriter::FlushBand(LevelState& state)
+{
+    const TiledImageLevel& info = state.level;
+    size_t rowBytes = (size_t)info.width * 3;
+    size_t tileRowBytes = (size_t)tileSize * 3;
+
+    for (int tileX = 0; tileX < info.tilesX; tileX++) {
+        int x0 = tileX * tileSize;
+        int columns = std::min(tileSize, info.width - x0);
+
+        for (int y = 0; y < tileSize; y++) {
+            const unsigned char *src = &state.band[
+                std::min(y, state.bandRows - 1) * rowBytes + x0 * 3];
+            unsigned char *dst = &tile[y * tileRowBytes];
+
+            std::memcpy(dst, src, columns * 3);
+
+            const unsigned char *edge = dst + (columns - 1) * 3;
+            for (int x = columns; x < tileSize; x++)
+                std::memcpy(dst + x * 3, edge, 3);
+        }
+
+        uint64_t offset = info.offset +
+                          ((uint64_t)state.bandIndex * info.tilesX + tileX) *
+                          tile.size();
+
+        output.seekp(offset);
+        output.write(reinterpret_cast<const char *>(tile.data()),
+                     tile.size());
+    }
+
+    state.bandRows = 0;
+    state.bandIndex++;
+}
+
+
+namespace {
+    // The next number in a PPM header, skipping whitespace and comments
+    bool ReadPPMNumber(std::istream& input, int& value)
+    {
+        int c = input.get();
+
+        while (c != EOF && (std::isspace(c) || c == '#')) {
+            if (c == '#') {
+                while (c != EOF && c != '\n')
+                    c = input.get();
+            }
+            c = input.get();
+        }
+
+        if (c == EOF || !std::isdigit(c))
+            return false;
+
+        value = 0;
+        while (c != EOF && std::isdigit(c)) {
+            value = value * 10 + (c - '0');
+            c = input.get();
+        }
+
+        // The one whitespace character after the number is part of it
+        return c != EOF && std::isspace(c);
+    }
+}
+
+
+bool TiledImageWriter::ConvertPPM(const std::string& ppmPath,
+                                  const std::string& tiledPath,
+                                  int tileSize)
+{
+    std::ifstream input(ppmPath.c_str(), std::ios::in | std::ios::binary);
+
+    if (!input) {
+        cout << "TiledImageWriter::ConvertPPM(): could not open "
+             << ppmPath << endl;
+        return false;
+    }
+
+    int width = 0;
+    int height = 0;
+    int maxValue = 0;
+
+    char magic[2] = {0};
+    input.read(magic, 2);
+
+    if (magic[0] != 'P' || magic[1] != '6' ||
+            !ReadPPMNumber(input, width) || !ReadPPMNumber(input, height) ||
+            !ReadPPMNumber(input, maxValue) || maxValue != 255)
+    {
+        cout << "TiledImageWriter::ConvertPPM(): " << ppmPath
+             << " is not an 8 bit binary PPM" << endl;
+        return false;
+    }
+
+    TiledImageWriter writer;
+    if (!writer.Open(tiledPath, width, height, tileSize))
+        return false;
+
+    // A band of tiles' worth of rows at a time
+    size_t rowBytes = (size_t)width * 3;
+    std::vector<unsigned char> rows(rowBytes * std::min(tileSize, height));
+
+    for (int y = 0; y < height; y += tileSize) {
+        int numRows = std::min(tileSize, height - y);
+
+        input.read(reinterpret_cast<char *>(rows.data()),
+                   rowBytes * numRows);
+
+        if (!input) {
+            cout << "TiledImageWriter::ConvertPPM(): " << ppmPath
+                 << " ends at row " << y << endl;
+            return false;
+        }
+
+        if (!writer.WriteRows(rows.data(), numRows))
+            return false;
+    }
+
+    return writer.Close();
+}
@@ -0,0 +1,78 @@
+//============================================================================
+// Name        : TreeHash.cpp
+// Author      : James L. Makela
+// Version     : 0.1.1
+// Copyright   : LGPL v3.0
+// Description : Hashes chunks of a buffer in parallel, and then the chunk
+//               hashes.
+//============================================================================
+
+#include <vector>
+#include <algorithm>
+
+#include "SpookyV2.h"
+#include "MappedFile.hpp"
+#include "TreeHash.hpp"
+
+const size_t TreeHash::DefaultChunkSize;
+
+
+TreeHash::TreeHash(JobSystem *jobs, size_t chunkSize)
+    : jobs(jobs), chunkSize(std::max<size_t>(chunkSize, 1))
+{
+}
+
+
+void TreeHash::Hash(const void *data, size_t size,
+                    uint64_t& hash1, uint64_t& hash2) const
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+
+    // Even nothing is a chunk, so every hash has the same shape
+    size_t numChunks = std::max<size_t>((size + chunkSize - 1) / chunkSize,
+                                        1);
+
+    // Two words for each chunk, in the chunks' order
+    std::vector<uint64> chunkHashes(numChunks * 2);
+
+    auto hashChunks = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            size_t offset = std::min(i * chunkSize, size);
+            size_t length = std::min(chunkSize, size - offset);
+
+            // Seeding with the chunk's index means two chunks with the
+            // same bytes still hash differently
+            uint64 chunk1 = i;
+            uint64 chunk2 = chunkSize;
+            SpookyHash::Hash128(bytes + offset, length, &chunk1, &chunk2);
+
+            chunkHashes[i * 2] = chunk1;
+            chunkHashes[i * 2 + 1] = chunk2;
+        }
+    };
+
+    if (jobs != nullptr && numChunks > 1)
+        jobs->ParallelFor(0, numChunks, 1, hashChunks);
+    else
+        hashChunks(0, numChunks);
+
+    uint64 root1 = size;
+    uint64 root2 = chunkSize;
+    SpookyHash::Hash128(chunkHashes.data(),
+                        chunkHashes.size() * sizeof(uint64), &root1, &root2);
+
+    hash1 = root1;
+    hash2 = root2;
+}
+
+
+bool TreeHash::HashFile(const std::string& path,
+                        uint64_t& hash1, uint64_t& hash2) const
+{
+    MappedFile file;
+    if (!file.Open(path))
+        return false;
+
+    Hash(file.Data(), file.Size(), hash1, hash2);
+    return true;
+}